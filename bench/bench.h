@@ -0,0 +1,16 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+
+// Average wall time of reps calls of f in milliseconds
+template<typename F>
+double timeMs(F&& f, int reps = 1) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; ++i) f();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count() / reps;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#include "bench.h"
+#include "cas.h"
+#include "compiled.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+// Relative error the adaptive evaluation is asked for and checked against
+constexpr number_t tolerance = 1e-12;
+
+int main() {
+    bool passed = true;
+    CAS cas;
+    constexpr size_t rows = 1 << 20;
+    // Rows checked against a multiprecision reference, which is far too slow for all of them
+    constexpr size_t checked = 4096;
+
+    // In every case about one row in a hundred is ill-conditioned
+    struct Case {
+        const char* formula;
+        number_t (*x)(std::mt19937_64&, bool bad);
+    };
+    std::vector<Case> cases = {
+        { "z = sqrt(x^2 + y^2)", [](std::mt19937_64& rng, bool) { return number_t(std::uniform_real_distribution<double>(-10, 10)(rng)); } },
+        { "z = sqrt(x^2 + y) - x", [](std::mt19937_64& rng, bool bad) {
+            return number_t(bad ? std::uniform_real_distribution<double>(1e6, 1e9)(rng) : std::uniform_real_distribution<double>(0, 10)(rng));
+        } },
+        { "z = (1 - cos(x)) / x^2", [](std::mt19937_64& rng, bool bad) {
+            return number_t(bad ? std::uniform_real_distribution<double>(1e-3, 1e-2)(rng) : std::uniform_real_distribution<double>(0.5, 3)(rng));
+        } },
+        // Well-conditioned where it looks like it is not, x - 1 is exact near 1
+        { "z = ln(x) / (x - 1) + sin(y)", [](std::mt19937_64& rng, bool bad) {
+            return number_t(bad ? 1 + std::uniform_real_distribution<double>(-1e-9, 1e-9)(rng) : std::uniform_real_distribution<double>(2, 10)(rng));
+        } },
+    };
+
+    number_t checksum = 0;
+    for (const auto& c : cases) {
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> dist(0.5, 2);
+        std::bernoulli_distribution bad(0.01);
+        std::vector<number_t> x(rows), y(rows);
+        for (size_t i = 0; i < rows; ++i) {
+            x[i] = c.x(rng, bad(rng));
+            y[i] = dist(rng);
+        }
+
+        auto expr = cas.compile(c.formula);
+        std::vector<std::span<const number_t>> columns;
+        for (const auto& symbol : expr->symbols()) columns.emplace_back(symbol == "x" ? x : y);
+
+        std::vector<number_t> plain(rows), adaptive(rows);
+        PrecisionCounts counts;
+        double plainMs = timeMs([&] { expr->evaluateBatch(columns, plain); }, 3);
+        double adaptiveMs = timeMs([&] { counts = expr->evaluateAdaptive(columns, adaptive, Tolerance{ .relative = tolerance }); }, 3);
+
+        std::vector<std::span<const number_t>> sample;
+        for (const auto& column : columns) sample.push_back(column.first(checked));
+        std::vector<number_t> reference(checked);
+        expr->evaluateAdaptive(sample, reference, Tolerance{ .relative = 1e-18 });
+        number_t plainError = 0, adaptiveError = 0;
+        for (size_t i = 0; i < checked; ++i) {
+            number_t scale = std::max(std::abs(reference[i]), number_t(1e-300));
+            plainError = std::max(plainError, std::abs(plain[i] - reference[i]) / scale);
+            adaptiveError = std::max(adaptiveError, std::abs(adaptive[i] - reference[i]) / scale);
+        }
+        for (number_t value : adaptive) checksum += value;
+        passed = passed && adaptiveError <= tolerance;
+
+        std::cout << c.formula << ": long double " << plainMs << " ms, adaptive " << adaptiveMs << " ms (" << plainMs / adaptiveMs << "x); "
+                  << counts.doubleRows << " rows in double, " << counts.longDoubleRows << " in long double, " << counts.preciseRows
+                  << " in multiprecision, " << counts.unresolvedRows << " unresolved; max relative error of " << checked
+                  << " rows: long double " << static_cast<double>(plainError) << ", adaptive " << static_cast<double>(adaptiveError) << '\n';
+    }
+    std::cout << "checksum " << static_cast<double>(checksum) << '\n';
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#include "bench.h"
+#include "cas.h"
+#include "context.h"
+
+#include <iostream>
+
+number_t fib(number_t n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+int main() {
+    CAS cas;
+    cas.define("f(x, y) = x^2 + 2*x*y + y^2");
+    cas.define("g(0) = 0");
+    cas.define("g(1) = 1");
+    cas.define("g(n) = g(n-1) + g(n-2)");
+    cas.setVariable("a", 1.5);
+    cas.setVariable("b", 2.5);
+
+    // An inlined call should cost the same as the body written out
+    constexpr int reps = 200000;
+    EvalContext context(cas.variables());
+    auto call = cas.compile("f(a, b) + f(b, a)");
+    auto written = cas.compile("a^2 + 2*a*b + b^2 + b^2 + 2*b*a + a^2");
+    std::cout << "inlined call: " << timeMs([&] { context.evaluate(*call); }, reps) * 1e6 << " ns, written out: "
+              << timeMs([&] { context.evaluate(*written); }, reps) * 1e6 << " ns\n";
+
+    // Memoization turns the exponential recursion linear, the cache of a context is reused while n is unchanged
+    for (int n : { 20, 25, 30 }) {
+        cas.setVariable("n", n);
+        auto recursive = cas.compile("g(n)");
+        EvalContext fresh(cas.variables());
+        double memoMs = timeMs([&] { fresh.evaluate(*recursive); });
+        double cachedMs = timeMs([&] { fresh.evaluate(*recursive); }, 100);
+        double naiveMs = timeMs([&] { fib(n); });
+        std::cout << "g(" << n << "): memoized " << memoMs << " ms, repeated " << cachedMs << " ms, naive C++ recursion " << naiveMs << " ms\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "cas.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Central differences with a step of 1e-6 lose about eps/1e-6 of the value to rounding, around 1e-10 here
+constexpr number_t maxDifference = 1e-8;
+
+int main() {
+    bool passed = true;
+    // A chain of n variables coupled to their neighbours, the shape of a typical loss function
+    for (size_t n : { 10, 100, 1000 }) {
+        std::string formula;
+        for (size_t i = 0; i < n; ++i) {
+            std::string x = "x_" + std::to_string(i), next = "x_" + std::to_string((i + 1) % n);
+            formula += (i ? " + " : "") + ("(" + x + " - " + next + ")^2 + sin(" + x + ")" + x);
+        }
+
+        CAS cas;
+        auto compiled = cas.compile(formula);
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> dist(-1, 1);
+        std::vector<number_t> slots(n), gradient(n), differences(n);
+        for (number_t& x : slots) x = dist(rng);
+
+        constexpr int reps = 20;
+        number_t sum = 0;
+        double evaluateMs = timeMs([&] { sum += compiled->evaluate(slots); }, reps);
+        double reverseMs = timeMs([&] { sum += compiled->gradient(slots, gradient); }, reps);
+        // Central differences need two evaluations per variable
+        double differenceMs = timeMs([&] {
+            std::vector<number_t> shifted = slots;
+            for (size_t i = 0; i < n; ++i) {
+                number_t h = 1e-6;
+                shifted[i] = slots[i] + h;
+                number_t up = compiled->evaluate(shifted);
+                shifted[i] = slots[i] - h;
+                differences[i] = (up - compiled->evaluate(shifted)) / (2 * h);
+                shifted[i] = slots[i];
+            }
+        }, reps);
+
+        number_t error = 0;
+        for (size_t i = 0; i < n; ++i) error = std::max(error, std::abs(gradient[i] - differences[i]));
+        passed = passed && error <= maxDifference;
+        std::cout << n << " variables: evaluate " << evaluateMs << " ms, reverse mode " << reverseMs << " ms ("
+                  << reverseMs / evaluateMs << "x), central differences " << differenceMs << " ms ("
+                  << differenceMs / reverseMs << "x slower), max difference " << static_cast<double>(error) << '\n';
+        std::cout << "checksum " << static_cast<double>(sum) << '\n';
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#include "bench.h"
+#include "cas.h"
+#include "linear.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Elimination in long double leaves residuals of around 1e-15 on these systems
+constexpr number_t maxResidual = 1e-12;
+
+// Textbook right-looking elimination, one pass over the trailing matrix per column
+void unblockedSolve(std::vector<number_t>& a, std::vector<number_t>& b, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+        size_t pivot = k;
+        for (size_t i = k + 1; i < n; ++i) if (std::abs(a[i * n + k]) > std::abs(a[pivot * n + k])) pivot = i;
+        for (size_t j = 0; j < n; ++j) std::swap(a[pivot * n + j], a[k * n + j]);
+        std::swap(b[pivot], b[k]);
+        for (size_t i = k + 1; i < n; ++i) {
+            number_t l = a[i * n + k] /= a[k * n + k];
+            for (size_t j = k + 1; j < n; ++j) a[i * n + j] -= l * a[k * n + j];
+            b[i] -= l * b[k];
+        }
+    }
+    for (size_t i = n; i-- > 0; ) {
+        for (size_t j = i + 1; j < n; ++j) b[i] -= a[i * n + j] * b[j];
+        b[i] /= a[i * n + i];
+    }
+}
+
+int main() {
+    bool passed = true;
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-1, 1);
+
+    for (size_t n : { 200, 500, 1000 }) {
+        std::vector<number_t> a(n * n), b(n);
+        for (number_t& x : a) x = dist(rng);
+        for (number_t& x : b) x = dist(rng);
+
+        auto blocked = a, unblocked = a;
+        auto blockedB = b, unblockedB = b;
+        double blockedMs = timeMs([&] { linear::solveDense(blocked, blockedB, n); });
+        double unblockedMs = timeMs([&] { unblockedSolve(unblocked, unblockedB, n); });
+
+        number_t residual = 0;
+        for (size_t i = 0; i < n; ++i) {
+            number_t sum = -b[i];
+            for (size_t j = 0; j < n; ++j) sum += a[i * n + j] * blockedB[j];
+            residual = std::max(residual, std::abs(sum));
+        }
+        passed = passed && residual <= maxResidual;
+        std::cout << "dense " << n << ": blocked LU " << blockedMs << " ms, unblocked " << unblockedMs << " ms ("
+                  << unblockedMs / blockedMs << "x), max residual " << static_cast<double>(residual) << '\n';
+    }
+
+    // Poisson equation on a grid, five unknowns per equation, typed as text and solved end to end
+    for (size_t side : { 20, 50, 70 }) {
+        auto name = [&](size_t i, size_t j) { return "u_" + std::to_string(i * side + j); };
+        std::vector<std::string> equations;
+        for (size_t i = 0; i < side; ++i) {
+            for (size_t j = 0; j < side; ++j) {
+                std::string equation = "4" + name(i, j);
+                if (i > 0) equation += " - " + name(i - 1, j);
+                if (i + 1 < side) equation += " - " + name(i + 1, j);
+                if (j > 0) equation += " - " + name(i, j - 1);
+                if (j + 1 < side) equation += " - " + name(i, j + 1);
+                equations.push_back(equation + " = 1");
+            }
+        }
+
+        CAS cas;
+        std::vector<std::pair<std::string, number_t>> solution;
+        double solveMs = timeMs([&] { solution = cas.solve(equations); });
+        number_t residual = 0;
+        for (size_t i = 0; i < side; ++i) {
+            for (size_t j = 0; j < side; ++j) {
+                number_t sum = 4 * cas.getVariable(name(i, j)) - 1;
+                if (i > 0) sum -= cas.getVariable(name(i - 1, j));
+                if (i + 1 < side) sum -= cas.getVariable(name(i + 1, j));
+                if (j > 0) sum -= cas.getVariable(name(i, j - 1));
+                if (j + 1 < side) sum -= cas.getVariable(name(i, j + 1));
+                residual = std::max(residual, std::abs(sum));
+            }
+        }
+        passed = passed && residual <= maxResidual;
+        std::cout << "grid " << side << "x" << side << " (" << equations.size() << " unknowns): parse and sparse solve "
+                  << solveMs << " ms, center " << static_cast<double>(cas.getVariable(name(side / 2, side / 2)))
+                  << ", max residual " << static_cast<double>(residual) << '\n';
+
+        if (side <= 20) {
+            size_t n = equations.size();
+            std::vector<number_t> a(n * n, 0), b(n, 1);
+            for (size_t i = 0; i < side; ++i) {
+                for (size_t j = 0; j < side; ++j) {
+                    size_t row = i * side + j;
+                    a[row * n + row] = 4;
+                    if (i > 0) a[row * n + row - side] = -1;
+                    if (i + 1 < side) a[row * n + row + side] = -1;
+                    if (j > 0) a[row * n + row - 1] = -1;
+                    if (j + 1 < side) a[row * n + row + 1] = -1;
+                }
+            }
+            double denseMs = timeMs([&] { linear::solveDense(a, b, n); });
+            std::cout << "  same system dense: " << denseMs << " ms\n";
+        }
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "cas.h"
+#include "mapper.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+int main() {
+    CAS cas;
+    cas.setVariable("k", 0.5);
+    auto expr = cas.compile("y = a*x^2 + b*x + k");
+
+    // Block-at-a-time interpretation against one execute per row
+    constexpr size_t rows = 1 << 20;
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-100, 100);
+    std::vector<std::vector<number_t>> columns(expr->symbols().size(), std::vector<number_t>(rows));
+    for (auto& column : columns) for (number_t& x : column) x = dist(rng);
+
+    std::vector<number_t> out(rows);
+    double rowMs = timeMs([&] {
+        std::vector<number_t> slots(columns.size());
+        for (size_t row = 0; row < rows; ++row) {
+            for (size_t i = 0; i < slots.size(); ++i) slots[i] = columns[i][row];
+            out[row] = expr->evaluate(slots);
+        }
+    });
+    std::vector<std::span<const number_t>> spans(columns.begin(), columns.end());
+    double batchMs = timeMs([&] { expr->evaluateBatch(spans, out); });
+    std::cout << "evaluate " << rows << " rows: per row " << rowMs << " ms, batched " << batchMs << " ms (" << rowMs / batchMs << "x)\n";
+
+    // End to end on a generated file, parsing and formatting dominate
+    auto input = std::filesystem::temp_directory_path() / "cas_bench_map.csv";
+    auto output = std::filesystem::temp_directory_path() / "cas_bench_map.out";
+    {
+        std::ofstream file(input);
+        file << "a,b,x,unused\n";
+        for (size_t row = 0; row < rows; ++row) file << dist(rng) << ',' << dist(rng) << ',' << dist(rng) << ",0\n";
+    }
+    double megabytes = std::filesystem::file_size(input) / 1e6;
+    for (size_t threads : { 1, 0 }) {
+        CsvMapper mapper(cas, "y = a*x^2 + b*x + k", threads);
+        double ms = timeMs([&] { mapper.run(input.string(), output.string()); });
+        std::cout << "map " << megabytes << " MB with " << (threads ? std::to_string(threads) : std::string("all")) << " threads: "
+                  << ms << " ms (" << megabytes / ms * 1000 << " MB/s)\n";
+    }
+
+    std::filesystem::remove(input);
+    std::filesystem::remove(output);
+    return 0;
+}
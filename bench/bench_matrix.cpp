@@ -0,0 +1,50 @@
+#include "bench.h"
+#include "value.h"
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+Value randomMatrix(std::mt19937_64& rng, size_t rows, size_t cols) {
+    std::uniform_real_distribution<double> dist(-1, 1);
+    std::vector<number_t> elements(rows * cols);
+    for (number_t& x : elements) x = dist(rng);
+    return Value::matrix(rows, cols, std::move(elements));
+}
+
+int main() {
+    std::mt19937_64 rng(42);
+
+    // The blocked kernel against the textbook i-j-k loop, whose inner loop strides down a column of b
+    for (size_t n : { 64, 256, 512 }) {
+        Value a = randomMatrix(rng, n, n), b = randomMatrix(rng, n, n);
+
+        std::vector<number_t> naive(n * n);
+        double naiveMs = timeMs([&] {
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t j = 0; j < n; ++j) {
+                    number_t sum = 0;
+                    for (size_t p = 0; p < n; ++p) sum += a(i, p) * b(p, j);
+                    naive[i * n + j] = sum;
+                }
+            }
+        });
+
+        Value product;
+        double blockedMs = timeMs([&] { product = Value::matmul(a, b); });
+
+        double gflop = 2.0 * n * n * n / 1e9;
+        std::cout << "matmul " << n << "x" << n << ": naive " << naiveMs << " ms, blocked " << blockedMs << " ms ("
+                  << gflop / blockedMs * 1000 << " GFLOP/s, " << naiveMs / blockedMs << "x)\n";
+    }
+
+    // Element-wise work on a dataset, the case that replaces one calc per element
+    constexpr size_t size = 1 << 20;
+    Value x = randomMatrix(rng, 1, size), y = randomMatrix(rng, 1, size), row = randomMatrix(rng, 1, 1024);
+    Value grid = randomMatrix(rng, size / 1024, 1024);
+    std::cout << "x + y on " << size << " elements: " << timeMs([&] { Value z = x + y; }, 10) << " ms\n";
+    std::cout << "grid + row broadcast: " << timeMs([&] { Value z = grid + row; }, 10) << " ms\n";
+    std::cout << "mean and stdev: " << timeMs([&] { x.mean(); x.stdev(); }, 10) << " ms\n";
+
+    return 0;
+}
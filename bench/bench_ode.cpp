@@ -0,0 +1,96 @@
+#include "bench.h"
+#include "cas.h"
+#include "ode.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The global error of an adaptive method grows over the hundred time units well beyond its per-step
+// tolerance, but stays within this factor of it
+constexpr number_t maxErrorFactor = 100;
+
+int main() {
+    bool passed = true;
+    CAS cas;
+
+    // Harmonic oscillator, the samples are compared to cos and sin
+    {
+        auto system = cas.odeSystem({ "x = -y", "y = x" });
+        std::vector<number_t> initial{ 1, 0 };
+        for (number_t tolerance : { 1e-6L, 1e-10L }) {
+            OdeOptions options{ .relativeTolerance = tolerance, .absoluteTolerance = tolerance * 1e-3L };
+            Trajectory trajectory;
+            double ms = timeMs([&] { trajectory = system.integrate(initial, 0, 100, 1000, options); });
+
+            number_t error = 0;
+            for (size_t i = 0; i < trajectory.times.size(); ++i) {
+                error = std::max(error, std::abs(trajectory.states[2 * i] - std::cos(trajectory.times[i])));
+                error = std::max(error, std::abs(trajectory.states[2 * i + 1] - std::sin(trajectory.times[i])));
+            }
+            passed = passed && error <= maxErrorFactor * tolerance;
+            std::cout << "oscillator, tolerance " << static_cast<double>(tolerance) << ": " << trajectory.steps << " steps ("
+                      << trajectory.rejected << " rejected) in " << ms << " ms, " << ms * 1e6 / trajectory.steps
+                      << " ns per step, max error over 1001 samples " << static_cast<double>(error) << '\n';
+        }
+    }
+
+    // Van der Pol with a large damping, stiff on the slow parts of its limit cycle
+    for (number_t mu : { 10, 100, 1000 }) {
+        cas.setVariable("m", mu);
+        auto system = cas.odeSystem({ "x = y", "y = m*(1 - x^2)*y - x" });
+        std::vector<number_t> initial{ 2, 0 };
+        number_t end = 2 * mu;
+
+        for (bool stiff : { false, true }) {
+            OdeOptions options{ .relativeTolerance = 1e-6L, .absoluteTolerance = 1e-6L, .stiff = stiff, .maxSteps = 2000000 };
+            Trajectory trajectory;
+            std::string outcome;
+            double ms = timeMs([&] {
+                try {
+                    trajectory = system.integrate(initial, 0, end, 10, options);
+                }
+                catch (const std::runtime_error& error) {
+                    outcome = error.what();
+                }
+            });
+            std::cout << "van der Pol mu = " << static_cast<double>(mu) << (stiff ? ", Rosenbrock: " : ", Dormand-Prince: ");
+            if (!outcome.empty()) std::cout << outcome << " after " << ms << " ms\n";
+            else std::cout << trajectory.steps << " steps (" << trajectory.rejected << " rejected) in " << ms << " ms, x(" << static_cast<double>(end)
+                           << ") = " << static_cast<double>(trajectory.states[trajectory.states.size() - 2]) << '\n';
+        }
+    }
+
+    // Parameter study: Lorenz attractor from many starting points
+    {
+        cas.setVariable("s", 10);
+        cas.setVariable("r", 28);
+        cas.setVariable("b", 8.0L / 3);
+        auto system = cas.odeSystem({ "x = s*(y - x)", "y = x*(r - z) - y", "z = x*y - b*z" });
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> dist(-10, 10);
+        std::vector<std::vector<number_t>> initial(256);
+        for (auto& state : initial) state = { dist(rng), dist(rng), dist(rng) + 25 };
+
+        double serialMs = 0;
+        number_t checksum = 0;
+        for (size_t threads : { 1u, std::max(1u, std::thread::hardware_concurrency()) }) {
+            std::vector<Trajectory> trajectories;
+            double ms = timeMs([&] { trajectories = system.integrateBatch(initial, 0, 20, 100, {}, threads); });
+            if (threads == 1) serialMs = ms;
+            size_t steps = 0;
+            for (const auto& trajectory : trajectories) {
+                steps += trajectory.steps;
+                checksum += trajectory.states.back();
+            }
+            std::cout << "lorenz, " << initial.size() << " starting points on " << threads << " threads: " << ms << " ms ("
+                      << serialMs / ms << "x), " << steps << " steps\n";
+        }
+        std::cout << "checksum " << static_cast<double>(checksum) << '\n';
+    }
+    return passed ? 0 : 1;
+}
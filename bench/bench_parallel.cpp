@@ -0,0 +1,88 @@
+#include "bench.h"
+#include "cas.h"
+#include "lexer.h"
+#include "calculate.h"
+#include "forkjoin.h"
+
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Random formula of about 2^depth leaves, the shape of generated code rather than of typed input
+std::string generate(std::mt19937_64& rng, int depth) {
+    if (depth == 0) {
+        switch (rng() % 4) {
+            case 0:  return "x";
+            case 1:  return "y";
+            default: return std::to_string(rng() % 1000 / 100.0);
+        }
+    }
+    static const char* ops[] = { " + ", " - ", " * ", " + " };
+    std::string lhs = generate(rng, depth - 1), rhs = generate(rng, depth - 1);
+    if (rng() % 16 == 0) return "sin(" + lhs + ops[rng() % 4] + rhs + ")";
+    return "(" + lhs + ops[rng() % 4] + rhs + ")";
+}
+
+// Left-leaning sum of small terms, as deep as it is long, and its value added up from left to right
+std::pair<std::string, number_t> chain(std::mt19937_64& rng, int terms, number_t x, number_t y) {
+    std::string text = "x";
+    number_t value = x;
+    for (int i = 1; i < terms; ++i) {
+        bool plus = rng() % 2, useX = rng() % 2;
+        text += (plus ? " + " : " - ") + std::to_string(i) + (useX ? "*x" : "*y");
+        number_t term = static_cast<number_t>(i) * (useX ? x : y);
+        value = plus ? value + term : value - term;
+    }
+    return { text, value };
+}
+
+int main() {
+    std::mt19937_64 rng(42);
+    std::unordered_map<std::string, number_t> variables{ { "x", 0.25 }, { "y", -0.5 } };
+
+    // Expressions and, where eval cannot compute it, their value
+    std::vector<std::pair<std::string, std::optional<number_t>>> cases;
+    for (int depth : { 16, 20 }) {
+        std::string text = generate(rng, depth);
+        // A chain of such trees, each term on the right of a long left-leaning sum
+        for (int i = 0; i < 8; ++i) text += " + " + generate(rng, depth - 4);
+        cases.emplace_back(std::move(text), std::nullopt);
+    }
+    // eval recurses once per term of this one and runs out of stack
+    cases.push_back(chain(rng, 1000000, variables["x"], variables["y"]));
+
+    bool allIdentical = true;
+    for (const auto& [text, value] : cases) {
+        Lexer lexer(text);
+        Parser parser(lexer.tokenize());
+        NodeExpr* tree = parser.parse()->rhs;
+
+        number_t serial = value.value_or(0);
+        double serialMs = 0;
+        if (!value) serialMs = timeMs([&] { serial = calculateExpr::eval(tree, variables); });
+        calculateExpr::ParallelPlan plan;
+        double planMs = timeMs([&] { plan = calculateExpr::planParallel(tree); });
+        std::cout << text.size() / 1000 << " kB expression: serial ";
+        if (value) std::cout << "out of stack";
+        else std::cout << serialMs << " ms";
+        std::cout << ", planning " << planMs << " ms once\n";
+
+        for (size_t threads : { 1u, 2u, 4u, std::max(1u, std::thread::hardware_concurrency()) }) {
+            ForkJoinPool pool(threads);
+            number_t parallel = 0;
+            double parallelMs = timeMs([&] { parallel = calculateExpr::evalParallel(plan, pool, variables); });
+            // Without a serial time the speedup is relative to one thread
+            if (serialMs == 0) serialMs = parallelMs;
+            bool identical = std::memcmp(&serial, &parallel, 10) == 0;
+            allIdentical = allIdentical && identical;
+            std::cout << "  " << threads << " threads: " << parallelMs << " ms (" << serialMs / parallelMs << "x), "
+                      << (identical ? "bit-identical" : "DIFFERENT") << '\n';
+        }
+    }
+    return allIdentical ? 0 : 1;
+}
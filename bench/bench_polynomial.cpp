@@ -0,0 +1,102 @@
+#include "bench.h"
+#include "types.h"
+#include "lexer.h"
+#include "parser.h"
+#include "calculate.h"
+#include "compiled.h"
+#include "polynomial.h"
+
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Horner, the compiled code and the tree round differently, by far less than this relative to the value
+constexpr number_t maxRelativeDifference = 1e-12;
+
+// Trees live as long as their arena, these until the end of the run
+std::vector<std::shared_ptr<AstArena>> trees;
+
+NodeExpr* parseExpr(const std::string& src) {
+    Lexer lexer(src);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+
+    NodeExpr* expr = parser.parse()->rhs;
+    trees.push_back(parser.arena());
+    return expr;
+}
+
+bool close(number_t value, number_t reference) {
+    return std::abs(value - reference) <= maxRelativeDifference * std::abs(reference);
+}
+
+std::string denseSum(int degree) {
+    std::string src = "1";
+    for (int k = 1; k <= degree; ++k) src += " + " + std::to_string(k % 7 + 1) + "x^" + std::to_string(k);
+    return src;
+}
+
+int main() {
+    bool passed = true;
+    volatile number_t sink = 0;
+    std::unordered_map<std::string, number_t> vars = { { "x", 0.999L }, { "y", 1.001L }, { "z", 0.5L } };
+
+    std::cout << "Univariate evaluation (per call)\n";
+    for (int degree : { 8, 64, 512, 4096 }) {
+        auto expr = parseExpr(denseSum(degree));
+        auto poly = Polynomial::fromExpr(expr, false).value();
+        auto coeffs = poly.denseCoefficients();
+
+        double tree = timeMs([&] { sink = sink + calculateExpr::eval(expr, vars); }, 20);
+        double horner = timeMs([&] { sink = sink + polynomial::horner(coeffs, 0.999L); }, 2000);
+
+        // Compilation recognizes the polynomial and emits it in Horner form
+        auto compiled = CompiledExpr::compile(expr);
+        number_t slot = 0.999L;
+        double code = timeMs([&] { sink = sink + compiled.evaluate(std::span(&slot, 1)); }, 2000);
+        number_t reference = polynomial::horner(coeffs, slot), compiledValue = compiled.evaluate(std::span(&slot, 1));
+        number_t treeValue = calculateExpr::eval(expr, vars);
+        passed = passed && close(compiledValue, reference) && close(treeValue, reference);
+
+        std::cout << "  degree " << degree << ": tree " << tree * 1000 << " us, horner " << horner * 1000
+                  << " us, compiled " << code * 1000 << " us in " << compiled.code().size() << " instructions, off horner by "
+                  << static_cast<double>(compiledValue - reference) << ", tree by " << static_cast<double>(treeValue - reference) << "\n";
+    }
+
+    std::cout << "Sparse univariate evaluation (per call)\n";
+    {
+        auto poly = Polynomial::fromExpr(parseExpr("x^60000 + 3x^30000 - x^7 + 2"), false).value();
+        double ms = timeMs([&] { sink = sink + poly.evaluate(0.999999L); }, 2000);
+        std::cout << "  4 terms, degree 60000: " << ms * 1000 << " us\n";
+    }
+
+    std::cout << "Expansion\n";
+    // With the number of terms each must expand to
+    std::pair<const char*, size_t> expansions[] = {
+        { "(x+1)^256", 257 }, { "(x+1)^2048", 2049 }, { "(x+y+z+1)^12", 455 }, { "(x+y+z+1)^24", 2925 }, { "(x^1000+y^1000+z^1000+x*y*z)^6", 84 },
+    };
+    for (auto [src, expected] : expansions) {
+        auto expr = parseExpr(src);
+        size_t terms = 0;
+        double ms = timeMs([&] { terms = Polynomial::fromExpr(expr).value().terms().size(); });
+        passed = passed && terms == expected;
+        std::cout << "  " << src << ": " << terms << " terms in " << ms << " ms\n";
+    }
+
+    std::cout << "Multivariate evaluation (per call)\n";
+    {
+        auto expr = parseExpr("(x+y+z+1)^12");
+        auto poly = Polynomial::fromExpr(expr).value();
+        double tree = timeMs([&] { sink = sink + calculateExpr::eval(expr, vars); }, 2000);
+        double expanded = timeMs([&] { sink = sink + poly.evaluate(vars); }, 200);
+        passed = passed && close(poly.evaluate(vars), calculateExpr::eval(expr, vars));
+        std::cout << "  factored tree " << tree * 1000 << " us, expanded " << poly.terms().size() << " terms " << expanded * 1000 << " us\n";
+    }
+
+    return passed ? 0 : 1;
+}
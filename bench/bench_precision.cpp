@@ -0,0 +1,44 @@
+#include "bench.h"
+#include "bigfloat.h"
+
+#include <functional>
+#include <iostream>
+#include <vector>
+
+int main() {
+    // Arguments are taken to the same precision as the result, so the timing includes no conversion
+    BigFloat two(2), half(1, -1), third;
+    struct Case {
+        const char* name;
+        std::function<BigFloat(size_t)> compute;
+        // The series based functions would take minutes at the largest size
+        bool large = true;
+    };
+    std::vector<Case> cases = {
+        { "pi", [](size_t bits) { return bigfloat::pi(bits); } },
+        { "e", [](size_t bits) { return bigfloat::e(bits); } },
+        { "ln 2", [](size_t bits) { return bigfloat::ln2(bits); } },
+        { "sqrt 2", [&](size_t bits) { return bigfloat::sqrt(two, bits); } },
+        { "exp 1/3", [&](size_t bits) { return bigfloat::exp(third, bits); }, false },
+        { "ln 1/3", [&](size_t bits) { return bigfloat::ln(third, bits); }, false },
+        { "sin 1/3", [&](size_t bits) { return bigfloat::sin(third, bits); }, false },
+        { "atan 1/2", [&](size_t bits) { return bigfloat::atan(half, bits); }, false },
+    };
+
+    for (size_t digits : { 1000, 10000, 100000 }) {
+        size_t bits = bigfloat::bitsForDigits(digits);
+        third = bigfloat::div(BigFloat(1), BigFloat(3), bits);
+        std::cout << digits << " digits\n";
+
+        for (auto& [name, compute, large] : cases) {
+            if (digits > 10000 && !large) continue;
+
+            BigFloat result;
+            double ms = timeMs([&] { result = compute(bits); });
+            double printMs = timeMs([&] { result.toString(digits); });
+            std::cout << "  " << name << ": " << ms << " ms, " << digits / ms * 1000 << " digits/s, printed in " << printMs << " ms\n";
+        }
+    }
+
+    return 0;
+}
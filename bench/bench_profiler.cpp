@@ -0,0 +1,50 @@
+#include "bench.h"
+#include "cas.h"
+#include "profiler.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main() {
+    CAS cas;
+    cas.setVariable("x", 0.7L);
+    cas.setVariable("y", 2);
+    constexpr int evaluations = 200000;
+
+    // Each formula is a sum of two parts. The share the profiler gives the right one is compared to its
+    // share when both parts are profiled on their own, where nothing else runs between the timestamps.
+    struct Case {
+        std::string lhs;
+        std::string rhs;
+    };
+    std::vector<Case> cases = {
+        { "x*y + 1", "sin(x)^2 + cos(y)^2" },
+        { "sqrt(x*x + y*y)", "atan(x/y)" },
+        { "(x + 1)*(x + 2)*(x + 3)", "ln(x) + ln(y) + ln(x + y)" },
+    };
+
+    number_t checksum = 0;
+    for (const auto& c : cases) {
+        auto profileTotal = [&](const std::string& expr) {
+            auto profiler = cas.profile(expr);
+            for (int i = 0; i < evaluations; ++i) checksum += profiler.evaluate();
+            return profiler.nodes().front().totalNs / evaluations;
+        };
+        double lhs = profileTotal(c.lhs), rhs = profileTotal(c.rhs);
+
+        auto profiler = cas.profile("(" + c.lhs + ") + (" + c.rhs + ")");
+        double instrumentedMs = timeMs([&] { for (int i = 0; i < evaluations; ++i) checksum += profiler.evaluate(); });
+        auto nodes = profiler.nodes();
+        // Node 0 adds the two parentheses, the right one is the last child of the root
+        size_t right = 0;
+        for (size_t i = 1; i < nodes.size(); ++i) if (nodes[i].depth == 1) right = i;
+
+        double total = nodes.front().totalNs / evaluations;
+        std::cout << c.lhs << " + " << c.rhs << ": " << total << " ns per evaluation after " << instrumentedMs * 1e6 / evaluations
+                  << " ns with timing, right part " << 100 * nodes[right].totalNs / nodes.front().totalNs << "% of it, on its own "
+                  << 100 * rhs / (lhs + rhs) << "% of " << lhs + rhs << " ns\n";
+    }
+    std::cout << "checksum " << static_cast<double>(checksum) << '\n';
+    return 0;
+}
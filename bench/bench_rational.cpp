@@ -0,0 +1,41 @@
+#include "bench.h"
+#include "rational.h"
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+int main() {
+    std::mt19937_64 rng(42);
+    std::vector<Rational> small;
+    for (int i = 0; i < 1024; ++i) {
+        small.emplace_back(static_cast<int64_t>(rng() % 2001) - 1000, static_cast<int64_t>(rng() % 1000) + 1);
+    }
+
+    // Operands of a few machine words, the case exact mode mostly sees
+    constexpr int ops = 1000000;
+    size_t stillSmall = 0;
+    double ms = timeMs([&] {
+        for (int i = 0; i < ops; ++i) {
+            const Rational& a = small[i % small.size()];
+            const Rational& b = small[(i * 7 + 3) % small.size()];
+            Rational r = (a + b) * (a - b) / (b == Rational() ? Rational(1) : b);
+            stillSmall += r.isSmall();
+        }
+    });
+    std::cout << "Machine word operands: " << ops * 4 / ms / 1000 << " M ops/s, "
+              << 100.0 * stillSmall / ops << "% of results stayed in int64\n";
+
+    // Harmonic numbers outgrow int64 after 46 terms and then run on BigInt
+    for (int n : { 40, 500, 5000 }) {
+        Rational sum;
+        ms = timeMs([&] {
+            sum = Rational();
+            for (int k = 1; k <= n; ++k) sum = sum + Rational(1, k);
+        });
+        std::cout << "H(" << n << "): " << ms << " ms, denominator has "
+                  << sum.denominator().toString().size() << " digits\n";
+    }
+
+    return 0;
+}
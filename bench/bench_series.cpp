@@ -0,0 +1,91 @@
+#include "bench.h"
+#include "series.h"
+#include "lexer.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Rounding in k steps of the recurrences and of k! itself, far below what an absolute error allows
+constexpr number_t maxRelativeError = 1e-15;
+// FFT products are accurate relative to their largest coefficient, which is below 1000 for these factors
+constexpr number_t maxProductDifference = 1e-12;
+
+// Schoolbook truncated product, what every multiplication would cost without the FFT
+Series naiveMultiply(const Series& a, const Series& b) {
+    Series result(a.size(), 0);
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (size_t j = 0; i + j < a.size(); ++j) result[i + j] += a[i] * b[j];
+    }
+    return result;
+}
+
+int main() {
+    bool passed = true;
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-1, 1);
+
+    for (size_t n : { 32, 64, 256, 1024, 4096, 16384 }) {
+        Series a(n), b(n);
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = dist(rng);
+            b[i] = dist(rng);
+        }
+        int reps = n <= 1024 ? 20 : 2;
+        Series naive, product;
+        double naiveMs = timeMs([&] { naive = naiveMultiply(a, b); }, reps);
+        double productMs = timeMs([&] { product = series::multiply(a, b); }, reps);
+
+        number_t error = 0;
+        for (size_t i = 0; i < n; ++i) error = std::max(error, std::abs(naive[i] - product[i]));
+        passed = passed && error <= maxProductDifference;
+        std::cout << "multiply " << n << " terms: schoolbook " << naiveMs << " ms, series::multiply " << productMs << " ms ("
+                  << naiveMs / productMs << "x), max difference " << static_cast<double>(error) << '\n';
+    }
+
+    // A formula that goes through division, composition and most of the functions
+    Lexer lexer("exp(sin(x)) + atan(x)/(2 + cos(x)) - sqrt(1 + x^2)*ln(2 + x)");
+    Parser parser(lexer.tokenize());
+    NodeExpr* tree = parser.parse()->rhs;
+    auto lookup = [](const std::string&) -> number_t { return 0; };
+
+    double previousMs = 0;
+    size_t previousOrder = 0;
+    for (size_t order : { 100, 1000, 10000, 100000 }) {
+        Series coefficients;
+        double ms = timeMs([&] { coefficients = series::taylor(tree, "x", 0, order, lookup); });
+        std::cout << "taylor to order " << order << ": " << ms << " ms";
+        if (previousOrder) std::cout << ", " << ms / previousMs << "x the time for " << order / previousOrder << "x the order";
+        std::cout << '\n';
+        previousMs = ms;
+        previousOrder = order;
+    }
+
+    // Coefficients of exp(x) are 1/k!, the low ones stay exact to long double precision at any order
+    Lexer expLexer("e^x");
+    Parser expParser(expLexer.tokenize());
+    Series exponential = series::taylor(expParser.parse()->rhs, "x", 0, 10000, lookup);
+    number_t factorial = 1, error = 0;
+    for (size_t k = 0; k <= 20; ++k) {
+        if (k) factorial *= k;
+        error = std::max(error, std::abs(exponential[k] * factorial - 1));
+    }
+    std::cout << "e^x to order 10000: max relative error of the first 21 coefficients " << static_cast<double>(error) << '\n';
+
+    // Far beyond k = 20 as well, where the coefficients 1/k! of e^x and +-1/k! of sin(x) are tiny
+    Lexer sinLexer("sin(x)");
+    Parser sinParser(sinLexer.tokenize());
+    Series sine = series::taylor(sinParser.parse()->rhs, "x", 0, 10000, lookup);
+    number_t reciprocal = 1, expError = 0, sinError = 0;
+    for (size_t k = 1; k <= 1000; ++k) {
+        reciprocal /= k;
+        expError = std::max(expError, std::abs(exponential[k] / reciprocal - 1));
+        number_t exact = k % 2 == 0 ? 0 : k % 4 == 1 ? reciprocal : -reciprocal;
+        sinError = std::max(sinError, exact == 0 ? std::abs(sine[k] / reciprocal) : std::abs(sine[k] / exact - 1));
+    }
+    std::cout << "order 10000: max relative error of the coefficients up to 1000, e^x " << static_cast<double>(expError)
+              << ", sin(x) " << static_cast<double>(sinError) << '\n';
+    return passed && expError < maxRelativeError && sinError < maxRelativeError ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#include "bench.h"
+#include "egraph.h"
+#include "lexer.h"
+#include "compiled.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Rewrites regroup and cancel, which changes the value by a few roundings
+constexpr number_t maxRelativeDifference = 1e-15;
+
+int main() {
+    bool passed = true;
+    std::unordered_map<std::string, number_t> values{ { "x", 0.7 }, { "y", 1.9 }, { "z", -0.3 }, { "t", 0.25 } };
+    auto slotsOf = [&](const CompiledExpr& compiled) {
+        std::vector<number_t> slots;
+        for (const auto& name : compiled.symbols()) slots.push_back(values.at(name));
+        return slots;
+    };
+
+    // Formulas the way they come out of substitution or hand derivation, with redundancy left in
+    const char* formulas[] = {
+        "sin(x)^2 + cos(x)^2",
+        "ln(x) + ln(y) - ln(z*z)",
+        "2*sin(t)*cos(t) + sin(x)/cos(x)*cos(x)",
+        "x*y + x*z + x*t",
+        "(x + y)*(x + y) - (x + y)*(x + y) + z",
+        "sqrt(x)*sqrt(y)*x^2*x^3",
+        "cos(t)^2 - sin(t)^2 + (sin(y)^2 + cos(y)^2)*x",
+        "x + y + z + t + x*y + y*z + z*t + t*x + 2*x - y/y",
+    };
+
+    Simplifier simplifier;
+    number_t sum = 0;
+    for (const char* formula : formulas) {
+        Lexer lexer(formula);
+        Parser parser(lexer.tokenize());
+        NodeExpr* tree = parser.parse()->rhs;
+
+        std::optional<Simplified> simplified;
+        double simplifyMs = timeMs([&] { simplified = simplifier.simplify(tree); }, 10);
+
+        auto original = CompiledExpr::compile(tree), cheapest = CompiledExpr::compile(simplified->expr);
+        auto originalSlots = slotsOf(original), cheapestSlots = slotsOf(cheapest);
+        constexpr int reps = 200000;
+        double originalMs = timeMs([&] { sum += original.evaluate(originalSlots); }, reps);
+        double cheapestMs = timeMs([&] { sum += cheapest.evaluate(cheapestSlots); }, reps);
+        number_t value = original.evaluate(originalSlots);
+        number_t difference = std::abs(value - cheapest.evaluate(cheapestSlots));
+        passed = passed && difference <= maxRelativeDifference * std::max(std::abs(value), number_t(1));
+
+        std::cout << formula << "\n  => " << simplified->text << "\n  simplify " << simplifyMs << " ms, " << simplified->nodes << " e-nodes, "
+                  << simplified->iterations << " iterations" << (simplified->saturated ? ", saturated" : ", budget hit")
+                  << "; cost " << simplified->originalCost << " -> " << simplified->cost << "; evaluate " << originalMs * 1e6 << " ns -> "
+                  << cheapestMs * 1e6 << " ns (" << originalMs / cheapestMs << "x), difference " << static_cast<double>(difference) << '\n';
+    }
+    std::cout << "checksum " << static_cast<double>(sum) << '\n';
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include "bench.h"
+#include "cas.h"
+#include "staticexpr.h"
+
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compares the bits of the value, which also tells NaNs and signed zeros apart under -Ofast
+bool identical(number_t a, number_t b) {
+    // x87 long doubles carry padding after their 80 bits
+    constexpr size_t bytes = std::numeric_limits<number_t>::digits == 64 ? 10 : sizeof(number_t);
+    return std::memcmp(&a, &b, bytes) == 0;
+}
+
+// Evaluates the formula through cas::expr and through Lexer, Parser and calculateExpr::eval on a grid of
+// points and counts the results that are not bit for bit the same
+template<cas::FixedString S>
+int mismatches() {
+    constexpr auto f = cas::expr<S>;
+    const std::string src(S.view());
+    Lexer lexer(src);
+    Parser parser(lexer.tokenize());
+    NodeExpr* tree = parser.parse()->rhs;
+
+    int count = 0;
+    std::unordered_map<std::string, number_t> variables;
+    std::array<number_t, f.arity> values{};
+    for (int i = 0; i < 64; ++i) {
+        for (size_t v = 0; v < f.arity; ++v) {
+            values[v] = static_cast<number_t>((i * 7 + static_cast<int>(v) * 13) % 41 - 20) / 4;
+            variables[std::string(f.variables[v])] = values[v];
+        }
+        number_t expected = calculateExpr::eval(tree, variables);
+        number_t actual = f(std::span<const number_t, f.arity>(values));
+        if (!identical(expected, actual) && count++ == 0)
+            std::cout << "mismatch for \"" << src << "\": static " << static_cast<double>(actual)
+                      << ", runtime " << static_cast<double>(expected) << '\n';
+    }
+    return count;
+}
+
+int main() {
+    // Every part of the grammar the static parser reimplements
+    int failed = mismatches<"3x^3 - 2x y + y^2/4 + 1">() + mismatches<"-2^2 + x">() + mismatches<"-x^2 - (-2)^2 x">()
+        + mismatches<"2(x + 1)(y - 1) + 3x y z">() + mismatches<"1,5x + 0.25 - 12345678901234567890">()
+        + mismatches<"sin(x)cos(y) + tan(x/7)">() + mismatches<"sqrt(x^2 + y^2) + sqrt x">()
+        + mismatches<"e^(x/10) - ln(y^2 + 1) + log(x^2 + 1)pi">() + mismatches<"asin(y/10) + acos(x/10) - atan x">()
+        + mismatches<"x_1^2.5 + x_1^(-3) + 2^x_1">() + mismatches<"phi tau x^64 / 2^65 - ans">();
+    if (failed) {
+        std::cout << failed << " static results differ from the runtime evaluator\n";
+        return 1;
+    }
+
+    constexpr size_t rows = 1 << 20;
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-10, 10);
+    std::vector<number_t> xs(rows), ys(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        xs[i] = dist(rng);
+        ys[i] = dist(rng);
+    }
+
+
+    // The same formula parsed by the compiler, compiled to bytecode, and walked as a tree
+    constexpr auto f = cas::expr<"3x^3 - 2x y + y^2/4 + 1">;
+    CAS cas;
+    auto compiled = cas.compile("3x^3 - 2x y + y^2/4 + 1");
+    Lexer lexer("3x^3 - 2x y + y^2/4 + 1");
+    Parser parser(lexer.tokenize());
+    NodeExpr* tree = parser.parse()->rhs;
+
+    number_t sum = 0;
+    double staticMs = timeMs([&] {
+        for (size_t i = 0; i < rows; ++i) sum += f(xs[i], ys[i]);
+    });
+    double compiledMs = timeMs([&] {
+        number_t slots[2];
+        for (size_t i = 0; i < rows; ++i) {
+            slots[0] = xs[i];
+            slots[1] = ys[i];
+            sum += compiled->evaluate(slots);
+        }
+    });
+    double treeMs = timeMs([&] {
+        std::unordered_map<std::string, number_t> variables;
+        for (size_t i = 0; i < rows; ++i) {
+            variables["x"] = xs[i];
+            variables["y"] = ys[i];
+            sum += calculateExpr::eval(tree, variables);
+        }
+    });
+
+    std::cout << rows << " evaluations: static " << staticMs << " ms, compiled " << compiledMs << " ms ("
+              << compiledMs / staticMs << "x), tree " << treeMs << " ms (" << treeMs / staticMs << "x)\n";
+    std::cout << "checksum " << static_cast<double>(sum) << '\n';
+    return 0;
+}
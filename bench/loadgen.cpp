@@ -0,0 +1,193 @@
+// Load generator for CAS --serve. Opens many pipelining sessions and reports throughput.
+//   loadgen <address> [--clients n] [--requests n] [--depth n] [--threads n]
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct Options {
+    std::string address;
+    size_t clients = 1000;
+    size_t requests = 1000;     // per client
+    size_t depth = 32;          // requests in flight per client
+    size_t threads = 4;
+};
+
+struct Client {
+    int fd = -1;
+    size_t sent = 0;
+    size_t received = 0;
+    size_t errors = 0;
+    std::string output;
+    size_t outputOffset = 0;
+    std::string input;
+};
+
+const char* requestLines[] = {
+    "x = 3",
+    "y_1 = x^2 + 2x - 1",
+    "sin(x) * y_1 + cos(x)",
+    "z = sqrt(y_1) / (x + 1)",
+    "ln(z) + log(y_1)",
+    "expand((x+1)^4)",
+};
+
+int connectTo(const std::string& address) {
+    auto colon = address.rfind(':');
+    bool tcp = colon != std::string::npos && address.find('/') == std::string::npos;
+
+    int fd;
+    if (tcp) {
+        std::string host = address.substr(0, colon);
+        if (host.empty() || host == "localhost") host = "127.0.0.1";
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(std::stoul(address.substr(colon + 1))));
+        inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) return -1;
+    }
+    else {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) return -1;
+    }
+
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+void queueRequests(Client& client, const Options& options) {
+    constexpr size_t lineCount = sizeof(requestLines) / sizeof(requestLines[0]);
+    while (client.sent < options.requests && client.sent - client.received < options.depth) {
+        client.output += requestLines[client.sent % lineCount];
+        client.output += '\n';
+        ++client.sent;
+    }
+}
+
+bool flushClient(Client& client) {
+    while (client.outputOffset < client.output.size()) {
+        ssize_t n = ::send(client.fd, client.output.data() + client.outputOffset, client.output.size() - client.outputOffset, MSG_NOSIGNAL);
+        if (n > 0) client.outputOffset += static_cast<size_t>(n);
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        else return false;
+    }
+    client.output.clear();
+    client.outputOffset = 0;
+    return true;
+}
+
+void runThread(const Options& options, size_t clientCount, std::atomic<size_t>& totalReceived, std::atomic<size_t>& totalErrors) {
+    int epollFd = ::epoll_create1(0);
+    std::vector<Client> clients(clientCount);
+
+    for (auto& client : clients) {
+        client.fd = connectTo(options.address);
+        if (client.fd < 0) {
+            std::cerr << "connect failed: " << std::strerror(errno) << '\n';
+            continue;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.ptr = &client;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, client.fd, &ev);
+
+        queueRequests(client, options);
+    }
+
+    size_t open = std::count_if(clients.begin(), clients.end(), [](const Client& c) { return c.fd >= 0; });
+    std::vector<epoll_event> events(256);
+    char buf[64 * 1024];
+
+    while (open > 0) {
+        int count = ::epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 1000);
+        for (int i = 0; i < count; ++i) {
+            auto& client = *static_cast<Client*>(events[i].data.ptr);
+            bool alive = true;
+
+            if (events[i].events & EPOLLIN) {
+                ssize_t n;
+                while ((n = ::read(client.fd, buf, sizeof(buf))) > 0) client.input.append(buf, static_cast<size_t>(n));
+                if (n == 0) alive = false;
+
+                size_t start = 0;
+                for (size_t end; (end = client.input.find('\n', start)) != std::string::npos; start = end + 1) {
+                    if (client.input.compare(start, 6, "error:") == 0) ++client.errors;
+                    ++client.received;
+                }
+                client.input.erase(0, start);
+                queueRequests(client, options);
+            }
+            if (alive) alive = flushClient(client);
+
+            if (!alive || client.received >= options.requests) {
+                ::epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+                ::close(client.fd);
+                totalReceived += client.received;
+                totalErrors += client.errors;
+                --open;
+                continue;
+            }
+
+            epoll_event ev{};
+            ev.events = EPOLLIN | (client.output.empty() ? 0 : EPOLLOUT);
+            ev.data.ptr = &client;
+            ::epoll_ctl(epollFd, EPOLL_CTL_MOD, client.fd, &ev);
+        }
+    }
+    ::close(epollFd);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: loadgen <address> [--clients n] [--requests n] [--depth n] [--threads n]\n";
+        return 1;
+    }
+
+    Options options;
+    options.address = argv[1];
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        size_t value = std::stoul(argv[i + 1]);
+        if (flag == "--clients") options.clients = value;
+        else if (flag == "--requests") options.requests = value;
+        else if (flag == "--depth") options.depth = std::max<size_t>(1, value);
+        else if (flag == "--threads") options.threads = std::max<size_t>(1, value);
+    }
+
+    std::atomic<size_t> received = 0, errors = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < options.threads; ++t) {
+        size_t count = options.clients / options.threads + (t < options.clients % options.threads ? 1 : 0);
+        threads.emplace_back(runThread, std::cref(options), count, std::ref(received), std::ref(errors));
+    }
+    for (auto& thread : threads) thread.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << options.clients << " clients, " << received << " responses (" << errors << " errors) in " << seconds << " s, "
+              << static_cast<size_t>(received / seconds) << " requests/s\n";
+
+    return 0;
+}
@@ -0,0 +1,627 @@
+#include "bigfloat.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+// Carried through intermediate steps so their truncation errors stay below the requested precision
+constexpr size_t guardBits = 32;
+// From here division goes through a Newton reciprocal, which profits from fast multiplication
+constexpr size_t newtonDivisionBits = 16384;
+// Arguments of sin and cos are reduced with pi to this many bits beyond their precision at most
+constexpr int64_t maxReductionBits = 1 << 20;
+
+BigFloat one() {
+    return BigFloat(1);
+}
+
+size_t bitWidth(int64_t value) {
+    return static_cast<size_t>(std::bit_width(value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value)));
+}
+
+// Increasing precisions for a Newton iteration that starts from a long double guess and doubles
+// the correct bits each step, ending at bits
+std::vector<size_t> newtonSteps(size_t bits) {
+    std::vector<size_t> steps;
+    for (size_t p = bits; p > 48; p = (p + 1) / 2) steps.push_back(p);
+    std::reverse(steps.begin(), steps.end());
+    return steps;
+}
+
+// Number of halvings before a Taylor series, balancing the series length against the doublings after it
+size_t halvings(size_t bits, int64_t magnitude, size_t scale) {
+    int64_t count = static_cast<int64_t>(std::sqrt(static_cast<double>(bits)) / scale) + magnitude;
+    return count > 0 ? static_cast<size_t>(count) : 0;
+}
+
+BigFloat reciprocal(const BigFloat& x, size_t bits) {
+    int64_t magnitude = x.magnitude();
+    BigFloat scaled = x.ldexp(-magnitude);
+
+    BigFloat y = BigFloat::fromNumber(1 / scaled.toNumber());
+    for (size_t p : newtonSteps(bits)) {
+        size_t w = p + guardBits;
+        // y += y (1 - x y)
+        BigFloat error = bigfloat::sub(one(), bigfloat::mul(scaled, y, w), w);
+        y = bigfloat::add(y, bigfloat::mul(y, error, w), w);
+    }
+    return y.ldexp(-magnitude).round(bits);
+}
+
+std::pair<BigFloat, BigFloat> sincos(const BigFloat& x, size_t bits) {
+    size_t w = bits + guardBits;
+
+    // x = q pi/2 + r with |r| <= pi/4, the quadrant q mod 4 picks signs and swaps sin and cos
+    BigFloat r = x;
+    int64_t quadrant = 0;
+    if (!x.isZero() && x.magnitude() >= 0) {
+        if (x.magnitude() > maxReductionBits) throw std::runtime_error("Argument of sin or cos is too large");
+
+        size_t extra = static_cast<size_t>(x.magnitude()) + guardBits;
+        BigFloat halfPi = bigfloat::pi(w + extra).ldexp(-1);
+        BigInt q = bigfloat::div(x, halfPi, static_cast<size_t>(x.magnitude()) + guardBits).toInteger();
+
+        r = bigfloat::sub(x, bigfloat::mul(BigFloat(q), halfPi, w + extra), w + extra);
+        quadrant = ((q % BigInt(4)).toInt64() + 4) % 4;
+    }
+
+    BigFloat s, c = one();
+    if (!r.isZero()) {
+        // Small results need more bits to keep their relative precision
+        int64_t magnitude = r.magnitude();
+        size_t ws = w + static_cast<size_t>(std::max<int64_t>(0, -magnitude));
+        size_t count = halvings(ws, magnitude, 2);
+        ws += count;
+
+        BigFloat y = r.round(ws).ldexp(-static_cast<int64_t>(count));
+        BigFloat y2 = bigfloat::mul(y, y, ws);
+
+        // sin y = y - y^3/3! + ..., cos y = 1 - y^2/2! + ...
+        s = y;
+        BigFloat term = y;
+        for (uint32_t k = 1; ; ++k) {
+            term = bigfloat::div(bigfloat::div(bigfloat::mul(term, y2, ws), 2 * k, ws), 2 * k + 1, ws);
+            if (term.isZero() || term.magnitude() < s.magnitude() - static_cast<int64_t>(ws)) break;
+            s = k % 2 ? bigfloat::sub(s, term, ws) : bigfloat::add(s, term, ws);
+        }
+        term = one();
+        for (uint32_t k = 1; ; ++k) {
+            term = bigfloat::div(bigfloat::div(bigfloat::mul(term, y2, ws), 2 * k - 1, ws), 2 * k, ws);
+            if (term.isZero() || term.magnitude() < -static_cast<int64_t>(ws)) break;
+            c = k % 2 ? bigfloat::sub(c, term, ws) : bigfloat::add(c, term, ws);
+        }
+
+        // sin 2y = 2 sin y cos y, cos 2y = 1 - 2 sin^2 y
+        for (size_t i = 0; i < count; ++i) {
+            BigFloat doubled = bigfloat::mul(s, c, ws).ldexp(1);
+            c = bigfloat::sub(one(), bigfloat::mul(s, s, ws).ldexp(1), ws);
+            s = std::move(doubled);
+        }
+    }
+
+    switch (quadrant) {
+        case 1: return { c.round(bits), (-s).round(bits) };
+        case 2: return { (-s).round(bits), (-c).round(bits) };
+        case 3: return { (-c).round(bits), s.round(bits) };
+        default: return { s.round(bits), c.round(bits) };
+    }
+}
+
+// Binary splitting of the Chudnovsky series, 1/pi = 12 sum (-1)^k (6k)! (13591409 + 545140134 k) / ((3k)! (k!)^3 640320^(3k + 3/2))
+struct ChudnovskySplit {
+    BigInt p, q, t;
+};
+
+ChudnovskySplit chudnovsky(int64_t a, int64_t b) {
+    if (b - a == 1) {
+        if (a == 0) return { BigInt(1), BigInt(1), BigInt(13591409) };
+
+        BigInt p = BigInt(6 * a - 5) * BigInt(2 * a - 1) * BigInt(6 * a - 1);
+        BigInt q = BigInt(a) * BigInt(a) * BigInt(a) * BigInt(10939058860032000);
+        BigInt t = p * (BigInt(13591409) + BigInt(545140134) * BigInt(a));
+        return { std::move(p), std::move(q), a % 2 ? -t : t };
+    }
+
+    int64_t m = (a + b) / 2;
+    ChudnovskySplit l = chudnovsky(a, m), r = chudnovsky(m, b);
+    return { l.p * r.p, l.q * r.q, l.t * r.q + l.p * r.t };
+}
+
+// P/Q = sum over k in (a, b] of 1 / ((a+1) (a+2) ... k)
+std::pair<BigInt, BigInt> factorialSeries(int64_t a, int64_t b) {
+    if (b - a == 1) return { BigInt(1), BigInt(b) };
+
+    int64_t m = (a + b) / 2;
+    auto [lp, lq] = factorialSeries(a, m);
+    auto [rp, rq] = factorialSeries(m, b);
+    return { lp * rq + rp, lq * rq };
+}
+
+// Binary splitting of atanh(1/n) = sum 1 / ((2k+1) n^(2k+1)), after Haible and Papanikolaou
+struct SeriesSplit {
+    BigInt p, q, b, t;
+};
+
+SeriesSplit atanhSeries(int64_t n, int64_t a, int64_t b) {
+    if (b - a == 1) {
+        BigInt q = a == 0 ? BigInt(n) : BigInt(n) * BigInt(n);
+        return { BigInt(1), std::move(q), BigInt(2 * a + 1), BigInt(1) };
+    }
+
+    int64_t m = (a + b) / 2;
+    SeriesSplit l = atanhSeries(n, a, m), r = atanhSeries(n, m, b);
+    return { l.p * r.p, l.q * r.q, l.b * r.b, r.b * r.q * l.t + l.b * l.p * r.t };
+}
+
+BigFloat atanhInverse(int64_t n, size_t bits) {
+    int64_t terms = static_cast<int64_t>(bits / (2 * std::log2(static_cast<double>(n)))) + 2;
+    SeriesSplit s = atanhSeries(n, 0, terms);
+    return bigfloat::div(BigFloat(s.t), BigFloat(s.b * s.q), bits);
+}
+
+BigFloat computePi(size_t bits) {
+    // Every term adds about 14.18 digits
+    int64_t terms = static_cast<int64_t>(bits / 47.11) + 2;
+    ChudnovskySplit s = chudnovsky(0, terms);
+
+    size_t w = bits + guardBits;
+    BigFloat numerator = bigfloat::mul(BigFloat(s.q * BigInt(426880)), bigfloat::sqrt(BigFloat(10005), w), w);
+    return bigfloat::div(numerator, BigFloat(s.t), bits);
+}
+
+BigFloat computeE(size_t bits) {
+    int64_t terms = 1;
+    for (double log2Factorial = 0; log2Factorial < bits + guardBits; ++terms) log2Factorial += std::log2(static_cast<double>(terms));
+
+    auto [p, q] = factorialSeries(0, terms);
+    return bigfloat::add(one(), bigfloat::div(BigFloat(p), BigFloat(q), bits + guardBits), bits);
+}
+
+BigFloat computeLn2(size_t bits) {
+    // ln 2 = 18 atanh(1/26) - 2 atanh(1/4801) + 8 atanh(1/8749)
+    size_t w = bits + guardBits;
+    BigFloat sum = bigfloat::mul(atanhInverse(26, w), BigFloat(18), w);
+    sum = bigfloat::sub(sum, bigfloat::mul(atanhInverse(4801, w), BigFloat(2), w), w);
+    return bigfloat::add(sum, bigfloat::mul(atanhInverse(8749, w), BigFloat(8), w), bits);
+}
+
+BigFloat computePhi(size_t bits) {
+    return bigfloat::add(one(), bigfloat::sqrt(BigFloat(5), bits + guardBits), bits + guardBits).ldexp(-1).round(bits);
+}
+
+BigFloat computeLn10(size_t bits) {
+    return bigfloat::ln(BigFloat(10), bits);
+}
+
+struct ConstantCache {
+    std::mutex mutex;
+    size_t bits = 0;
+    BigFloat value;
+};
+
+BigFloat cached(ConstantCache& cache, size_t bits, BigFloat (*compute)(size_t)) {
+    std::lock_guard lock(cache.mutex);
+    if (cache.bits < bits) {
+        // Some headroom, so raising the precision a little does not recompute
+        size_t target = bits + bits / 8 + guardBits;
+        cache.value = compute(target);
+        cache.bits = target;
+    }
+    return cache.value.round(bits);
+}
+}
+
+BigFloat BigFloat::fromNumber(number_t value) {
+    if (std::isnan(value) || std::isinf(value)) throw std::runtime_error("Cannot convert nan or infinity to a precise number");
+    if (value == 0) return BigFloat();
+
+    // The 64 mantissa bits of long double, taken in two halves
+    int exponent;
+    number_t scaled = std::ldexp(std::fabs(std::frexp(value, &exponent)), 32);
+    int64_t high = static_cast<int64_t>(scaled);
+    int64_t low = static_cast<int64_t>(std::ldexp(scaled - static_cast<number_t>(high), 32));
+
+    BigInt mantissa = (BigInt(high) << 32) + BigInt(low);
+    return BigFloat(value < 0 ? -mantissa : mantissa, exponent - 64);
+}
+
+BigFloat BigFloat::fromDecimal(std::string_view text, size_t bits) {
+    bool negative = !text.empty() && text.front() == '-';
+    if (negative) text.remove_prefix(1);
+
+    std::string digits;
+    size_t fractionDigits = 0;
+    bool point = false;
+    for (char c : text) {
+        if (c == '.' && !point) point = true;
+        else if (c >= '0' && c <= '9') {
+            digits.push_back(c);
+            if (point) ++fractionDigits;
+        }
+        else throw std::runtime_error("Invalid number " + std::string(text));
+    }
+
+    BigFloat value(BigInt::fromString(digits));
+    if (fractionDigits > 9) value = bigfloat::div(value, BigFloat(BigInt(10).pow(fractionDigits)), bits);
+    else if (fractionDigits > 0) value = bigfloat::div(value, static_cast<uint32_t>(std::pow(10, fractionDigits)), bits);
+
+    return negative ? -value : value;
+}
+
+bool BigFloat::isInteger() const {
+    if (m_exponent >= 0 || isZero()) return true;
+    if (m_exponent < -static_cast<int64_t>(m_mantissa.bitLength())) return false;
+
+    size_t shift = static_cast<size_t>(-m_exponent);
+    return ((m_mantissa.abs() >> shift) << shift) == m_mantissa.abs();
+}
+
+int64_t BigFloat::magnitude() const {
+    return m_exponent + static_cast<int64_t>(m_mantissa.bitLength());
+}
+
+int BigFloat::compare(const BigFloat& other) const {
+    if (isNegative() != other.isNegative()) return isNegative() ? -1 : 1;
+    if (isZero() || other.isZero()) return isZero() ? (other.isZero() ? 0 : (other.isNegative() ? 1 : -1)) : (isNegative() ? -1 : 1);
+
+    // Same sign from here, compare the absolute values and flip for negatives
+    int sign = isNegative() ? -1 : 1;
+    if (magnitude() != other.magnitude()) return magnitude() < other.magnitude() ? -sign : sign;
+
+    int64_t exponent = std::min(m_exponent, other.m_exponent);
+    BigInt a = m_mantissa.abs() << static_cast<size_t>(m_exponent - exponent);
+    BigInt b = other.m_mantissa.abs() << static_cast<size_t>(other.m_exponent - exponent);
+    return a.compare(b) * sign;
+}
+
+BigFloat BigFloat::round(size_t bits) const {
+    size_t length = m_mantissa.bitLength();
+    if (length <= bits) return *this;
+
+    size_t shift = length - bits;
+    return BigFloat(m_mantissa >> shift, m_exponent + static_cast<int64_t>(shift));
+}
+
+BigInt BigFloat::toInteger() const {
+    if (m_exponent >= 0) return m_mantissa << static_cast<size_t>(m_exponent);
+
+    BigInt half = ((m_mantissa.abs() >> static_cast<size_t>(-m_exponent - 1)) + BigInt(1)) >> 1;
+    return isNegative() ? -half : half;
+}
+
+std::optional<int64_t> BigFloat::toInt64() const {
+    if (!isZero() && magnitude() > 62) return std::nullopt;
+    return toInteger().toInt64();
+}
+
+number_t BigFloat::toNumber() const {
+    if (isZero()) return 0;
+
+    // Past the long double range anyway, and keeps the exponent within int
+    int64_t exponent = magnitude();
+    if (exponent > 20000) return isNegative() ? -HUGE_VALL : HUGE_VALL;
+    if (exponent < -20000) return 0;
+
+    size_t length = m_mantissa.bitLength();
+    size_t shift = length > 64 ? length - 64 : 0;
+    return std::ldexp((m_mantissa >> shift).toNumber(), static_cast<int>(m_exponent + static_cast<int64_t>(shift)));
+}
+
+std::string BigFloat::toString(size_t digits) const {
+    if (isZero()) return "0";
+    digits = std::max<size_t>(digits, 1);
+
+    // Decimal exponent of the first digit, the estimate from the binary magnitude can be off by one
+    int64_t decimalExponent = static_cast<int64_t>(std::floor((magnitude() - 1) * 0.30102999566398119521L));
+    std::string text;
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        // round(|x| * 10^scale) has exactly digits digits
+        int64_t scale = static_cast<int64_t>(digits) - 1 - decimalExponent;
+        BigInt value = m_mantissa.abs();
+        BigInt divisor(1);
+        if (scale >= 0) value = value * BigInt(10).pow(static_cast<uint64_t>(scale));
+        else divisor = BigInt(10).pow(static_cast<uint64_t>(-scale));
+
+        if (m_exponent >= 0) value = value << static_cast<size_t>(m_exponent);
+        else if (divisor == BigInt(1)) value = ((value >> static_cast<size_t>(-m_exponent - 1)) + BigInt(1)) >> 1;
+        else divisor = divisor << static_cast<size_t>(-m_exponent);
+
+        if (!(divisor == BigInt(1))) value = ((value << 1) + divisor) / (divisor << 1);
+
+        text = value.toString();
+        if (text.size() > digits) ++decimalExponent;
+        else if (text.size() < digits) --decimalExponent;
+        else break;
+    }
+    while (text.size() > 1 && text.back() == '0') text.pop_back();
+
+    std::string result = isNegative() ? "-" : "";
+    if (decimalExponent >= 0 && decimalExponent < static_cast<int64_t>(std::max<size_t>(digits, 21))) {
+        size_t integerDigits = static_cast<size_t>(decimalExponent) + 1;
+        if (text.size() <= integerDigits) result += text + std::string(integerDigits - text.size(), '0');
+        else result += text.substr(0, integerDigits) + "." + text.substr(integerDigits);
+    }
+    else if (decimalExponent < 0 && decimalExponent >= -5) {
+        result += "0." + std::string(static_cast<size_t>(-decimalExponent - 1), '0') + text;
+    }
+    else {
+        result += text.substr(0, 1);
+        if (text.size() > 1) result += "." + text.substr(1);
+        result += "e" + std::to_string(decimalExponent);
+    }
+    return result;
+}
+
+namespace bigfloat {
+size_t bitsForDigits(size_t digits) {
+    return static_cast<size_t>(std::ceil(digits * 3.32192809488736234787)) + guardBits;
+}
+
+BigFloat add(const BigFloat& a, const BigFloat& b, size_t bits) {
+    if (a.isZero()) return b.round(bits);
+    if (b.isZero()) return a.round(bits);
+
+    // An operand entirely below the last bit of the other cannot change the truncated sum
+    int64_t limit = static_cast<int64_t>(bits) + 2;
+    if (a.magnitude() - b.magnitude() > limit) return a.round(bits);
+    if (b.magnitude() - a.magnitude() > limit) return b.round(bits);
+
+    BigFloat x = a.round(bits + guardBits), y = b.round(bits + guardBits);
+    int64_t exponent = std::min(x.exponent(), y.exponent());
+    BigInt sum = (x.mantissa() << static_cast<size_t>(x.exponent() - exponent)) + (y.mantissa() << static_cast<size_t>(y.exponent() - exponent));
+    return BigFloat(std::move(sum), exponent).round(bits);
+}
+
+BigFloat sub(const BigFloat& a, const BigFloat& b, size_t bits) {
+    return add(a, -b, bits);
+}
+
+BigFloat mul(const BigFloat& a, const BigFloat& b, size_t bits) {
+    BigFloat x = a.round(bits + guardBits);
+    // Squares keep both operands the same object so the transform is only done once
+    if (&a == &b) return BigFloat(x.mantissa() * x.mantissa(), 2 * x.exponent()).round(bits);
+
+    BigFloat y = b.round(bits + guardBits);
+    return BigFloat(x.mantissa() * y.mantissa(), x.exponent() + y.exponent()).round(bits);
+}
+
+BigFloat div(const BigFloat& a, const BigFloat& b, size_t bits) {
+    if (b.isZero()) throw std::runtime_error("Division by zero");
+    if (a.isZero()) return BigFloat();
+    if (bits > newtonDivisionBits) return mul(a, reciprocal(b, bits + guardBits), bits);
+
+    BigFloat x = a.round(bits + guardBits), y = b.round(bits + guardBits);
+    int64_t shift = static_cast<int64_t>(bits + guardBits + y.mantissa().bitLength()) - static_cast<int64_t>(x.mantissa().bitLength());
+    shift = std::max<int64_t>(shift, 0);
+
+    BigInt quotient = (x.mantissa() << static_cast<size_t>(shift)) / y.mantissa();
+    return BigFloat(std::move(quotient), x.exponent() - shift - y.exponent()).round(bits);
+}
+
+BigFloat div(const BigFloat& a, uint32_t b, size_t bits) {
+    if (b == 0) throw std::runtime_error("Division by zero");
+
+    BigFloat x = a.round(bits + guardBits);
+    int64_t shift = std::max<int64_t>(static_cast<int64_t>(bits + 2 * guardBits) - static_cast<int64_t>(x.mantissa().bitLength()), 0);
+    BigInt quotient = (x.mantissa() << static_cast<size_t>(shift)) / BigInt(b);
+    return BigFloat(std::move(quotient), x.exponent() - shift).round(bits);
+}
+
+BigFloat sqrt(const BigFloat& x, size_t bits) {
+    if (x.isNegative()) throw std::runtime_error("Square root of a negative number");
+    if (x.isZero()) return BigFloat();
+
+    // x = scaled * 4^half with scaled in [1/2, 2)
+    int64_t magnitude = x.magnitude();
+    int64_t half = magnitude >= 0 ? magnitude / 2 : -((-magnitude + 1) / 2);
+    BigFloat scaled = x.ldexp(-2 * half);
+
+    // Newton for 1/sqrt needs no division: y += y (1 - x y^2) / 2
+    BigFloat y = BigFloat::fromNumber(1 / std::sqrt(scaled.toNumber()));
+    for (size_t p : newtonSteps(bits)) {
+        size_t w = p + guardBits;
+        BigFloat error = sub(one(), mul(scaled, mul(y, y, w), w), w);
+        y = add(y, mul(y, error, w).ldexp(-1), w);
+    }
+
+    // One more step on sqrt x = x y itself (Karp and Markstein)
+    size_t w = bits + guardBits;
+    BigFloat root = mul(scaled, y, w);
+    root = add(root, mul(y, sub(scaled, mul(root, root, w), w), w).ldexp(-1), w);
+    return root.ldexp(half).round(bits);
+}
+
+BigFloat exp(const BigFloat& x, size_t bits) {
+    if (x.isZero()) return one();
+    if (x.magnitude() > 62) {
+        if (x.isNegative()) return BigFloat();
+        throw std::runtime_error("Overflow in exp");
+    }
+
+    // x = n ln 2 + r with |r| <= ln 2 / 2
+    size_t w = bits + guardBits;
+    int64_t n = std::llround(x.toNumber() / 0.69314718055994530942L);
+    size_t extra = bitWidth(n) + static_cast<size_t>(std::max<int64_t>(x.magnitude(), 0));
+    BigFloat r = n ? sub(x, mul(BigFloat(n), ln2(w + extra), w + extra), w) : x.round(w);
+    if (r.isZero()) return one().ldexp(n);
+
+    // exp r = exp(r / 2^count)^(2^count), the halved argument makes the series converge quickly
+    size_t count = halvings(w, r.magnitude(), 2);
+    size_t ws = w + count;
+    BigFloat y = r.ldexp(-static_cast<int64_t>(count));
+
+    BigFloat sum = one(), term = one();
+    for (uint32_t k = 1; ; ++k) {
+        term = div(mul(term, y, ws), k, ws);
+        if (term.isZero() || term.magnitude() < -static_cast<int64_t>(ws)) break;
+        sum = add(sum, term, ws);
+    }
+    for (size_t i = 0; i < count; ++i) sum = mul(sum, sum, ws);
+
+    return sum.ldexp(n).round(bits);
+}
+
+BigFloat ln(const BigFloat& x, size_t bits) {
+    if (x.isNegative() || x.isZero()) throw std::runtime_error("Logarithm of a non-positive number");
+
+    // x = 2^k m with m in [1/sqrt 2, sqrt 2), so ln 1 comes out as exactly 0
+    int64_t k = x.magnitude();
+    BigFloat m = x.ldexp(-k);
+    if (m.toNumber() < 0.70710678118654752440L) {
+        m = m.ldexp(1);
+        --k;
+    }
+
+    // Newton on exp y = m: y += m exp(-y) - 1
+    BigFloat y = BigFloat::fromNumber(std::log(m.toNumber()));
+    for (size_t p : newtonSteps(bits + guardBits)) {
+        size_t w = p + guardBits;
+        y = add(y, sub(mul(m, exp(-y, w), w), one(), w), w);
+    }
+
+    if (k == 0) return y.round(bits);
+    size_t w = bits + guardBits + bitWidth(k);
+    return add(y, mul(BigFloat(k), ln2(w), w), bits);
+}
+
+BigFloat log10(const BigFloat& x, size_t bits) {
+    size_t w = bits + guardBits;
+    return div(ln(x, w), ln10(w), bits);
+}
+
+BigFloat sin(const BigFloat& x, size_t bits) {
+    return sincos(x, bits).first;
+}
+
+BigFloat cos(const BigFloat& x, size_t bits) {
+    return sincos(x, bits).second;
+}
+
+BigFloat tan(const BigFloat& x, size_t bits) {
+    auto [s, c] = sincos(x, bits + guardBits);
+    return div(s, c, bits);
+}
+
+BigFloat asin(const BigFloat& x, size_t bits) {
+    int range = x.abs().compare(one());
+    if (range > 0) throw std::runtime_error("asin and acos are only defined on [-1, 1]");
+    if (range == 0) return x.isNegative() ? -pi(bits).ldexp(-1) : pi(bits).ldexp(-1);
+
+    // asin x = atan(x / sqrt((1 - x) (1 + x))), the factored form avoids cancellation near 1
+    size_t w = bits + guardBits;
+    BigFloat root = sqrt(mul(sub(one(), x, w), add(one(), x, w), w), w);
+    return atan(div(x, root, w), bits);
+}
+
+BigFloat acos(const BigFloat& x, size_t bits) {
+    size_t w = bits + 2 * guardBits;
+    return sub(pi(w).ldexp(-1), asin(x, w), bits);
+}
+
+BigFloat atan(const BigFloat& x, size_t bits) {
+    if (x.isZero()) return BigFloat();
+    if (x.isNegative()) return -atan(-x, bits);
+
+    size_t w = bits + guardBits;
+    int range = x.compare(one());
+    if (range == 0) return pi(bits).ldexp(-2);
+    if (range > 0) return sub(pi(w).ldexp(-1), atan(div(one(), x, w), w), bits);
+
+    // atan x = 2 atan(x / (1 + sqrt(1 + x^2))) shrinks the argument for the series
+    int64_t magnitude = x.magnitude();
+    size_t count = halvings(w, magnitude, 4);
+    size_t ws = w + count + static_cast<size_t>(std::max<int64_t>(0, -magnitude));
+
+    BigFloat y = x.round(ws);
+    for (size_t i = 0; i < count; ++i) {
+        y = div(y, add(one(), sqrt(add(one(), mul(y, y, ws), ws), ws), ws), ws);
+    }
+
+    // atan y = y - y^3/3 + y^5/5 - ...
+    BigFloat y2 = mul(y, y, ws), power = y, sum = y;
+    for (uint32_t k = 1; ; ++k) {
+        power = mul(power, y2, ws);
+        BigFloat term = div(power, 2 * k + 1, ws);
+        if (term.isZero() || term.magnitude() < sum.magnitude() - static_cast<int64_t>(ws)) break;
+        sum = k % 2 ? sub(sum, term, ws) : add(sum, term, ws);
+    }
+
+    return sum.ldexp(static_cast<int64_t>(count)).round(bits);
+}
+
+BigFloat pow(const BigFloat& base, const BigFloat& exp, size_t bits, bool negativeLiteralBase) {
+    bool isInteger = exp.isInteger();
+    if (base.isNegative() && (negativeLiteralBase || !isInteger)) return -pow(-base, exp, bits, false);
+
+    if (base.isZero()) {
+        if (exp.isNegative()) throw std::runtime_error("Division by zero");
+        return exp.isZero() ? one() : BigFloat();
+    }
+
+    // Binary exponentiation while the exponent is of reasonable size
+    auto n = isInteger ? exp.toInt64() : std::nullopt;
+    if (n && bitWidth(n.value()) <= 32) {
+        size_t w = bits + guardBits + bitWidth(n.value());
+        uint64_t rest = static_cast<uint64_t>(std::abs(n.value()));
+        BigFloat result = one(), square = base.round(w);
+        while (rest) {
+            if (rest & 1) result = mul(result, square, w);
+            rest >>= 1;
+            if (rest) square = mul(square, square, w);
+        }
+        return n.value() < 0 ? div(one(), result, bits) : result.round(bits);
+    }
+
+    // Negative bases only get here with huge integer exponents, whose parity decides the sign
+    bool negate = base.isNegative() && (exp.toInteger().limbs().front() & 1);
+    BigFloat magnitude = base.abs();
+
+    // exp(y) loses as many bits as y has integer bits, a rough first logarithm tells how many
+    size_t w = bits + guardBits;
+    int64_t integerBits = mul(exp, ln(magnitude, 2 * guardBits), guardBits).magnitude();
+    w += static_cast<size_t>(std::max<int64_t>(0, integerBits));
+    BigFloat result = bigfloat::exp(mul(exp, ln(magnitude, w), w), bits);
+    return negate ? -result : result;
+}
+
+BigFloat pi(size_t bits) {
+    static ConstantCache cache;
+    return cached(cache, bits, computePi);
+}
+
+BigFloat e(size_t bits) {
+    static ConstantCache cache;
+    return cached(cache, bits, computeE);
+}
+
+BigFloat phi(size_t bits) {
+    static ConstantCache cache;
+    return cached(cache, bits, computePhi);
+}
+
+BigFloat tau(size_t bits) {
+    return pi(bits).ldexp(1);
+}
+
+BigFloat ln2(size_t bits) {
+    static ConstantCache cache;
+    return cached(cache, bits, computeLn2);
+}
+
+BigFloat ln10(size_t bits) {
+    static ConstantCache cache;
+    return cached(cache, bits, computeLn10);
+}
+
+std::optional<BigFloat> constant(std::string_view name, size_t bits) {
+    if (name == "pi") return pi(bits);
+    if (name == "e") return e(bits);
+    if (name == "phi") return phi(bits);
+    if (name == "tau") return tau(bits);
+    return std::nullopt;
+}
+}
@@ -0,0 +1,87 @@
+#ifndef BIGFLOAT_H
+#define BIGFLOAT_H
+
+#include "types.h"
+#include "bigint.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Binary floating point number mantissa * 2^exponent of any size. Values carry no precision of their
+// own, every inexact operation takes the precision of its result in bits and truncates to it.
+class BigFloat {
+public:
+    BigFloat() = default;
+    BigFloat(BigInt mantissa, int64_t exponent = 0) : m_mantissa(std::move(mantissa)), m_exponent(exponent) {}
+
+    static BigFloat fromNumber(number_t value);
+    // Decimal literal like "0.1", correct to the given number of bits
+    static BigFloat fromDecimal(std::string_view text, size_t bits);
+
+    const BigInt& mantissa() const { return m_mantissa; }
+    int64_t exponent() const { return m_exponent; }
+    bool isZero() const { return m_mantissa.isZero(); }
+    bool isNegative() const { return m_mantissa.isNegative(); }
+    bool isInteger() const;
+    // The absolute value lies in [2^(magnitude - 1), 2^magnitude)
+    int64_t magnitude() const;
+
+    BigFloat operator-() const { return BigFloat(-m_mantissa, m_exponent); }
+    BigFloat abs() const { return BigFloat(m_mantissa.abs(), m_exponent); }
+    // Exact multiplication by 2^bits
+    BigFloat ldexp(int64_t bits) const { return BigFloat(m_mantissa, m_exponent + bits); }
+    int compare(const BigFloat& other) const;
+
+    // Truncates the mantissa to at most bits significant bits
+    BigFloat round(size_t bits) const;
+    // Nearest integer, halves round away from zero
+    BigInt toInteger() const;
+    // std::nullopt if the nearest integer does not fit in int64
+    std::optional<int64_t> toInt64() const;
+
+    number_t toNumber() const;
+    // Rounded to the given number of significant digits, trailing zeros are dropped
+    std::string toString(size_t digits) const;
+private:
+    BigInt m_mantissa;
+    int64_t m_exponent = 0;
+};
+
+namespace bigfloat {
+    // Working precision in bits for a number of decimal digits, including guard bits
+    size_t bitsForDigits(size_t digits);
+
+    BigFloat add(const BigFloat& a, const BigFloat& b, size_t bits);
+    BigFloat sub(const BigFloat& a, const BigFloat& b, size_t bits);
+    BigFloat mul(const BigFloat& a, const BigFloat& b, size_t bits);
+    BigFloat div(const BigFloat& a, const BigFloat& b, size_t bits);
+    BigFloat div(const BigFloat& a, uint32_t b, size_t bits);
+
+    BigFloat sqrt(const BigFloat& x, size_t bits);
+    BigFloat exp(const BigFloat& x, size_t bits);
+    BigFloat ln(const BigFloat& x, size_t bits);
+    BigFloat log10(const BigFloat& x, size_t bits);
+    BigFloat sin(const BigFloat& x, size_t bits);
+    BigFloat cos(const BigFloat& x, size_t bits);
+    BigFloat tan(const BigFloat& x, size_t bits);
+    BigFloat asin(const BigFloat& x, size_t bits);
+    BigFloat acos(const BigFloat& x, size_t bits);
+    BigFloat atan(const BigFloat& x, size_t bits);
+    // Same sign rule as calculateExpr::power
+    BigFloat pow(const BigFloat& base, const BigFloat& exp, size_t bits, bool negativeLiteralBase);
+
+    // Constants are cached, once computed to n bits every request up to n bits is a truncation
+    BigFloat pi(size_t bits);
+    BigFloat e(size_t bits);
+    BigFloat phi(size_t bits);
+    BigFloat tau(size_t bits);
+    BigFloat ln2(size_t bits);
+    BigFloat ln10(size_t bits);
+    // Named constant as the lexer spells it
+    std::optional<BigFloat> constant(std::string_view name, size_t bits);
+}
+
+#endif
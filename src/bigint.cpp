@@ -0,0 +1,592 @@
+#include "bigint.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <span>
+#include <stdexcept>
+
+namespace {
+using Limbs = std::vector<uint32_t>;
+using LimbSpan = std::span<const uint32_t>;
+
+constexpr uint64_t limbBase = uint64_t(1) << 32;
+// Operand sizes in limbs from which the asymptotically faster multiplications win
+constexpr size_t karatsubaThreshold = 40;
+constexpr size_t nttThreshold = 6000;
+// Largest power of ten that fits in a limb, decimal conversion works in chunks of it
+constexpr uint32_t decimalChunk = 1000000000;
+constexpr int decimalChunkDigits = 9;
+
+// The lowest 64 bits of a magnitude
+uint64_t lowWord(const Limbs& a) {
+    uint64_t word = 0;
+    if (a.size() > 0) word |= a[0];
+    if (a.size() > 1) word |= uint64_t(a[1]) << 32;
+    return word;
+}
+
+Limbs fromWord(uint64_t word) {
+    Limbs a;
+    if (word) a.push_back(static_cast<uint32_t>(word));
+    if (word >> 32) a.push_back(static_cast<uint32_t>(word >> 32));
+    return a;
+}
+
+void trimLimbs(Limbs& a) {
+    while (!a.empty() && a.back() == 0) a.pop_back();
+}
+
+int compareMagnitude(const Limbs& a, const Limbs& b) {
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    for (size_t i = a.size(); i-- > 0; ) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+Limbs addMagnitude(LimbSpan a, LimbSpan b) {
+    LimbSpan longer = a.size() >= b.size() ? a : b;
+    LimbSpan shorter = a.size() >= b.size() ? b : a;
+
+    Limbs result(longer.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); ++i) {
+        uint64_t sum = uint64_t(longer[i]) + (i < shorter.size() ? shorter[i] : 0) + carry;
+        result[i] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+    }
+    result[longer.size()] = static_cast<uint32_t>(carry);
+    trimLimbs(result);
+    return result;
+}
+
+// a - b for |a| >= |b|
+Limbs subMagnitude(LimbSpan a, LimbSpan b) {
+    Limbs result(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        int64_t diff = int64_t(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = diff < 0;
+        result[i] = static_cast<uint32_t>(diff + (borrow ? int64_t(limbBase) : 0));
+    }
+    trimLimbs(result);
+    return result;
+}
+
+Limbs mulSchoolbook(LimbSpan a, LimbSpan b) {
+    if (a.empty() || b.empty()) return {};
+
+    Limbs result(a.size() + b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.size(); ++j) {
+            // (2^32-1)^2 + 2 * (2^32-1) still fits in 64 bits
+            uint64_t t = uint64_t(a[i]) * b[j] + result[i + j] + carry;
+            result[i + j] = static_cast<uint32_t>(t);
+            carry = t >> 32;
+        }
+        result[i + b.size()] = static_cast<uint32_t>(carry);
+    }
+    trimLimbs(result);
+    return result;
+}
+
+// result += a * 2^(32 * offset), result has room for the sum
+void addShifted(Limbs& result, LimbSpan a, size_t offset) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < a.size(); ++i) {
+        uint64_t sum = uint64_t(result[i + offset]) + a[i] + carry;
+        result[i + offset] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+    }
+    for (; carry; ++i) {
+        uint64_t sum = uint64_t(result[i + offset]) + carry;
+        result[i + offset] = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+    }
+}
+
+// Number theoretic transform over the Goldilocks prime 2^64 - 2^32 + 1. Its 2-adic roots of unity
+// allow lengths up to 2^32, and with 16-bit digits no coefficient of a product can reach the modulus.
+namespace ntt {
+constexpr uint64_t modulus = 0xffffffff00000001;
+constexpr uint64_t epsilon = 0xffffffff;
+constexpr uint64_t generator = 7;
+
+// Branch free, the operands of a transform are effectively random so every branch would mispredict
+uint64_t mask(bool condition) {
+    return 0 - static_cast<uint64_t>(condition);
+}
+
+uint64_t add(uint64_t a, uint64_t b) {
+    uint64_t sum = a + b;
+    sum += epsilon & mask(sum < a);
+    return sum - (modulus & mask(sum >= modulus));
+}
+
+uint64_t sub(uint64_t a, uint64_t b) {
+    return (a - b) - (epsilon & mask(a < b));
+}
+
+// Reduces hi * 2^64 + lo using 2^64 = 2^32 - 1 and 2^96 = -1
+uint64_t reduce(uint64_t hi, uint64_t lo) {
+    uint64_t hiHi = hi >> 32, hiLo = hi & epsilon;
+
+    uint64_t t0 = (lo - hiHi) - (epsilon & mask(lo < hiHi));
+    uint64_t t1 = hiLo * epsilon;
+    uint64_t result = t0 + t1;
+    result += epsilon & mask(result < t1);
+    return result - (modulus & mask(result >= modulus));
+}
+
+uint64_t mul(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 uint128;
+    uint128 product = static_cast<uint128>(a) * b;
+    return reduce(static_cast<uint64_t>(product >> 64), static_cast<uint64_t>(product));
+#else
+    uint64_t aLo = a & epsilon, aHi = a >> 32, bLo = b & epsilon, bHi = b >> 32;
+    uint64_t lolo = aLo * bLo, lohi = aLo * bHi, hilo = aHi * bLo, hihi = aHi * bHi;
+    uint64_t middle = (lolo >> 32) + (lohi & epsilon) + (hilo & epsilon);
+    uint64_t lo = (middle << 32) | (lolo & epsilon);
+    uint64_t hi = hihi + (lohi >> 32) + (hilo >> 32) + (middle >> 32);
+    return reduce(hi, lo);
+#endif
+}
+
+uint64_t pow(uint64_t base, uint64_t exp) {
+    uint64_t result = 1;
+    while (exp) {
+        if (exp & 1) result = mul(result, base);
+        base = mul(base, base);
+        exp >>= 1;
+    }
+    return result;
+}
+
+void transform(std::vector<uint64_t>& a, bool inverse) {
+    size_t n = a.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(a[i], a[j]);
+    }
+
+    std::vector<uint64_t> twiddles(n / 2);
+    for (size_t length = 2; length <= n; length <<= 1) {
+        uint64_t root = pow(generator, (modulus - 1) / length);
+        if (inverse) root = pow(root, modulus - 2);
+
+        size_t half = length / 2;
+        twiddles[0] = 1;
+        for (size_t k = 1; k < half; ++k) twiddles[k] = mul(twiddles[k - 1], root);
+
+        for (size_t start = 0; start < n; start += length) {
+            for (size_t k = 0; k < half; ++k) {
+                uint64_t u = a[start + k], v = mul(a[start + k + half], twiddles[k]);
+                a[start + k] = add(u, v);
+                a[start + k + half] = sub(u, v);
+            }
+        }
+    }
+
+    if (inverse) {
+        uint64_t scale = pow(n, modulus - 2);
+        for (auto& x : a) x = mul(x, scale);
+    }
+}
+
+std::vector<uint64_t> digits(LimbSpan a, size_t size) {
+    std::vector<uint64_t> result(size);
+    for (size_t i = 0; i < a.size(); ++i) {
+        result[2 * i] = a[i] & 0xffff;
+        result[2 * i + 1] = a[i] >> 16;
+    }
+    return result;
+}
+}
+
+Limbs mulNtt(LimbSpan a, LimbSpan b) {
+    size_t size = std::bit_ceil(2 * (a.size() + b.size()));
+
+    // Squaring needs one forward transform less
+    auto fa = ntt::digits(a, size);
+    ntt::transform(fa, false);
+    if (a.data() == b.data() && a.size() == b.size()) {
+        for (auto& x : fa) x = ntt::mul(x, x);
+    }
+    else {
+        auto fb = ntt::digits(b, size);
+        ntt::transform(fb, false);
+        for (size_t i = 0; i < size; ++i) fa[i] = ntt::mul(fa[i], fb[i]);
+    }
+    ntt::transform(fa, true);
+
+    Limbs result(a.size() + b.size());
+    uint64_t carry = 0;
+    for (size_t i = 0; i < 2 * result.size(); ++i) {
+        uint64_t digit = fa[i] + carry;
+        carry = digit >> 16;
+        result[i / 2] |= static_cast<uint32_t>(digit & 0xffff) << (16 * (i % 2));
+    }
+    trimLimbs(result);
+    return result;
+}
+
+Limbs mulMagnitude(LimbSpan a, LimbSpan b);
+
+Limbs mulKaratsuba(LimbSpan a, LimbSpan b) {
+    size_t half = (a.size() + 1) / 2;
+
+    // Much shorter b, multiply it with both halves of a
+    if (b.size() <= half) {
+        Limbs result(a.size() + b.size() + 1);
+        addShifted(result, mulMagnitude(a.first(half), b), 0);
+        addShifted(result, mulMagnitude(a.subspan(half), b), half);
+        trimLimbs(result);
+        return result;
+    }
+
+    LimbSpan a0 = a.first(half), a1 = a.subspan(half), b0 = b.first(half), b1 = b.subspan(half);
+    Limbs z0 = mulMagnitude(a0, b0), z2 = mulMagnitude(a1, b1);
+    Limbs z1 = mulMagnitude(addMagnitude(a0, a1), addMagnitude(b0, b1));
+    z1 = subMagnitude(subMagnitude(z1, z0), z2);
+
+    Limbs result(a.size() + b.size() + 1);
+    addShifted(result, z0, 0);
+    addShifted(result, z1, half);
+    addShifted(result, z2, 2 * half);
+    trimLimbs(result);
+    return result;
+}
+
+Limbs mulMagnitude(LimbSpan a, LimbSpan b) {
+    if (a.size() < b.size()) std::swap(a, b);
+    while (!b.empty() && b.back() == 0) b = b.first(b.size() - 1);
+    while (!a.empty() && a.back() == 0) a = a.first(a.size() - 1);
+
+    if (b.size() < karatsubaThreshold) return mulSchoolbook(a, b);
+    if (b.size() >= nttThreshold) return mulNtt(a, b);
+    return mulKaratsuba(a, b);
+}
+
+// a = a * factor + addend
+void mulAddSmall(Limbs& a, uint32_t factor, uint32_t addend) {
+    uint64_t carry = addend;
+    for (auto& limb : a) {
+        uint64_t t = uint64_t(limb) * factor + carry;
+        limb = static_cast<uint32_t>(t);
+        carry = t >> 32;
+    }
+    if (carry) a.push_back(static_cast<uint32_t>(carry));
+}
+
+// Divides a in place and returns the remainder
+uint32_t divSmall(Limbs& a, uint32_t divisor) {
+    uint64_t rem = 0;
+    for (size_t i = a.size(); i-- > 0; ) {
+        uint64_t cur = (rem << 32) | a[i];
+        a[i] = static_cast<uint32_t>(cur / divisor);
+        rem = cur % divisor;
+    }
+    trimLimbs(a);
+    return static_cast<uint32_t>(rem);
+}
+
+Limbs shiftLeft(const Limbs& a, size_t bits) {
+    if (a.empty()) return {};
+
+    size_t limbShift = bits / 32, bitShift = bits % 32;
+    Limbs result(a.size() + limbShift + 1);
+    for (size_t i = 0; i < a.size(); ++i) {
+        uint64_t v = uint64_t(a[i]) << bitShift;
+        result[i + limbShift] |= static_cast<uint32_t>(v);
+        result[i + limbShift + 1] |= static_cast<uint32_t>(v >> 32);
+    }
+    trimLimbs(result);
+    return result;
+}
+
+Limbs shiftRight(const Limbs& a, size_t bits) {
+    size_t limbShift = bits / 32, bitShift = bits % 32;
+    if (limbShift >= a.size()) return {};
+
+    Limbs result(a.size() - limbShift);
+    for (size_t i = 0; i < result.size(); ++i) {
+        uint64_t v = a[i + limbShift];
+        if (i + limbShift + 1 < a.size()) v |= uint64_t(a[i + limbShift + 1]) << 32;
+        result[i] = static_cast<uint32_t>(v >> bitShift);
+    }
+    trimLimbs(result);
+    return result;
+}
+
+// Knuth's algorithm D (TAOCP 4.3.1) for divisors of at least two limbs
+void divmodMagnitude(const Limbs& a, const Limbs& b, Limbs& quotient, Limbs& remainder) {
+    if (compareMagnitude(a, b) < 0) {
+        quotient.clear();
+        remainder = a;
+        return;
+    }
+    if (b.size() == 1) {
+        quotient = a;
+        uint32_t rem = divSmall(quotient, b[0]);
+        remainder = rem ? Limbs{ rem } : Limbs{};
+        return;
+    }
+
+    // Normalizing so the top divisor limb has its high bit set keeps the quotient estimate within 2
+    int shift = std::countl_zero(b.back());
+    Limbs v = shiftLeft(b, shift);
+    Limbs u = shiftLeft(a, shift);
+    u.resize(a.size() + 1);
+
+    size_t n = v.size(), m = a.size() - n;
+    quotient.assign(m + 1, 0);
+
+    for (size_t j = m + 1; j-- > 0; ) {
+        uint64_t top = (uint64_t(u[j + n]) << 32) | u[j + n - 1];
+        uint64_t qhat = top / v[n - 1], rhat = top % v[n - 1];
+        while (qhat >= limbBase || qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])) {
+            --qhat;
+            rhat += v[n - 1];
+            if (rhat >= limbBase) break;
+        }
+
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t product = qhat * v[i] + carry;
+            carry = product >> 32;
+            int64_t diff = int64_t(u[i + j]) - borrow - int64_t(product & 0xffffffff);
+            u[i + j] = static_cast<uint32_t>(diff);
+            borrow = diff < 0;
+        }
+        int64_t diff = int64_t(u[j + n]) - borrow - int64_t(carry);
+        u[j + n] = static_cast<uint32_t>(diff);
+
+        // qhat was one too large, add the divisor back
+        if (diff < 0) {
+            --qhat;
+            carry = 0;
+            for (size_t i = 0; i < n; ++i) {
+                uint64_t sum = uint64_t(u[i + j]) + v[i] + carry;
+                u[i + j] = static_cast<uint32_t>(sum);
+                carry = sum >> 32;
+            }
+            u[j + n] += static_cast<uint32_t>(carry);
+        }
+        quotient[j] = static_cast<uint32_t>(qhat);
+    }
+
+    trimLimbs(quotient);
+    u.resize(n);
+    remainder = shiftRight(u, shift);
+}
+}
+
+BigInt::BigInt(int64_t value) : m_negative(value < 0) {
+    // Negating in unsigned arithmetic also works for INT64_MIN
+    m_limbs = fromWord(value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value));
+}
+
+BigInt BigInt::fromString(std::string_view text) {
+    BigInt result;
+    bool negative = !text.empty() && text.front() == '-';
+    if (negative) text.remove_prefix(1);
+    if (text.empty()) throw std::runtime_error("Expected digits in integer");
+
+    for (size_t i = 0; i < text.size(); ) {
+        size_t count = std::min<size_t>(decimalChunkDigits, text.size() - i);
+        uint32_t chunk = 0, scale = 1;
+        for (size_t k = 0; k < count; ++k, ++i) {
+            if (text[i] < '0' || text[i] > '9') throw std::runtime_error("Invalid digit in integer");
+            chunk = chunk * 10 + static_cast<uint32_t>(text[i] - '0');
+            scale *= 10;
+        }
+        mulAddSmall(result.m_limbs, scale, chunk);
+    }
+
+    result.trim();
+    result.m_negative = negative && !result.isZero();
+    return result;
+}
+
+size_t BigInt::bitLength() const {
+    if (m_limbs.empty()) return 0;
+    return m_limbs.size() * 32 - std::countl_zero(m_limbs.back());
+}
+
+bool BigInt::fitsInt64() const {
+    if (m_limbs.size() <= 1) return true;
+    if (m_limbs.size() > 2) return false;
+
+    uint64_t magnitude = lowWord(m_limbs);
+    return magnitude <= (m_negative ? uint64_t(1) << 63 : (uint64_t(1) << 63) - 1);
+}
+
+int64_t BigInt::toInt64() const {
+    if (!fitsInt64()) throw std::runtime_error("Integer does not fit in 64 bits");
+
+    uint64_t magnitude = lowWord(m_limbs);
+    return m_negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+}
+
+number_t BigInt::toNumber() const {
+    size_t bits = bitLength();
+    size_t shift = bits > 64 ? bits - 64 : 0;
+
+    uint64_t magnitude = lowWord(shiftRight(m_limbs, shift));
+    number_t value = std::ldexp(static_cast<number_t>(magnitude), static_cast<int>(shift));
+    return m_negative ? -value : value;
+}
+
+std::string BigInt::toString() const {
+    if (isZero()) return "0";
+
+    Limbs rest = m_limbs;
+    std::vector<uint32_t> chunks;
+    while (!rest.empty()) chunks.push_back(divSmall(rest, decimalChunk));
+
+    std::string result = m_negative ? "-" : "";
+    result += std::to_string(chunks.back());
+    for (size_t i = chunks.size() - 1; i-- > 0; ) {
+        std::string digits = std::to_string(chunks[i]);
+        result.append(decimalChunkDigits - digits.size(), '0');
+        result += digits;
+    }
+    return result;
+}
+
+BigInt BigInt::operator-() const {
+    BigInt result = *this;
+    result.m_negative = !m_negative && !isZero();
+    return result;
+}
+
+BigInt BigInt::abs() const {
+    BigInt result = *this;
+    result.m_negative = false;
+    return result;
+}
+
+BigInt BigInt::operator+(const BigInt& other) const {
+    BigInt result;
+    if (m_negative == other.m_negative) {
+        result.m_limbs = addMagnitude(m_limbs, other.m_limbs);
+        result.m_negative = m_negative;
+    }
+    else if (compareMagnitude(m_limbs, other.m_limbs) >= 0) {
+        result.m_limbs = subMagnitude(m_limbs, other.m_limbs);
+        result.m_negative = m_negative;
+    }
+    else {
+        result.m_limbs = subMagnitude(other.m_limbs, m_limbs);
+        result.m_negative = other.m_negative;
+    }
+    result.trim();
+    return result;
+}
+
+BigInt BigInt::operator-(const BigInt& other) const {
+    return *this + (-other);
+}
+
+BigInt BigInt::operator*(const BigInt& other) const {
+    BigInt result;
+    result.m_limbs = mulMagnitude(m_limbs, other.m_limbs);
+    result.m_negative = m_negative != other.m_negative;
+    result.trim();
+    return result;
+}
+
+BigInt BigInt::operator/(const BigInt& other) const {
+    return divmod(*this, other).first;
+}
+
+BigInt BigInt::operator%(const BigInt& other) const {
+    return divmod(*this, other).second;
+}
+
+BigInt BigInt::operator<<(size_t bits) const {
+    BigInt result;
+    result.m_limbs = shiftLeft(m_limbs, bits);
+    result.m_negative = m_negative;
+    result.trim();
+    return result;
+}
+
+BigInt BigInt::operator>>(size_t bits) const {
+    BigInt result;
+    result.m_limbs = shiftRight(m_limbs, bits);
+    result.m_negative = m_negative;
+    result.trim();
+    return result;
+}
+
+int BigInt::compare(const BigInt& other) const {
+    if (m_negative != other.m_negative) return m_negative ? -1 : 1;
+
+    int magnitude = compareMagnitude(m_limbs, other.m_limbs);
+    return m_negative ? -magnitude : magnitude;
+}
+
+std::pair<BigInt, BigInt> BigInt::divmod(const BigInt& a, const BigInt& b) {
+    if (b.isZero()) throw std::runtime_error("Division by zero");
+
+    BigInt quotient, remainder;
+    divmodMagnitude(a.m_limbs, b.m_limbs, quotient.m_limbs, remainder.m_limbs);
+    quotient.m_negative = a.m_negative != b.m_negative;
+    remainder.m_negative = a.m_negative;
+    quotient.trim();
+    remainder.trim();
+    return { std::move(quotient), std::move(remainder) };
+}
+
+BigInt BigInt::gcd(BigInt a, BigInt b) {
+    a.m_negative = b.m_negative = false;
+    while (!b.isZero()) {
+        // Finish in machine words once both operands got small enough
+        if (a.m_limbs.size() <= 2 && b.m_limbs.size() <= 2) {
+            uint64_t x = lowWord(a.m_limbs), y = lowWord(b.m_limbs);
+            while (y) x = std::exchange(y, x % y);
+
+            BigInt result;
+            result.m_limbs = fromWord(x);
+            return result;
+        }
+        a = std::exchange(b, a % b);
+    }
+    return a;
+}
+
+BigInt BigInt::pow(uint64_t exp) const {
+    BigInt result = 1, base = *this;
+    while (exp) {
+        if (exp & 1) result = result * base;
+        exp >>= 1;
+        if (exp) base = base * base;
+    }
+    return result;
+}
+
+BigInt BigInt::isqrt() const {
+    if (m_negative) throw std::runtime_error("Square root of a negative integer");
+    if (isZero()) return *this;
+
+    // Newton's iteration from above converges monotonically to the floor
+    BigInt x = BigInt(1) << ((bitLength() + 1) / 2);
+    while (true) {
+        BigInt next = (x + *this / x) >> 1;
+        if (next.compare(x) >= 0) return x;
+        x = std::move(next);
+    }
+}
+
+void BigInt::trim() {
+    trimLimbs(m_limbs);
+    if (m_limbs.empty()) m_negative = false;
+}
@@ -0,0 +1,61 @@
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include "types.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Arbitrary precision integer stored as sign and magnitude. The magnitude is kept in base 2^32
+// limbs, least significant first, without leading zero limbs, so zero has no limbs at all.
+class BigInt {
+public:
+    BigInt() = default;
+    BigInt(int64_t value);
+
+    // Decimal digits with an optional leading minus sign
+    static BigInt fromString(std::string_view text);
+
+    bool isZero() const { return m_limbs.empty(); }
+    bool isNegative() const { return m_negative; }
+    size_t bitLength() const;
+    const std::vector<uint32_t>& limbs() const { return m_limbs; }
+
+    bool fitsInt64() const;
+    int64_t toInt64() const;
+    // Truncates to the 64 bits of long double's mantissa
+    number_t toNumber() const;
+    std::string toString() const;
+
+    BigInt operator-() const;
+    BigInt abs() const;
+
+    BigInt operator+(const BigInt& other) const;
+    BigInt operator-(const BigInt& other) const;
+    BigInt operator*(const BigInt& other) const;
+    // Truncating division like the builtin integers, the remainder has the sign of the dividend
+    BigInt operator/(const BigInt& other) const;
+    BigInt operator%(const BigInt& other) const;
+    BigInt operator<<(size_t bits) const;
+    // Shifts the magnitude, so negative values round towards zero
+    BigInt operator>>(size_t bits) const;
+
+    bool operator==(const BigInt& other) const = default;
+    int compare(const BigInt& other) const;
+
+    static std::pair<BigInt, BigInt> divmod(const BigInt& a, const BigInt& b);
+    static BigInt gcd(BigInt a, BigInt b);
+    BigInt pow(uint64_t exp) const;
+    // Floor of the square root, the value must not be negative
+    BigInt isqrt() const;
+private:
+    void trim();
+private:
+    std::vector<uint32_t> m_limbs;
+    bool m_negative = false;
+};
+
+#endif
@@ -1,8 +1,165 @@
 #include "calculate.h"
 
+#include "polynomial.h"
+
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+// Integer exponents up to this size use binary exponentiation instead of std::pow
+constexpr number_t maxIntegerExponent = 64;
+
+// Subtrees with fewer nodes are evaluated serially, forking them costs more than it saves
+constexpr size_t parallelGrain = 2048;
+
+Value tableValue(const std::optional<std::unordered_map<std::string, number_t>>& varTable, const std::string& name) {
+    if (varTable.has_value()) {
+        if (auto it = varTable->find(name); it != varTable->end()) return it->second;
+    }
+    throw std::runtime_error("Variable " + name + " does not exist");
+}
+
+number_t applyBinary(NodeBinExpr* bin, number_t lhs, number_t rhs) {
+    if (std::holds_alternative<NodeBinExprAdd*>(bin->var)) return lhs + rhs;
+    if (std::holds_alternative<NodeBinExprSub*>(bin->var)) return lhs - rhs;
+    if (std::holds_alternative<NodeBinExprMul*>(bin->var)) return lhs * rhs;
+    if (std::holds_alternative<NodeBinExprDiv*>(bin->var)) return lhs / rhs;
+    return calculateExpr::power(lhs, rhs, calculateExpr::isNegativeLiteral(std::get<NodeBinExprPow*>(bin->var)->lhs));
+}
+
+// Operator chain like a + b - c, which nests to the left as (a + b) - c: the first operand, then the
+// operator and right operand of every step in the order eval applies them. Parentheses on the way
+// down are skipped, they evaluate to what they enclose.
+struct Chain {
+    NodeExpr* first = nullptr;
+    std::vector<std::pair<NodeBinExpr*, NodeExpr*>> steps;
+
+    NodeExpr* operand(size_t i) const { return i == 0 ? first : steps[i - 1].second; }
+    size_t size() const { return steps.size() + 1; }
+};
+
+Chain chainOf(NodeExpr* expr) {
+    Chain chain;
+    while (true) {
+        if (auto bin = std::get_if<NodeBinExpr*>(&expr->var)) {
+            auto [lhs, rhs] = std::visit([](auto n) { return std::make_pair(n->lhs, n->rhs); }, (*bin)->var);
+            chain.steps.emplace_back(*bin, rhs);
+            expr = lhs;
+        }
+        else if (auto term = std::get_if<NodeTerm*>(&expr->var); term && std::holds_alternative<NodeTermParen*>((*term)->var)) {
+            expr = std::get<NodeTermParen*>((*term)->var)->expr;
+        }
+        else break;
+    }
+    chain.first = expr;
+    std::ranges::reverse(chain.steps);
+    return chain;
+}
+
+// Size of expr. Chains of at least parallelGrain nodes are added to plan with the running sizes of
+// their operands, a chain is walked in a loop however long it is.
+size_t measure(NodeExpr* expr, calculateExpr::ParallelPlan& plan) {
+    if (!expr) return 0;
+
+    if (std::holds_alternative<NodeBinExpr*>(expr->var)) {
+        Chain chain = chainOf(expr);
+        std::vector<size_t> offsets{ 0 };
+        offsets.reserve(chain.size() + 1);
+        for (size_t i = 0; i < chain.size(); ++i) offsets.push_back(offsets.back() + measure(chain.operand(i), plan));
+
+        size_t size = offsets.back() + chain.steps.size();
+        if (size >= parallelGrain) plan.chains.emplace(expr, std::move(offsets));
+        return size;
+    }
+
+    size_t size = 1;
+    if (auto term = std::get_if<NodeTerm*>(&expr->var)) {
+        if (auto paren = std::get_if<NodeTermParen*>(&(*term)->var)) size += measure((*paren)->expr, plan);
+        else if (auto list = std::get_if<NodeTermList*>(&(*term)->var)) {
+            for (auto element : (*list)->elements) size += measure(element, plan);
+        }
+    }
+    else {
+        size += std::visit([&](auto node) {
+            size_t children = 0;
+            if constexpr (requires { node->args; }) for (auto arg : node->args) children += measure(arg, plan);
+            else if constexpr (requires { node->n; }) children = measure(node->expr, plan) + measure(node->n, plan);
+            else if constexpr (requires { node->lhs; }) children = measure(node->lhs, plan) + measure(node->rhs, plan);
+            else children = measure(node->expr, plan);
+            return children;
+        }, std::get<NodeExprFunc*>(expr->var)->var);
+    }
+    return size;
+}
+
+using VarTable = std::optional<std::unordered_map<std::string, number_t>>;
+
+// eval that splits the operands of large chains into parts of about parallelGrain nodes, evaluates
+// the parts in parallel and then combines the operands from left to right, as eval does
+class ForkedEval {
+public:
+    ForkedEval(const calculateExpr::ParallelPlan& plan, const VarTable& varTable, ForkJoinPool& pool)
+        : m_plan(plan), m_varTable(varTable), m_pool(pool) {}
+
+    number_t eval(NodeExpr* expr) const {
+        if (auto term = std::get_if<NodeTerm*>(&expr->var)) {
+            if (auto paren = std::get_if<NodeTermParen*>(&(*term)->var)) return eval((*paren)->expr);
+        }
+        else if (std::holds_alternative<NodeBinExpr*>(expr->var)) {
+            auto offsets = m_plan.chains.find(expr);
+            if (offsets == m_plan.chains.end()) return calculateExpr::eval(expr, m_varTable);
+
+            Chain chain = chainOf(expr);
+            std::vector<number_t> values(chain.size());
+            operands(chain, offsets->second, 0, chain.size(), values);
+
+            number_t result = values[0];
+            for (size_t i = 0; i < chain.steps.size(); ++i) result = applyBinary(chain.steps[i].first, result, values[i + 1]);
+            return result;
+        }
+        else if (auto func = std::get_if<NodeExprFunc*>(&expr->var)) {
+            // Unary functions pass the split on to their operand, the rest only occur on small values
+            auto unary = std::visit([](auto node) -> std::optional<std::pair<NodeExpr*, number_t(*)(number_t)>> {
+                using Node = std::remove_pointer_t<decltype(node)>;
+                if constexpr (std::is_same_v<Node, NodeBinExprSqrt>) return std::pair(node->expr, [](number_t x) { return std::sqrt(x); });
+                else if constexpr (std::is_same_v<Node, NodeBinExprSin>) return std::pair(node->expr, [](number_t x) { return std::sin(x); });
+                else if constexpr (std::is_same_v<Node, NodeBinExprCos>) return std::pair(node->expr, [](number_t x) { return std::cos(x); });
+                else if constexpr (std::is_same_v<Node, NodeBinExprTan>) return std::pair(node->expr, [](number_t x) { return std::tan(x); });
+                else if constexpr (std::is_same_v<Node, NodeBinExprAsin>) return std::pair(node->expr, [](number_t x) { return std::asin(x); });
+                else if constexpr (std::is_same_v<Node, NodeBinExprAcos>) return std::pair(node->expr, [](number_t x) { return std::acos(x); });
+                else if constexpr (std::is_same_v<Node, NodeBinExprAtan>) return std::pair(node->expr, [](number_t x) { return std::atan(x); });
+                else if constexpr (std::is_same_v<Node, NodeBinExprLog>) return std::pair(node->expr, [](number_t x) { return std::log10(x); });
+                else if constexpr (std::is_same_v<Node, NodeBinExprLn>) return std::pair(node->expr, [](number_t x) { return std::log(x); });
+                else return std::nullopt;
+            }, (*func)->var);
+            if (unary) return unary->second(eval(unary->first));
+        }
+        return calculateExpr::eval(expr, m_varTable);
+    }
+private:
+    // Values of the operands begin to end of chain, halved by size until a part is small or a single operand
+    void operands(const Chain& chain, const std::vector<size_t>& offsets, size_t begin, size_t end, std::vector<number_t>& values) const {
+        if (end - begin == 1 || offsets[end] - offsets[begin] < parallelGrain) {
+            for (size_t i = begin; i < end; ++i) values[i] = eval(chain.operand(i));
+            return;
+        }
+
+        size_t half = offsets[begin] + (offsets[end] - offsets[begin]) / 2;
+        size_t middle = std::upper_bound(offsets.begin() + begin + 1, offsets.begin() + end, half) - offsets.begin();
+        middle = std::min(middle, end - 1);
+        m_pool.invoke([&] { operands(chain, offsets, begin, middle, values); },
+                      [&] { operands(chain, offsets, middle, end, values); });
+    }
+private:
+    const calculateExpr::ParallelPlan& m_plan;
+    const VarTable& m_varTable;
+    ForkJoinPool& m_pool;
+};
+}
 
 namespace calculateExpr {
 number_t eval(NodeExpr* expr, const std::optional<std::unordered_map<std::string, number_t>>& varTable) {
@@ -14,6 +171,10 @@ number_t eval(NodeExpr* expr, const std::optional<std::unordered_map<std::string
         if (std::holds_alternative<NodeTermNumber*>(term->var)) {
             auto num = std::get<NodeTermNumber*>(term->var);
             if (num->lit && num->lit->value.has_value()) return std::stod(num->lit->value.value());
+        } else if (std::holds_alternative<NodeTermConstant*>(term->var)) {
+            auto constant = std::get<NodeTermConstant*>(term->var);
+            if (auto value = constants::value(constant->name->value.value())) return value.value();
+            throw std::runtime_error("Unknown constant " + constant->name->value.value());
         } else if (std::holds_alternative<NodeTermVariable*>(term->var)) {
             auto var = std::get<NodeTermVariable*>(term->var);
             auto str = var->ident->value.value();
@@ -26,44 +187,17 @@ number_t eval(NodeExpr* expr, const std::optional<std::unordered_map<std::string
         } else if (std::holds_alternative<NodeTermParen*>(term->var)) {
             auto paren = std::get<NodeTermParen*>(term->var);
             return eval(paren->expr, varTable);
+        } else if (std::holds_alternative<NodeTermList*>(term->var)) {
+            return evalValue(expr, [&](const std::string& name) { return tableValue(varTable, name); }).scalar();
         }
     }
     else if (std::holds_alternative<NodeBinExpr*>(expr->var)) {
         NodeBinExpr* bin = std::get<NodeBinExpr*>(expr->var);
-        if (std::holds_alternative<NodeBinExprAdd*>(bin->var)) {
-            auto n = std::get<NodeBinExprAdd*>(bin->var);
-            number_t lhs = eval(n->lhs, varTable);
-            number_t rhs = eval(n->rhs, varTable);
-
-            return lhs + rhs;
-        } else if (std::holds_alternative<NodeBinExprSub*>(bin->var)) {
-            auto n = std::get<NodeBinExprSub*>(bin->var);
-            number_t lhs = eval(n->lhs, varTable);
-            number_t rhs = eval(n->rhs, varTable);
+        auto operands = std::visit([](auto n) { return std::make_pair(n->lhs, n->rhs); }, bin->var);
+        number_t lhs = eval(operands.first, varTable);
+        number_t rhs = eval(operands.second, varTable);
 
-            return lhs - rhs;
-        } else if (std::holds_alternative<NodeBinExprMul*>(bin->var)) {
-            auto n = std::get<NodeBinExprMul*>(bin->var);
-            number_t lhs = eval(n->lhs, varTable);
-            number_t rhs = eval(n->rhs, varTable);
-
-            return lhs * rhs;
-        } else if (std::holds_alternative<NodeBinExprDiv*>(bin->var)) {
-            auto n = std::get<NodeBinExprDiv*>(bin->var);
-            number_t lhs = eval(n->lhs, varTable);
-            number_t rhs = eval(n->rhs, varTable);
-
-            return lhs / rhs;
-        }
-        else if (std::holds_alternative<NodeBinExprPow*>(bin->var)) {
-            auto n = std::get<NodeBinExprPow*>(bin->var);
-            number_t lhs = eval(n->lhs, varTable);
-            number_t rhs = eval(n->rhs, varTable);
-
-            if (lhs < 0) return -std::pow(std::abs(lhs), rhs);
-
-            return std::pow(lhs, rhs);
-        }
+        return applyBinary(bin, lhs, rhs);
     }
     else if (std::holds_alternative<NodeExprFunc*>(expr->var)) {
         NodeExprFunc* func = std::get<NodeExprFunc*>(expr->var);
@@ -123,10 +257,29 @@ number_t eval(NodeExpr* expr, const std::optional<std::unordered_map<std::string
 
             return std::log(expr);
         }
+        // Reductions and products of vectors
+        return evalValue(expr, [&](const std::string& name) { return tableValue(varTable, name); }).scalar();
     }
 
     return result;
 }
+ParallelPlan planParallel(NodeExpr* expr) {
+    ParallelPlan plan{ .expr = expr, .chains = {} };
+    measure(expr, plan);
+    return plan;
+}
+
+number_t evalParallel(const ParallelPlan& plan, ForkJoinPool& pool, const std::optional<std::unordered_map<std::string, number_t>>& varTable) {
+    number_t result = 0;
+    ForkedEval forked(plan, varTable, pool);
+    pool.run([&] { result = forked.eval(plan.expr); });
+    return result;
+}
+
+number_t evalParallel(NodeExpr* expr, ForkJoinPool& pool, const std::optional<std::unordered_map<std::string, number_t>>& varTable) {
+    return evalParallel(planParallel(expr), pool, varTable);
+}
+
 number_t eval(std::string eq) {
     Lexer lexer(eq);
     auto tokens = lexer.tokenize();
@@ -137,6 +290,295 @@ number_t eval(std::string eq) {
     return eval(ast->rhs);
 }
 
+std::optional<Rational> evalExact(NodeExpr* expr, const std::function<std::optional<Rational>(const std::string&)>& lookup) {
+    if (!expr) return std::nullopt;
+
+    if (std::holds_alternative<NodeTerm*>(expr->var)) {
+        NodeTerm* term = std::get<NodeTerm*>(expr->var);
+        if (auto num = std::get_if<NodeTermNumber*>(&term->var)) {
+            if ((*num)->lit && (*num)->lit->value.has_value()) return Rational::fromDecimal((*num)->lit->value.value());
+        }
+        else if (auto var = std::get_if<NodeTermVariable*>(&term->var)) {
+            if ((*var)->ident && (*var)->ident->value.has_value()) return lookup((*var)->ident->value.value());
+        }
+        else if (auto paren = std::get_if<NodeTermParen*>(&term->var)) {
+            return evalExact((*paren)->expr, lookup);
+        }
+        // Named constants are irrational
+        return std::nullopt;
+    }
+    else if (std::holds_alternative<NodeBinExpr*>(expr->var)) {
+        NodeBinExpr* bin = std::get<NodeBinExpr*>(expr->var);
+        auto operands = std::visit([](auto n) { return std::make_pair(n->lhs, n->rhs); }, bin->var);
+
+        auto lhs = evalExact(operands.first, lookup);
+        if (!lhs) return std::nullopt;
+        auto rhs = evalExact(operands.second, lookup);
+        if (!rhs) return std::nullopt;
+
+        if (std::holds_alternative<NodeBinExprAdd*>(bin->var)) return *lhs + *rhs;
+        if (std::holds_alternative<NodeBinExprSub*>(bin->var)) return *lhs - *rhs;
+        if (std::holds_alternative<NodeBinExprMul*>(bin->var)) return *lhs * *rhs;
+        if (std::holds_alternative<NodeBinExprDiv*>(bin->var)) {
+            // Left to floating point, which gives inf or nan
+            if (rhs->isZero()) return std::nullopt;
+            return *lhs / *rhs;
+        }
+
+        // Same sign rule as power()
+        if (lhs->isNegative() && isNegativeLiteral(operands.first)) {
+            auto result = (-*lhs).pow(*rhs);
+            return result ? std::optional(-*result) : std::nullopt;
+        }
+        return lhs->pow(*rhs);
+    }
+    else if (std::holds_alternative<NodeExprFunc*>(expr->var)) {
+        NodeExprFunc* func = std::get<NodeExprFunc*>(expr->var);
+        if (auto n = std::get_if<NodeBinExprSqrt*>(&func->var)) {
+            auto value = evalExact((*n)->expr, lookup);
+            return value ? value->sqrt() : std::nullopt;
+        }
+    }
+
+    return std::nullopt;
+}
+
+BigFloat evalPrecise(NodeExpr* expr, size_t bits, const std::function<BigFloat(const std::string&)>& lookup) {
+    if (!expr) return BigFloat();
+
+    if (std::holds_alternative<NodeTerm*>(expr->var)) {
+        NodeTerm* term = std::get<NodeTerm*>(expr->var);
+        if (auto num = std::get_if<NodeTermNumber*>(&term->var)) {
+            return BigFloat::fromDecimal((*num)->lit->value.value(), bits);
+        }
+        else if (auto constant = std::get_if<NodeTermConstant*>(&term->var)) {
+            if (auto value = bigfloat::constant((*constant)->name->value.value(), bits)) return value.value();
+            throw std::runtime_error("Unknown constant " + (*constant)->name->value.value());
+        }
+        else if (auto var = std::get_if<NodeTermVariable*>(&term->var)) {
+            return lookup((*var)->ident->value.value());
+        }
+        else if (auto paren = std::get_if<NodeTermParen*>(&term->var)) {
+            return evalPrecise((*paren)->expr, bits, lookup);
+        }
+    }
+    else if (std::holds_alternative<NodeBinExpr*>(expr->var)) {
+        NodeBinExpr* bin = std::get<NodeBinExpr*>(expr->var);
+        auto operands = std::visit([](auto n) { return std::make_pair(n->lhs, n->rhs); }, bin->var);
+
+        BigFloat lhs = evalPrecise(operands.first, bits, lookup);
+        BigFloat rhs = evalPrecise(operands.second, bits, lookup);
+
+        if (std::holds_alternative<NodeBinExprAdd*>(bin->var)) return bigfloat::add(lhs, rhs, bits);
+        if (std::holds_alternative<NodeBinExprSub*>(bin->var)) return bigfloat::sub(lhs, rhs, bits);
+        if (std::holds_alternative<NodeBinExprMul*>(bin->var)) return bigfloat::mul(lhs, rhs, bits);
+        if (std::holds_alternative<NodeBinExprDiv*>(bin->var)) return bigfloat::div(lhs, rhs, bits);
+        return bigfloat::pow(lhs, rhs, bits, isNegativeLiteral(operands.first));
+    }
+    else if (std::holds_alternative<NodeExprFunc*>(expr->var)) {
+        NodeExprFunc* func = std::get<NodeExprFunc*>(expr->var);
+        NodeExpr* argument = std::visit([](auto n) -> NodeExpr* {
+            if constexpr (requires { n->expr; }) return n->expr;
+            else return nullptr;
+        }, func->var);
+        if (!argument) throw std::runtime_error("Expression is not supported in precision mode");
+        BigFloat value = evalPrecise(argument, bits, lookup);
+
+        if (std::holds_alternative<NodeBinExprSqrt*>(func->var)) return bigfloat::sqrt(value, bits);
+        if (std::holds_alternative<NodeBinExprSin*>(func->var)) return bigfloat::sin(value, bits);
+        if (std::holds_alternative<NodeBinExprCos*>(func->var)) return bigfloat::cos(value, bits);
+        if (std::holds_alternative<NodeBinExprTan*>(func->var)) return bigfloat::tan(value, bits);
+        if (std::holds_alternative<NodeBinExprAsin*>(func->var)) return bigfloat::asin(value, bits);
+        if (std::holds_alternative<NodeBinExprAcos*>(func->var)) return bigfloat::acos(value, bits);
+        if (std::holds_alternative<NodeBinExprAtan*>(func->var)) return bigfloat::atan(value, bits);
+        if (std::holds_alternative<NodeBinExprLog*>(func->var)) return bigfloat::log10(value, bits);
+        if (std::holds_alternative<NodeBinExprLn*>(func->var)) return bigfloat::ln(value, bits);
+    }
+
+    throw std::runtime_error("Expression is not supported in precision mode");
+}
+
+Value evalValue(NodeExpr* expr, const std::function<Value(const std::string&)>& lookup, const CallHandler& call) {
+    if (!expr) return Value();
+
+    if (std::holds_alternative<NodeTerm*>(expr->var)) {
+        NodeTerm* term = std::get<NodeTerm*>(expr->var);
+        if (auto num = std::get_if<NodeTermNumber*>(&term->var)) {
+            return std::stod((*num)->lit->value.value());
+        }
+        else if (auto constant = std::get_if<NodeTermConstant*>(&term->var)) {
+            if (auto value = constants::value((*constant)->name->value.value())) return value.value();
+            throw std::runtime_error("Unknown constant " + (*constant)->name->value.value());
+        }
+        else if (auto var = std::get_if<NodeTermVariable*>(&term->var)) {
+            return lookup((*var)->ident->value.value());
+        }
+        else if (auto paren = std::get_if<NodeTermParen*>(&term->var)) {
+            return evalValue((*paren)->expr, lookup, call);
+        }
+        else if (auto list = std::get_if<NodeTermList*>(&term->var)) {
+            std::vector<Value> elements;
+            elements.reserve((*list)->elements.size());
+            for (auto element : (*list)->elements) elements.push_back(evalValue(element, lookup, call));
+
+            // A list of numbers is a vector, a list of equally long vectors the rows of a matrix
+            std::vector<number_t> flat;
+            if (elements.front().isScalar()) {
+                for (const auto& element : elements) flat.push_back(element.scalar());
+                return Value::vector(std::move(flat));
+            }
+
+            size_t cols = elements.front().size();
+            flat.reserve(elements.size() * cols);
+            for (const auto& element : elements) {
+                if (element.rank() != 1) throw std::runtime_error("Rows of a matrix must be vectors");
+                if (element.size() != cols) throw std::runtime_error("Rows of a matrix must have the same length");
+                flat.insert(flat.end(), element.elements().begin(), element.elements().end());
+            }
+            return Value::matrix(elements.size(), cols, std::move(flat));
+        }
+    }
+    else if (std::holds_alternative<NodeBinExpr*>(expr->var)) {
+        NodeBinExpr* bin = std::get<NodeBinExpr*>(expr->var);
+        auto operands = std::visit([](auto n) { return std::make_pair(n->lhs, n->rhs); }, bin->var);
+
+        Value lhs = evalValue(operands.first, lookup, call);
+        Value rhs = evalValue(operands.second, lookup, call);
+
+        if (std::holds_alternative<NodeBinExprAdd*>(bin->var)) return lhs + rhs;
+        if (std::holds_alternative<NodeBinExprSub*>(bin->var)) return lhs - rhs;
+        if (std::holds_alternative<NodeBinExprMul*>(bin->var)) return lhs * rhs;
+        if (std::holds_alternative<NodeBinExprDiv*>(bin->var)) return lhs / rhs;
+
+        bool negativeLiteralBase = isNegativeLiteral(operands.first);
+        return Value::broadcast(lhs, rhs, [=](number_t base, number_t exp) { return power(base, exp, negativeLiteralBase); });
+    }
+    else if (std::holds_alternative<NodeExprFunc*>(expr->var)) {
+        NodeExprFunc* func = std::get<NodeExprFunc*>(expr->var);
+        if (auto n = std::get_if<NodeBinExprDot*>(&func->var)) {
+            return Value::dot(evalValue((*n)->lhs, lookup, call), evalValue((*n)->rhs, lookup, call));
+        }
+        if (auto n = std::get_if<NodeBinExprMatmul*>(&func->var)) {
+            return Value::matmul(evalValue((*n)->lhs, lookup, call), evalValue((*n)->rhs, lookup, call));
+        }
+        if (auto n = std::get_if<NodeBinExprCall*>(&func->var)) {
+            if (!call) throw std::runtime_error("Unknown function " + (*n)->name->value.value());
+
+            std::vector<Value> args;
+            args.reserve((*n)->args.size());
+            for (auto arg : (*n)->args) args.push_back(evalValue(arg, lookup, call));
+            return call((*n)->name->value.value(), args);
+        }
+
+        NodeExpr* argument = std::visit([](auto n) -> NodeExpr* {
+            if constexpr (requires { n->expr; }) return n->expr;
+            else return nullptr;
+        }, func->var);
+        Value value = evalValue(argument, lookup, call);
+
+        if (std::holds_alternative<NodeBinExprSum*>(func->var)) return value.sum();
+        if (std::holds_alternative<NodeBinExprMean*>(func->var)) return value.mean();
+        if (std::holds_alternative<NodeBinExprStdev*>(func->var)) return value.stdev();
+        if (std::holds_alternative<NodeBinExprMin*>(func->var)) return value.min();
+        if (std::holds_alternative<NodeBinExprMax*>(func->var)) return value.max();
+
+        if (std::holds_alternative<NodeBinExprSqrt*>(func->var)) return value.map([](number_t x) { return std::sqrt(x); });
+        if (std::holds_alternative<NodeBinExprSin*>(func->var)) return value.map([](number_t x) { return std::sin(x); });
+        if (std::holds_alternative<NodeBinExprCos*>(func->var)) return value.map([](number_t x) { return std::cos(x); });
+        if (std::holds_alternative<NodeBinExprTan*>(func->var)) return value.map([](number_t x) { return std::tan(x); });
+        if (std::holds_alternative<NodeBinExprAsin*>(func->var)) return value.map([](number_t x) { return std::asin(x); });
+        if (std::holds_alternative<NodeBinExprAcos*>(func->var)) return value.map([](number_t x) { return std::acos(x); });
+        if (std::holds_alternative<NodeBinExprAtan*>(func->var)) return value.map([](number_t x) { return std::atan(x); });
+        if (std::holds_alternative<NodeBinExprLog*>(func->var)) return value.map([](number_t x) { return std::log10(x); });
+        if (std::holds_alternative<NodeBinExprLn*>(func->var)) return value.map([](number_t x) { return std::log(x); });
+    }
+
+    throw std::runtime_error("Expression cannot be evaluated");
+}
+
+bool needsValues(NodeExpr* expr, const std::function<bool(const std::string&)>& isVector) {
+    if (!expr) return false;
+
+    // Down the left operands in a loop, long chains like a + b + c nest as deep as they are long
+    while (auto bin = std::get_if<NodeBinExpr*>(&expr->var)) {
+        auto operands = std::visit([](auto n) { return std::make_pair(n->lhs, n->rhs); }, (*bin)->var);
+        if (needsValues(operands.second, isVector)) return true;
+        expr = operands.first;
+    }
+
+    if (auto term = std::get_if<NodeTerm*>(&expr->var)) {
+        if (std::holds_alternative<NodeTermList*>((*term)->var)) return true;
+        if (auto var = std::get_if<NodeTermVariable*>(&(*term)->var)) return isVector((*var)->ident->value.value());
+        if (auto paren = std::get_if<NodeTermParen*>(&(*term)->var)) return needsValues((*paren)->expr, isVector);
+        return false;
+    }
+
+    // Reductions, dot and matmul only exist for values
+    auto func = std::get<NodeExprFunc*>(expr->var);
+    if (std::holds_alternative<NodeBinExprSum*>(func->var) || std::holds_alternative<NodeBinExprMean*>(func->var)
+        || std::holds_alternative<NodeBinExprStdev*>(func->var) || std::holds_alternative<NodeBinExprMin*>(func->var)
+        || std::holds_alternative<NodeBinExprMax*>(func->var) || std::holds_alternative<NodeBinExprDot*>(func->var)
+        || std::holds_alternative<NodeBinExprMatmul*>(func->var)) return true;
+
+    if (auto call = std::get_if<NodeBinExprCall*>(&func->var)) {
+        return std::ranges::any_of((*call)->args, [&](NodeExpr* arg) { return needsValues(arg, isVector); });
+    }
+
+    return std::visit([&](auto node) {
+        if constexpr (requires { node->n; }) return needsValues(node->expr, isVector) || needsValues(node->n, isVector);
+        else if constexpr (requires { node->expr; }) return needsValues(node->expr, isVector);
+        else return true;
+    }, func->var);
+}
+
+bool hasCalls(NodeExpr* expr) {
+    if (!expr) return false;
+
+    // Same loop down the left operands as needsValues
+    while (auto bin = std::get_if<NodeBinExpr*>(&expr->var)) {
+        auto operands = std::visit([](auto n) { return std::make_pair(n->lhs, n->rhs); }, (*bin)->var);
+        if (hasCalls(operands.second)) return true;
+        expr = operands.first;
+    }
+
+    if (auto term = std::get_if<NodeTerm*>(&expr->var)) {
+        if (auto paren = std::get_if<NodeTermParen*>(&(*term)->var)) return hasCalls((*paren)->expr);
+        if (auto list = std::get_if<NodeTermList*>(&(*term)->var)) return std::ranges::any_of((*list)->elements, hasCalls);
+        return false;
+    }
+
+    return std::visit([](auto node) {
+        if constexpr (requires { node->args; }) return true;
+        else if constexpr (requires { node->n; }) return hasCalls(node->expr) || hasCalls(node->n);
+        else if constexpr (requires { node->lhs; }) return hasCalls(node->lhs) || hasCalls(node->rhs);
+        else return hasCalls(node->expr);
+    }, std::get<NodeExprFunc*>(expr->var)->var);
+}
+
+number_t power(number_t base, number_t exp, bool negativeLiteralBase) {
+    bool isInteger = exp == std::trunc(exp);
+    bool small = isInteger && std::abs(exp) <= maxIntegerExponent;
+
+    // -2^2 is lexed as the literal -2, so the sign is applied after the power.
+    // Negative bases with fractional exponents keep the odd-root convention -(|b|^e).
+    if (base < 0 && (negativeLiteralBase || !isInteger)) {
+        return -(small ? polynomial::ipow(-base, static_cast<int64_t>(exp)) : std::pow(-base, exp));
+    }
+
+    if (small) return polynomial::ipow(base, static_cast<int64_t>(exp));
+    return std::pow(base, exp);
+}
+
+bool isNegativeLiteral(NodeExpr* expr) {
+    if (auto term = std::get_if<NodeTerm*>(&expr->var)) {
+        if (auto num = std::get_if<NodeTermNumber*>(&(*term)->var)) {
+            auto& value = (*num)->lit->value;
+            return value.has_value() && !value->empty() && value->front() == '-';
+        }
+    }
+    return false;
+}
+
 number_t solve(NodeEquals* expr) { // WIP
     auto lhs = expr->lhs;
     auto rhs = expr->rhs;
@@ -3,14 +3,57 @@
 
 #include "types.h"
 #include "parser.h"
+#include "rational.h"
+#include "bigfloat.h"
+#include "value.h"
+#include "forkjoin.h"
+#include <functional>
 #include <optional>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace calculateExpr {
     number_t eval(NodeExpr* expr, const std::optional<std::unordered_map<std::string, number_t>>& varTable = std::nullopt);
     number_t eval(std::string eq);
 
+    // Operator chains of expr like a + b - c large enough to be worth evaluating in parallel, found in
+    // one pass over it. Each maps to the running sizes of its operands, from 0 to the size of all.
+    struct ParallelPlan {
+        NodeExpr* expr = nullptr;
+        std::unordered_map<NodeExpr*, std::vector<size_t>> chains;
+    };
+    ParallelPlan planParallel(NodeExpr* expr);
+    // Same value as eval, bit for bit. The operands of large chains are evaluated in parallel on pool
+    // and combined from left to right afterwards, chains of any length are walked without recursion.
+    // Meant for machine-generated expressions of many thousands of nodes, a plan saves the sizing pass
+    // when the same expression is evaluated again.
+    number_t evalParallel(const ParallelPlan& plan, ForkJoinPool& pool, const std::optional<std::unordered_map<std::string, number_t>>& varTable = std::nullopt);
+    number_t evalParallel(NodeExpr* expr, ForkJoinPool& pool, const std::optional<std::unordered_map<std::string, number_t>>& varTable = std::nullopt);
+
+    // Exact value of an expression made of rational literals, exactly known variables, + - * /,
+    // integer powers and square roots of squares. std::nullopt as soon as any part has no exact value.
+    std::optional<Rational> evalExact(NodeExpr* expr, const std::function<std::optional<Rational>(const std::string&)>& lookup);
+
+    // Value to the given number of bits, the working precision of every step. Variables come from
+    // lookup, which throws for unknown names like eval does.
+    BigFloat evalPrecise(NodeExpr* expr, size_t bits, const std::function<BigFloat(const std::string&)>& lookup);
+
+    // Evaluates vectors and matrices, every operator and function applies element-wise with broadcasting.
+    // Calls of user functions go to call, without it they cannot be evaluated.
+    using CallHandler = std::function<Value(const std::string&, const std::vector<Value>&)>;
+    Value evalValue(NodeExpr* expr, const std::function<Value(const std::string&)>& lookup, const CallHandler& call = {});
+    // True if expr has lists, vector functions or variables for which isVector is true. Those need
+    // evalValue, every other evaluator only handles numbers.
+    bool needsValues(NodeExpr* expr, const std::function<bool(const std::string&)>& isVector);
+    // True if expr calls a user function
+    bool hasCalls(NodeExpr* expr);
+
     number_t solve(NodeEquals* expr);
+
+    // Power with the parser's sign rule, -2^2 is the literal -2 raised to 2 and evaluates to -4
+    number_t power(number_t base, number_t exp, bool negativeLiteralBase);
+    bool isNegativeLiteral(NodeExpr* expr);
 }
 
 #endif
\ No newline at end of file
@@ -4,27 +4,40 @@
 #include "functions.h"
 #include "lexer.h"
 #include "calculate.h"
+#include "polynomial.h"
+#include "linear.h"
+#include "egraph.h"
 
+#include <algorithm>
+#include <iterator>
+#include <limits>
 #include <stdexcept>
+#include <utility>
+
+namespace {
+// The rules are parsed once and shared by every session
+const Simplifier& simplifier() {
+    static const Simplifier instance;
+    return instance;
+}
+}
 
 void CAS::setVariable(std::string key, number_t value) {
-    if (auto it = m_varTable.find(key); it != m_varTable.end()) {
-        it->second = value;
-    }
-    else {
-        m_varTable.insert(std::make_pair(key, value));
-    }
+    m_exactTable.erase(key);
+    m_preciseTable.erase(key);
+    m_vectorTable.erase(key);
+    m_variables.set(key, value);
 }
 
 number_t CAS::getVariable(std::string key) {
-    if (auto it = m_varTable.find(key); it != m_varTable.end()) {
-        return it->second;
+    if (auto value = m_variables.get(key)) {
+        return value.value();
     }
     return 0;
 }
 
 std::tuple<std::string, number_t> CAS::calc(std::string eq) {
-    Lexer lexer(eq);
+    Lexer lexer(eq, [this](const std::string& name) { return isFunction(name); });
     auto tokens = lexer.tokenize();
     //printTokens(tokens);
     
@@ -33,14 +46,398 @@ std::tuple<std::string, number_t> CAS::calc(std::string eq) {
     //printAST(ast->lhs);
     //printAST(ast->rhs);
 
-    number_t result = calculateExpr::eval(ast->rhs, m_varTable);
+    auto var = isVariable(ast->lhs);
+    if (!var.has_value()) throw std::runtime_error("Left hand side should be a variable but isn't");
 
-    if (auto var = isVariable(ast->lhs)) {
+    std::optional<Simplified> simplified;
+    if (m_simplify && (simplified = simplifier().simplify(ast->rhs))) ast->rhs = simplified->expr;
+
+    if (calculateExpr::needsValues(ast->rhs, [this](const std::string& name) { return m_vectorTable.contains(name); })) {
+        Value value = calculateExpr::evalValue(ast->rhs, [this](const std::string& name) -> Value {
+            if (auto vector = vectorValue(name)) return vector.value();
+            if (auto value = m_variables.get(name)) return value.value();
+            throw std::runtime_error("Variable " + name + " does not exist");
+        }, [this](const std::string& name, const std::vector<Value>& args) { return callFunction(name, args); });
+
+        // Reductions give numbers, which are stored like any other result
+        number_t result = value.isScalar() ? value.scalar() : std::numeric_limits<number_t>::quiet_NaN();
         setVariable(var.value(), result);
+        if (!value.isScalar()) m_vectorTable.insert_or_assign(var.value(), std::move(value));
+        m_formulaTable.erase(var.value());
 
         return std::make_tuple(var.value(), result);
     }
-    else throw std::runtime_error("Left hand side should be a variable but isn't");
+
+    if (m_pool && !m_exact && !m_precision && !calculateExpr::hasCalls(ast->rhs)) {
+        auto plan = calculateExpr::planParallel(ast->rhs);
+        if (!plan.chains.empty()) {
+            std::unordered_map<std::string, number_t> values;
+            for (const auto& token : tokens) {
+                if (token.type != TokenType::variable) continue;
+                if (auto value = m_variables.get(token.value.value())) values.emplace(token.value.value(), value.value());
+            }
+            number_t result = calculateExpr::evalParallel(plan, *m_pool, values);
+
+            setVariable(var.value(), result);
+            m_formulaTable.erase(var.value());
+            return std::make_tuple(var.value(), result);
+        }
+    }
+
+    auto compiled = std::make_shared<const CompiledExpr>(CompiledExpr::compile(ast->rhs, &m_functions));
+
+    std::optional<Rational> exact;
+    if (m_exact) {
+        exact = calculateExpr::evalExact(ast->rhs, [this](const std::string& name) { return exactValue(name); });
+    }
+    std::optional<BigFloat> precise;
+    // User functions are compiled to number_t code, their calls have no precise value
+    if (m_precision && !exact && !calculateExpr::hasCalls(ast->rhs)) {
+        precise = calculateExpr::evalPrecise(ast->rhs, bigfloat::bitsForDigits(m_precision), [this](const std::string& name) {
+            if (auto value = preciseValue(name)) return value.value();
+            throw std::runtime_error("Variable " + name + " does not exist");
+        });
+    }
+    number_t result = exact ? exact->toNumber() : precise ? precise->toNumber() : m_context.evaluate(*compiled);
+
+    setVariable(var.value(), result);
+    if (exact) m_exactTable.insert_or_assign(var.value(), std::move(exact.value()));
+    if (precise) m_preciseTable.insert_or_assign(var.value(), std::move(precise.value()));
+    m_formulaTable.insert_or_assign(var.value(), std::move(compiled));
+
+    return std::make_tuple(var.value(), result);
+}
+
+void CAS::setParallel(bool parallel) {
+    if (!parallel) m_pool.reset();
+    else if (!m_pool) m_pool = std::make_unique<ForkJoinPool>();
+}
+
+std::optional<Rational> CAS::exactValue(const std::string& name) const {
+    if (auto it = m_exactTable.find(name); it != m_exactTable.end()) return it->second;
+    return std::nullopt;
+}
+
+std::optional<BigFloat> CAS::preciseValue(const std::string& name) const {
+    if (auto it = m_preciseTable.find(name); it != m_preciseTable.end()) return it->second;
+    if (auto exact = exactValue(name)) {
+        return bigfloat::div(BigFloat(exact->numerator()), BigFloat(exact->denominator()), bigfloat::bitsForDigits(m_precision));
+    }
+    if (auto value = m_variables.get(name)) return BigFloat::fromNumber(value.value());
+    return std::nullopt;
+}
+
+std::optional<Value> CAS::vectorValue(const std::string& name) const {
+    if (auto it = m_vectorTable.find(name); it != m_vectorTable.end()) return it->second;
+    return std::nullopt;
+}
+
+std::string CAS::expand(std::string expr) {
+    Lexer lexer(expr, [this](const std::string& name) { return isFunction(name); });
+    auto tokens = lexer.tokenize();
+
+    Parser parser(tokens);
+    auto ast = parser.parse();
+
+    auto poly = Polynomial::fromExpr(ast->rhs);
+    if (!poly.has_value()) throw std::runtime_error("Expression is not a polynomial");
+
+    return poly->toString();
+}
+
+Series CAS::series(std::string expr, const std::string& variable, number_t center, size_t order) {
+    Lexer lexer(expr, [this](const std::string& name) { return isFunction(name); });
+    auto tokens = lexer.tokenize();
+
+    Parser parser(tokens);
+    auto ast = parser.parse();
+
+    return series::taylor(ast->rhs, variable, center, order, [this](const std::string& name) {
+        if (auto value = m_variables.get(name)) return value.value();
+        throw std::runtime_error("Variable " + name + " does not exist");
+    });
+}
+
+Profiler CAS::profile(std::string expr) const {
+    Lexer lexer(expr, [this](const std::string& name) { return isFunction(name); });
+    auto tokens = lexer.tokenize();
+
+    Parser parser(tokens);
+    auto ast = parser.parse();
+
+    return Profiler(ast->rhs, [this](const std::string& name) {
+        if (auto value = m_variables.get(name)) return value.value();
+        throw std::runtime_error("Variable " + name + " does not exist");
+    }, &m_functions);
+}
+
+std::string CAS::simplify(std::string expr) {
+    Lexer lexer(expr, [this](const std::string& name) { return isFunction(name); });
+    auto tokens = lexer.tokenize();
+
+    Parser parser(tokens);
+    auto ast = parser.parse();
+
+    auto simplified = simplifier().simplify(ast->rhs);
+    if (!simplified.has_value()) throw std::runtime_error("Only numbers, variables, operators and elementary functions can be simplified");
+
+    return simplified->text;
+}
+
+std::vector<std::pair<std::string, number_t>> CAS::gradient(std::string expr, const std::vector<std::string>& variables) {
+    auto compiled = compile(expr);
+    std::vector<number_t> partials(compiled->symbols().size());
+    m_context.gradient(*compiled, partials);
+
+    std::vector<std::pair<std::string, number_t>> result;
+    if (variables.empty()) {
+        for (size_t i = 0; i < partials.size(); ++i) result.emplace_back(compiled->symbols()[i], partials[i]);
+        return result;
+    }
+    for (const auto& name : variables) {
+        auto symbol = std::ranges::find(compiled->symbols(), name);
+        result.emplace_back(name, symbol == compiled->symbols().end() ? 0 : partials[symbol - compiled->symbols().begin()]);
+    }
+    return result;
+}
+
+std::vector<std::pair<std::string, number_t>> CAS::solve(const std::vector<std::string>& equations, const std::vector<std::string>& unknowns) {
+    LinearSystem system(unknowns, [this](const std::string& name) { return m_variables.get(name).has_value() || m_vectorTable.contains(name); });
+    auto lookup = [this](const std::string& name) -> Value {
+        if (auto vector = vectorValue(name)) return vector.value();
+        if (auto value = m_variables.get(name)) return value.value();
+        throw std::runtime_error("Variable " + name + " does not exist");
+    };
+    auto call = [this](const std::string& name, const std::vector<Value>& args) { return callFunction(name, args); };
+
+    for (const auto& equation : equations) {
+        Lexer lexer(equation, [this](const std::string& name) { return isFunction(name); });
+        auto tokens = lexer.tokenize();
+        if (std::ranges::count_if(tokens, [](const Token& token) { return token.type == TokenType::equals; }) != 1) {
+            throw std::runtime_error("Expected an equation with a single = but got " + equation);
+        }
+
+        Parser parser(tokens);
+        auto ast = parser.parse();
+        system.add(ast->lhs, ast->rhs, lookup, call);
+    }
+
+    auto values = system.solve();
+    std::vector<std::pair<std::string, number_t>> solution;
+    solution.reserve(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        const std::string& name = system.unknowns()[i];
+        m_exactTable.erase(name);
+        m_preciseTable.erase(name);
+        m_vectorTable.erase(name);
+        m_formulaTable.erase(name);
+        solution.emplace_back(name, values[i]);
+    }
+    // One published version for the whole solution instead of one per unknown
+    m_variables.set(solution);
+    return solution;
+}
+
+OdeSystem CAS::odeSystem(const std::vector<std::string>& derivatives) const {
+    std::vector<std::string> states;
+    std::vector<SharedExpr> expressions;
+    for (const auto& derivative : derivatives) {
+        Lexer lexer(derivative, [this](const std::string& name) { return isFunction(name); });
+        Parser parser(lexer.tokenize());
+        auto ast = parser.parse();
+
+        auto term = std::get_if<NodeTerm*>(&ast->lhs->var);
+        auto variable = term ? std::get_if<NodeTermVariable*>(&(*term)->var) : nullptr;
+        if (!variable || (*variable)->ident->value.value() == "ans") throw std::runtime_error("Expected x = expr for dx/dt but got " + derivative);
+
+        states.push_back((*variable)->ident->value.value());
+        expressions.push_back(std::make_shared<const CompiledExpr>(CompiledExpr::compile(ast->rhs, &m_functions)));
+    }
+
+    return OdeSystem(std::move(states), std::move(expressions), [this](const std::string& name) {
+        if (auto value = m_variables.get(name)) return value.value();
+        throw std::runtime_error("Variable " + name + " does not exist");
+    });
+}
+
+Trajectory CAS::odesolve(const OdeSystem& system, number_t t0, number_t t1, size_t samples, const OdeOptions& options) {
+    std::vector<number_t> initial;
+    for (const auto& name : system.states()) {
+        auto value = m_variables.get(name);
+        if (!value) throw std::runtime_error("Variable " + name + " needs an initial value");
+        initial.push_back(value.value());
+    }
+
+    auto trajectory = system.integrate(initial, t0, t1, samples, options);
+
+    std::vector<std::pair<std::string, number_t>> final{ { "t", t1 } };
+    for (size_t i = 0; i < system.size(); ++i) final.emplace_back(system.states()[i], trajectory.states[trajectory.states.size() - system.size() + i]);
+    for (const auto& [name, value] : final) {
+        m_exactTable.erase(name);
+        m_preciseTable.erase(name);
+        m_vectorTable.erase(name);
+        m_formulaTable.erase(name);
+    }
+    m_variables.set(final);
+    return trajectory;
+}
+
+std::optional<std::string> CAS::define(const std::string& line) {
+    auto equals = line.find('=');
+    if (equals == std::string::npos) return std::nullopt;
+
+    // The head is name(params) or name(numbers), only its first name can be a function
+    Lexer headLexer(line.substr(0, equals), [first = true](const std::string&) mutable { return std::exchange(first, false); });
+    auto head = headLexer.tokenize();
+    if (head.size() < 4 || head[0].type != TokenType::function || head[1].type != TokenType::lParen) return std::nullopt;
+
+    std::string name = head[0].value.value();
+    std::vector<std::string> params;
+    std::vector<number_t> literals;
+    size_t i = 2;
+    while (head[i].type != TokenType::rParen) {
+        if (!params.empty() || !literals.empty()) {
+            if (head[i].type != TokenType::comma) return std::nullopt;
+            ++i;
+        }
+
+        bool negative = head[i].type == TokenType::minus;
+        if (negative) ++i;
+        if (head[i].type == TokenType::number && params.empty()) {
+            number_t value = std::stod(head[i].value.value());
+            literals.push_back(negative ? -value : value);
+        }
+        else if (head[i].type == TokenType::variable && !negative && literals.empty()) {
+            if (std::ranges::find(params, head[i].value.value()) != params.end()) {
+                throw std::runtime_error("Parameter " + head[i].value.value() + " of " + name + " appears twice");
+            }
+            params.push_back(head[i].value.value());
+        }
+        else return std::nullopt;
+        ++i;
+    }
+    if (head[i + 1].type != TokenType::end) return std::nullopt;
+
+    // Parameters shadow functions of the same name, the function itself is known for recursion
+    Lexer bodyLexer(line.substr(equals + 1), [&](const std::string& ident) {
+        return std::ranges::find(params, ident) == params.end() && (ident == name || isFunction(ident));
+    });
+    auto tokens = bodyLexer.tokenize();
+    if (std::ranges::any_of(tokens, [](const Token& token) { return token.type == TokenType::equals; })) {
+        throw std::runtime_error("Expected a single = in the definition of " + name);
+    }
+    Parser parser(tokens);
+    NodeExpr* body = parser.parse()->rhs;
+
+    auto previous = m_functions.find(name) != m_functions.end() ? std::optional(m_functions.at(name)) : std::nullopt;
+    FunctionDef& function = m_functions[name];
+    std::string description = "Defined " + name + "(";
+    try {
+        if (!literals.empty()) {
+            if ((function.body || !function.cases.empty()) && literals.size() != function.arity()) {
+                throw std::runtime_error(name + " takes " + std::to_string(function.arity()) + " arguments");
+            }
+
+            // Base cases are values, the right hand side is evaluated once here
+            number_t value = m_context.evaluate(CompiledExpr::compile(body, &m_functions));
+            std::erase_if(function.cases, [&](const auto& c) { return c.first == literals; });
+            function.cases.emplace_back(literals, value);
+
+            for (size_t j = 0; j < literals.size(); ++j) description += (j ? ", " : "") + formatNumber(literals[j]);
+            description += ") = " + formatNumber(value);
+        }
+        else {
+            // A new arity replaces the function, base cases of the old one no longer apply
+            if (function.arity() != params.size()) function.cases.clear();
+            function.params = std::move(params);
+            function.body = body;
+            function.tree = parser.arena();
+
+            // Checks calls and arities in the body once instead of on every use
+            CompiledExpr::compileCall(name, m_functions);
+
+            for (size_t j = 0; j < function.params.size(); ++j) description += (j ? ", " : "") + function.params[j];
+            description += ")";
+        }
+    }
+    catch (...) {
+        if (previous) m_functions.insert_or_assign(name, std::move(previous.value()));
+        else m_functions.erase(name);
+        throw;
+    }
+    return description;
+}
+
+void CAS::setMemoize(const std::string& name, bool memoize) {
+    auto it = m_functions.find(name);
+    if (it == m_functions.end()) throw std::runtime_error("Unknown function " + name);
+    it->second.memoize = memoize;
+}
+
+SharedExpr CAS::compile(std::string expr) const {
+    Lexer lexer(expr, [this](const std::string& name) { return isFunction(name); });
+    auto tokens = lexer.tokenize();
+
+    Parser parser(tokens);
+    auto ast = parser.parse();
+
+    return std::make_shared<const CompiledExpr>(CompiledExpr::compile(ast->rhs, &m_functions));
+}
+
+void CAS::save(const std::string& path) {
+    auto variables = m_variables.entries();
+    std::vector<std::pair<std::string, const CompiledExpr*>> formulas;
+    formulas.reserve(m_formulaTable.size());
+    for (const auto& [name, formula] : m_formulaTable) formulas.emplace_back(name, formula.get());
+
+    // Entries of the loaded snapshot that were not overwritten in this session
+    std::vector<CompiledExpr> inherited;
+    if (m_snapshot) {
+        std::unordered_map<std::string, number_t> defined(variables.begin(), variables.end());
+        for (const auto& entry : m_snapshot->variables()) {
+            std::string name(m_snapshot->string(entry.name));
+            if (!defined.contains(name)) variables.emplace_back(std::move(name), entry.value);
+        }
+
+        inherited.reserve(m_snapshot->formulas().size());
+        for (const auto& entry : m_snapshot->formulas()) {
+            std::string name(m_snapshot->string(entry.name));
+            if (m_formulaTable.contains(name)) continue;
+
+            auto view = m_snapshot->formula(name).value();
+            std::vector<std::string> symbols(view.symbols.begin(), view.symbols.end());
+            inherited.emplace_back(std::vector<Instruction>(view.code.begin(), view.code.end()), std::move(symbols), view.stackSize);
+            formulas.emplace_back(std::move(name), &inherited.back());
+        }
+    }
+
+    Snapshot::write(path, std::move(variables), std::move(formulas));
+}
+
+void CAS::load(const std::string& path) {
+    auto snapshot = std::make_shared<const Snapshot>(path);
+
+    m_formulaTable.clear();
+    m_exactTable.clear();
+    m_preciseTable.clear();
+    m_vectorTable.clear();
+    m_variables.reset(snapshot);
+    m_snapshot = std::move(snapshot);
+}
+
+std::tuple<std::string, number_t> CAS::recalc(std::string name) {
+    number_t result;
+    if (auto it = m_formulaTable.find(name); it != m_formulaTable.end()) {
+        result = m_context.evaluate(*it->second);
+    }
+    else if (auto view = m_snapshot ? m_snapshot->formula(name) : std::nullopt) {
+        // Runs straight from the mapped file
+        result = CompiledExpr::execute(view->code, resolve(view->symbols), view->stackSize);
+    }
+    else throw std::runtime_error("No formula is stored for " + name);
+
+    setVariable(name, result);
+    return std::make_tuple(name, result);
 }
 
 std::optional<std::string> CAS::isVariable(NodeExpr* expr) {
@@ -52,4 +449,34 @@ std::optional<std::string> CAS::isVariable(NodeExpr* expr) {
         }
     }
     return std::nullopt;
-}
\ No newline at end of file
+}
+
+Value CAS::callFunction(const std::string& name, const std::vector<Value>& args) const {
+    auto compiled = CompiledExpr::compileCall(name, m_functions);
+    if (args.size() != m_functions.at(name).arity()) {
+        throw std::runtime_error(name + " takes " + std::to_string(m_functions.at(name).arity()) + " arguments but got " + std::to_string(args.size()));
+    }
+
+    // The arguments are the first symbols, the variables the body reads follow them
+    std::vector<number_t> slots;
+    slots.reserve(compiled.symbols().size());
+    for (const auto& arg : args) {
+        if (!arg.isScalar()) throw std::runtime_error(name + " takes numbers, not vectors");
+        slots.push_back(arg.scalar());
+    }
+    std::vector<std::string_view> symbols(compiled.symbols().begin() + args.size(), compiled.symbols().end());
+    std::ranges::copy(resolve(symbols), std::back_inserter(slots));
+
+    return compiled.evaluate(slots);
+}
+
+std::vector<number_t> CAS::resolve(const std::vector<std::string_view>& symbols) const {
+    std::vector<number_t> slots;
+    slots.reserve(symbols.size());
+    for (const auto& symbol : symbols) {
+        auto value = m_variables.get(symbol);
+        if (!value.has_value()) throw std::runtime_error("Variable " + std::string(symbol) + " does not exist");
+        slots.push_back(value.value());
+    }
+    return slots;
+}
@@ -3,11 +3,25 @@
 
 #include "types.h"
 #include "parser.h"
+#include "compiled.h"
+#include "context.h"
+#include "snapshot.h"
+#include "rational.h"
+#include "bigfloat.h"
+#include "value.h"
+#include "ode.h"
+#include "series.h"
+#include "profiler.h"
+#include "forkjoin.h"
 
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <optional>
 #include <tuple>
+#include <utility>
+#include <memory>
+#include <vector>
 
 class CAS {
 public:
@@ -17,10 +31,90 @@ public:
     number_t getVariable(std::string key);
 
     std::tuple<std::string, number_t> calc(std::string eq);
+
+    // In exact mode rational results are also kept as fractions, calc still returns their nearest number_t
+    void setExact(bool exact) { m_exact = exact; }
+    bool exact() const { return m_exact; }
+    std::optional<Rational> exactValue(const std::string& name) const;
+    // With a precision of n digits, results are also computed to n significant digits. 0 turns it off.
+    void setPrecision(size_t digits) { m_precision = digits; }
+    size_t precision() const { return m_precision; }
+    std::optional<BigFloat> preciseValue(const std::string& name) const;
+    // In parallel mode results with operator chains of thousands of nodes are evaluated from the tree
+    // on a pool of one thread per core, see calculateExpr::evalParallel. Their formulas are not
+    // compiled, so recalc cannot repeat them.
+    void setParallel(bool parallel);
+    bool parallel() const { return m_pool != nullptr; }
+    // Value of a variable that holds a vector or matrix
+    std::optional<Value> vectorValue(const std::string& name) const;
+    std::string expand(std::string expr);
+    // Taylor coefficients of expr in variable around center up to order, other variables are constants
+    Series series(std::string expr, const std::string& variable, number_t center, size_t order);
+    // Cheapest equivalent form of expr found by equality saturation, e.g. sin(x)^2 + cos(x)^2 gives 1
+    std::string simplify(std::string expr);
+    // With simplification on, formulas are evaluated and stored in their simplified form
+    void setSimplify(bool simplify) { m_simplify = simplify; }
+    bool simplifies() const { return m_simplify; }
+    // Partial derivatives of expr with respect to variables, or to every variable it reads if none are
+    // given, all from a single backward pass. Variables expr does not read have a derivative of 0.
+    std::vector<std::pair<std::string, number_t>> gradient(std::string expr, const std::vector<std::string>& variables = {});
+    // Solves simultaneous linear equations like "2x + y = 3" and assigns the unknowns, which are the
+    // variables of the equations that hold no value yet unless given. Other variables keep their
+    // values and are used as constants. Returns the solution.
+    std::vector<std::pair<std::string, number_t>> solve(const std::vector<std::string>& equations, const std::vector<std::string>& unknowns = {});
+    // System of differential equations from lines "x = expr" for dx/dt = expr, with t the time. Other
+    // variables are parameters and take their current values.
+    OdeSystem odeSystem(const std::vector<std::string>& derivatives) const;
+    // Integrates system from the current values of its states at t0 to t1 and assigns the values at t1
+    // to the states and to t
+    Trajectory odesolve(const OdeSystem& system, number_t t0, number_t t1, size_t samples, const OdeOptions& options = {});
+
+    // Profiler of expr with the current values of its variables, see Profiler
+    Profiler profile(std::string expr) const;
+
+    // Defines f(x, y) = body or the base case f(0, 1) = value if line has that form. Returns a
+    // description of what was defined, std::nullopt if line is not a definition.
+    std::optional<std::string> define(const std::string& line);
+    // Caches results of name by argument values, recursive functions are always memoized
+    void setMemoize(const std::string& name, bool memoize);
+
+    // Compiles the right hand side of an expression without evaluating it. The result can be
+    // evaluated concurrently, each thread through its own EvalContext on variables().
+    SharedExpr compile(std::string expr) const;
+    VariableStore& variables() { return m_variables; }
+
+    // Snapshots hold every variable and the compiled formula that last assigned it
+    void save(const std::string& path);
+    void load(const std::string& path);
+    std::tuple<std::string, number_t> recalc(std::string name);
 private:
     std::optional<std::string> isVariable(NodeExpr* expr);
+    std::vector<number_t> resolve(const std::vector<std::string_view>& symbols) const;
+    bool isFunction(const std::string& name) const { return m_functions.contains(name); }
+    // Call of a user function from evalValue, the arguments must be numbers
+    Value callFunction(const std::string& name, const std::vector<Value>& args) const;
 private:
-    std::unordered_map<std::string, number_t> m_varTable;
+    // Falls back to the loaded snapshot for names it does not define
+    VariableStore m_variables;
+    EvalContext m_context{ m_variables };
+
+    // Formulas of this session, they shadow those of the snapshot
+    std::unordered_map<std::string, SharedExpr> m_formulaTable;
+    std::shared_ptr<const Snapshot> m_snapshot;
+
+    // Variables whose value is known exactly, always in sync with m_variables
+    bool m_exact = false;
+    std::unordered_map<std::string, Rational> m_exactTable;
+    // Same for values computed in precision mode, to the precision that was set at the time
+    size_t m_precision = 0;
+    std::unordered_map<std::string, BigFloat> m_preciseTable;
+    bool m_simplify = false;
+    // Only exists in parallel mode
+    std::unique_ptr<ForkJoinPool> m_pool;
+    // Vectors and matrices, their entry in m_variables is nan
+    std::unordered_map<std::string, Value> m_vectorTable;
+    // User-defined functions, calls are compiled against the definitions at the time
+    FunctionTable m_functions;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,278 @@
+#include "commands.h"
+
+#include "functions.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+// Rows odesolve prints unless told otherwise
+constexpr size_t defaultSamples = 10;
+// Evaluations profile times unless told otherwise, enough to smooth out the timer
+constexpr size_t defaultRepeats = 100000;
+
+void requireFiles(const CommandLimits& limits, const std::string& command) {
+    if (!limits.files) throw std::runtime_error(command + " cannot access files here");
+}
+}
+
+CommandLimits CommandLimits::shared() {
+    return CommandLimits{ .files = false, .parallel = false, .precision = 1000, .seriesOrder = 1000, .samples = 1000, .odeSteps = 100000, .profiledNodes = 10000000 };
+}
+
+std::optional<std::string> commandArg(const std::string& line, std::string_view name) {
+    auto start = line.find_first_not_of(' ');
+    if (start == std::string::npos || line.compare(start, name.size(), name) != 0) return std::nullopt;
+
+    std::string rest = line.substr(start + name.size());
+    auto first = rest.find_first_not_of(' ');
+    if (first == std::string::npos) return std::string();
+    if (first == 0 && rest.front() != '(') return std::nullopt;
+
+    rest = rest.substr(first);
+    auto last = rest.find_last_not_of(' ');
+    rest = rest.substr(0, last + 1);
+    if (rest.front() != '(' || rest.back() != ')') return rest;
+
+    // Only strip the parentheses if the first one closes at the end, "(x+1)*(x-1)" keeps them
+    int depth = 0;
+    for (size_t i = 0; i < rest.size(); ++i) {
+        if (rest[i] == '(') ++depth;
+        else if (rest[i] == ')' && --depth == 0 && i + 1 < rest.size()) return rest;
+    }
+    return rest.substr(1, rest.size() - 2);
+}
+
+std::string runCommand(CAS& cas, const std::string& line, const CommandLimits& limits) {
+    if (auto arg = commandArg(line, "expand")) {
+        return cas.expand(arg.value());
+    }
+    if (auto arg = commandArg(line, "series")) {
+        // series(expr, x, x0, n), expr may have commas of its own inside parentheses or brackets
+        std::vector<std::string> parts;
+        int depth = 0;
+        size_t start = 0;
+        for (size_t i = 0; i <= arg->size(); ++i) {
+            if (i == arg->size() || (arg->at(i) == ',' && depth == 0)) {
+                auto first = arg->find_first_not_of(' ', start), last = arg->find_last_not_of(' ', i - 1);
+                parts.push_back(first < i && last >= first ? arg->substr(first, last - first + 1) : std::string());
+                start = i + 1;
+            }
+            else if (arg->at(i) == '(' || arg->at(i) == '[') ++depth;
+            else if (arg->at(i) == ')' || arg->at(i) == ']') --depth;
+        }
+        if (parts.size() != 4 || std::ranges::any_of(parts, [](const std::string& part) { return part.empty(); })) {
+            throw std::runtime_error("Expected series(expr, x, x0, n)");
+        }
+
+        size_t order = 0;
+        auto [end, error] = std::from_chars(parts[3].data(), parts[3].data() + parts[3].size(), order);
+        if (error != std::errc() || end != parts[3].data() + parts[3].size() || order > limits.seriesOrder) {
+            throw std::runtime_error("Expected an order up to " + std::to_string(limits.seriesOrder) + " but got " + parts[3]);
+        }
+        EvalContext context(cas.variables());
+        number_t center = context.evaluate(*cas.compile(parts[2]));
+        return series::toString(cas.series(parts[0], parts[1], center, order), parts[1], center);
+    }
+    if (auto arg = commandArg(line, "simplify")) {
+        if (arg.value() == "on") cas.setSimplify(true);
+        else if (arg.value() == "off") cas.setSimplify(false);
+        else if (!arg->empty()) return cas.simplify(arg.value());
+        return std::string("Simplification is ") + (cas.simplifies() ? "on" : "off");
+    }
+    if (auto arg = commandArg(line, "grad")) {
+        // grad expr for x, y differentiates by the listed variables only, the same keyword as solve
+        auto forPos = arg->find(" for ");
+        std::vector<std::string> variables;
+        for (size_t pos = forPos == std::string::npos ? arg->size() : forPos + 5; pos < arg->size(); ) {
+            size_t comma = std::min(arg->find(',', pos), arg->size());
+            auto first = arg->find_first_not_of(' ', pos), last = arg->find_last_not_of(' ', comma - 1);
+            if (first >= comma || last < first) throw std::runtime_error("Expected variables separated by commas after for");
+            variables.push_back(arg->substr(first, last - first + 1));
+            pos = comma + 1;
+        }
+
+        std::string result;
+        for (const auto& [name, partial] : cas.gradient(arg->substr(0, forPos), variables)) {
+            result += (result.empty() ? "" : ", ") + ("d/d" + name) + " = " + formatNumber(partial);
+        }
+        return result.empty() ? "Expression has no variables" : result;
+    }
+    if (auto arg = commandArg(line, "solve")) {
+        // solve eq; eq; ... for x, y solves for the listed variables only
+        auto split = [](const std::string& text, char separator) {
+            std::vector<std::string> parts;
+            for (size_t pos = 0; pos <= text.size(); ) {
+                size_t end = std::min(text.find(separator, pos), text.size());
+                auto first = text.find_first_not_of(' ', pos), last = text.find_last_not_of(' ', end - 1);
+                if (first < end && last >= first) parts.push_back(text.substr(first, last - first + 1));
+                pos = end + 1;
+            }
+            return parts;
+        };
+        auto forPos = arg->find(" for ");
+        auto equations = split(arg->substr(0, forPos), ';');
+        auto unknowns = forPos == std::string::npos ? std::vector<std::string>() : split(arg->substr(forPos + 5), ',');
+        if (equations.empty()) throw std::runtime_error("Expected equations separated by ; after solve");
+
+        std::string result;
+        for (const auto& [name, value] : cas.solve(equations, unknowns)) result += (result.empty() ? "" : ", ") + name + " = " + formatNumber(value);
+        return result;
+    }
+    if (auto arg = commandArg(line, "odesolve")) {
+        // odesolve x = expr; y = expr from t0 to t1 [samples n] [stiff]
+        const std::string usage = "Expected odesolve x = expr; ... from t0 to t1, optionally followed by samples n up to "
+                                + std::to_string(limits.samples) + " and stiff";
+        auto from = arg->find(" from ");
+        if (from == std::string::npos) throw std::runtime_error(usage);
+
+        std::vector<std::string> derivatives, words;
+        for (size_t pos = 0; pos <= from; ) {
+            size_t end = std::min(arg->find(';', pos), from);
+            auto first = arg->find_first_not_of(' ', pos), last = arg->find_last_not_of(' ', end - 1);
+            if (first < end && last >= first) derivatives.push_back(arg->substr(first, last - first + 1));
+            pos = end + 1;
+        }
+        for (size_t pos = from + 6; pos < arg->size(); ) {
+            size_t end = std::min(arg->find(' ', pos), arg->size());
+            if (end > pos) words.push_back(arg->substr(pos, end - pos));
+            pos = end + 1;
+        }
+
+        auto number = [&](const std::string& word) {
+            number_t value = 0;
+            auto [end, error] = std::from_chars(word.data(), word.data() + word.size(), value);
+            if (error != std::errc() || end != word.data() + word.size()) throw std::runtime_error(usage);
+            return value;
+        };
+        if (derivatives.empty() || words.size() < 3 || words[1] != "to") throw std::runtime_error(usage);
+        number_t t0 = number(words[0]), t1 = number(words[2]);
+        size_t samples = defaultSamples;
+        OdeOptions options;
+        options.maxSteps = std::min(options.maxSteps, limits.odeSteps);
+        for (size_t i = 3; i < words.size(); ++i) {
+            if (words[i] == "stiff") options.stiff = true;
+            else if (words[i] == "samples" && i + 1 < words.size()) {
+                const std::string& count = words[++i];
+                auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), samples);
+                if (error != std::errc() || end != count.data() + count.size() || samples == 0 || samples > limits.samples) throw std::runtime_error(usage);
+            }
+            else throw std::runtime_error(usage);
+        }
+
+        auto system = cas.odeSystem(derivatives);
+        auto trajectory = cas.odesolve(system, t0, t1, samples, options);
+        const auto& states = system.states();
+        std::string result;
+        for (size_t row = 0; row < trajectory.times.size(); ++row) {
+            result += (row ? "; t = " : "t = ") + formatNumber(trajectory.times[row]) + ":";
+            for (size_t i = 0; i < states.size(); ++i) {
+                result += (i ? ", " : " ") + states[i] + " = " + formatNumber(trajectory.states[row * states.size() + i]);
+            }
+        }
+        return result;
+    }
+    if (auto arg = commandArg(line, "profile")) {
+        // profile expr [repeat n] [folded path]
+        const char* usage = "Expected profile expr, optionally followed by repeat n and folded path";
+        std::string expr = arg.value();
+        std::string foldedPath;
+        if (auto folded = expr.find(" folded "); folded != std::string::npos) {
+            auto first = expr.find_first_not_of(' ', folded + 8), last = expr.find_last_not_of(' ');
+            if (first == std::string::npos) throw std::runtime_error(usage);
+            requireFiles(limits, "profile ... folded");
+            foldedPath = expr.substr(first, last - first + 1);
+            expr.resize(folded);
+        }
+        std::optional<size_t> repeats;
+        if (auto repeat = expr.find(" repeat "); repeat != std::string::npos) {
+            std::string count = expr.substr(expr.find_first_not_of(' ', repeat + 8));
+            size_t value = 0;
+            auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), value);
+            if (error != std::errc() || end != count.data() + count.size() || value == 0) throw std::runtime_error(usage);
+            repeats = value;
+            expr.resize(repeat);
+        }
+        if (expr.find_first_not_of(' ') == std::string::npos) throw std::runtime_error(usage);
+
+        auto profiler = cas.profile(expr);
+        size_t maxRepeats = std::max<size_t>(limits.profiledNodes / profiler.size(), 1);
+        if (repeats > maxRepeats) {
+            throw std::runtime_error("Expected repeat n up to " + std::to_string(maxRepeats) + " for a tree of " + std::to_string(profiler.size()) + " nodes");
+        }
+        repeats = repeats.value_or(std::min(defaultRepeats, maxRepeats));
+        for (size_t i = 0; i < repeats.value(); ++i) profiler.evaluate();
+        std::string report = profiler.report();
+        report.pop_back();
+        if (!foldedPath.empty()) {
+            std::ofstream file(foldedPath, std::ios::trunc);
+            file << profiler.folded();
+            if (!file) throw std::runtime_error("Cannot write " + foldedPath);
+            report += "\nWrote folded stacks to " + foldedPath;
+        }
+        return report;
+    }
+    if (auto arg = commandArg(line, "save")) {
+        requireFiles(limits, "save");
+        cas.save(arg.value());
+        return "Saved session to " + arg.value();
+    }
+    if (auto arg = commandArg(line, "load")) {
+        requireFiles(limits, "load");
+        cas.load(arg.value());
+        return "Loaded session from " + arg.value();
+    }
+    if (auto arg = commandArg(line, "exact")) {
+        if (arg.value() == "on") cas.setExact(true);
+        else if (arg.value() == "off") cas.setExact(false);
+        else if (!arg->empty()) throw std::runtime_error("Expected exact on or exact off");
+        return std::string("Exact mode is ") + (cas.exact() ? "on" : "off");
+    }
+    if (auto arg = commandArg(line, "parallel")) {
+        if (arg.value() == "on") {
+            if (!limits.parallel) throw std::runtime_error("parallel on is not available here");
+            cas.setParallel(true);
+        }
+        else if (arg.value() == "off") cas.setParallel(false);
+        else if (!arg->empty()) throw std::runtime_error("Expected parallel on or parallel off");
+        return std::string("Parallel mode is ") + (cas.parallel() ? "on" : "off");
+    }
+    if (auto arg = commandArg(line, "precision")) {
+        if (arg.value() == "off") cas.setPrecision(0);
+        else if (!arg->empty()) {
+            size_t digits = 0;
+            auto [end, error] = std::from_chars(arg->data(), arg->data() + arg->size(), digits);
+            if (error != std::errc() || end != arg->data() + arg->size() || digits == 0 || digits > limits.precision) {
+                throw std::runtime_error("Expected precision off or a number of digits up to " + std::to_string(limits.precision));
+            }
+            cas.setPrecision(digits);
+        }
+        return cas.precision() ? "Precision is " + std::to_string(cas.precision()) + " digits" : std::string("Precision is off");
+    }
+    if (auto arg = commandArg(line, "memo")) {
+        auto space = arg->find(' ');
+        std::string name = arg->substr(0, space);
+        std::string mode = space == std::string::npos ? "on" : arg->substr(arg->find_first_not_of(' ', space));
+        if (name.empty() || (mode != "on" && mode != "off")) throw std::runtime_error("Expected memo followed by a function and optionally off");
+
+        cas.setMemoize(name, mode == "on");
+        return "Memoization of " + name + " is " + mode;
+    }
+    if (auto arg = commandArg(line, "recalc")) {
+        if (arg->empty()) throw std::runtime_error("Expected a variable name after recalc");
+        auto [var, res] = cas.recalc(arg.value());
+        return var + " = " + formatNumber(res);
+    }
+
+    if (auto defined = cas.define(line)) return defined.value();
+
+    auto [var, res] = cas.calc(line);
+    if (auto vector = cas.vectorValue(var)) return var + " = " + vector->toString();
+    if (auto exact = cas.exact() ? cas.exactValue(var) : std::nullopt) return var + " = " + exact->toString();
+    if (cas.precision()) {
+        if (auto precise = cas.preciseValue(var)) return var + " = " + precise->toString(cas.precision());
+    }
+    return var + " = " + formatNumber(res);
+}
@@ -0,0 +1,38 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include "cas.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Returns the argument of "name(arg)" or "name arg" if the line is that command
+std::optional<std::string> commandArg(const std::string& line, std::string_view name);
+
+// What one command may ask for. The defaults are for the prompt, where nobody but its user waits.
+struct CommandLimits {
+    // save, load and profile ... folded path
+    bool files = true;
+    // parallel on, which starts a thread per core for the session
+    bool parallel = true;
+    // A million digits take seconds for pi and minutes for the slower functions
+    size_t precision = 1000000;
+    // Far beyond what anyone reads, series are computed in near-linear time but printed in full
+    size_t seriesOrder = 100000;
+    // Rows of odesolve and steps it may take to get there
+    size_t samples = 100000;
+    size_t odeSteps = 1000000;
+    // Nodes profile evaluates, the repeats times the size of the tree
+    size_t profiledNodes = 10000000000;
+
+    // For a server, whose workers are shared by every client: no files, and no command that takes
+    // more than a fraction of a second or more than a few megabytes
+    static CommandLimits shared();
+};
+
+// Runs one line of input, a command or an equation, and returns the text to print. Errors are thrown.
+std::string runCommand(CAS& cas, const std::string& line, const CommandLimits& limits = {});
+
+#endif
@@ -0,0 +1,1135 @@
+#include "compiled.h"
+
+#include "calculate.h"
+#include "bigfloat.h"
+#include "polynomial.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <numbers>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+// Expressions whose stack fits here run without a heap allocation
+constexpr uint32_t inlineStackSize = 64;
+// Deeper recursion is reported instead of exhausting memory
+constexpr size_t maxCallDepth = 100000;
+// The reverse sweep differentiates calls by native recursion, whose stack is much smaller than the heap
+constexpr size_t maxSweepDepth = 2000;
+// Memo entries kept before the cache starts over
+constexpr size_t maxMemoEntries = 1 << 16;
+// Rows per block of evaluateBatch, small enough for the stack of a typical formula to stay in L1
+constexpr size_t batchRows = 256;
+// libm promises about one ulp for the elementary functions, bounds allow two, four unit roundoffs
+constexpr int functionRoundoffs = 4;
+// Integer exponents up to this are multiplied out in bounded evaluation, which is faster than std::pow
+constexpr uint32_t maxMultipliedExponent = 64;
+// Working precision of the first multiprecision evaluation of a row, doubled until two agree
+constexpr size_t firstPreciseBits = 128;
+constexpr size_t maxPreciseBits = 1024;
+
+std::atomic<uint64_t> nextExprId = 1;
+
+bool isBinary(OpCode op) {
+    return op >= OpCode::add && op <= OpCode::powNegLiteral;
+}
+
+bool isFunctionHeader(OpCode op) {
+    return op == OpCode::function || op == OpCode::memoFunction;
+}
+
+// First instruction of the body of the function whose header is at index header
+size_t bodyStart(std::span<const Instruction> code, size_t header) {
+    return header + 1 + static_cast<size_t>(code[header].value) * (code[header].arg + 1);
+}
+
+std::optional<number_t> matchCase(std::span<const Instruction> code, size_t header, std::span<const number_t> args) {
+    size_t pc = header + 1;
+    for (size_t c = 0; c < static_cast<size_t>(code[header].value); ++c, pc += args.size() + 1) {
+        bool match = true;
+        for (size_t i = 0; i < args.size() && match; ++i) match = code[pc + i].value == args[i];
+        if (match) return code[pc + args.size()].value;
+    }
+    return std::nullopt;
+}
+
+// Stack depth of a function body or the main code, std::nullopt if it is not well formed
+std::optional<int64_t> validateBody(std::span<const Instruction> code, size_t begin, size_t end, size_t symbolCount, uint32_t stackSize, int64_t params) {
+    int64_t depth = params;
+    for (size_t pc = begin; pc < end; ++pc) {
+        const Instruction& ins = code[pc];
+        if (ins.op >= OpCode::count) return std::nullopt;
+
+        if (ins.op == OpCode::constant) ++depth;
+        else if (ins.op == OpCode::variable) {
+            if (ins.arg >= symbolCount) return std::nullopt;
+            ++depth;
+        }
+        else if (ins.op == OpCode::local) {
+            if (ins.arg >= depth) return std::nullopt;
+            ++depth;
+        }
+        else if (ins.op == OpCode::drop) {
+            if (depth <= ins.arg) return std::nullopt;
+            depth -= ins.arg;
+        }
+        else if (ins.op == OpCode::call) {
+            if (ins.arg >= code.size() || !isFunctionHeader(code[ins.arg].op) || depth < code[ins.arg].arg) return std::nullopt;
+            depth -= code[ins.arg].arg - 1;
+        }
+        else if (ins.op == OpCode::ret || isFunctionHeader(ins.op) || ins.op == OpCode::caseArg || ins.op == OpCode::caseValue) return std::nullopt;
+        else if (isBinary(ins.op)) {
+            if (depth < 2) return std::nullopt;
+            --depth;
+        }
+        else if (depth < 1) return std::nullopt;
+
+        if (depth > stackSize) return std::nullopt;
+    }
+    return depth;
+}
+
+// Value of a function body or the main code with its partial derivatives by argument and by symbol slot
+struct Jacobian {
+    number_t value = 0;
+    std::vector<number_t> args;
+    std::vector<std::pair<uint32_t, number_t>> slots;
+};
+
+// Every value of the forward pass is a node, with edges to the nodes it was computed from weighted by
+// the local partial derivative. Edges are added first and then closed by the node they lead to.
+struct Tape {
+    std::vector<number_t> values;
+    std::vector<uint32_t> edgeEnds;
+    std::vector<uint32_t> inputs;
+    std::vector<number_t> partials;
+
+    void edge(uint32_t input, number_t partial) {
+        inputs.push_back(input);
+        partials.push_back(partial);
+    }
+    uint32_t node(number_t value) {
+        values.push_back(value);
+        edgeEnds.push_back(static_cast<uint32_t>(inputs.size()));
+        return static_cast<uint32_t>(values.size() - 1);
+    }
+
+    // Adjoint of every node, the derivative of node result with respect to it
+    std::vector<number_t> backward(uint32_t result) const {
+        std::vector<number_t> adjoints(values.size());
+        adjoints[result] = 1;
+        for (size_t n = result + 1; n-- > 0; ) {
+            for (uint32_t e = n ? edgeEnds[n - 1] : 0; e < edgeEnds[n]; ++e) adjoints[inputs[e]] += adjoints[n] * partials[e];
+        }
+        return adjoints;
+    }
+};
+
+// Reverse-mode differentiation of compiled code. A call is a single node whose edges come from the
+// Jacobian of the function at its arguments, computed by a sweep over the body once per distinct
+// arguments, so recursion costs what memoized evaluation does.
+class ReverseSweep {
+public:
+    ReverseSweep(std::span<const Instruction> code, std::span<const number_t> slots) : m_code(code), m_slots(slots) {}
+
+    Jacobian run(size_t begin, std::span<const number_t> args, size_t depth);
+private:
+    const Jacobian& call(uint32_t header, std::span<const number_t> args, size_t depth);
+private:
+    std::span<const Instruction> m_code;
+    std::span<const number_t> m_slots;
+    std::map<std::pair<uint32_t, std::vector<number_t>>, Jacobian> m_calls;
+};
+
+Jacobian ReverseSweep::run(size_t begin, std::span<const number_t> args, size_t depth) {
+    constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+    Tape tape;
+    tape.values.reserve(m_code.size());
+    tape.edgeEnds.reserve(m_code.size());
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> slotNodes(m_slots.size(), none);
+    auto slotNode = [&](uint32_t slot) {
+        if (slotNodes[slot] == none) slotNodes[slot] = tape.node(m_slots[slot]);
+        return slotNodes[slot];
+    };
+
+    // Arguments are the first nodes, at the bottom of the stack where OpCode::local finds them
+    for (number_t arg : args) stack.push_back(tape.node(arg));
+
+    for (size_t pc = begin; pc < m_code.size(); ++pc) {
+        const Instruction& ins = m_code[pc];
+        if (ins.op == OpCode::ret || isFunctionHeader(ins.op)) break;
+
+        if (isBinary(ins.op)) {
+            uint32_t rhs = stack.back();
+            stack.pop_back();
+            uint32_t lhs = stack.back();
+            number_t a = tape.values[lhs], b = tape.values[rhs], result;
+            switch (ins.op) {
+                case OpCode::add: result = a + b; tape.edge(lhs, 1); tape.edge(rhs, 1); break;
+                case OpCode::sub: result = a - b; tape.edge(lhs, 1); tape.edge(rhs, -1); break;
+                case OpCode::mul: result = a * b; tape.edge(lhs, b); tape.edge(rhs, a); break;
+                case OpCode::div: result = a / b; tape.edge(lhs, 1 / b); tape.edge(rhs, -result / b); break;
+                default: {
+                    // Under the odd-root convention of power() the result is -(|a|^b), whose slope in a is b|a|^(b-1)
+                    result = calculateExpr::power(a, b, ins.op == OpCode::powNegLiteral);
+                    bool oddRoot = a < 0 && (ins.op == OpCode::powNegLiteral || b != std::trunc(b));
+                    tape.edge(lhs, b == 0 ? 0 : b * calculateExpr::power(oddRoot ? -a : a, b - 1, false));
+                    tape.edge(rhs, a == 0 ? 0 : result * std::log(std::abs(a)));
+                }
+            }
+            stack.back() = tape.node(result);
+            continue;
+        }
+
+        switch (ins.op) {
+            case OpCode::constant:  stack.push_back(tape.node(ins.value)); continue;
+            case OpCode::variable:  stack.push_back(slotNode(ins.arg)); continue;
+            case OpCode::local:     stack.push_back(stack[ins.arg]); continue;
+            case OpCode::drop: {
+                uint32_t result = stack.back();
+                stack.resize(stack.size() - ins.arg);
+                stack.back() = result;
+                continue;
+            }
+            case OpCode::call: {
+                uint32_t arity = m_code[ins.arg].arg;
+                std::vector<number_t> values(arity);
+                for (uint32_t i = 0; i < arity; ++i) values[i] = tape.values[stack[stack.size() - arity + i]];
+
+                // Base cases are constants, everything else goes through the Jacobian of the function
+                number_t result;
+                if (auto value = matchCase(m_code, ins.arg, values)) result = value.value();
+                else {
+                    const Jacobian& jacobian = call(ins.arg, values, depth + 1);
+                    for (uint32_t i = 0; i < arity; ++i) tape.edge(stack[stack.size() - arity + i], jacobian.args[i]);
+                    for (auto [slot, partial] : jacobian.slots) tape.edge(slotNode(slot), partial);
+                    result = jacobian.value;
+                }
+                stack.resize(stack.size() - arity);
+                stack.push_back(tape.node(result));
+                continue;
+            }
+            case OpCode::caseArg:
+            case OpCode::caseValue:
+            case OpCode::count:     continue;
+            default:                break;
+        }
+
+        uint32_t operand = stack.back();
+        number_t a = tape.values[operand], result;
+        switch (ins.op) {
+            case OpCode::sqrt:  result = std::sqrt(a); tape.edge(operand, 1 / (2 * result)); break;
+            case OpCode::sin:   result = std::sin(a); tape.edge(operand, std::cos(a)); break;
+            case OpCode::cos:   result = std::cos(a); tape.edge(operand, -std::sin(a)); break;
+            case OpCode::tan:   result = std::tan(a); tape.edge(operand, 1 + result * result); break;
+            case OpCode::asin:  result = std::asin(a); tape.edge(operand, 1 / std::sqrt(1 - a * a)); break;
+            case OpCode::acos:  result = std::acos(a); tape.edge(operand, -1 / std::sqrt(1 - a * a)); break;
+            case OpCode::atan:  result = std::atan(a); tape.edge(operand, 1 / (1 + a * a)); break;
+            case OpCode::log:   result = std::log10(a); tape.edge(operand, 1 / (a * std::numbers::ln10_v<number_t>)); break;
+            default:            result = std::log(a); tape.edge(operand, 1 / a); break;
+        }
+        stack.back() = tape.node(result);
+    }
+
+    Jacobian jacobian;
+    jacobian.args.resize(args.size());
+    if (stack.size() <= args.size()) return jacobian;
+
+    auto adjoints = tape.backward(stack.back());
+    jacobian.value = tape.values[stack.back()];
+    std::copy_n(adjoints.begin(), args.size(), jacobian.args.begin());
+    for (uint32_t slot = 0; slot < slotNodes.size(); ++slot) {
+        if (slotNodes[slot] != none) jacobian.slots.emplace_back(slot, adjoints[slotNodes[slot]]);
+    }
+    return jacobian;
+}
+
+const Jacobian& ReverseSweep::call(uint32_t header, std::span<const number_t> args, size_t depth) {
+    std::pair key{ header, std::vector<number_t>(args.begin(), args.end()) };
+    if (auto it = m_calls.find(key); it != m_calls.end()) return it->second;
+
+    if (depth >= maxSweepDepth) throw std::runtime_error("Recursion is too deep");
+    Jacobian jacobian = run(bodyStart(m_code, header), args, depth);
+    return m_calls.emplace(std::move(key), std::move(jacobian)).first->second;
+}
+
+// Power with the sign rule of calculateExpr::power for both precisions of the bounded evaluation.
+// Sets roundoffs to the bound of its rounding error in unit roundoffs: x^n by repeated squaring is
+// within n - 1 of them, its reciprocal one more.
+template<typename T>
+T boundedPower(T base, T exp, bool negativeLiteralBase, int& roundoffs) {
+    bool isInteger = exp == std::trunc(exp);
+    bool negate = base < 0 && (negativeLiteralBase || !isInteger);
+    if (negate) base = -base;
+
+    T result = 1;
+    if (isInteger && std::abs(exp) <= maxMultipliedExponent) {
+        auto n = static_cast<uint32_t>(std::abs(exp));
+        roundoffs = static_cast<int>(n);
+        for (T square = base; n; n >>= 1) {
+            if (n & 1) result *= square;
+            if (n > 1) square *= square;
+        }
+        if (exp < 0) result = 1 / result;
+    }
+    else {
+        result = std::pow(base, exp);
+        roundoffs = functionRoundoffs;
+    }
+    return negate ? -result : result;
+}
+
+// Whether x converts to double without rounding. The round trip goes through memory, otherwise -Ofast
+// assumes it is exact.
+bool fitsDouble(number_t x) {
+    volatile double narrowed = static_cast<double>(x);
+    return static_cast<number_t>(narrowed) == x;
+}
+
+// False for infinities and nan, which std::isfinite assumes away under -Ofast, by the exponent bits
+bool isFinite(number_t x) {
+    if constexpr (std::numeric_limits<number_t>::digits == std::numeric_limits<double>::digits) {
+        constexpr uint64_t exponent = 0x7ff0000000000000;
+        return (std::bit_cast<uint64_t>(static_cast<double>(x)) & exponent) != exponent;
+    }
+    else {
+        // x87 extended precision has its 15 exponent bits in the word after the 64 bit mantissa,
+        // quadruple precision in the last word
+        std::array<uint16_t, sizeof(number_t) / 2> words;
+        std::memcpy(words.data(), &x, sizeof(number_t));
+        size_t top = std::numeric_limits<number_t>::digits == 64 ? 4 : words.size() - 1;
+        return (words[top] & 0x7fff) != 0x7fff;
+    }
+}
+
+// Runs code without calls over rows rows from first on like evaluateBatch, in T, and bounds the
+// distance of every result from the exact value of the formula for the inputs as given. Leaves the
+// results in entry 0 of values and their bounds in entry 0 of errors, both batchRows per entry.
+// Sums, products and quotients are bounded rigorously. Powers and tan are bounded to first order,
+// whose neglected terms are far below the tolerance of any bound that passes.
+template<typename T>
+void evaluateBounded(std::span<const Instruction> code, std::span<const std::span<const number_t>> columns,
+                     size_t first, size_t rows, std::vector<T>& values, std::vector<T>& errors) {
+    constexpr T roundoff = std::numeric_limits<T>::epsilon() / 2;
+    // Denormals are flushed to zero, which loses up to the smallest normal number
+    constexpr T flushed = std::numeric_limits<T>::min();
+    // Bound of a result whose inputs may lie on both sides of a singularity
+    constexpr T unbounded = std::numeric_limits<T>::max();
+    // Columns and constants are long double, so only the double pass may round them
+    constexpr bool exactInputs = std::is_same_v<T, number_t>;
+    // The x87 sin, cos and tan reduce their argument by a 66 bit pi, which loses up to about |x| 2^-64.
+    // glibc reduces double arguments exactly.
+    constexpr T reduction = std::is_same_v<T, double> ? 0 : roundoff;
+    // Zero is exact where the operands say so, otherwise it may be a flushed denormal
+    auto rounding = [](T value, int roundoffs, bool exactZero) {
+        T magnitude = std::abs(value);
+        if (magnitude < flushed) return exactZero && value == 0 ? T(0) : flushed;
+        return roundoffs * roundoff * magnitude;
+    };
+
+    size_t top = 0;
+    auto value = [&](size_t index) { return values.data() + index * batchRows; };
+    auto error = [&](size_t index) { return errors.data() + index * batchRows; };
+    auto load = [&](auto get) {
+        T* v = value(top);
+        T* e = error(top);
+        for (size_t i = 0; i < rows; ++i) {
+            number_t x = get(i);
+            v[i] = static_cast<T>(x);
+            e[i] = exactInputs || fitsDouble(x) ? 0 : rounding(v[i], 1, false);
+        }
+        ++top;
+    };
+    // Applies f to the top, bound(x, error of x, f(x)) gives the new bound before rounding. None of the
+    // functions underflows, they only return zero where that is exact.
+    auto mapTop = [&](auto f, auto bound) {
+        T* v = value(top - 1);
+        T* e = error(top - 1);
+        for (size_t i = 0; i < rows; ++i) {
+            T x = v[i];
+            v[i] = f(x);
+            e[i] = bound(x, e[i], v[i]) + rounding(v[i], functionRoundoffs, true);
+        }
+    };
+
+    for (const auto& ins : code) {
+        if (isBinary(ins.op)) {
+            --top;
+            T* a = value(top - 1);
+            T* ea = error(top - 1);
+            const T* b = value(top);
+            const T* eb = error(top);
+            switch (ins.op) {
+                case OpCode::add:
+                    for (size_t i = 0; i < rows; ++i) {
+                        bool exactZero = a[i] == -b[i];
+                        a[i] += b[i];
+                        ea[i] += eb[i] + rounding(a[i], 1, exactZero);
+                    }
+                    break;
+                case OpCode::sub:
+                    for (size_t i = 0; i < rows; ++i) {
+                        bool exactZero = a[i] == b[i];
+                        a[i] -= b[i];
+                        ea[i] += eb[i] + rounding(a[i], 1, exactZero);
+                    }
+                    break;
+                case OpCode::mul:
+                    for (size_t i = 0; i < rows; ++i) {
+                        bool exactZero = a[i] == 0 || b[i] == 0;
+                        ea[i] = std::abs(a[i]) * eb[i] + std::abs(b[i]) * ea[i] + ea[i] * eb[i];
+                        a[i] *= b[i];
+                        ea[i] += rounding(a[i], 1, exactZero);
+                    }
+                    break;
+                case OpCode::div:
+                    for (size_t i = 0; i < rows; ++i) {
+                        bool exactZero = a[i] == 0;
+                        T margin = std::abs(b[i]) - eb[i];
+                        a[i] /= b[i];
+                        ea[i] = margin > 0 ? (ea[i] + std::abs(a[i]) * eb[i]) / margin + rounding(a[i], 1, exactZero) : unbounded;
+                    }
+                    break;
+                default: {
+                    bool negativeLiteral = ins.op == OpCode::powNegLiteral;
+                    for (size_t i = 0; i < rows; ++i) {
+                        T base = a[i];
+                        T margin = std::abs(base) - ea[i];
+                        // Away from integer exponents a negative base flips the sign of the result
+                        bool signInDoubt = base < 0 && eb[i] > 0 && !negativeLiteral;
+                        int roundoffs;
+                        a[i] = boundedPower(base, b[i], negativeLiteral, roundoffs);
+
+                        T propagated = 0;
+                        if (margin <= 0 || signInDoubt) propagated = ea[i] == 0 && eb[i] == 0 ? 0 : unbounded;
+                        else {
+                            if (ea[i] != 0) propagated += ea[i] * std::abs(b[i]) / margin;
+                            if (eb[i] != 0) propagated += eb[i] * std::abs(std::log(std::abs(base)));
+                            propagated *= std::abs(a[i]);
+                        }
+                        ea[i] = propagated + rounding(a[i], roundoffs, base == 0);
+                    }
+                }
+            }
+            continue;
+        }
+
+        switch (ins.op) {
+            case OpCode::constant:
+                load([&](size_t) { return ins.value; });
+                break;
+            case OpCode::variable: {
+                auto column = columns[ins.arg];
+                if (column.size() == 1) load([&](size_t) { return column[0]; });
+                else load([&](size_t i) { return column[first + i]; });
+                break;
+            }
+            case OpCode::local:
+                std::copy_n(value(ins.arg), rows, value(top));
+                std::copy_n(error(ins.arg), rows, error(top));
+                ++top;
+                break;
+            case OpCode::drop:
+                std::copy_n(value(top - 1), rows, value(top - 1 - ins.arg));
+                std::copy_n(error(top - 1), rows, error(top - 1 - ins.arg));
+                top -= ins.arg;
+                break;
+            case OpCode::sqrt:
+                // sqrt(x) - sqrt(x - e) is at most sqrt(e), and e / (sqrt(x) + sqrt(x - e)) away from zero
+                mapTop([](T x) { return std::sqrt(x); }, [](T x, T e, T y) {
+                    T low = std::sqrt(std::max<T>(x - e, 0));
+                    return y + low > 0 ? std::min(std::sqrt(e), e / (y + low)) : std::sqrt(e);
+                });
+                break;
+            case OpCode::sin:
+                mapTop([](T x) { return std::sin(x); }, [](T x, T e, T) { return std::min<T>(e + reduction * std::abs(x), 2); });
+                break;
+            case OpCode::cos:
+                mapTop([](T x) { return std::cos(x); }, [](T x, T e, T) { return std::min<T>(e + reduction * std::abs(x), 2); });
+                break;
+            case OpCode::tan:
+                mapTop([](T x) { return std::tan(x); }, [](T x, T e, T y) { return (e + reduction * std::abs(x)) * (1 + y * y); });
+                break;
+            case OpCode::asin:
+            case OpCode::acos: {
+                // The derivative 1 / sqrt(1 - x^2) is largest at the end of the interval furthest from zero
+                auto bound = [](T x, T e, T) {
+                    T far = std::abs(x) + e;
+                    return e == 0 ? 0 : far < 1 ? e / std::sqrt(1 - far * far) : unbounded;
+                };
+                if (ins.op == OpCode::asin) mapTop([](T x) { return std::asin(x); }, bound);
+                else mapTop([](T x) { return std::acos(x); }, bound);
+                break;
+            }
+            case OpCode::atan:
+                mapTop([](T x) { return std::atan(x); }, [](T x, T e, T) {
+                    T near = std::max<T>(std::abs(x) - e, 0);
+                    return e / (1 + near * near);
+                });
+                break;
+            case OpCode::log:
+            case OpCode::ln: {
+                T scale = ins.op == OpCode::log ? 1 / std::numbers::ln10_v<T> : 1;
+                auto bound = [scale](T x, T e, T) { return e == 0 ? 0 : x - e > 0 ? scale * e / (x - e) : unbounded; };
+                if (ins.op == OpCode::log) mapTop([](T x) { return std::log10(x); }, bound);
+                else mapTop([](T x) { return std::log(x); }, bound);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    if (top == 0) {
+        std::fill_n(value(0), rows, 0);
+        std::fill_n(error(0), rows, 0);
+    }
+    else if (top > 1) {
+        std::copy_n(value(top - 1), rows, value(0));
+        std::copy_n(error(top - 1), rows, error(0));
+    }
+}
+
+// Code without calls in multiprecision, every operation rounded to bits. Throws where the result is
+// not a finite number.
+BigFloat evaluatePrecise(std::span<const Instruction> code, std::span<const number_t> slots, size_t bits) {
+    std::vector<BigFloat> stack;
+    for (const auto& ins : code) {
+        if (isBinary(ins.op)) {
+            BigFloat b = std::move(stack.back());
+            stack.pop_back();
+            BigFloat& a = stack.back();
+            switch (ins.op) {
+                case OpCode::add:   a = bigfloat::add(a, b, bits); break;
+                case OpCode::sub:   a = bigfloat::sub(a, b, bits); break;
+                case OpCode::mul:   a = bigfloat::mul(a, b, bits); break;
+                case OpCode::div:   a = bigfloat::div(a, b, bits); break;
+                default:            a = bigfloat::pow(a, b, bits, ins.op == OpCode::powNegLiteral); break;
+            }
+            continue;
+        }
+
+        switch (ins.op) {
+            case OpCode::constant:  stack.push_back(BigFloat::fromNumber(ins.value)); break;
+            case OpCode::variable:  stack.push_back(BigFloat::fromNumber(slots[ins.arg])); break;
+            case OpCode::local:     stack.push_back(stack[ins.arg]); break;
+            case OpCode::drop:
+                stack[stack.size() - 1 - ins.arg] = std::move(stack.back());
+                stack.resize(stack.size() - ins.arg);
+                break;
+            case OpCode::sqrt:      stack.back() = bigfloat::sqrt(stack.back(), bits); break;
+            case OpCode::sin:       stack.back() = bigfloat::sin(stack.back(), bits); break;
+            case OpCode::cos:       stack.back() = bigfloat::cos(stack.back(), bits); break;
+            case OpCode::tan:       stack.back() = bigfloat::tan(stack.back(), bits); break;
+            case OpCode::asin:      stack.back() = bigfloat::asin(stack.back(), bits); break;
+            case OpCode::acos:      stack.back() = bigfloat::acos(stack.back(), bits); break;
+            case OpCode::atan:      stack.back() = bigfloat::atan(stack.back(), bits); break;
+            case OpCode::log:       stack.back() = bigfloat::log10(stack.back(), bits); break;
+            case OpCode::ln:        stack.back() = bigfloat::ln(stack.back(), bits); break;
+            default:                break;
+        }
+    }
+    return stack.empty() ? BigFloat() : stack.back();
+}
+}
+
+std::optional<number_t> MemoCache::find(uint32_t function, std::span<const number_t> args) const {
+    auto it = m_entries.find(Key{ function, args });
+    if (it == m_entries.end()) return std::nullopt;
+    return it->second;
+}
+
+void MemoCache::store(uint32_t function, std::span<const number_t> args, number_t value) {
+    if (m_entries.size() >= maxMemoEntries) m_entries.clear();
+    m_entries.emplace(StoredKey{ function, std::vector<number_t>(args.begin(), args.end()) }, value);
+}
+
+size_t MemoCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<uint32_t>()(key.function);
+    for (number_t arg : key.args) hash = hash * 0x9e3779b97f4a7c15ull + std::hash<number_t>()(arg);
+    return hash;
+}
+
+CompiledExpr::CompiledExpr() : m_id(nextExprId++) {}
+
+CompiledExpr::CompiledExpr(std::vector<Instruction> code, std::vector<std::string> symbols, uint32_t stackSize)
+    : m_code(std::move(code)), m_symbols(std::move(symbols)), m_stackSize(stackSize), m_id(nextExprId++) {
+    m_memoizes = std::ranges::any_of(m_code, [](const Instruction& ins) { return ins.op == OpCode::memoFunction; });
+    m_calls = std::ranges::any_of(m_code, [](const Instruction& ins) { return ins.op == OpCode::call; });
+}
+
+CompiledExpr CompiledExpr::compile(NodeExpr* expr, const FunctionTable* functions) {
+    CompiledExpr compiled;
+    compiled.m_functions = functions;
+    if (expr) compiled.emit(expr, 0);
+    compiled.emitFunctions();
+    compiled.m_slotIndex.clear();
+    compiled.m_functions = nullptr;
+
+    return compiled;
+}
+
+CompiledExpr CompiledExpr::compileCall(const std::string& name, const FunctionTable& functions) {
+    auto it = functions.find(name);
+    if (it == functions.end()) throw std::runtime_error("Unknown function " + name);
+
+    // Arguments are variables whose names no input can spell
+    std::vector<Token> names;
+    std::vector<NodeTermVariable> variables;
+    std::vector<NodeTerm> terms;
+    std::vector<NodeExpr> exprs;
+    names.reserve(it->second.arity());
+    variables.reserve(it->second.arity());
+    terms.reserve(it->second.arity());
+    exprs.reserve(it->second.arity());
+    std::vector<NodeExpr*> args;
+    for (size_t i = 0; i < it->second.arity(); ++i) {
+        names.push_back(Token{ .type = TokenType::variable, .value = "#" + std::to_string(i) });
+        variables.push_back(NodeTermVariable{ &names.back() });
+        terms.push_back(NodeTerm{ &variables.back() });
+        exprs.push_back(NodeExpr{ &terms.back() });
+        args.push_back(&exprs.back());
+    }
+
+    CompiledExpr compiled;
+    compiled.m_functions = &functions;
+    for (size_t i = 0; i < args.size(); ++i) compiled.symbolSlot(names[i].value.value());
+    compiled.emitCall(name, args, 0);
+    compiled.emitFunctions();
+    compiled.m_slotIndex.clear();
+    compiled.m_functions = nullptr;
+
+    return compiled;
+}
+
+number_t CompiledExpr::evaluate(std::span<const number_t> slots, MemoCache* memo) const {
+    if (slots.size() < m_symbols.size()) throw std::runtime_error("Missing values for compiled expression");
+    return execute(m_code, slots, m_stackSize, memo);
+}
+
+number_t CompiledExpr::execute(std::span<const Instruction> code, std::span<const number_t> slots, uint32_t stackSize, MemoCache* memo) {
+    std::array<number_t, inlineStackSize> inlineStack;
+    std::vector<number_t> heapStack;
+    number_t* stack = inlineStack.data();
+    size_t capacity = inlineStackSize;
+    if (stackSize > inlineStackSize) {
+        heapStack.resize(stackSize);
+        stack = heapStack.data();
+        capacity = stackSize;
+    }
+
+    // Every call gets a frame of stackSize above its arguments
+    struct Frame {
+        size_t returnPc;
+        size_t base;
+        uint32_t function;
+    };
+    std::vector<Frame> frames;
+    MemoCache localMemo;
+    if (!memo) memo = &localMemo;
+
+    size_t top = 0, base = 0;
+    for (size_t pc = 0; pc < code.size(); ++pc) {
+        const Instruction& ins = code[pc];
+        switch (ins.op) {
+            case OpCode::constant:      stack[top++] = ins.value; break;
+            case OpCode::variable:      stack[top++] = slots[ins.arg]; break;
+            case OpCode::add:           --top; stack[top - 1] = stack[top - 1] + stack[top]; break;
+            case OpCode::sub:           --top; stack[top - 1] = stack[top - 1] - stack[top]; break;
+            case OpCode::mul:           --top; stack[top - 1] = stack[top - 1] * stack[top]; break;
+            case OpCode::div:           --top; stack[top - 1] = stack[top - 1] / stack[top]; break;
+            case OpCode::pow:           --top; stack[top - 1] = calculateExpr::power(stack[top - 1], stack[top], false); break;
+            case OpCode::powNegLiteral: --top; stack[top - 1] = calculateExpr::power(stack[top - 1], stack[top], true); break;
+            case OpCode::sqrt:          stack[top - 1] = std::sqrt(stack[top - 1]); break;
+            case OpCode::sin:           stack[top - 1] = std::sin(stack[top - 1]); break;
+            case OpCode::cos:           stack[top - 1] = std::cos(stack[top - 1]); break;
+            case OpCode::tan:           stack[top - 1] = std::tan(stack[top - 1]); break;
+            case OpCode::asin:          stack[top - 1] = std::asin(stack[top - 1]); break;
+            case OpCode::acos:          stack[top - 1] = std::acos(stack[top - 1]); break;
+            case OpCode::atan:          stack[top - 1] = std::atan(stack[top - 1]); break;
+            case OpCode::log:           stack[top - 1] = std::log10(stack[top - 1]); break;
+            case OpCode::ln:            stack[top - 1] = std::log(stack[top - 1]); break;
+            case OpCode::local:         stack[top] = stack[base + ins.arg]; ++top; break;
+            case OpCode::drop:          stack[top - 1 - ins.arg] = stack[top - 1]; top -= ins.arg; break;
+            case OpCode::call: {
+                const Instruction& header = code[ins.arg];
+                std::span<const number_t> args(stack + top - header.arg, header.arg);
+
+                auto result = matchCase(code, ins.arg, args);
+                if (!result && header.op == OpCode::memoFunction) result = memo->find(ins.arg, args);
+                if (result) {
+                    top -= header.arg;
+                    stack[top++] = result.value();
+                    break;
+                }
+
+                if (frames.size() >= maxCallDepth) throw std::runtime_error("Recursion is too deep");
+                frames.push_back(Frame{ pc, top - header.arg, ins.arg });
+                base = top - header.arg;
+                if (base + stackSize > capacity) {
+                    capacity = std::max(capacity * 2, base + stackSize);
+                    if (heapStack.empty()) heapStack.assign(stack, stack + top);
+                    heapStack.resize(capacity);
+                    stack = heapStack.data();
+                }
+                pc = bodyStart(code, ins.arg) - 1;
+                break;
+            }
+            case OpCode::ret: {
+                Frame frame = frames.back();
+                frames.pop_back();
+
+                number_t result = stack[top - 1];
+                const Instruction& header = code[frame.function];
+                if (header.op == OpCode::memoFunction) memo->store(frame.function, std::span(stack + frame.base, header.arg), result);
+
+                top = frame.base;
+                stack[top++] = result;
+                base = frames.empty() ? 0 : frames.back().base;
+                pc = frame.returnPc;
+                break;
+            }
+            // The main code ends where the first function begins
+            case OpCode::function:
+            case OpCode::memoFunction:  return top ? stack[top - 1] : 0;
+            case OpCode::caseArg:
+            case OpCode::caseValue:
+            case OpCode::count:         break;
+        }
+    }
+
+    return top ? stack[top - 1] : 0;
+}
+
+void CompiledExpr::evaluateBatch(std::span<const std::span<const number_t>> columns, std::span<number_t> out) const {
+    if (columns.size() < m_symbols.size()) throw std::runtime_error("Missing values for compiled expression");
+    auto value = [&](size_t symbol, size_t row) { return columns[symbol].size() == 1 ? columns[symbol][0] : columns[symbol][row]; };
+
+    if (m_calls) {
+        std::vector<number_t> slots(m_symbols.size());
+        MemoCache memo;
+        for (size_t row = 0; row < out.size(); ++row) {
+            for (size_t i = 0; i < slots.size(); ++i) slots[i] = value(i, row);
+            out[row] = execute(m_code, slots, m_stackSize, &memo);
+            memo.clear();
+        }
+        return;
+    }
+
+    // Every stack entry is a row of batchRows values, so each loop below is a plain loop the compiler vectorizes
+    std::vector<number_t> stack(std::max<size_t>(m_stackSize, 1) * batchRows);
+    for (size_t first = 0; first < out.size(); first += batchRows) {
+        size_t rows = std::min(batchRows, out.size() - first);
+        size_t top = 0;
+        auto entry = [&](size_t index) { return stack.data() + index * batchRows; };
+        auto mapTop = [&](auto op) {
+            number_t* x = entry(top - 1);
+            for (size_t i = 0; i < rows; ++i) x[i] = op(x[i]);
+        };
+
+        for (const auto& ins : m_code) {
+            if (isBinary(ins.op)) {
+                --top;
+                number_t* a = entry(top - 1);
+                const number_t* b = entry(top);
+                switch (ins.op) {
+                    case OpCode::add:   for (size_t i = 0; i < rows; ++i) a[i] += b[i]; break;
+                    case OpCode::sub:   for (size_t i = 0; i < rows; ++i) a[i] -= b[i]; break;
+                    case OpCode::mul:   for (size_t i = 0; i < rows; ++i) a[i] *= b[i]; break;
+                    case OpCode::div:   for (size_t i = 0; i < rows; ++i) a[i] /= b[i]; break;
+                    default: {
+                        bool negativeLiteral = ins.op == OpCode::powNegLiteral;
+                        for (size_t i = 0; i < rows; ++i) a[i] = calculateExpr::power(a[i], b[i], negativeLiteral);
+                    }
+                }
+                continue;
+            }
+
+            number_t* a = entry(top);
+            switch (ins.op) {
+                case OpCode::constant:
+                    std::fill_n(a, rows, ins.value);
+                    ++top;
+                    break;
+                case OpCode::variable:
+                    if (columns[ins.arg].size() == 1) std::fill_n(a, rows, columns[ins.arg][0]);
+                    else std::copy_n(columns[ins.arg].data() + first, rows, a);
+                    ++top;
+                    break;
+                case OpCode::local:
+                    std::copy_n(entry(ins.arg), rows, a);
+                    ++top;
+                    break;
+                case OpCode::drop:
+                    std::copy_n(entry(top - 1), rows, entry(top - 1 - ins.arg));
+                    top -= ins.arg;
+                    break;
+                case OpCode::sqrt:  mapTop([](number_t x) { return std::sqrt(x); }); break;
+                case OpCode::sin:   mapTop([](number_t x) { return std::sin(x); }); break;
+                case OpCode::cos:   mapTop([](number_t x) { return std::cos(x); }); break;
+                case OpCode::tan:   mapTop([](number_t x) { return std::tan(x); }); break;
+                case OpCode::asin:  mapTop([](number_t x) { return std::asin(x); }); break;
+                case OpCode::acos:  mapTop([](number_t x) { return std::acos(x); }); break;
+                case OpCode::atan:  mapTop([](number_t x) { return std::atan(x); }); break;
+                case OpCode::log:   mapTop([](number_t x) { return std::log10(x); }); break;
+                case OpCode::ln:    mapTop([](number_t x) { return std::log(x); }); break;
+                default:            break;
+            }
+        }
+
+        if (top) std::copy_n(entry(top - 1), rows, out.data() + first);
+        else std::fill_n(out.data() + first, rows, 0);
+    }
+}
+
+PrecisionCounts CompiledExpr::evaluateAdaptive(std::span<const std::span<const number_t>> columns, std::span<number_t> out, const Tolerance& tolerance) const {
+    if (columns.size() < m_symbols.size()) throw std::runtime_error("Missing values for compiled expression");
+    PrecisionCounts counts;
+    if (m_calls) {
+        evaluateBatch(columns, out);
+        counts.longDoubleRows = out.size();
+        return counts;
+    }
+    auto passes = [&](number_t value, number_t error) {
+        return isFinite(value) && error <= std::max(tolerance.relative * std::abs(value), tolerance.absolute);
+    };
+
+    // Double, rows whose bound passes are done
+    size_t entries = std::max<size_t>(m_stackSize, 1) * batchRows;
+    std::vector<size_t> escalated;
+    {
+        std::vector<double> values(entries), errors(entries);
+        for (size_t first = 0; first < out.size(); first += batchRows) {
+            size_t rows = std::min(batchRows, out.size() - first);
+            evaluateBounded<double>(m_code, columns, first, rows, values, errors);
+            for (size_t i = 0; i < rows; ++i) {
+                if (passes(values[i], errors[i])) out[first + i] = values[i];
+                else escalated.push_back(first + i);
+            }
+        }
+    }
+    counts.doubleRows = out.size() - escalated.size();
+    if (escalated.empty()) return counts;
+
+    // Long double over the escalated rows, gathered into columns of their own
+    std::vector<std::vector<number_t>> gathered(m_symbols.size());
+    std::vector<std::span<const number_t>> gatheredColumns(m_symbols.size());
+    for (size_t symbol = 0; symbol < m_symbols.size(); ++symbol) {
+        if (columns[symbol].size() == 1) gatheredColumns[symbol] = columns[symbol];
+        else {
+            for (size_t row : escalated) gathered[symbol].push_back(columns[symbol][row]);
+            gatheredColumns[symbol] = gathered[symbol];
+        }
+    }
+    std::vector<size_t> precise;
+    {
+        std::vector<number_t> values(entries), errors(entries);
+        for (size_t first = 0; first < escalated.size(); first += batchRows) {
+            size_t rows = std::min(batchRows, escalated.size() - first);
+            evaluateBounded<number_t>(m_code, gatheredColumns, first, rows, values, errors);
+            for (size_t i = 0; i < rows; ++i) {
+                out[escalated[first + i]] = values[i];
+                if (passes(values[i], errors[i])) ++counts.longDoubleRows;
+                else precise.push_back(escalated[first + i]);
+            }
+        }
+    }
+
+    // Multiprecision at doubling precision until two evaluations agree to the tolerance
+    std::vector<number_t> slots(m_symbols.size());
+    for (size_t row : precise) {
+        for (size_t symbol = 0; symbol < slots.size(); ++symbol) slots[symbol] = columns[symbol].size() == 1 ? columns[symbol][0] : columns[symbol][row];
+        bool agreed = false;
+        try {
+            BigFloat last = evaluatePrecise(m_code, slots, firstPreciseBits);
+            for (size_t bits = 2 * firstPreciseBits; bits <= maxPreciseBits && !agreed; bits *= 2) {
+                BigFloat next = evaluatePrecise(m_code, slots, bits);
+                number_t difference = bigfloat::sub(next, last, bits).abs().toNumber();
+                last = std::move(next);
+                agreed = passes(last.toNumber(), difference);
+            }
+            out[row] = last.toNumber();
+        }
+        catch (const std::runtime_error&) {
+            // Not a finite number, the long double result stands
+        }
+        ++(agreed ? counts.preciseRows : counts.unresolvedRows);
+    }
+    return counts;
+}
+
+number_t CompiledExpr::gradient(std::span<const number_t> slots, std::span<number_t> gradient) const {
+    if (slots.size() < m_symbols.size()) throw std::runtime_error("Missing values for compiled expression");
+    if (gradient.size() < m_symbols.size()) throw std::runtime_error("Missing room for the gradient of compiled expression");
+
+    ReverseSweep sweep(m_code, slots.first(m_symbols.size()));
+    Jacobian jacobian = sweep.run(0, {}, 0);
+    std::fill_n(gradient.begin(), m_symbols.size(), 0);
+    for (auto [slot, partial] : jacobian.slots) gradient[slot] = partial;
+
+    return jacobian.value;
+}
+
+bool CompiledExpr::validate(std::span<const Instruction> code, size_t symbolCount, uint32_t stackSize) {
+    size_t mainEnd = 0;
+    while (mainEnd < code.size() && !isFunctionHeader(code[mainEnd].op)) ++mainEnd;
+
+    auto depth = validateBody(code, 0, mainEnd, symbolCount, stackSize, 0);
+    if (!depth || depth.value() > 1) return false;
+
+    // Each function: header, base cases of arity literals and a value, a body and ret
+    for (size_t pc = mainEnd; pc < code.size(); ) {
+        const Instruction& header = code[pc];
+        if (!isFunctionHeader(header.op) || header.value < 0 || header.arg > stackSize) return false;
+
+        size_t body = bodyStart(code, pc);
+        if (body > code.size()) return false;
+        for (size_t i = pc + 1; i < body; ++i) {
+            bool isValue = (i - pc) % (header.arg + 1) == 0;
+            if (code[i].op != (isValue ? OpCode::caseValue : OpCode::caseArg)) return false;
+        }
+
+        size_t end = body;
+        while (end < code.size() && code[end].op != OpCode::ret) ++end;
+        if (end == code.size()) return false;
+
+        depth = validateBody(code, body, end, symbolCount, stackSize, header.arg);
+        if (!depth || depth.value() != header.arg + 1) return false;
+        pc = end + 1;
+    }
+    return true;
+}
+
+void CompiledExpr::emit(NodeExpr* expr, uint32_t depth) {
+    m_stackSize = std::max(m_stackSize, depth + 1);
+
+    if (std::holds_alternative<NodeTerm*>(expr->var)) {
+        NodeTerm* term = std::get<NodeTerm*>(expr->var);
+        if (std::holds_alternative<NodeTermNumber*>(term->var)) {
+            auto num = std::get<NodeTermNumber*>(term->var);
+            number_t value = num->lit && num->lit->value.has_value() ? std::stod(num->lit->value.value()) : 0;
+            m_code.push_back(Instruction{ .op = OpCode::constant, .arg = 0, .value = value });
+        }
+        else if (std::holds_alternative<NodeTermConstant*>(term->var)) {
+            auto constant = std::get<NodeTermConstant*>(term->var);
+            auto value = constants::value(constant->name->value.value());
+            if (!value.has_value()) throw std::runtime_error("Unknown constant " + constant->name->value.value());
+            m_code.push_back(Instruction{ .op = OpCode::constant, .arg = 0, .value = value.value() });
+        }
+        else if (std::holds_alternative<NodeTermVariable*>(term->var)) {
+            auto var = std::get<NodeTermVariable*>(term->var);
+            if (!var->ident || !var->ident->value.has_value()) throw std::runtime_error("Variable without a name");
+
+            emitVariable(var->ident->value.value());
+        }
+        else if (std::holds_alternative<NodeTermParen*>(term->var)) {
+            emit(std::get<NodeTermParen*>(term->var)->expr, depth);
+        }
+        else throw std::runtime_error("Vectors cannot be compiled");
+    }
+    else if (std::holds_alternative<NodeBinExpr*>(expr->var)) {
+        NodeBinExpr* bin = std::get<NodeBinExpr*>(expr->var);
+        bool sum = std::holds_alternative<NodeBinExprAdd*>(bin->var) || std::holds_alternative<NodeBinExprSub*>(bin->var);
+        if (sum && !m_inPolynomial && emitPolynomial(expr, depth)) return;
+
+        if (auto n = std::get_if<NodeBinExprAdd*>(&bin->var)) emitBinary(OpCode::add, (*n)->lhs, (*n)->rhs, depth);
+        else if (auto n = std::get_if<NodeBinExprSub*>(&bin->var)) emitBinary(OpCode::sub, (*n)->lhs, (*n)->rhs, depth);
+        else if (auto n = std::get_if<NodeBinExprMul*>(&bin->var)) emitBinary(OpCode::mul, (*n)->lhs, (*n)->rhs, depth);
+        else if (auto n = std::get_if<NodeBinExprDiv*>(&bin->var)) emitBinary(OpCode::div, (*n)->lhs, (*n)->rhs, depth);
+        else if (auto n = std::get_if<NodeBinExprPow*>(&bin->var)) {
+            OpCode op = calculateExpr::isNegativeLiteral((*n)->lhs) ? OpCode::powNegLiteral : OpCode::pow;
+            emitBinary(op, (*n)->lhs, (*n)->rhs, depth);
+        }
+    }
+    else if (std::holds_alternative<NodeExprFunc*>(expr->var)) {
+        NodeExprFunc* func = std::get<NodeExprFunc*>(expr->var);
+        if (auto n = std::get_if<NodeBinExprSqrt*>(&func->var)) emitUnary(OpCode::sqrt, (*n)->expr, depth);
+        else if (auto n = std::get_if<NodeBinExprSin*>(&func->var)) emitUnary(OpCode::sin, (*n)->expr, depth);
+        else if (auto n = std::get_if<NodeBinExprCos*>(&func->var)) emitUnary(OpCode::cos, (*n)->expr, depth);
+        else if (auto n = std::get_if<NodeBinExprTan*>(&func->var)) emitUnary(OpCode::tan, (*n)->expr, depth);
+        else if (auto n = std::get_if<NodeBinExprAsin*>(&func->var)) emitUnary(OpCode::asin, (*n)->expr, depth);
+        else if (auto n = std::get_if<NodeBinExprAcos*>(&func->var)) emitUnary(OpCode::acos, (*n)->expr, depth);
+        else if (auto n = std::get_if<NodeBinExprAtan*>(&func->var)) emitUnary(OpCode::atan, (*n)->expr, depth);
+        else if (auto n = std::get_if<NodeBinExprLog*>(&func->var)) emitUnary(OpCode::log, (*n)->expr, depth);
+        else if (auto n = std::get_if<NodeBinExprLn*>(&func->var)) emitUnary(OpCode::ln, (*n)->expr, depth);
+        else if (auto n = std::get_if<NodeBinExprCall*>(&func->var)) emitCall((*n)->name->value.value(), (*n)->args, depth);
+        else throw std::runtime_error("Function cannot be compiled");
+    }
+}
+
+void CompiledExpr::emitVariable(const std::string& name) {
+    // Parameters of the function being emitted shadow variables of the same name
+    auto param = m_params ? std::ranges::find(*m_params, name) : std::vector<std::string>::const_iterator();
+    if (m_params && param != m_params->end()) {
+        uint32_t index = static_cast<uint32_t>(param - m_params->begin());
+        m_code.push_back(Instruction{ .op = OpCode::local, .arg = m_paramBase + index, .value = 0 });
+    }
+    else m_code.push_back(Instruction{ .op = OpCode::variable, .arg = symbolSlot(name), .value = 0 });
+}
+
+bool CompiledExpr::emitPolynomial(NodeExpr* expr, uint32_t depth) {
+    // Only sums of monomials, expanding a factored form would cost accuracy. Exponents too large to
+    // expand are left to the pow of the tree.
+    std::optional<Polynomial> poly;
+    try {
+        poly = Polynomial::fromExpr(expr, false);
+    }
+    catch (const std::runtime_error&) {
+        return false;
+    }
+    if (!poly || !poly->isUnivariate() || poly->isConstant() || poly->terms().size() < 2 || poly->degree() < 2) return false;
+
+    std::vector<std::pair<uint32_t, number_t>> terms;
+    for (const auto& [monomial, coeff] : poly->terms()) terms.emplace_back(monomial.exps.front(), coeff);
+    std::ranges::sort(terms, std::ranges::greater(), [](const auto& term) { return term.first; });
+
+    // c0 x^e0 + c1 x^e1 + ... as ((c0 x^(e0 - e1) + c1) x^(e1 - e2) + ...) x^en, a gap of more than one is a pow
+    std::vector<Instruction> horner;
+    const std::string& name = poly->variables().front();
+    auto shift = [&](uint32_t gap) {
+        if (gap == 0) return;
+        emitVariable(name);
+        horner.push_back(m_code.back());
+        m_code.pop_back();
+        if (gap > 1) {
+            horner.push_back(Instruction{ .op = OpCode::constant, .arg = 0, .value = static_cast<number_t>(gap) });
+            horner.push_back(Instruction{ .op = OpCode::pow, .arg = 0, .value = 0 });
+        }
+        horner.push_back(Instruction{ .op = OpCode::mul, .arg = 0, .value = 0 });
+    };
+    horner.push_back(Instruction{ .op = OpCode::constant, .arg = 0, .value = terms.front().second });
+    for (size_t i = 1; i < terms.size(); ++i) {
+        shift(terms[i - 1].first - terms[i].first);
+        horner.push_back(Instruction{ .op = OpCode::constant, .arg = 0, .value = terms[i].second });
+        horner.push_back(Instruction{ .op = OpCode::add, .arg = 0, .value = 0 });
+    }
+    shift(terms.back().first);
+
+    // The tree is kept where it is as short, like x^2 + 1
+    size_t start = m_code.size();
+    m_inPolynomial = true;
+    emit(expr, depth);
+    m_inPolynomial = false;
+    if (m_code.size() - start <= horner.size()) return true;
+
+    m_code.resize(start);
+    m_code.insert(m_code.end(), horner.begin(), horner.end());
+    m_stackSize = std::max(m_stackSize, depth + 3);
+    return true;
+}
+
+void CompiledExpr::emitBinary(OpCode op, NodeExpr* lhs, NodeExpr* rhs, uint32_t depth) {
+    emit(lhs, depth);
+    emit(rhs, depth + 1);
+    m_code.push_back(Instruction{ .op = op, .arg = 0, .value = 0 });
+
+    // Fold constant operands by running the three instructions, which gives exactly the runtime result
+    size_t size = m_code.size();
+    if (m_code[size - 3].op == OpCode::constant && m_code[size - 2].op == OpCode::constant) {
+        number_t value = execute(std::span(m_code).subspan(size - 3), {}, 2);
+        m_code.resize(size - 3);
+        m_code.push_back(Instruction{ .op = OpCode::constant, .arg = 0, .value = value });
+    }
+}
+
+void CompiledExpr::emitUnary(OpCode op, NodeExpr* expr, uint32_t depth) {
+    emit(expr, depth);
+    m_code.push_back(Instruction{ .op = op, .arg = 0, .value = 0 });
+
+    size_t size = m_code.size();
+    if (m_code[size - 2].op == OpCode::constant) {
+        number_t value = execute(std::span(m_code).subspan(size - 2), {}, 1);
+        m_code.resize(size - 2);
+        m_code.push_back(Instruction{ .op = OpCode::constant, .arg = 0, .value = value });
+    }
+}
+
+void CompiledExpr::emitCall(const std::string& name, const std::vector<NodeExpr*>& args, uint32_t depth) {
+    auto it = m_functions ? m_functions->find(name) : FunctionTable::const_iterator();
+    if (!m_functions || it == m_functions->end()) throw std::runtime_error("Unknown function " + name);
+
+    const FunctionDef& function = it->second;
+    if (args.size() != function.arity()) {
+        throw std::runtime_error(name + " takes " + std::to_string(function.arity()) + " arguments but got " + std::to_string(args.size()));
+    }
+    if (!function.body) throw std::runtime_error(name + " has base cases but no general definition");
+
+    // The arguments stay on the stack where the body reads them
+    uint32_t count = static_cast<uint32_t>(args.size());
+    for (uint32_t i = 0; i < count; ++i) emit(args[i], depth + i);
+
+    bool recursive = std::ranges::find(m_inlining, name) != m_inlining.end();
+    if (recursive && std::ranges::find(m_recursive, name) == m_recursive.end()) m_recursive.push_back(name);
+    if (recursive || function.memoize || !function.cases.empty()) {
+        if (std::ranges::find(m_called, name) == m_called.end()) m_called.push_back(name);
+        m_callSites.emplace_back(m_code.size(), name);
+        m_code.push_back(Instruction{ .op = OpCode::call, .arg = 0, .value = 0 });
+        m_calls = true;
+        m_stackSize = std::max(m_stackSize, depth + 1);
+        return;
+    }
+
+    // Inlined: the body runs in the caller's frame right above the arguments
+    auto params = std::exchange(m_params, &function.params);
+    auto paramBase = std::exchange(m_paramBase, depth);
+    m_inlining.push_back(name);
+    emit(function.body, depth + count);
+    m_inlining.pop_back();
+    m_params = params;
+    m_paramBase = paramBase;
+
+    if (count) m_code.push_back(Instruction{ .op = OpCode::drop, .arg = count, .value = 0 });
+}
+
+void CompiledExpr::emitFunctions() {
+    // Bodies can call further functions, which are appended to m_called while this runs
+    std::unordered_map<std::string, uint32_t> headers;
+    for (size_t i = 0; i < m_called.size(); ++i) {
+        std::string name = m_called[i];
+        const FunctionDef& function = m_functions->at(name);
+
+        uint32_t header = static_cast<uint32_t>(m_code.size());
+        headers[name] = header;
+        uint32_t count = static_cast<uint32_t>(function.params.size());
+        m_code.push_back(Instruction{ .op = OpCode::function, .arg = count, .value = static_cast<number_t>(function.cases.size()) });
+        for (const auto& [args, value] : function.cases) {
+            for (number_t arg : args) m_code.push_back(Instruction{ .op = OpCode::caseArg, .arg = 0, .value = arg });
+            m_code.push_back(Instruction{ .op = OpCode::caseValue, .arg = 0, .value = value });
+        }
+
+        m_params = &function.params;
+        m_paramBase = 0;
+        m_inlining = { name };
+        emit(function.body, count);
+        m_code.push_back(Instruction{ .op = OpCode::ret, .arg = count, .value = 0 });
+
+        // Recursion is only known once the body is emitted
+        if (function.memoize || std::ranges::find(m_recursive, name) != m_recursive.end()) {
+            m_code[header].op = OpCode::memoFunction;
+            m_memoizes = true;
+        }
+    }
+    m_params = nullptr;
+    m_inlining.clear();
+    m_recursive.clear();
+
+    for (const auto& [site, name] : m_callSites) m_code[site].arg = headers.at(name);
+    m_called.clear();
+    m_callSites.clear();
+}
+
+uint32_t CompiledExpr::symbolSlot(const std::string& name) {
+    auto [it, inserted] = m_slotIndex.try_emplace(name, static_cast<uint32_t>(m_symbols.size()));
+    if (inserted) m_symbols.push_back(name);
+
+    return it->second;
+}
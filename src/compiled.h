@@ -0,0 +1,191 @@
+#ifndef COMPILED_H
+#define COMPILED_H
+
+#include "types.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class OpCode : uint32_t {
+    constant,
+    variable,
+    add,
+    sub,
+    mul,
+    div,
+    pow,
+    powNegLiteral,
+    sqrt,
+    sin,
+    cos,
+    tan,
+    asin,
+    acos,
+    atan,
+    log,
+    ln,
+    local,          // pushes the value arg slots above the frame base, the arguments of a function
+    drop,           // removes the arg values below the top, the arguments of an inlined call
+    call,           // calls the function whose header is at instruction arg
+    ret,            // returns from a function, its arguments are replaced by the result
+    function,       // header of a function taking arg arguments, value is its number of base cases
+    memoFunction,   // same for a function whose results are cached
+    caseArg,        // argument of a base case, value is the literal
+    caseValue,      // result of a base case, after its arguments
+    count
+};
+
+// One postfix instruction. Plain data without pointers so compiled code can be stored in and run from a mapped file.
+// Functions that are not inlined follow the main code, each as a header, its base cases and its body.
+struct Instruction {
+    OpCode op;
+    uint32_t arg;       // symbol slot of OpCode::variable
+    number_t value;     // literal of OpCode::constant
+};
+
+// User-defined function f(x, y) = body, with optional base cases like f(0, 0) = 1
+struct FunctionDef {
+    std::vector<std::string> params;
+    NodeExpr* body = nullptr;
+    // Owns body
+    std::shared_ptr<const AstArena> tree;
+    std::vector<std::pair<std::vector<number_t>, number_t>> cases;
+    // Results are cached by argument values instead of recomputed, recursive functions always are
+    bool memoize = false;
+
+    size_t arity() const { return body || cases.empty() ? params.size() : cases.front().first.size(); }
+};
+
+using FunctionTable = std::unordered_map<std::string, FunctionDef>;
+
+// Accuracy evaluateAdaptive asks of every row, its error may be the larger of the two
+struct Tolerance {
+    number_t relative = 1e-12;
+    number_t absolute = 0;
+};
+
+// Rows of evaluateAdaptive by the precision that met the tolerance. Unresolved rows hold the most
+// precise value that could be computed, like a result that is exactly zero or not a number at all.
+struct PrecisionCounts {
+    size_t doubleRows = 0;
+    size_t longDoubleRows = 0;
+    size_t preciseRows = 0;
+    size_t unresolvedRows = 0;
+};
+
+// Results of memoized calls keyed on the function and its arguments. Bounded, once full it starts over.
+class MemoCache {
+public:
+    std::optional<number_t> find(uint32_t function, std::span<const number_t> args) const;
+    void store(uint32_t function, std::span<const number_t> args, number_t value);
+    void clear() { m_entries.clear(); }
+private:
+    struct Key {
+        uint32_t function;
+        std::span<const number_t> args;
+    };
+    struct StoredKey {
+        uint32_t function;
+        std::vector<number_t> args;
+    };
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()(const Key& key) const;
+        size_t operator()(const StoredKey& key) const { return (*this)(Key{ key.function, key.args }); }
+    };
+    struct KeyEqual {
+        using is_transparent = void;
+        template<typename A, typename B>
+        bool operator()(const A& a, const B& b) const {
+            return a.function == b.function && std::ranges::equal(a.args, b.args);
+        }
+    };
+
+    std::unordered_map<StoredKey, number_t, KeyHash, KeyEqual> m_entries;
+};
+
+// Immutable once compiled, one instance can be evaluated from any number of threads at once
+class CompiledExpr {
+public:
+    CompiledExpr();
+    CompiledExpr(std::vector<Instruction> code, std::vector<std::string> symbols, uint32_t stackSize);
+
+    // Calls of user functions are inlined, recursive and memoized ones are compiled once behind the main code
+    static CompiledExpr compile(NodeExpr* expr, const FunctionTable* functions = nullptr);
+    // Code for name(#0, #1, ...), the first symbols are the arguments
+    static CompiledExpr compileCall(const std::string& name, const FunctionTable& functions);
+
+    const std::vector<Instruction>& code() const { return m_code; }
+    const std::vector<std::string>& symbols() const { return m_symbols; }
+    uint32_t stackSize() const { return m_stackSize; }
+    // Copies share the id since they hold the same code, it keys per-context binding caches
+    uint64_t id() const { return m_id; }
+
+    // True if the code has memoized functions, whose cache is only valid while the slots stay the same
+    bool memoizes() const { return m_memoizes; }
+
+    // slots holds the value of every symbol, in the order of symbols(). Without a memo cache one is
+    // kept for the duration of the call.
+    number_t evaluate(std::span<const number_t> slots, MemoCache* memo = nullptr) const;
+    static number_t execute(std::span<const Instruction> code, std::span<const number_t> slots, uint32_t stackSize, MemoCache* memo = nullptr);
+    // Evaluates many rows at once, column i holds the values of symbol i for every row or a single
+    // value for all of them. Runs each instruction over a block of rows instead of one row at a time.
+    void evaluateBatch(std::span<const std::span<const number_t>> columns, std::span<number_t> out) const;
+    // Same, but runs in double while bounding the error of every row from the exact value of the formula.
+    // Only rows whose bound exceeds the tolerance are evaluated again in long double with a bound, and
+    // those that still do in multiprecision. Code with calls has no bound and runs like evaluateBatch.
+    PrecisionCounts evaluateAdaptive(std::span<const std::span<const number_t>> columns, std::span<number_t> out, const Tolerance& tolerance = {}) const;
+    // Value of the expression, with its partial derivative with respect to every symbol written to
+    // gradient in the order of symbols(). A forward pass records each operation on a tape and one
+    // backward pass over it yields all of them at once.
+    number_t gradient(std::span<const number_t> slots, std::span<number_t> gradient) const;
+
+    // Checks that code only uses known opcodes and slots and never under- or overflows its stack
+    static bool validate(std::span<const Instruction> code, size_t symbolCount, uint32_t stackSize);
+private:
+    void emit(NodeExpr* expr, uint32_t depth);
+    void emitVariable(const std::string& name);
+    // Emits a univariate polynomial subtree in Horner form where that takes fewer instructions
+    bool emitPolynomial(NodeExpr* expr, uint32_t depth);
+    void emitBinary(OpCode op, NodeExpr* lhs, NodeExpr* rhs, uint32_t depth);
+    void emitUnary(OpCode op, NodeExpr* expr, uint32_t depth);
+    void emitCall(const std::string& name, const std::vector<NodeExpr*>& args, uint32_t depth);
+    void emitFunctions();
+    uint32_t symbolSlot(const std::string& name);
+private:
+    std::vector<Instruction> m_code;
+    std::vector<std::string> m_symbols;
+    uint32_t m_stackSize = 0;
+    uint64_t m_id;
+    bool m_memoizes = false;
+    // Calls branch per row, code with calls is evaluated one row at a time
+    bool m_calls = false;
+
+    // Only used while compiling
+    std::unordered_map<std::string, uint32_t> m_slotIndex;
+    const FunctionTable* m_functions = nullptr;
+    // Parameters of the function body being emitted and where the frame holds their values
+    const std::vector<std::string>* m_params = nullptr;
+    uint32_t m_paramBase = 0;
+    // Functions being inlined, a call to one of them is recursive
+    std::vector<std::string> m_inlining;
+    // Functions that call themselves, directly or through others, and are therefore memoized
+    std::vector<std::string> m_recursive;
+    // Functions compiled behind the main code, with the calls whose target is patched once they are placed
+    std::vector<std::string> m_called;
+    std::vector<std::pair<size_t, std::string>> m_callSites;
+    // Set while the tree of a polynomial is emitted, whose sums are then not polynomials of their own
+    bool m_inPolynomial = false;
+};
+
+using SharedExpr = std::shared_ptr<const CompiledExpr>;
+
+#endif
@@ -0,0 +1,191 @@
+#include "context.h"
+
+#include <stdexcept>
+
+namespace {
+// Bindings of expressions that were evaluated once and dropped would pile up otherwise
+constexpr size_t maxBindings = 4096;
+}
+
+std::optional<number_t> VariableVersion::get(uint32_t id) const {
+    size_t chunk = id / chunkSize, index = id % chunkSize;
+    if (chunk >= m_chunks.size() || !m_chunks[chunk] || !m_chunks[chunk]->defined.test(index)) return std::nullopt;
+
+    return m_chunks[chunk]->values[index];
+}
+
+VariableStore::VariableStore() {
+    m_current.store(std::make_shared<const VariableVersion>());
+}
+
+uint32_t VariableStore::intern(std::string_view name) {
+    std::lock_guard lock(m_nameMutex);
+    auto [it, inserted] = m_ids.try_emplace(std::string(name), static_cast<uint32_t>(m_names.size()));
+    if (inserted) m_names.emplace_back(name);
+
+    return it->second;
+}
+
+std::optional<uint32_t> VariableStore::find(std::string_view name) const {
+    std::lock_guard lock(m_nameMutex);
+    if (auto it = m_ids.find(std::string(name)); it != m_ids.end()) return it->second;
+
+    return std::nullopt;
+}
+
+std::string VariableStore::name(uint32_t id) const {
+    std::lock_guard lock(m_nameMutex);
+    return id < m_names.size() ? m_names[id] : std::string();
+}
+
+std::shared_ptr<const VariableVersion> VariableStore::current() const {
+    return m_current.load(std::memory_order_acquire);
+}
+
+std::optional<number_t> VariableStore::get(std::string_view name) const {
+    auto version = current();
+    if (auto id = find(name)) {
+        if (auto value = version->get(id.value())) return value;
+    }
+    if (version->base()) return version->base()->variable(name);
+
+    return std::nullopt;
+}
+
+void VariableStore::set(std::string_view name, number_t value) {
+    set({ std::make_pair(std::string(name), value) });
+}
+
+void VariableStore::set(const std::vector<std::pair<std::string, number_t>>& values) {
+    std::lock_guard lock(m_writeMutex);
+
+    auto next = std::make_shared<VariableVersion>(*current());
+    std::vector<std::shared_ptr<VariableVersion::Chunk>> writable(next->m_chunks.size());
+
+    for (const auto& [name, value] : values) {
+        uint32_t id = intern(name);
+        size_t chunk = id / VariableVersion::chunkSize, index = id % VariableVersion::chunkSize;
+        if (chunk >= next->m_chunks.size()) {
+            next->m_chunks.resize(chunk + 1);
+            writable.resize(chunk + 1);
+        }
+
+        // Chunks are shared with older versions that readers may still hold, copy before writing
+        if (!writable[chunk]) {
+            writable[chunk] = next->m_chunks[chunk]
+                ? std::make_shared<VariableVersion::Chunk>(*next->m_chunks[chunk])
+                : std::make_shared<VariableVersion::Chunk>();
+            next->m_chunks[chunk] = writable[chunk];
+        }
+
+        writable[chunk]->values[index] = value;
+        writable[chunk]->defined.set(index);
+    }
+
+    publish(std::move(next));
+}
+
+void VariableStore::reset(std::shared_ptr<const Snapshot> base) {
+    std::lock_guard lock(m_writeMutex);
+
+    auto next = std::make_shared<VariableVersion>();
+    next->m_base = std::move(base);
+    publish(std::move(next));
+}
+
+std::vector<std::pair<std::string, number_t>> VariableStore::entries() const {
+    auto version = current();
+    std::lock_guard lock(m_nameMutex);
+
+    std::vector<std::pair<std::string, number_t>> result;
+    for (uint32_t id = 0; id < m_names.size(); ++id) {
+        if (auto value = version->get(id)) result.emplace_back(m_names[id], value.value());
+    }
+    return result;
+}
+
+void VariableStore::publish(std::shared_ptr<VariableVersion> version) {
+    version->m_generation = m_generation.load(std::memory_order_relaxed) + 1;
+    uint64_t generation = version->m_generation;
+
+    m_current.store(std::move(version), std::memory_order_release);
+    m_generation.store(generation, std::memory_order_release);
+}
+
+EvalContext::EvalContext(VariableStore& store) : m_store(store), m_version(store.current()) {}
+
+void EvalContext::set(std::string_view name, number_t value) {
+    uint32_t id = m_store.intern(name);
+    if (id >= m_locals.size()) m_locals.resize(id + 1);
+
+    m_locals[id] = value;
+}
+
+void EvalContext::unset(std::string_view name) {
+    if (auto id = m_store.find(name); id && id.value() < m_locals.size()) m_locals[id.value()].reset();
+}
+
+number_t EvalContext::evaluate(const CompiledExpr& expr) {
+    // A single atomic load on the hot path, the version is only swapped when a writer published
+    if (m_store.generation() != m_version->generation()) refresh();
+
+    Binding& binding = bind(expr);
+    load(expr, binding);
+
+    if (!expr.memoizes()) return CompiledExpr::execute(expr.code(), m_slots, expr.stackSize());
+
+    // Memoized results stay valid across evaluations until a variable the expression reads changes
+    if (binding.memoSlots != m_slots) {
+        binding.memo.clear();
+        binding.memoSlots = m_slots;
+    }
+    return CompiledExpr::execute(expr.code(), m_slots, expr.stackSize(), &binding.memo);
+}
+
+number_t EvalContext::gradient(const CompiledExpr& expr, std::span<number_t> gradient) {
+    if (m_store.generation() != m_version->generation()) refresh();
+
+    load(expr, bind(expr));
+    return expr.gradient(m_slots, gradient);
+}
+
+void EvalContext::load(const CompiledExpr& expr, const Binding& binding) {
+    m_slots.resize(binding.ids.size());
+
+    for (size_t i = 0; i < binding.ids.size(); ++i) {
+        uint32_t id = binding.ids[i];
+        if (id < m_locals.size() && m_locals[id].has_value()) m_slots[i] = m_locals[id].value();
+        else if (auto value = m_version->get(id)) m_slots[i] = value.value();
+        else if (binding.baseValues[i].has_value()) m_slots[i] = binding.baseValues[i].value();
+        else throw std::runtime_error("Variable " + expr.symbols()[i] + " does not exist");
+    }
+}
+
+void EvalContext::refresh() {
+    m_version = m_store.current();
+}
+
+EvalContext::Binding& EvalContext::bind(const CompiledExpr& expr) {
+    auto it = m_bindings.find(expr.id());
+    if (it == m_bindings.end()) {
+        if (m_bindings.size() >= maxBindings) m_bindings.clear();
+
+        Binding binding;
+        binding.ids.reserve(expr.symbols().size());
+        for (const auto& symbol : expr.symbols()) binding.ids.push_back(m_store.intern(symbol));
+        binding.baseValues.resize(expr.symbols().size());
+
+        it = m_bindings.emplace(expr.id(), std::move(binding)).first;
+    }
+
+    // Snapshot values never change, they are looked up once per loaded snapshot
+    Binding& binding = it->second;
+    const auto& base = m_version->base();
+    if (binding.base != base) {
+        for (size_t i = 0; i < binding.ids.size(); ++i) {
+            binding.baseValues[i] = base ? base->variable(expr.symbols()[i]) : std::nullopt;
+        }
+        binding.base = base;
+    }
+    return binding;
+}
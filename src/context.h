@@ -0,0 +1,121 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "types.h"
+#include "compiled.h"
+#include "snapshot.h"
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Immutable set of variable values. Values are indexed by the ids of VariableStore and stored in
+// shared chunks, so publishing a change copies one chunk and the chunk table, not every value.
+class VariableVersion {
+public:
+    static constexpr size_t chunkSize = 256;
+
+    std::optional<number_t> get(uint32_t id) const;
+    uint64_t generation() const { return m_generation; }
+    // Loaded snapshot that supplies every variable this version does not define
+    const std::shared_ptr<const Snapshot>& base() const { return m_base; }
+private:
+    friend class VariableStore;
+
+    struct Chunk {
+        std::array<number_t, chunkSize> values{};
+        std::bitset<chunkSize> defined;
+    };
+
+    std::vector<std::shared_ptr<const Chunk>> m_chunks;
+    std::shared_ptr<const Snapshot> m_base;
+    uint64_t m_generation = 0;
+};
+
+// Variables shared between threads. Writers copy the current version, change it and publish it
+// (read-copy-update), readers keep evaluating against the version they hold without taking a lock.
+class VariableStore {
+public:
+    VariableStore();
+
+    // Stable id of a name, the same for every version
+    uint32_t intern(std::string_view name);
+    std::optional<uint32_t> find(std::string_view name) const;
+    std::string name(uint32_t id) const;
+
+    std::shared_ptr<const VariableVersion> current() const;
+    // Cheap check whether current() changed since a version was taken
+    uint64_t generation() const { return m_generation.load(std::memory_order_acquire); }
+
+    std::optional<number_t> get(std::string_view name) const;
+    void set(std::string_view name, number_t value);
+    void set(const std::vector<std::pair<std::string, number_t>>& values);
+
+    // Drops every value and makes base the fallback for all lookups
+    void reset(std::shared_ptr<const Snapshot> base = nullptr);
+
+    // Values defined in the current version, without those of the base snapshot
+    std::vector<std::pair<std::string, number_t>> entries() const;
+private:
+    void publish(std::shared_ptr<VariableVersion> version);
+private:
+    mutable std::mutex m_nameMutex;
+    std::unordered_map<std::string, uint32_t> m_ids;
+    std::vector<std::string> m_names;
+
+    std::mutex m_writeMutex;
+    std::atomic<std::shared_ptr<const VariableVersion>> m_current;
+    std::atomic<uint64_t> m_generation = 0;
+};
+
+// Per-thread evaluation state: the version in use, thread-local variable values and the
+// slot bindings of every expression it evaluated. Not thread safe itself, use one per thread.
+class EvalContext {
+public:
+    explicit EvalContext(VariableStore& store);
+
+    // Thread-local value that shadows the shared store
+    void set(std::string_view name, number_t value);
+    void unset(std::string_view name);
+
+    number_t evaluate(const CompiledExpr& expr);
+    // Value of expr with its partial derivatives in gradient, see CompiledExpr::gradient
+    number_t gradient(const CompiledExpr& expr, std::span<number_t> gradient);
+
+    // Moves to the newest published version, evaluate() does this automatically
+    void refresh();
+    const VariableVersion& version() const { return *m_version; }
+private:
+    struct Binding {
+        std::vector<uint32_t> ids;
+        std::vector<std::optional<number_t>> baseValues;
+        // Held so the address cannot be reused by a later snapshot while the values are cached
+        std::shared_ptr<const Snapshot> base;
+        // Results of memoized calls, they depend on the slot values they were computed with
+        MemoCache memo;
+        std::vector<number_t> memoSlots;
+    };
+
+    Binding& bind(const CompiledExpr& expr);
+    // Fills m_slots with the values of the symbols of expr
+    void load(const CompiledExpr& expr, const Binding& binding);
+private:
+    VariableStore& m_store;
+    std::shared_ptr<const VariableVersion> m_version;
+
+    std::vector<std::optional<number_t>> m_locals;
+    std::unordered_map<uint64_t, Binding> m_bindings;
+    std::vector<number_t> m_slots;
+};
+
+#endif
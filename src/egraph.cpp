@@ -0,0 +1,626 @@
+#include "egraph.h"
+
+#include "lexer.h"
+#include "calculate.h"
+#include "functions.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+
+namespace {
+// Budgets of the saturation, commutativity and associativity alone give a sum of n terms 2^n forms
+constexpr size_t maxNodes = 10000;
+constexpr size_t maxIterations = 30;
+constexpr auto maxDuration = std::chrono::milliseconds(100);
+// Folded values beyond this are left as they are, which also keeps infinities out
+constexpr number_t maxFolded = 1e300;
+
+// Rewrites lhs => rhs, where a, b and c stand for any subexpression. Rules that would change the
+// value for negative operands only apply if the variables in nonNegative are known to be non-negative,
+// or else if those in integers are all integer constants.
+struct Rewrite {
+    const char* lhs;
+    const char* rhs;
+    const char* nonNegative = "";
+    const char* integers = "";
+};
+
+constexpr Rewrite rewrites[] = {
+    { "a + b", "b + a" },
+    { "a * b", "b * a" },
+    { "(a + b) + c", "a + (b + c)" },
+    { "a + (b + c)", "(a + b) + c" },
+    { "(a * b) * c", "a * (b * c)" },
+    { "a * (b * c)", "(a * b) * c" },
+    { "a - b", "a + -1 * b" },
+    { "a + -1 * b", "a - b" },
+    { "a / b", "a * (1 / b)" },
+    { "a * (1 / b)", "a / b" },
+    { "(a / b) / c", "a / (b * c)" },
+
+    { "a + 0", "a" },
+    { "a - 0", "a" },
+    { "a * 1", "a" },
+    { "a * 0", "0" },
+    { "a / 1", "a" },
+    { "a - a", "0" },
+    { "a / a", "1" },
+    { "a ^ 1", "a" },
+    { "a ^ 0", "1" },
+    { "a + a", "2 * a" },
+    { "a * a", "a ^ 2" },
+    { "a ^ 2", "a * a" },
+    { "a ^ b * a ^ c", "a ^ (b + c)", "a", "bc" },
+    { "a ^ b * a", "a ^ (b + 1)", "a", "b" },
+    { "a * b + a", "a * (b + 1)" },
+    { "a * (b + c)", "a * b + a * c" },
+    { "a * b + a * c", "a * (b + c)" },
+    { "a * b - a * c", "a * (b - c)" },
+
+    { "sin(a)^2 + cos(a)^2", "1" },
+    { "1 - sin(a)^2", "cos(a)^2" },
+    { "1 - cos(a)^2", "sin(a)^2" },
+    { "cos(a)^2 - sin(a)^2", "cos(2 * a)" },
+    { "2 * (sin(a) * cos(a))", "sin(2 * a)" },
+    { "sin(a) / cos(a)", "tan(a)" },
+    { "tan(a) * cos(a)", "sin(a)" },
+    { "sqrt(a) * sqrt(b)", "sqrt(a * b)", "ab" },
+    { "ln(a) + ln(b)", "ln(a * b)", "ab" },
+    { "ln(a) - ln(b)", "ln(a / b)", "ab" },
+    { "log(a) + log(b)", "log(a * b)", "ab" },
+    { "log(a) - log(b)", "log(a / b)", "ab" },
+};
+
+size_t arity(EOp op) {
+    if (op <= EOp::variable) return 0;
+    if (op <= EOp::pow) return 2;
+    return 1;
+}
+
+// Evaluation cost in additions, a transcendental function takes about as long as twenty
+double opCost(EOp op) {
+    switch (op) {
+        case EOp::number:
+        case EOp::constant:
+        case EOp::variable: return 1;
+        case EOp::add:
+        case EOp::sub:
+        case EOp::mul: return 2;
+        case EOp::div: return 8;
+        case EOp::sqrt: return 10;
+        case EOp::pow: return 12;
+        default: return 40;
+    }
+}
+
+// Same functions as the evaluator
+number_t apply(EOp op, number_t a, number_t b) {
+    switch (op) {
+        case EOp::add: return a + b;
+        case EOp::sub: return a - b;
+        case EOp::mul: return a * b;
+        case EOp::div: return a / b;
+        case EOp::pow: return calculateExpr::power(a, b, false);
+        case EOp::sqrt: return std::sqrt(a);
+        case EOp::sin: return std::sin(a);
+        case EOp::cos: return std::cos(a);
+        case EOp::tan: return std::tan(a);
+        case EOp::asin: return std::asin(a);
+        case EOp::acos: return std::acos(a);
+        case EOp::atan: return std::atan(a);
+        case EOp::log: return std::log10(a);
+        case EOp::ln: return std::log(a);
+        default: throw std::logic_error("Leaves have no operation to apply");
+    }
+}
+
+// Whether a double holds value exactly. A round trip through double would not tell, -Ofast removes it.
+bool isDouble(number_t value) {
+    int exponent = 0;
+    number_t mantissa = std::ldexp(std::frexp(value, &exponent), std::numeric_limits<double>::digits);
+    return mantissa == std::trunc(mantissa) && exponent >= std::numeric_limits<double>::min_exponent;
+}
+
+// Whether every value of the class is at least 0 or undefined: a non-negative number, a square
+// root, an even integer power or a power of a non-negative number
+bool isNonNegative(const EGraph& graph, uint32_t id) {
+    if (auto value = graph.constant(id)) return value.value() >= 0;
+    return std::ranges::any_of(graph.nodes(id), [&](const ENode& node) {
+        if (node.op == EOp::sqrt) return true;
+        if (node.op != EOp::pow) return false;
+        auto base = graph.constant(node.children[0]);
+        auto exponent = graph.constant(node.children[1]);
+        return (base && base.value() >= 0) || (exponent && std::fmod(exponent.value(), 2) == 0);
+    });
+}
+
+template<typename Node>
+constexpr std::optional<EOp> opOf() {
+    if constexpr (std::is_same_v<Node, NodeBinExprAdd>) return EOp::add;
+    else if constexpr (std::is_same_v<Node, NodeBinExprSub>) return EOp::sub;
+    else if constexpr (std::is_same_v<Node, NodeBinExprMul>) return EOp::mul;
+    else if constexpr (std::is_same_v<Node, NodeBinExprDiv>) return EOp::div;
+    else if constexpr (std::is_same_v<Node, NodeBinExprPow>) return EOp::pow;
+    else if constexpr (std::is_same_v<Node, NodeBinExprSqrt>) return EOp::sqrt;
+    else if constexpr (std::is_same_v<Node, NodeBinExprSin>) return EOp::sin;
+    else if constexpr (std::is_same_v<Node, NodeBinExprCos>) return EOp::cos;
+    else if constexpr (std::is_same_v<Node, NodeBinExprTan>) return EOp::tan;
+    else if constexpr (std::is_same_v<Node, NodeBinExprAsin>) return EOp::asin;
+    else if constexpr (std::is_same_v<Node, NodeBinExprAcos>) return EOp::acos;
+    else if constexpr (std::is_same_v<Node, NodeBinExprAtan>) return EOp::atan;
+    else if constexpr (std::is_same_v<Node, NodeBinExprLog>) return EOp::log;
+    else if constexpr (std::is_same_v<Node, NodeBinExprLn>) return EOp::ln;
+    else return std::nullopt;
+}
+
+template<typename Op>
+NodeExpr* binary(AstArena& arena, NodeExpr* lhs, NodeExpr* rhs) {
+    return arena.make(NodeExpr{ .var = arena.make(NodeBinExpr{ .var = arena.make(Op{ .lhs = lhs, .rhs = rhs }) }) });
+}
+
+template<typename Func>
+NodeExpr* unary(AstArena& arena, NodeExpr* expr) {
+    return arena.make(NodeExpr{ .var = arena.make(NodeExprFunc{ .var = arena.make(Func{ .expr = expr }) }) });
+}
+
+NodeExpr* number(AstArena& arena, number_t value) {
+    // Folded values are doubles, so the shortest text that reads back as the same double is exact
+    char buffer[32];
+    auto end = std::to_chars(buffer, buffer + sizeof buffer, static_cast<double>(value)).ptr;
+    auto token = arena.make(Token{ .type = TokenType::number, .value = std::string(buffer, end) });
+    auto term = arena.make(NodeTerm{ .var = arena.make(NodeTermNumber{ .lit = token }) });
+    // As the base of a power a negative literal would take its sign after the power
+    if (value < 0) term = arena.make(NodeTerm{ .var = arena.make(NodeTermParen{ .expr = arena.make(NodeExpr{ .var = term }) }) });
+    return arena.make(NodeExpr{ .var = term });
+}
+
+// One level of an expression, parentheses are skipped. Operands spelled out anew are made in arena.
+struct Decomposed {
+    EOp op;
+    std::array<NodeExpr*, 2> operands{};
+    number_t value = 0;
+    std::string name;
+};
+
+std::optional<Decomposed> decompose(NodeExpr* expr, AstArena& arena) {
+    if (auto term = std::get_if<NodeTerm*>(&expr->var)) {
+        if (auto num = std::get_if<NodeTermNumber*>(&(*term)->var)) return Decomposed{ .op = EOp::number, .value = std::stod((*num)->lit->value.value()) };
+        if (auto constant = std::get_if<NodeTermConstant*>(&(*term)->var)) return Decomposed{ .op = EOp::constant, .name = (*constant)->name->value.value() };
+        if (auto variable = std::get_if<NodeTermVariable*>(&(*term)->var)) return Decomposed{ .op = EOp::variable, .name = (*variable)->ident->value.value() };
+        if (auto paren = std::get_if<NodeTermParen*>(&(*term)->var)) return decompose((*paren)->expr, arena);
+        return std::nullopt;
+    }
+    if (auto bin = std::get_if<NodeBinExpr*>(&expr->var)) {
+        // -2^x is -(2^x), spelled out so the graph needs no notion of literals
+        if (auto pow = std::get_if<NodeBinExprPow*>(&(*bin)->var); pow && calculateExpr::isNegativeLiteral((*pow)->lhs)) {
+            number_t base = std::stod(std::get<NodeTermNumber*>(std::get<NodeTerm*>((*pow)->lhs->var)->var)->lit->value.value());
+            return Decomposed{ .op = EOp::mul, .operands = { number(arena, -1), binary<NodeBinExprPow>(arena, number(arena, -base), (*pow)->rhs) } };
+        }
+        return std::visit([](auto node) {
+            return Decomposed{ .op = opOf<std::remove_pointer_t<decltype(node)>>().value(), .operands = { node->lhs, node->rhs } };
+        }, (*bin)->var);
+    }
+
+    return std::visit([](auto node) -> std::optional<Decomposed> {
+        using Node = std::remove_pointer_t<decltype(node)>;
+        if constexpr (opOf<Node>().has_value()) return Decomposed{ .op = opOf<Node>().value(), .operands = { node->expr } };
+        else return std::nullopt;
+    }, std::get<NodeExprFunc*>(expr->var)->var);
+}
+
+// Cheapest member of every class, found by relaxing class costs until none improves
+struct Extraction {
+    const EGraph& graph;
+    const std::vector<std::string>& symbols;
+    AstArena& arena;
+    std::vector<double> costs;
+    std::vector<ENode> best;
+
+    Extraction(const EGraph& graph, const std::vector<std::string>& symbols, AstArena& arena);
+    NodeExpr* build(uint32_t id) const;
+    // Operands binding weaker than minPrec are parenthesized, leading tells if a minus sign may start the text
+    std::string print(uint32_t id, int minPrec = 0, bool leading = true) const;
+};
+
+Extraction::Extraction(const EGraph& graph, const std::vector<std::string>& symbols, AstArena& arena) : graph(graph), symbols(symbols), arena(arena) {
+    constexpr double unknown = std::numeric_limits<double>::max();
+    auto ids = graph.classes();
+    costs.assign(ids.back() + 1, unknown);
+    best.resize(ids.back() + 1);
+
+    for (bool improved = true; improved; ) {
+        improved = false;
+        for (uint32_t id : ids) {
+            for (const ENode& node : graph.nodes(id)) {
+                double cost = opCost(node.op);
+                for (size_t i = 0; i < arity(node.op) && cost != unknown; ++i) {
+                    double operand = costs[graph.find(node.children[i])];
+                    cost = operand == unknown ? unknown : cost + operand;
+                }
+                if (cost < costs[id]) {
+                    costs[id] = cost;
+                    best[id] = node;
+                    improved = true;
+                }
+            }
+        }
+    }
+}
+
+NodeExpr* Extraction::build(uint32_t id) const {
+    const ENode& node = best[graph.find(id)];
+    auto operand = [&](size_t i) { return build(node.children[i]); };
+    switch (node.op) {
+        case EOp::number: return number(arena, node.value);
+        case EOp::constant: {
+            auto name = arena.make(Token{ .type = TokenType::constant, .value = symbols[node.symbol] });
+            return arena.make(NodeExpr{ .var = arena.make(NodeTerm{ .var = arena.make(NodeTermConstant{ .name = name }) }) });
+        }
+        case EOp::variable: {
+            auto ident = arena.make(Token{ .type = TokenType::variable, .value = symbols[node.symbol] });
+            return arena.make(NodeExpr{ .var = arena.make(NodeTerm{ .var = arena.make(NodeTermVariable{ .ident = ident }) }) });
+        }
+        case EOp::add: return binary<NodeBinExprAdd>(arena, operand(0), operand(1));
+        case EOp::sub: return binary<NodeBinExprSub>(arena, operand(0), operand(1));
+        case EOp::mul: return binary<NodeBinExprMul>(arena, operand(0), operand(1));
+        case EOp::div: return binary<NodeBinExprDiv>(arena, operand(0), operand(1));
+        case EOp::pow: return binary<NodeBinExprPow>(arena, operand(0), operand(1));
+        case EOp::sqrt: return unary<NodeBinExprSqrt>(arena, operand(0));
+        case EOp::sin: return unary<NodeBinExprSin>(arena, operand(0));
+        case EOp::cos: return unary<NodeBinExprCos>(arena, operand(0));
+        case EOp::tan: return unary<NodeBinExprTan>(arena, operand(0));
+        case EOp::asin: return unary<NodeBinExprAsin>(arena, operand(0));
+        case EOp::acos: return unary<NodeBinExprAcos>(arena, operand(0));
+        case EOp::atan: return unary<NodeBinExprAtan>(arena, operand(0));
+        case EOp::log: return unary<NodeBinExprLog>(arena, operand(0));
+        case EOp::ln: return unary<NodeBinExprLn>(arena, operand(0));
+    }
+    throw std::logic_error("Unknown e-node operation");
+}
+
+std::string Extraction::print(uint32_t id, int minPrec, bool leading) const {
+    const ENode& node = best[graph.find(id)];
+    auto [lhs, rhs] = node.children;
+    // Operators are left associative, so right operands of equal precedence need parentheses too
+    auto infix = [&](const char* op, int prec, bool lhsLeading = true) {
+        bool wrapped = prec < minPrec;
+        std::string text = print(lhs, prec, lhsLeading && (wrapped || leading)) + op + print(rhs, prec + 1, false);
+        return wrapped ? "(" + text + ")" : text;
+    };
+
+    switch (node.op) {
+        case EOp::number: {
+            std::string text = formatNumber(node.value);
+            return node.value < 0 && !leading ? "(" + text + ")" : text;
+        }
+        case EOp::constant:
+        case EOp::variable: return symbols[node.symbol];
+        case EOp::add: return infix(" + ", 1);
+        case EOp::sub: return infix(" - ", 1);
+        case EOp::mul: {
+            const ENode& factor = best[graph.find(lhs)];
+            if (factor.op != EOp::number || factor.value != -1) return infix("*", 2);
+
+            std::string text = "-" + print(rhs, 2, false);
+            return leading && minPrec <= 2 ? text : "(" + text + ")";
+        }
+        case EOp::div: return infix("/", 2);
+        // A leading -2 would be read as a literal, which takes its sign after the power
+        case EOp::pow: return infix("^", 3, false);
+        case EOp::sqrt: return "sqrt(" + print(lhs) + ")";
+        case EOp::sin: return "sin(" + print(lhs) + ")";
+        case EOp::cos: return "cos(" + print(lhs) + ")";
+        case EOp::tan: return "tan(" + print(lhs) + ")";
+        case EOp::asin: return "asin(" + print(lhs) + ")";
+        case EOp::acos: return "acos(" + print(lhs) + ")";
+        case EOp::atan: return "atan(" + print(lhs) + ")";
+        case EOp::log: return "log(" + print(lhs) + ")";
+        case EOp::ln: return "ln(" + print(lhs) + ")";
+    }
+    throw std::logic_error("Unknown e-node operation");
+}
+}
+
+size_t ENodeHash::operator()(const ENode& node) const {
+    size_t hash = static_cast<size_t>(node.op);
+    auto combine = [&hash](size_t value) { hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2); };
+    combine(node.children[0]);
+    combine(node.children[1]);
+    // 0 and -0 compare equal, so they have to hash equal
+    combine(node.value == 0 ? 0 : std::hash<number_t>{}(node.value));
+    combine(node.symbol);
+    return hash;
+}
+
+uint32_t EGraph::add(ENode node) {
+    node = canonical(node);
+    if (auto it = m_memo.find(node); it != m_memo.end()) return find(it->second);
+
+    auto id = static_cast<uint32_t>(m_classes.size());
+    auto constant = fold(node);
+    m_parents.push_back(id);
+    m_classes.push_back(EClass{ .nodes = { node }, .constant = constant });
+    ++m_classCount;
+    for (size_t i = 0; i < arity(node.op); ++i) m_classes[node.children[i]].parents.emplace_back(node, id);
+    m_memo.emplace(node, id);
+
+    if (constant && node.op != EOp::number) merge(id, add(ENode{ .op = EOp::number, .value = constant.value() }));
+    return find(id);
+}
+
+uint32_t EGraph::find(uint32_t id) const {
+    while (m_parents[id] != id) {
+        m_parents[id] = m_parents[m_parents[id]];
+        id = m_parents[id];
+    }
+    return id;
+}
+
+bool EGraph::merge(uint32_t a, uint32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) return false;
+
+    // The class with fewer parents moves, those are what repair() has to revisit
+    if (m_classes[a].parents.size() < m_classes[b].parents.size()) std::swap(a, b);
+    m_parents[b] = a;
+    --m_classCount;
+
+    EClass from = std::exchange(m_classes[b], EClass{});
+    EClass& into = m_classes[a];
+    into.nodes.insert(into.nodes.end(), from.nodes.begin(), from.nodes.end());
+    into.parents.insert(into.parents.end(), from.parents.begin(), from.parents.end());
+    if (!into.constant) into.constant = from.constant;
+
+    m_pending.push_back(a);
+    return true;
+}
+
+void EGraph::rebuild() {
+    while (!m_pending.empty()) {
+        auto pending = std::exchange(m_pending, {});
+        for (auto& id : pending) id = find(id);
+        std::ranges::sort(pending);
+        auto duplicates = std::ranges::unique(pending);
+        pending.erase(duplicates.begin(), duplicates.end());
+
+        for (uint32_t id : pending) repair(find(id));
+    }
+
+    // Members still name the classes their operands had when they were added
+    auto key = [](const ENode& node) { return std::tie(node.op, node.children, node.value, node.symbol); };
+    for (uint32_t id : classes()) {
+        auto& nodes = m_classes[id].nodes;
+        for (auto& node : nodes) node = canonical(node);
+        std::ranges::sort(nodes, [&](const ENode& a, const ENode& b) { return key(a) < key(b); });
+        auto duplicates = std::ranges::unique(nodes);
+        nodes.erase(duplicates.begin(), duplicates.end());
+    }
+}
+
+std::vector<uint32_t> EGraph::classes() const {
+    std::vector<uint32_t> ids;
+    ids.reserve(m_classCount);
+    for (uint32_t id = 0; id < m_parents.size(); ++id) {
+        if (m_parents[id] == id) ids.push_back(id);
+    }
+    return ids;
+}
+
+ENode EGraph::canonical(ENode node) const {
+    for (size_t i = 0; i < arity(node.op); ++i) node.children[i] = find(node.children[i]);
+    return node;
+}
+
+void EGraph::repair(uint32_t id) {
+    auto parents = std::exchange(m_classes[id].parents, {});
+    for (auto& [node, parent] : parents) {
+        m_memo.erase(node);
+        node = canonical(node);
+    }
+
+    // Parents that became equal operations on equal classes are equal
+    std::unordered_map<ENode, uint32_t, ENodeHash> unique;
+    for (const auto& [node, parent] : parents) {
+        auto [it, inserted] = unique.try_emplace(node, parent);
+        if (!inserted) merge(it->second, parent);
+        it->second = find(parent);
+    }
+
+    for (auto& [node, parent] : unique) {
+        parent = find(parent);
+        m_memo.insert_or_assign(node, parent);
+        // A merge may have made all operands of a parent numbers
+        if (!m_classes[parent].constant) {
+            if (auto constant = fold(node)) {
+                m_classes[parent].constant = constant;
+                merge(parent, add(ENode{ .op = EOp::number, .value = constant.value() }));
+            }
+        }
+    }
+
+    auto& target = m_classes[find(id)].parents;
+    for (const auto& [node, parent] : unique) target.emplace_back(node, find(parent));
+}
+
+std::optional<number_t> EGraph::fold(const ENode& node) const {
+    if (node.op == EOp::number) return node.value;
+    if (arity(node.op) == 0) return std::nullopt;
+
+    auto a = constant(node.children[0]);
+    auto b = arity(node.op) == 2 ? constant(node.children[1]) : std::optional<number_t>(0);
+    if (!a || !b) return std::nullopt;
+
+    // Outside the domain there is no number to fold to
+    switch (node.op) {
+        case EOp::div: if (b.value() == 0) return std::nullopt; break;
+        case EOp::pow: if (a.value() == 0 && b.value() < 0) return std::nullopt; break;
+        case EOp::sqrt: if (a.value() < 0) return std::nullopt; break;
+        case EOp::log:
+        case EOp::ln: if (a.value() <= 0) return std::nullopt; break;
+        case EOp::asin:
+        case EOp::acos: if (std::abs(a.value()) > 1) return std::nullopt; break;
+        default: break;
+    }
+
+    // Only values a literal holds exactly, 1/3 stays a division and sin(1) a call
+    number_t value = apply(node.op, a.value(), b.value());
+    if (!(std::abs(value) <= maxFolded) || !isDouble(value)) return std::nullopt;
+    return value;
+}
+
+Simplifier::Simplifier() {
+    for (auto [lhs, rhs, nonNegative, integers] : rewrites) {
+        std::unordered_map<std::string, uint32_t> variables;
+        Rule rule;
+        for (auto [text, pattern] : { std::pair(lhs, &rule.lhs), std::pair(rhs, &rule.rhs) }) {
+            Lexer lexer(text);
+            Parser parser(lexer.tokenize());
+            addPattern(*pattern, parser.parse()->rhs, variables);
+        }
+        rule.variables = variables.size();
+        for (auto [names, indices] : { std::pair(nonNegative, &rule.nonNegative), std::pair(integers, &rule.integers) }) {
+            for (const char* name = names; *name; ++name) indices->push_back(variables.at(std::string(1, *name)));
+        }
+        m_rules.push_back(std::move(rule));
+    }
+}
+
+std::optional<Simplified> Simplifier::simplify(NodeExpr* expr) const {
+    EGraph graph;
+    std::vector<std::string> symbols;
+    double originalCost = 0;
+    auto arena = std::make_shared<AstArena>();
+
+    std::function<std::optional<uint32_t>(NodeExpr*)> add = [&](NodeExpr* expr) -> std::optional<uint32_t> {
+        auto decomposed = decompose(expr, *arena);
+        if (!decomposed) return std::nullopt;
+        originalCost += opCost(decomposed->op);
+
+        ENode node{ .op = decomposed->op, .value = decomposed->value };
+        if (node.op == EOp::constant || node.op == EOp::variable) {
+            auto symbol = std::ranges::find(symbols, decomposed->name);
+            node.symbol = static_cast<uint32_t>(symbol - symbols.begin());
+            if (symbol == symbols.end()) symbols.push_back(decomposed->name);
+        }
+        for (size_t i = 0; i < arity(node.op); ++i) {
+            auto operand = add(decomposed->operands[i]);
+            if (!operand) return std::nullopt;
+            node.children[i] = operand.value();
+        }
+        return graph.add(node);
+    };
+    auto root = add(expr);
+    if (!root) return std::nullopt;
+    graph.rebuild();
+
+    // Every iteration matches all rules against the graph as it is, then applies all matches at once
+    struct Match {
+        const Rule* rule;
+        uint32_t id;
+        Substitution substitution;
+    };
+    auto start = std::chrono::steady_clock::now();
+    size_t iterations = 0;
+    bool saturated = false;
+    while (!saturated && iterations < maxIterations && graph.nodeCount() < maxNodes && std::chrono::steady_clock::now() - start < maxDuration) {
+        ++iterations;
+        std::vector<Match> matches;
+        auto ids = graph.classes();
+        for (const Rule& rule : m_rules) {
+            Substitution substitution(rule.variables, std::numeric_limits<uint32_t>::max());
+            for (uint32_t id : ids) {
+                match(graph, rule.lhs, static_cast<int>(rule.lhs.size()) - 1, id, substitution, [&] {
+                    if (applies(graph, rule, substitution)) matches.push_back(Match{ &rule, id, substitution });
+                });
+            }
+        }
+
+        size_t nodes = graph.nodeCount();
+        bool merged = false;
+        for (const auto& [rule, id, substitution] : matches) {
+            if (graph.nodeCount() >= maxNodes) break;
+            merged |= graph.merge(id, instantiate(graph, rule->rhs, static_cast<int>(rule->rhs.size()) - 1, substitution));
+        }
+        graph.rebuild();
+        saturated = !merged && graph.nodeCount() == nodes;
+    }
+
+    Extraction extraction(graph, symbols, *arena);
+    uint32_t id = graph.find(root.value());
+    return Simplified{
+        .expr = extraction.build(id),
+        .arena = arena,
+        .text = extraction.print(id),
+        .originalCost = originalCost,
+        .cost = extraction.costs[id],
+        .nodes = graph.nodeCount(),
+        .iterations = iterations,
+        .saturated = saturated,
+    };
+}
+
+int Simplifier::addPattern(std::vector<PatternNode>& pattern, NodeExpr* expr, std::unordered_map<std::string, uint32_t>& variables) {
+    AstArena arena;
+    auto decomposed = decompose(expr, arena);
+    if (!decomposed || decomposed->op == EOp::constant) throw std::logic_error("Rewrite rules may only hold numbers, variables, operators and functions");
+
+    PatternNode node{ .op = decomposed->op, .value = decomposed->value };
+    if (node.op == EOp::variable) node.variable = variables.try_emplace(decomposed->name, static_cast<uint32_t>(variables.size())).first->second;
+    if (arity(node.op) > 0) node.lhs = addPattern(pattern, decomposed->operands[0], variables);
+    if (arity(node.op) > 1) node.rhs = addPattern(pattern, decomposed->operands[1], variables);
+
+    pattern.push_back(node);
+    return static_cast<int>(pattern.size()) - 1;
+}
+
+void Simplifier::match(const EGraph& graph, const std::vector<PatternNode>& pattern, int node, uint32_t id, Substitution& substitution, const std::function<void()>& found) const {
+    const PatternNode& p = pattern[node];
+    id = graph.find(id);
+
+    if (p.op == EOp::variable) {
+        uint32_t& bound = substitution[p.variable];
+        if (bound == std::numeric_limits<uint32_t>::max()) {
+            bound = id;
+            found();
+            bound = std::numeric_limits<uint32_t>::max();
+        }
+        else if (bound == id) found();
+        return;
+    }
+    // Numbers match any class that folds to them
+    if (p.op == EOp::number) {
+        if (graph.constant(id) == p.value) found();
+        return;
+    }
+
+    for (const ENode& member : graph.nodes(id)) {
+        if (member.op != p.op) continue;
+        if (p.rhs < 0) match(graph, pattern, p.lhs, member.children[0], substitution, found);
+        else match(graph, pattern, p.lhs, member.children[0], substitution, [&] { match(graph, pattern, p.rhs, member.children[1], substitution, found); });
+    }
+}
+
+bool Simplifier::applies(const EGraph& graph, const Rule& rule, const Substitution& substitution) {
+    if (std::ranges::all_of(rule.nonNegative, [&](uint32_t variable) { return isNonNegative(graph, substitution[variable]); })) return true;
+    return !rule.integers.empty() && std::ranges::all_of(rule.integers, [&](uint32_t variable) {
+        auto value = graph.constant(substitution[variable]);
+        return value && value.value() == std::trunc(value.value());
+    });
+}
+
+uint32_t Simplifier::instantiate(EGraph& graph, const std::vector<PatternNode>& pattern, int node, const Substitution& substitution) const {
+    const PatternNode& p = pattern[node];
+    if (p.op == EOp::variable) return substitution[p.variable];
+
+    ENode result{ .op = p.op, .value = p.value };
+    if (p.lhs >= 0) result.children[0] = instantiate(graph, pattern, p.lhs, substitution);
+    if (p.rhs >= 0) result.children[1] = instantiate(graph, pattern, p.rhs, substitution);
+    return graph.add(result);
+}
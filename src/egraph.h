@@ -0,0 +1,145 @@
+#ifndef EGRAPH_H
+#define EGRAPH_H
+
+#include "types.h"
+#include "parser.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class EOp : uint8_t {
+    number,
+    constant,
+    variable,
+    add,
+    sub,
+    mul,
+    div,
+    pow,
+    sqrt,
+    sin,
+    cos,
+    tan,
+    asin,
+    acos,
+    atan,
+    log,
+    ln
+};
+
+// Operation whose operands are e-classes rather than subexpressions. Numbers carry their value,
+// constants and variables the index of their name.
+struct ENode {
+    EOp op;
+    std::array<uint32_t, 2> children{};
+    number_t value = 0;
+    uint32_t symbol = 0;
+
+    bool operator==(const ENode&) const = default;
+};
+
+struct ENodeHash {
+    size_t operator()(const ENode& node) const;
+};
+
+// Classes of equal expressions over shared subterms. merge() records that two classes are equal,
+// rebuild() then restores that equal operations of equal classes are one class. Classes whose value
+// folds to a number exactly hold that number as a member.
+class EGraph {
+public:
+    uint32_t add(ENode node);
+    uint32_t find(uint32_t id) const;
+    // False if both already were one class
+    bool merge(uint32_t a, uint32_t b);
+    void rebuild();
+
+    // Canonical id of every class
+    std::vector<uint32_t> classes() const;
+    const std::vector<ENode>& nodes(uint32_t id) const { return m_classes[find(id)].nodes; }
+    std::optional<number_t> constant(uint32_t id) const { return m_classes[find(id)].constant; }
+    size_t nodeCount() const { return m_memo.size(); }
+    size_t classCount() const { return m_classCount; }
+private:
+    struct EClass {
+        std::vector<ENode> nodes;
+        // Nodes that have this class as an operand, and the class each of them is in
+        std::vector<std::pair<ENode, uint32_t>> parents;
+        std::optional<number_t> constant;
+    };
+
+    ENode canonical(ENode node) const;
+    void repair(uint32_t id);
+    std::optional<number_t> fold(const ENode& node) const;
+private:
+    // Union-find, compressed on lookup
+    mutable std::vector<uint32_t> m_parents;
+    std::vector<EClass> m_classes;
+    std::unordered_map<ENode, uint32_t, ENodeHash> m_memo;
+    // Classes merged since the last rebuild
+    std::vector<uint32_t> m_pending;
+    size_t m_classCount = 0;
+};
+
+struct Simplified {
+    NodeExpr* expr;
+    // Owns expr
+    std::shared_ptr<AstArena> arena;
+    std::string text;
+    // Estimated evaluation cost before and after, in additions
+    double originalCost;
+    double cost;
+    size_t nodes;
+    size_t iterations;
+    // Every rule was applied everywhere before a budget ran out
+    bool saturated;
+};
+
+// Simplifies by equality saturation: the rewrites of a rule set of algebraic and trigonometric
+// identities are all added to one e-graph, so no rewrite is ever undone by the order of the others.
+// The cheapest expression to evaluate is then extracted, transcendental functions costing most.
+// The identities hold wherever both sides are defined, x/x becomes 1 even though 0/0 is not.
+// Powers, square roots and logarithms are only combined where no operand can be negative, or for
+// powers where the exponents are integers, so x^(1/3)*x^(1/3) keeps its value at x = -8.
+class Simplifier {
+public:
+    Simplifier();
+
+    // std::nullopt if expr holds anything but numbers, variables, operators and elementary functions
+    std::optional<Simplified> simplify(NodeExpr* expr) const;
+private:
+    // Trees of an expression whose variables stand for any subexpression
+    struct PatternNode {
+        EOp op;
+        int lhs = -1;
+        int rhs = -1;
+        number_t value = 0;
+        uint32_t variable = 0;
+    };
+    struct Rule {
+        std::vector<PatternNode> lhs;
+        std::vector<PatternNode> rhs;
+        size_t variables;
+        // Variables that have to be known non-negative, or else all be integer constants
+        std::vector<uint32_t> nonNegative;
+        std::vector<uint32_t> integers;
+    };
+    using Substitution = std::vector<uint32_t>;
+
+    // Appends the pattern of expr after those of its operands and returns its index
+    static int addPattern(std::vector<PatternNode>& pattern, NodeExpr* expr, std::unordered_map<std::string, uint32_t>& variables);
+    void match(const EGraph& graph, const std::vector<PatternNode>& pattern, int node, uint32_t id, Substitution& substitution, const std::function<void()>& found) const;
+    static bool applies(const EGraph& graph, const Rule& rule, const Substitution& substitution);
+    uint32_t instantiate(EGraph& graph, const std::vector<PatternNode>& pattern, int node, const Substitution& substitution) const;
+private:
+    std::vector<Rule> m_rules;
+};
+
+#endif
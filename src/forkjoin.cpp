@@ -0,0 +1,162 @@
+#include "forkjoin.h"
+
+#include <algorithm>
+
+namespace {
+// Worker the current thread is, so nested invoke() calls know which deque is theirs
+thread_local const ForkJoinPool* currentPool = nullptr;
+thread_local size_t currentWorker = 0;
+}
+
+ForkJoinPool::ForkJoinPool(size_t threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    m_workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) m_workers.push_back(std::make_unique<Worker>());
+    m_threads.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) m_threads.emplace_back([this, i] { workerLoop(i); });
+}
+
+ForkJoinPool::~ForkJoinPool() {
+    {
+        std::lock_guard lock(m_idleMutex);
+        m_stopping = true;
+    }
+    m_idle.notify_all();
+
+    for (auto& thread : m_threads) thread.join();
+}
+
+void ForkJoinPool::run(const std::function<void()>& root) {
+    // Called from a worker it would wait on itself, so it just runs
+    if (currentPool == this) {
+        root();
+        return;
+    }
+
+    Task task{ &root, nullptr, false, true };
+    {
+        std::lock_guard lock(m_submitted.mutex);
+        m_submitted.tasks.push_back(&task);
+        ++m_queued;
+    }
+    {
+        std::lock_guard lock(m_idleMutex);
+    }
+    m_idle.notify_one();
+
+    {
+        std::unique_lock lock(m_idleMutex);
+        m_finished.wait(lock, [&task] { return task.done.load(std::memory_order_acquire); });
+    }
+    if (task.error) std::rethrow_exception(task.error);
+}
+
+void ForkJoinPool::invoke(const std::function<void()>& a, const std::function<void()>& b) {
+    if (currentPool != this) {
+        a();
+        b();
+        return;
+    }
+
+    size_t self = currentWorker;
+    Task task{ &b };
+    push(self, &task);
+
+    std::exception_ptr error;
+    try {
+        a();
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+
+    // Every invoke inside a() has joined, so b is at the back unless a thief took it
+    bool popped = false;
+    {
+        Worker& worker = *m_workers[self];
+        std::lock_guard lock(worker.mutex);
+        if (!worker.tasks.empty() && worker.tasks.back() == &task) {
+            worker.tasks.pop_back();
+            --m_queued;
+            popped = true;
+        }
+    }
+    if (popped) execute(task);
+    else {
+        while (!task.done.load(std::memory_order_acquire)) {
+            if (Task* other = steal(self)) execute(*other);
+            else std::this_thread::yield();
+        }
+    }
+
+    if (error) std::rethrow_exception(error);
+    if (task.error) std::rethrow_exception(task.error);
+}
+
+void ForkJoinPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentWorker = index;
+
+    while (true) {
+        // The own deque only holds tasks while this worker is inside invoke(), never here
+        if (Task* task = steal(index)) {
+            execute(*task);
+            continue;
+        }
+
+        std::unique_lock lock(m_idleMutex);
+        m_idle.wait(lock, [this] { return m_stopping || m_queued > 0; });
+        if (m_stopping && m_queued == 0) return;
+    }
+}
+
+void ForkJoinPool::execute(Task& task) {
+    try {
+        (*task.function)();
+    }
+    catch (...) {
+        task.error = std::current_exception();
+    }
+
+    // The waiter of a forked task polls, the one of a root sleeps and may destroy the task as soon as
+    // it sees it done, so it is only notified through the pool
+    if (!task.root) {
+        task.done.store(true, std::memory_order_release);
+        return;
+    }
+    {
+        std::lock_guard lock(m_idleMutex);
+        task.done.store(true, std::memory_order_release);
+    }
+    m_finished.notify_all();
+}
+
+void ForkJoinPool::push(size_t worker, Task* task) {
+    {
+        std::lock_guard lock(m_workers[worker]->mutex);
+        m_workers[worker]->tasks.push_back(task);
+        ++m_queued;
+    }
+    {
+        std::lock_guard lock(m_idleMutex);
+    }
+    m_idle.notify_one();
+}
+
+ForkJoinPool::Task* ForkJoinPool::steal(size_t self) {
+    auto takeOldest = [this](Worker& worker) -> Task* {
+        std::lock_guard lock(worker.mutex);
+        if (worker.tasks.empty()) return nullptr;
+
+        Task* task = worker.tasks.front();
+        worker.tasks.pop_front();
+        --m_queued;
+        return task;
+    };
+
+    for (size_t i = 1; i < m_workers.size(); ++i) {
+        if (Task* task = takeOldest(*m_workers[(self + i) % m_workers.size()])) return task;
+    }
+    return takeOldest(m_submitted);
+}
@@ -0,0 +1,65 @@
+#ifndef FORKJOIN_H
+#define FORKJOIN_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool for recursive fork-join work. Every worker keeps its own deque of forked tasks, runs the newest
+// itself and lets idle workers steal the oldest, which are the largest parts of a recursive split.
+// A worker waiting for a stolen task steals other work meanwhile instead of blocking.
+class ForkJoinPool {
+public:
+    // 0 threads means one per hardware thread
+    explicit ForkJoinPool(size_t threads = 0);
+    ~ForkJoinPool();
+
+    ForkJoinPool(const ForkJoinPool&) = delete;
+    ForkJoinPool& operator=(const ForkJoinPool&) = delete;
+
+    // Runs root on the pool and waits for it, exceptions are rethrown here
+    void run(const std::function<void()>& root);
+    // Runs a and b, possibly in parallel, and returns once both are done. Only valid inside run().
+    // If both throw, the exception of a is rethrown.
+    void invoke(const std::function<void()>& a, const std::function<void()>& b);
+
+    size_t size() const { return m_workers.size(); }
+private:
+    struct Task {
+        const std::function<void()>* function;
+        std::exception_ptr error;
+        std::atomic<bool> done = false;
+        // Submitted by run() rather than forked
+        bool root = false;
+    };
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task*> tasks;
+    };
+
+    void workerLoop(size_t index);
+    void execute(Task& task);
+    void push(size_t worker, Task* task);
+    // Oldest task of any worker but self, or of the tasks submitted by run()
+    Task* steal(size_t self);
+private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    Worker m_submitted;
+
+    // Tasks in all deques, idle workers sleep while there are none
+    std::atomic<size_t> m_queued = 0;
+    std::mutex m_idleMutex;
+    std::condition_variable m_idle;
+    std::condition_variable m_finished;
+    std::atomic<bool> m_stopping = false;
+};
+
+#endif
@@ -2,10 +2,13 @@
 
 #include <sstream>
 #include <iostream>
+#include <format>
+#include <ranges>
 
 std::string TokenTypeToString(TokenType type) {
     switch (type) {
         case TokenType::number:     return "Number";
+        case TokenType::constant:   return "Constant";
         case TokenType::variable:   return "Variable";
         case TokenType::plus:       return "Plus";
         case TokenType::minus:      return "Minus";
@@ -21,8 +24,19 @@ std::string TokenTypeToString(TokenType type) {
         case TokenType::atan:       return "Arctangent";
         case TokenType::log:        return "Log";
         case TokenType::ln:         return "Ln";
+        case TokenType::sum:        return "Sum";
+        case TokenType::mean:       return "Mean";
+        case TokenType::stdev:      return "Standard deviation";
+        case TokenType::min:        return "Min";
+        case TokenType::max:        return "Max";
+        case TokenType::dot:        return "Dot";
+        case TokenType::matmul:     return "Matmul";
+        case TokenType::function:   return "Function";
         case TokenType::lParen:     return "Left parenthesis";
         case TokenType::rParen:     return "Right parenthesis";
+        case TokenType::lBracket:   return "Left bracket";
+        case TokenType::rBracket:   return "Right bracket";
+        case TokenType::comma:      return "Comma";
         case TokenType::equals:     return "Equals";
         case TokenType::end:        return "End";
         case TokenType::unknown:    return "Unknown";
@@ -48,12 +62,38 @@ std::optional<int> binPrec(const TokenType type) {
         case TokenType::atan:
         case TokenType::log:
         case TokenType::ln:
+        case TokenType::sum:
+        case TokenType::mean:
+        case TokenType::stdev:
+        case TokenType::min:
+        case TokenType::max:
+        case TokenType::dot:
+        case TokenType::matmul:
+        case TokenType::function:
             return 3;
         default:
             return std::nullopt;
     }
 }
 
+std::string roundString(std::string str) {
+    if (str.find(".") == static_cast<size_t>(-1)) return str;
+    
+    auto buf = str;
+
+    for (auto& c : std::ranges::reverse_view(str)) {
+        if (c == '0') buf.pop_back();
+        else break;
+    }
+    if (buf.back() == '.') buf.pop_back();
+
+    return buf;
+}
+
+std::string formatNumber(number_t value) {
+    return roundString(std::format("{:.5f}", value));
+}
+
 void printTokens(std::vector<Token> tokens) {
     std::stringstream ss;
     for (auto token : tokens) {
@@ -79,6 +119,13 @@ void printAST(NodeExpr* expr, int indent) {
             if (num->lit && num->lit->value.has_value()) std::cout << num->lit->value.value();
             std::cout << '\n';
         }
+        else if (std::holds_alternative<NodeTermConstant*>(term->var)) {
+            auto constant = std::get<NodeTermConstant*>(term->var);
+            printIndent(indent);
+            std::cout << "Constant: ";
+            if (constant->name && constant->name->value.has_value()) std::cout << constant->name->value.value();
+            std::cout << '\n';
+        }
         else if (std::holds_alternative<NodeTermVariable*>(term->var)) {
             auto var = std::get<NodeTermVariable*>(term->var);
             printIndent(indent);
@@ -92,6 +139,12 @@ void printAST(NodeExpr* expr, int indent) {
             std::cout << "Paren" << '\n';
             printAST(paren->expr, indent + 4);
         }
+        else if (std::holds_alternative<NodeTermList*>(term->var)) {
+            auto list = std::get<NodeTermList*>(term->var);
+            printIndent(indent);
+            std::cout << "List" << '\n';
+            for (auto element : list->elements) printAST(element, indent + 4);
+        }
     }
     else if (std::holds_alternative<NodeBinExpr*>(expr->var)) {
         NodeBinExpr* bin = std::get<NodeBinExpr*>(expr->var);
@@ -163,5 +216,47 @@ void printAST(NodeExpr* expr, int indent) {
             printIndent(indent); std::cout << "Arctangent" << '\n';
             printAST(n->expr, indent + 4);
         }
+        else if (std::holds_alternative<NodeBinExprSum*>(func->var)) {
+            auto n = std::get<NodeBinExprSum*>(func->var);
+            printIndent(indent); std::cout << "Sum" << '\n';
+            printAST(n->expr, indent + 4);
+        }
+        else if (std::holds_alternative<NodeBinExprMean*>(func->var)) {
+            auto n = std::get<NodeBinExprMean*>(func->var);
+            printIndent(indent); std::cout << "Mean" << '\n';
+            printAST(n->expr, indent + 4);
+        }
+        else if (std::holds_alternative<NodeBinExprStdev*>(func->var)) {
+            auto n = std::get<NodeBinExprStdev*>(func->var);
+            printIndent(indent); std::cout << "Standard deviation" << '\n';
+            printAST(n->expr, indent + 4);
+        }
+        else if (std::holds_alternative<NodeBinExprMin*>(func->var)) {
+            auto n = std::get<NodeBinExprMin*>(func->var);
+            printIndent(indent); std::cout << "Min" << '\n';
+            printAST(n->expr, indent + 4);
+        }
+        else if (std::holds_alternative<NodeBinExprMax*>(func->var)) {
+            auto n = std::get<NodeBinExprMax*>(func->var);
+            printIndent(indent); std::cout << "Max" << '\n';
+            printAST(n->expr, indent + 4);
+        }
+        else if (std::holds_alternative<NodeBinExprDot*>(func->var)) {
+            auto n = std::get<NodeBinExprDot*>(func->var);
+            printIndent(indent); std::cout << "Dot" << '\n';
+            printAST(n->lhs, indent + 4);
+            printAST(n->rhs, indent + 4);
+        }
+        else if (std::holds_alternative<NodeBinExprMatmul*>(func->var)) {
+            auto n = std::get<NodeBinExprMatmul*>(func->var);
+            printIndent(indent); std::cout << "Matmul" << '\n';
+            printAST(n->lhs, indent + 4);
+            printAST(n->rhs, indent + 4);
+        }
+        else if (std::holds_alternative<NodeBinExprCall*>(func->var)) {
+            auto n = std::get<NodeBinExprCall*>(func->var);
+            printIndent(indent); std::cout << "Call: " << n->name->value.value() << '\n';
+            for (auto arg : n->args) printAST(arg, indent + 4);
+        }
     }
 }
\ No newline at end of file
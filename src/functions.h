@@ -1,6 +1,7 @@
 #ifndef TRANSLATOR_H
 #define TRANSLATOR_H
 
+#include "types.h"
 #include "lexer.h"
 #include "parser.h"
 
@@ -11,6 +12,9 @@
 std::string TokenTypeToString(TokenType type);
 std::optional<int> binPrec(const TokenType type);
 
+std::string roundString(std::string str);
+std::string formatNumber(number_t value);
+
 void printTokens(std::vector<Token> tokens);
 void printAST(NodeExpr* expr, int indent = 0);
 
@@ -1,12 +1,10 @@
 
 #include "lexer.h"
-#include "types.h"
 
 #include <cctype>
 #include <cstdlib>
 #include <iostream>
-#include <numbers>
-#include <sstream>
+#include <stdexcept>
 
 std::vector<Token> Lexer::tokenize() {
 	while (peek().has_value()) m_tokens.push_back(tokenizeOne());
@@ -34,7 +32,8 @@ Token Lexer::tokenizeOne() {
 		while (peek().has_value() && std::isdigit(peek().value()))
 			buf.push_back(consume());
 		
-		if (peek().has_value() && (peek().value() == '.' || peek().value() == ',')) {
+		bool decimalComma = m_bracketDepth == 0 && peek().has_value() && peek().value() == ',' && peek(1).has_value() && std::isdigit(peek(1).value());
+		if (peek().has_value() && (peek().value() == '.' || decimalComma)) {
 			if (peek().value() == ',') {
  				buf.push_back('.');
 				consume();
@@ -51,9 +50,17 @@ Token Lexer::tokenizeOne() {
 		return Token{ .type = TokenType::number, .value = buf };
 	}
 	else if (std::isalpha(c.value())) { // \sin or sin?  || c == '\\'
-		std::ostringstream value;
-		value.precision(constants::precision);
-		value << std::fixed;
+		// Subscripted names like x_1 or k_max, needed once a model has more than a few dozen variables
+		if (peek(1).has_value() && peek(1).value() == '_') {
+			buf.push_back(consume());
+			buf.push_back(consume());
+			while (peek().has_value() && std::isalnum(peek().value()))
+				buf.push_back(consume());
+
+			if (buf.size() == 2) throw std::runtime_error("Expected subscript after _ in variable name");
+			if (m_isFunction && m_isFunction(buf)) return Token{ .type = TokenType::function, .value = buf };
+			return Token{ .type = TokenType::variable, .value = buf };
+		}
 
 		if (consumeIf("sqrt")) return Token{ .type = TokenType::sqrt };
 		else if (consumeIf("sin")) return Token{ .type = TokenType::sin };
@@ -64,25 +71,61 @@ Token Lexer::tokenizeOne() {
 		else if (consumeIf("atan")) return Token{ .type = TokenType::atan };
 		else if (consumeIf("log")) return Token{ .type = TokenType::log };
 		else if (consumeIf("ln")) return Token{ .type = TokenType::ln };
-
-		else if (consumeIf("pi")) {
-			value << constants::pi;
-			return Token { .type = TokenType::number, .value = std::move(value).str() };
-		}
-		else if (consumeIf("e")) return Token { .type = TokenType::number, .value = std::to_string(std::numbers::e)};
-		else if (consumeIf("phi")) return Token { .type = TokenType::number, .value = std::to_string(std::numbers::phi)};
-		else if (consumeIf("tau")) return Token { .type = TokenType::number, .value = std::to_string(constants::pi * 2)};
+		else if (consumeIf("sum")) return Token{ .type = TokenType::sum };
+		else if (consumeIf("mean")) return Token{ .type = TokenType::mean };
+		else if (consumeIf("stdev")) return Token{ .type = TokenType::stdev };
+		else if (consumeIf("min")) return Token{ .type = TokenType::min };
+		else if (consumeIf("max")) return Token{ .type = TokenType::max };
+		else if (consumeIf("dot")) return Token{ .type = TokenType::dot };
+		else if (consumeIf("matmul")) return Token{ .type = TokenType::matmul };
+
+		// Constants stay named so every evaluator can use its own precision for them
+		else if (consumeIf("pi")) return Token{ .type = TokenType::constant, .value = "pi" };
+		else if (consumeIf("e")) return Token{ .type = TokenType::constant, .value = "e" };
+		else if (consumeIf("phi")) return Token{ .type = TokenType::constant, .value = "phi" };
+		else if (consumeIf("tau")) return Token{ .type = TokenType::constant, .value = "tau" };
 
 		else if (consumeIf("ans")) return Token{ .type = TokenType::variable, .value = "ans" };
 
 		buf.push_back(consume());
+		if (m_isFunction && m_isFunction(buf)) return Token{ .type = TokenType::function, .value = buf };
 		return Token{ .type = TokenType::variable, .value = buf };
 	}
 	
 	switch (consume()) {
 		case '=': return Token{ .type = TokenType::equals };
-		case '(': return Token{ .type = TokenType::lParen };
-		case ')': return Token{ .type = TokenType::rParen };
+		case '(': {
+			// Arguments of functions are separated by commas like the elements of a list
+			bool arguments = false;
+			if (!m_tokens.empty()) {
+				switch (m_tokens.back().type) {
+					case TokenType::function:
+					case TokenType::sum:
+					case TokenType::mean:
+					case TokenType::stdev:
+					case TokenType::min:
+					case TokenType::max:
+					case TokenType::dot:
+					case TokenType::matmul:
+						arguments = true;
+						break;
+					default:
+						break;
+				}
+			}
+			m_argumentParens.push_back(arguments);
+			if (arguments) ++m_bracketDepth;
+			return Token{ .type = TokenType::lParen };
+		}
+		case ')':
+			if (!m_argumentParens.empty()) {
+				if (m_argumentParens.back()) --m_bracketDepth;
+				m_argumentParens.pop_back();
+			}
+			return Token{ .type = TokenType::rParen };
+		case '[': ++m_bracketDepth; return Token{ .type = TokenType::lBracket };
+		case ']': --m_bracketDepth; return Token{ .type = TokenType::rBracket };
+		case ',': return Token{ .type = TokenType::comma };
 		case '+': return Token{ .type = TokenType::plus };
 		case '-': return Token{ .type = TokenType::minus };
 		case '*': return Token{ .type = TokenType::multiply };
@@ -93,21 +136,21 @@ Token Lexer::tokenizeOne() {
 }
 
 void Lexer::implicitMulConvert() {
-	std::vector<TokenType> functions = {TokenType::sqrt, TokenType::sin, TokenType::cos, TokenType::tan, TokenType::asin, TokenType::acos, TokenType::atan, TokenType::log, TokenType::ln};
+	std::vector<TokenType> functions = {TokenType::sqrt, TokenType::sin, TokenType::cos, TokenType::tan, TokenType::asin, TokenType::acos, TokenType::atan, TokenType::log, TokenType::ln, TokenType::sum, TokenType::mean, TokenType::stdev, TokenType::min, TokenType::max, TokenType::dot, TokenType::matmul, TokenType::function};
 
 	for (size_t i = 0; i + 1 < m_tokens.size(); ) {
 		auto curr = m_tokens.at(i);
 		auto next = m_tokens.at(i + 1);
 
-		if (curr.type == TokenType::minus && next.type != TokenType::number && (i == 0 || (m_tokens.at(i - 1).type != TokenType::number && m_tokens.at(i - 1).type != TokenType::variable && m_tokens.at(i - 1).type != TokenType::rParen))) {
+		if (curr.type == TokenType::minus && next.type != TokenType::number && (i == 0 || (m_tokens.at(i - 1).type != TokenType::number && m_tokens.at(i - 1).type != TokenType::constant && m_tokens.at(i - 1).type != TokenType::variable && m_tokens.at(i - 1).type != TokenType::rParen && m_tokens.at(i - 1).type != TokenType::rBracket))) {
 		    m_tokens.at(i) = Token { .type = TokenType::number, .value = "-1" };
 		    m_tokens.insert(m_tokens.begin() + i + 1, Token{ .type = TokenType::multiply });
 		    i += 2;
 		    continue;
 		}
 
-		bool currIsNumOrVarOrRParenOrFunc = (curr.type == TokenType::number || curr.type == TokenType::variable || curr.type == TokenType::rParen);
-		bool nextIsVarOrNumOrLParenOrFunc = (next.type == TokenType::variable || next.type == TokenType::number || next.type == TokenType::lParen);
+		bool currIsNumOrVarOrRParenOrFunc = (curr.type == TokenType::number || curr.type == TokenType::constant || curr.type == TokenType::variable || curr.type == TokenType::rParen || curr.type == TokenType::rBracket);
+		bool nextIsVarOrNumOrLParenOrFunc = (next.type == TokenType::variable || next.type == TokenType::number || next.type == TokenType::constant || next.type == TokenType::lParen || next.type == TokenType::lBracket);
 
 		for (auto function : functions) {
 			if (currIsNumOrVarOrRParenOrFunc && next.type == function) {
@@ -1,12 +1,14 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <optional>
 
 enum class TokenType {
     number,
+    constant,
     variable,
     plus,
     minus,
@@ -23,8 +25,19 @@ enum class TokenType {
     log,
     logn,
     ln,
+    sum,
+    mean,
+    stdev,
+    min,
+    max,
+    dot,
+    matmul,
+    function,
     lParen,
     rParen,
+    lBracket,
+    rBracket,
+    comma,
     equals,
     end,
     unknown
@@ -37,7 +50,9 @@ struct Token {
 
 class Lexer {
 public:
-    explicit Lexer(const std::string& src) : m_fileContents(src) {}
+    // Names for which isFunction is true are lexed as calls of user functions instead of variables
+    explicit Lexer(const std::string& src, std::function<bool(const std::string&)> isFunction = nullptr)
+        : m_fileContents(src), m_isFunction(std::move(isFunction)) {}
     std::vector<Token> tokenize();
 private:
     Token tokenizeOne();
@@ -50,8 +65,13 @@ private:
     
 private:
     std::string m_fileContents;
+    std::function<bool(const std::string&)> m_isFunction;
     std::vector<Token> m_tokens;
     size_t m_currIndex = 0;
+    // Inside brackets a comma always separates elements instead of being a decimal point
+    int m_bracketDepth = 0;
+    // For every open parenthesis, whether it holds the arguments of a function
+    std::vector<bool> m_argumentParens;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "linear.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+// Columns factored per panel of the dense LU, the trailing update reuses each panel row this often
+constexpr size_t panelColumns = 64;
+// Columns of the trailing matrix updated at once, a panel's rows of them stay in L2
+constexpr size_t updateColumns = 256;
+// Smaller systems are always dense, there is nothing to gain from the bookkeeping
+constexpr size_t minSparseUnknowns = 64;
+// Matrices with at most one nonzero in this many coefficients are solved sparsely
+constexpr size_t sparseRatio = 10;
+// A sparse pivot may be this much smaller than the largest candidate if its row has fewer nonzeros
+constexpr number_t pivotThreshold = 0.1;
+
+[[noreturn]] void singular() {
+    throw std::runtime_error("System is singular, the equations do not determine every unknown");
+}
+
+// Pivots this small relative to the matrix are rounding noise of a zero
+number_t pivotTolerance(number_t largest, size_t n) {
+    return largest * static_cast<number_t>(n) * std::numeric_limits<number_t>::epsilon();
+}
+}
+
+LinearSystem::LinearSystem(std::vector<std::string> unknowns, std::function<bool(const std::string&)> isDefined)
+    : m_unknowns(std::move(unknowns)), m_fixedUnknowns(!m_unknowns.empty()), m_isDefined(std::move(isDefined)) {
+    for (uint32_t i = 0; i < m_unknowns.size(); ++i) {
+        if (!m_unknownIndex.try_emplace(m_unknowns[i], i).second) throw std::runtime_error("Unknown " + m_unknowns[i] + " is listed twice");
+    }
+    m_coefficients.resize(m_unknowns.size());
+}
+
+void LinearSystem::add(NodeExpr* lhs, NodeExpr* rhs, const std::function<Value(const std::string&)>& lookup, const calculateExpr::CallHandler& call) {
+    // An equation that threw halfway leaves its coefficients behind
+    for (uint32_t index : m_touched) m_coefficients[index] = 0;
+    m_touched.clear();
+    m_constant = 0;
+    m_lookup = &lookup;
+    m_call = &call;
+
+    accumulate(lhs, 1);
+    accumulate(rhs, -1);
+
+    std::ranges::sort(m_touched);
+    m_touched.erase(std::unique(m_touched.begin(), m_touched.end()), m_touched.end());
+    SparseRow row;
+    row.reserve(m_touched.size());
+    for (uint32_t index : m_touched) {
+        if (m_coefficients[index] != 0) row.emplace_back(index, m_coefficients[index]);
+        m_coefficients[index] = 0;
+    }
+    m_touched.clear();
+
+    m_rows.push_back(std::move(row));
+    m_rhs.push_back(-m_constant);
+}
+
+std::vector<number_t> LinearSystem::solve() const {
+    size_t n = m_unknowns.size();
+    if (m_rows.size() != n) {
+        throw std::runtime_error(std::to_string(m_rows.size()) + " equations cannot determine " + std::to_string(n) + " unknowns, there must be as many of each");
+    }
+
+    size_t nonzeros = 0;
+    for (const auto& row : m_rows) nonzeros += row.size();
+    if (n >= minSparseUnknowns && nonzeros * sparseRatio <= n * n) return linear::solveSparse(m_rows, m_rhs, n);
+
+    std::vector<number_t> a(n * n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        for (auto [j, coefficient] : m_rows[i]) a[i * n + j] = coefficient;
+    }
+    std::vector<number_t> b = m_rhs;
+    linear::solveDense(a, b, n);
+    return b;
+}
+
+void LinearSystem::accumulate(NodeExpr* expr, number_t scale) {
+    if (auto term = std::get_if<NodeTerm*>(&expr->var)) {
+        if (auto var = std::get_if<NodeTermVariable*>(&(*term)->var)) {
+            const std::string& name = (*var)->ident->value.value();
+            if (isUnknown(name)) {
+                uint32_t index = unknownIndex(name);
+                m_touched.push_back(index);
+                m_coefficients[index] += scale;
+                return;
+            }
+        }
+        else if (auto paren = std::get_if<NodeTermParen*>(&(*term)->var)) {
+            accumulate((*paren)->expr, scale);
+            return;
+        }
+    }
+    else if (auto bin = std::get_if<NodeBinExpr*>(&expr->var)) {
+        if (auto n = std::get_if<NodeBinExprAdd*>(&(*bin)->var)) {
+            accumulate((*n)->lhs, scale);
+            accumulate((*n)->rhs, scale);
+            return;
+        }
+        if (auto n = std::get_if<NodeBinExprSub*>(&(*bin)->var)) {
+            accumulate((*n)->lhs, scale);
+            accumulate((*n)->rhs, -scale);
+            return;
+        }
+        // Products and quotients are linear if all but one factor are constants
+        if (auto n = std::get_if<NodeBinExprMul*>(&(*bin)->var)) {
+            if (auto factor = constant((*n)->lhs)) {
+                accumulate((*n)->rhs, scale * factor.value());
+                return;
+            }
+            if (auto factor = constant((*n)->rhs)) {
+                accumulate((*n)->lhs, scale * factor.value());
+                return;
+            }
+        }
+        else if (auto n = std::get_if<NodeBinExprDiv*>(&(*bin)->var)) {
+            if (auto divisor = constant((*n)->rhs)) {
+                accumulate((*n)->lhs, scale / divisor.value());
+                return;
+            }
+        }
+        else if (auto n = std::get_if<NodeBinExprPow*>(&(*bin)->var)) {
+            if (auto exp = constant((*n)->rhs); exp && exp.value() == 1) {
+                accumulate((*n)->lhs, scale);
+                return;
+            }
+        }
+    }
+
+    auto value = constant(expr);
+    if (!value) throw std::runtime_error("Equation " + std::to_string(m_rows.size() + 1) + " is not linear in its unknowns");
+    m_constant += scale * value.value();
+}
+
+std::optional<number_t> LinearSystem::constant(NodeExpr* expr) {
+    bool dependsOnUnknown = false;
+    try {
+        Value value = calculateExpr::evalValue(expr, [&](const std::string& name) {
+            if (isUnknown(name)) {
+                dependsOnUnknown = true;
+                return Value();
+            }
+            return (*m_lookup)(name);
+        }, *m_call);
+        if (dependsOnUnknown) return std::nullopt;
+
+        return value.scalar();
+    }
+    catch (const std::runtime_error&) {
+        // Unknowns stand in as 0 while looking for them, which may not be a valid argument
+        if (dependsOnUnknown) return std::nullopt;
+        throw;
+    }
+}
+
+bool LinearSystem::isUnknown(const std::string& name) const {
+    if (m_unknownIndex.contains(name)) return true;
+    return !m_fixedUnknowns && !(m_isDefined && m_isDefined(name));
+}
+
+uint32_t LinearSystem::unknownIndex(const std::string& name) {
+    auto [it, inserted] = m_unknownIndex.try_emplace(name, static_cast<uint32_t>(m_unknowns.size()));
+    if (inserted) {
+        m_unknowns.push_back(name);
+        m_coefficients.push_back(0);
+    }
+    return it->second;
+}
+
+namespace linear {
+    void solveDense(std::span<number_t> a, std::span<number_t> b, size_t n) {
+        auto at = [&](size_t i, size_t j) -> number_t& { return a[i * n + j]; };
+        number_t largest = 0;
+        for (number_t x : a.first(n * n)) largest = std::max(largest, std::abs(x));
+        number_t tolerance = pivotTolerance(largest, n);
+        if (largest == 0 && n > 0) singular();
+
+        for (size_t k0 = 0; k0 < n; k0 += panelColumns) {
+            size_t k1 = std::min(k0 + panelColumns, n);
+
+            // Panel: unblocked LU of columns k0..k1, whole rows are swapped so b follows the pivots
+            for (size_t k = k0; k < k1; ++k) {
+                size_t pivot = k;
+                for (size_t i = k + 1; i < n; ++i) {
+                    if (std::abs(at(i, k)) > std::abs(at(pivot, k))) pivot = i;
+                }
+                if (std::abs(at(pivot, k)) <= tolerance) singular();
+                if (pivot != k) {
+                    std::swap_ranges(a.begin() + pivot * n, a.begin() + (pivot + 1) * n, a.begin() + k * n);
+                    std::swap(b[pivot], b[k]);
+                }
+
+                number_t inverse = 1 / at(k, k);
+                for (size_t i = k + 1; i < n; ++i) {
+                    number_t l = at(i, k) *= inverse;
+                    for (size_t j = k + 1; j < k1; ++j) at(i, j) -= l * at(k, j);
+                }
+            }
+
+            // Rows of U right of the panel, then the trailing matrix minus L21 U12 a tile of columns at a time
+            for (size_t k = k0; k < k1; ++k) {
+                for (size_t i = k + 1; i < k1; ++i) {
+                    number_t l = at(i, k);
+                    for (size_t j = k1; j < n; ++j) at(i, j) -= l * at(k, j);
+                }
+            }
+            for (size_t j0 = k1; j0 < n; j0 += updateColumns) {
+                size_t j1 = std::min(j0 + updateColumns, n);
+                for (size_t i = k1; i < n; ++i) {
+                    number_t* row = &at(i, 0);
+                    size_t k = k0;
+                    // Four pivot rows per pass load and store each element of row a quarter as often
+                    for (; k + 4 <= k1; k += 4) {
+                        number_t l0 = row[k], l1 = row[k + 1], l2 = row[k + 2], l3 = row[k + 3];
+                        const number_t* p0 = &at(k, 0);
+                        const number_t* p1 = p0 + n;
+                        const number_t* p2 = p1 + n;
+                        const number_t* p3 = p2 + n;
+                        for (size_t j = j0; j < j1; ++j) row[j] -= l0 * p0[j] + l1 * p1[j] + l2 * p2[j] + l3 * p3[j];
+                    }
+                    for (; k < k1; ++k) {
+                        number_t l = row[k];
+                        const number_t* pivotRow = &at(k, 0);
+                        for (size_t j = j0; j < j1; ++j) row[j] -= l * pivotRow[j];
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < i; ++j) b[i] -= at(i, j) * b[j];
+        }
+        for (size_t i = n; i-- > 0; ) {
+            for (size_t j = i + 1; j < n; ++j) b[i] -= at(i, j) * b[j];
+            b[i] /= at(i, i);
+        }
+    }
+
+    std::vector<number_t> solveSparse(std::vector<SparseRow> rows, std::vector<number_t> b, size_t n) {
+        number_t largest = 0;
+        std::vector<std::vector<uint32_t>> columnRows(n);
+        for (uint32_t r = 0; r < rows.size(); ++r) {
+            for (auto [column, coefficient] : rows[r]) {
+                columnRows[column].push_back(r);
+                largest = std::max(largest, std::abs(coefficient));
+            }
+        }
+        number_t tolerance = pivotTolerance(largest, n);
+
+        // Rows not yet used as a pivot have no entries left of the current column, so an entry in
+        // it is their first one
+        std::vector<bool> used(rows.size());
+        std::vector<uint32_t> pivots(n);
+        std::vector<uint32_t> candidates;
+        SparseRow merged;
+        for (uint32_t k = 0; k < n; ++k) {
+            candidates.clear();
+            number_t best = 0;
+            for (uint32_t r : columnRows[k]) {
+                if (used[r] || rows[r].empty() || rows[r].front().first != k) continue;
+                candidates.push_back(r);
+                best = std::max(best, std::abs(rows[r].front().second));
+            }
+            if (best <= tolerance) singular();
+            std::ranges::sort(candidates);
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+            uint32_t pivot = candidates.front();
+            for (uint32_t r : candidates) {
+                bool eligible = std::abs(rows[r].front().second) >= pivotThreshold * best;
+                if (eligible && (std::abs(rows[pivot].front().second) < pivotThreshold * best || rows[r].size() < rows[pivot].size())) pivot = r;
+            }
+            used[pivot] = true;
+            pivots[k] = pivot;
+
+            const SparseRow& pivotRow = rows[pivot];
+            for (uint32_t r : candidates) {
+                if (r == pivot) continue;
+
+                // rows[r] - factor * pivotRow, both sorted and without column k
+                number_t factor = rows[r].front().second / pivotRow.front().second;
+                const SparseRow& row = rows[r];
+                merged.clear();
+                size_t i = 1, j = 1;
+                while (i < row.size() || j < pivotRow.size()) {
+                    if (j == pivotRow.size() || (i < row.size() && row[i].first < pivotRow[j].first)) merged.push_back(row[i++]);
+                    else if (i == row.size() || pivotRow[j].first < row[i].first) {
+                        columnRows[pivotRow[j].first].push_back(r);
+                        merged.emplace_back(pivotRow[j].first, -factor * pivotRow[j].second);
+                        ++j;
+                    }
+                    else {
+                        number_t value = row[i].second - factor * pivotRow[j].second;
+                        if (value != 0) merged.emplace_back(row[i].first, value);
+                        ++i;
+                        ++j;
+                    }
+                }
+                rows[r].swap(merged);
+                b[r] -= factor * b[pivot];
+            }
+        }
+
+        std::vector<number_t> x(n);
+        for (uint32_t k = n; k-- > 0; ) {
+            const SparseRow& row = rows[pivots[k]];
+            number_t sum = b[pivots[k]];
+            for (size_t i = 1; i < row.size(); ++i) sum -= row[i].second * x[row[i].first];
+            x[k] = sum / row.front().second;
+        }
+        return x;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef LINEAR_H
+#define LINEAR_H
+
+#include "types.h"
+#include "parser.h"
+#include "calculate.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Nonzero coefficients of one equation by unknown index, sorted by index
+using SparseRow = std::vector<std::pair<uint32_t, number_t>>;
+
+// Simultaneous linear equations in named unknowns, collected from parsed equations and solved at once
+class LinearSystem {
+public:
+    // Without unknowns every variable of the equations that isDefined rejects is one, in order of
+    // appearance. Defined variables are read through lookup like any other constant.
+    explicit LinearSystem(std::vector<std::string> unknowns = {}, std::function<bool(const std::string&)> isDefined = nullptr);
+
+    // Adds lhs = rhs, throws if it is not linear in the unknowns. Every other variable and every call
+    // is evaluated through lookup and call like evalValue does.
+    void add(NodeExpr* lhs, NodeExpr* rhs, const std::function<Value(const std::string&)>& lookup, const calculateExpr::CallHandler& call = {});
+
+    const std::vector<std::string>& unknowns() const { return m_unknowns; }
+    size_t equations() const { return m_rows.size(); }
+
+    // Values of the unknowns in the order of unknowns(). Mostly zero coefficient matrices are
+    // eliminated sparsely, the rest by dense LU. Throws unless there is exactly one solution.
+    std::vector<number_t> solve() const;
+private:
+    // Adds scale * expr to the equation being collected
+    void accumulate(NodeExpr* expr, number_t scale);
+    // Value of expr if it does not depend on an unknown
+    std::optional<number_t> constant(NodeExpr* expr);
+    uint32_t unknownIndex(const std::string& name);
+    bool isUnknown(const std::string& name) const;
+private:
+    std::vector<std::string> m_unknowns;
+    std::unordered_map<std::string, uint32_t> m_unknownIndex;
+    bool m_fixedUnknowns;
+    std::function<bool(const std::string&)> m_isDefined;
+
+    std::vector<SparseRow> m_rows;
+    std::vector<number_t> m_rhs;
+
+    // Only used while adding an equation, a dense accumulator with the unknowns it touched
+    std::vector<number_t> m_coefficients;
+    std::vector<uint32_t> m_touched;
+    number_t m_constant = 0;
+    const std::function<Value(const std::string&)>* m_lookup = nullptr;
+    const calculateExpr::CallHandler* m_call = nullptr;
+};
+
+namespace linear {
+    // Solves a x = b for the n by n row-major matrix a by LU with partial pivoting, blocked so the
+    // trailing update works from cache. a and b are overwritten, b with the solution.
+    void solveDense(std::span<number_t> a, std::span<number_t> b, size_t n);
+
+    // Same for a matrix given by its rows. Eliminates column by column and pivots on the sparsest
+    // row among those whose coefficient is close to the largest, which keeps fill-in low.
+    std::vector<number_t> solveSparse(std::vector<SparseRow> rows, std::vector<number_t> b, size_t n);
+}
+
+#endif
@@ -4,7 +4,7 @@
 #include <math.h>
 #include <ranges>
 #include <algorithm>
-#include <format>
+#include <vector>
 #include <chrono>
 
 #include "types.h"
@@ -13,43 +13,86 @@
 #include "parser.h"
 #include "calculate.h"
 #include "cas.h"
+#include "commands.h"
+#include "server.h"
+#include "mapper.h"
 
-std::string roundString(std::string str) {
-    if (str.find(".") == static_cast<size_t>(-1)) return str;
-    
-    auto buf = str;
+void printUsage() {
+    std::cerr << "Usage: CAS                                  interactive prompt\n"
+              << "       CAS --serve <address> [--threads n]  serve the prompt over a local socket\n"
+              << "                                            address is a Unix socket path or host:port\n"
+              << "       CAS --map <formula> <input.csv> [--output path] [--threads n] [--load snapshot] [--tolerance t]\n"
+              << "                                            apply a formula to every row of a CSV file\n";
+}
 
-    for (auto& c : std::ranges::reverse_view(str)) {
-        if (c == '0') buf.pop_back();
-        else break;
-    }
-    if (buf.back() == '.') buf.pop_back();
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
 
-    return buf;
-}
+    if (!args.empty()) {
+        try {
+            if (args[0] == "--serve" && (args.size() == 2 || (args.size() == 4 && args[2] == "--threads"))) {
+                size_t threads = args.size() == 4 ? std::stoul(args[3]) : 0;
+                Server server(args[1], threads);
+                server.run();
+                return 0;
+            }
+            if (args[0] == "--map" && args.size() >= 3 && args.size() % 2 == 1) {
+                CAS cas;
+                std::string output;
+                size_t threads = 0;
+                number_t tolerance = 0;
+                for (size_t i = 3; i < args.size(); i += 2) {
+                    if (args[i] == "--output") output = args[i + 1];
+                    else if (args[i] == "--threads") threads = std::stoul(args[i + 1]);
+                    else if (args[i] == "--load") cas.load(args[i + 1]);
+                    else if (args[i] == "--tolerance") tolerance = std::stold(args[i + 1]);
+                    else {
+                        printUsage();
+                        return 1;
+                    }
+                }
+
+                CsvMapper mapper(cas, args[1], threads, tolerance);
+                size_t rows = mapper.run(args[2], output);
+                if (!output.empty()) std::cerr << "Wrote " << rows << " rows to " << output << '\n';
+                if (tolerance > 0) {
+                    const auto& counts = mapper.precisionCounts();
+                    std::cerr << counts.doubleRows << " rows in double, " << counts.longDoubleRows << " in long double, "
+                              << counts.preciseRows << " in multiprecision, " << counts.unresolvedRows << " unresolved\n";
+                }
+                return 0;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+
+        printUsage();
+        return 1;
+    }
 
-int main() {
     CAS cas;
 
     while (true) {
         try {
             std::cout << "Eval: ";
             std::string eq;
-            std::getline(std::cin, eq);
+            if (!std::getline(std::cin, eq)) break;
 
             //auto start = std::chrono::system_clock::now();
-            auto [var, res] = cas.calc(eq);
+            auto result = runCommand(cas, eq);
             //auto end = std::chrono::system_clock::now();
 
             //auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
             //std::cout << "Calc took:" << elapsed << std::endl;
 
-            std::cout << var << " = " << roundString(std::format("{:.5f}", res)) << '\n' << std::endl;
+            std::cout << result << '\n' << std::endl;
         }
         catch(const std::exception& e) {
             std::cerr << '\n' << e.what() << '\n';
         }
     }
-    
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,265 @@
+#include "mapper.h"
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Input bytes per task, large enough to amortize scheduling and small enough to keep every thread busy
+constexpr size_t chunkBytes = 4 << 20;
+// Chunks in flight per thread, bounds memory while the writer catches up
+constexpr size_t chunksPerThread = 2;
+constexpr size_t outputBufferSize = 1 << 20;
+
+// Read-only view of a whole file, mapped where the platform allows it
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view text() const { return std::string_view(m_data, m_size); }
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+#if defined(_WIN32)
+    std::string m_buffer;
+#endif
+};
+
+MappedFile::MappedFile(const std::string& path) {
+#if defined(_WIN32)
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot open " + path);
+    m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot read " + path);
+    }
+    m_size = static_cast<size_t>(st.st_size);
+    if (m_size == 0) {
+        ::close(fd);
+        return;
+    }
+
+    void* mapping = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) throw std::runtime_error("Cannot map " + path);
+
+    // Every chunk is read front to back exactly once
+    ::madvise(mapping, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(mapping);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#if !defined(_WIN32)
+    if (m_data) ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+}
+
+std::string_view trim(std::string_view field) {
+    auto first = field.find_first_not_of(" \t\r\"");
+    if (first == std::string_view::npos) return {};
+    auto last = field.find_last_not_of(" \t\r\"");
+    return field.substr(first, last - first + 1);
+}
+
+struct ChunkResult {
+    std::string text;
+    size_t rows = 0;
+    PrecisionCounts counts;
+};
+
+// What a chunk needs to know about the columns, shared read-only by every task
+struct Layout {
+    std::string_view text;
+    const CompiledExpr* expr;
+    // Symbol bound to each field of a row, npos for fields the formula does not read
+    std::vector<size_t> fieldSymbols;
+    size_t fieldsNeeded;
+    // Value of every symbol that is not a column
+    std::vector<number_t> constants;
+    std::vector<bool> isColumn;
+    // Relative tolerance of evaluateAdaptive, 0 evaluates every row in long double
+    number_t tolerance;
+
+    ChunkResult map(size_t begin, size_t end) const;
+    [[noreturn]] void fail(const char* position, const std::string& message) const;
+};
+
+ChunkResult Layout::map(size_t begin, size_t end) const {
+    std::vector<std::vector<number_t>> columns(constants.size());
+    size_t rows = 0;
+    const char* pos = text.data() + begin;
+    const char* stop = text.data() + end;
+
+    while (pos < stop) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(pos, '\n', stop - pos));
+        if (!lineEnd) lineEnd = stop;
+        if (trim(std::string_view(pos, lineEnd - pos)).empty()) {
+            pos = lineEnd + 1;
+            continue;
+        }
+
+        const char* field = pos;
+        for (size_t index = 0; index < fieldsNeeded; ++index) {
+            if (field > lineEnd) fail(pos, "has fewer columns than the header");
+            const char* fieldEnd = static_cast<const char*>(std::memchr(field, ',', lineEnd - field));
+            if (!fieldEnd) fieldEnd = lineEnd;
+
+            if (size_t symbol = fieldSymbols[index]; symbol != std::string_view::npos) {
+                // Read as double like literals at the prompt, which is also much faster than long double
+                std::string_view value = trim(std::string_view(field, fieldEnd - field));
+                double number = 0;
+                auto [parsed, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+                if (value.empty() || error != std::errc() || parsed != value.data() + value.size()) {
+                    fail(pos, "has \"" + std::string(value) + "\" where a number is expected");
+                }
+                columns[symbol].push_back(number);
+            }
+            field = fieldEnd + 1;
+        }
+        ++rows;
+        pos = lineEnd + 1;
+    }
+
+    ChunkResult result;
+    result.rows = rows;
+    if (rows == 0) return result;
+
+    std::vector<std::span<const number_t>> spans(constants.size());
+    for (size_t symbol = 0; symbol < spans.size(); ++symbol) {
+        spans[symbol] = isColumn[symbol] ? std::span<const number_t>(columns[symbol]) : std::span<const number_t>(&constants[symbol], 1);
+    }
+    std::vector<number_t> values(result.rows);
+    if (tolerance > 0) result.counts = expr->evaluateAdaptive(spans, values, Tolerance{ .relative = tolerance });
+    else expr->evaluateBatch(spans, values);
+
+    // Shortest text that reads back as the same double, columns are rarely more precise than that
+    result.text.reserve(result.rows * 12);
+    char buffer[64];
+    for (number_t value : values) {
+        auto [last, error] = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<double>(value));
+        result.text.append(buffer, last);
+        result.text.push_back('\n');
+    }
+    return result;
+}
+
+void Layout::fail(const char* position, const std::string& message) const {
+    size_t line = std::count(text.data(), position, '\n') + 1;
+    throw std::runtime_error("Line " + std::to_string(line) + " " + message);
+}
+}
+
+CsvMapper::CsvMapper(CAS& cas, const std::string& formula, size_t threads, number_t tolerance)
+    : m_cas(cas), m_expr(cas.compile(formula)), m_threads(threads), m_tolerance(tolerance) {
+    if (tolerance < 0) throw std::runtime_error("Tolerance must not be negative");
+    auto equals = formula.find('=');
+    m_name = equals == std::string::npos ? "ans" : std::string(trim(std::string_view(formula).substr(0, equals)));
+    if (m_name.empty()) throw std::runtime_error("Left hand side should be a variable but isn't");
+}
+
+size_t CsvMapper::run(const std::string& inputPath, const std::string& outputPath) {
+    MappedFile input(inputPath);
+    std::string_view text = input.text();
+    m_counts = {};
+
+    size_t headerEnd = std::min(text.find('\n'), text.size());
+    std::vector<std::string_view> header;
+    for (size_t pos = 0; pos <= headerEnd; ) {
+        size_t comma = std::min(text.find(',', pos), headerEnd);
+        header.push_back(trim(text.substr(pos, comma - pos)));
+        pos = comma + 1;
+    }
+    if (header.size() == 1 && header[0].empty()) throw std::runtime_error(inputPath + " has no header line");
+
+    // Columns first, the remaining symbols are variables of the session
+    const auto& symbols = m_expr->symbols();
+    Layout layout{ .text = text, .expr = m_expr.get(), .fieldSymbols = {}, .fieldsNeeded = 0, .constants = std::vector<number_t>(symbols.size()), .isColumn = std::vector<bool>(symbols.size()), .tolerance = m_tolerance };
+    layout.fieldSymbols.assign(header.size(), std::string_view::npos);
+    for (size_t symbol = 0; symbol < symbols.size(); ++symbol) {
+        auto field = std::ranges::find(header, symbols[symbol]);
+        if (field != header.end()) {
+            size_t index = field - header.begin();
+            layout.fieldSymbols[index] = symbol;
+            layout.fieldsNeeded = std::max(layout.fieldsNeeded, index + 1);
+            layout.isColumn[symbol] = true;
+        }
+        else if (auto value = m_cas.variables().get(symbols[symbol])) layout.constants[symbol] = value.value();
+        else throw std::runtime_error("Variable " + symbols[symbol] + " is neither a column of " + inputPath + " nor defined");
+    }
+
+    // Chunks end after a newline so no row is split between two of them
+    std::vector<std::pair<size_t, size_t>> chunks;
+    for (size_t begin = std::min(headerEnd + 1, text.size()); begin < text.size(); ) {
+        size_t end = std::min(begin + chunkBytes, text.size());
+        if (end < text.size()) end = std::min(text.find('\n', end), text.size() - 1) + 1;
+        chunks.emplace_back(begin, end);
+        begin = end;
+    }
+
+    std::ofstream output;
+    std::vector<char> outputBuffer;
+    std::ostream* out = &std::cout;
+    if (!outputPath.empty()) {
+        outputBuffer.resize(outputBufferSize);
+        output.rdbuf()->pubsetbuf(outputBuffer.data(), outputBuffer.size());
+        output.open(outputPath, std::ios::binary | std::ios::trunc);
+        if (!output) throw std::runtime_error("Cannot open " + outputPath);
+        out = &output;
+    }
+    *out << m_name << '\n';
+
+    ThreadPool pool(m_threads);
+    std::deque<std::future<ChunkResult>> inFlight;
+    size_t next = 0, rows = 0;
+    auto submit = [&] {
+        auto [begin, end] = chunks[next++];
+        inFlight.push_back(pool.submit([&layout, begin, end] { return layout.map(begin, end); }));
+    };
+
+    while (next < chunks.size() && inFlight.size() < pool.size() * chunksPerThread) submit();
+    while (!inFlight.empty()) {
+        ChunkResult result = inFlight.front().get();
+        inFlight.pop_front();
+        if (next < chunks.size()) submit();
+
+        out->write(result.text.data(), result.text.size());
+        rows += result.rows;
+        m_counts.doubleRows += result.counts.doubleRows;
+        m_counts.longDoubleRows += result.counts.longDoubleRows;
+        m_counts.preciseRows += result.counts.preciseRows;
+        m_counts.unresolvedRows += result.counts.unresolvedRows;
+    }
+
+    out->flush();
+    if (!*out) throw std::runtime_error("Cannot write " + (outputPath.empty() ? std::string("output") : outputPath));
+    return rows;
+}
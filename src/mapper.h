@@ -0,0 +1,32 @@
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include "cas.h"
+
+#include <cstddef>
+#include <string>
+
+// Applies a formula like "y = a*x + b" to every row of a CSV file whose first line names the columns.
+// Columns are bound to the variables of the same name, every other variable keeps its value in cas.
+// The input is memory-mapped and split into chunks that are parsed and evaluated in parallel, the
+// results are written in row order as a single column headed by the assigned name.
+class CsvMapper {
+public:
+    // 0 threads means one per hardware thread. With a relative tolerance rows are evaluated in double
+    // and only those that need it in higher precision, see CompiledExpr::evaluateAdaptive.
+    CsvMapper(CAS& cas, const std::string& formula, size_t threads = 0, number_t tolerance = 0);
+
+    // Writes to stdout if outputPath is empty. Returns the number of rows.
+    size_t run(const std::string& inputPath, const std::string& outputPath);
+    // Rows of the last run by precision, only counted with a tolerance
+    const PrecisionCounts& precisionCounts() const { return m_counts; }
+private:
+    CAS& m_cas;
+    std::string m_name;
+    SharedExpr m_expr;
+    size_t m_threads;
+    number_t m_tolerance;
+    PrecisionCounts m_counts;
+};
+
+#endif
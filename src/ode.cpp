@@ -0,0 +1,352 @@
+#include "ode.h"
+
+#include "functions.h"
+#include "linear.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+// Step size control: steps shrink or grow by at most these factors and aim a little below the tolerance
+constexpr number_t minFactor = 0.2;
+constexpr number_t maxFactor = 10;
+constexpr number_t safety = 0.9;
+// Error norms below this count as this, a zero error would otherwise ask for an infinite step
+constexpr number_t minNorm = 1e-10;
+// Steps this small relative to t no longer advance it
+constexpr number_t minRelativeStep = 1e-14;
+
+// Dormand-Prince 5(4) tableau, the seventh stage is the derivative at the new point and the first of the next step
+constexpr number_t dpC[7] = { 0, 1.0L / 5, 3.0L / 10, 4.0L / 5, 8.0L / 9, 1, 1 };
+constexpr number_t dpA[7][6] = {
+    {},
+    { 1.0L / 5 },
+    { 3.0L / 40, 9.0L / 40 },
+    { 44.0L / 45, -56.0L / 15, 32.0L / 9 },
+    { 19372.0L / 6561, -25360.0L / 2187, 64448.0L / 6561, -212.0L / 729 },
+    { 9017.0L / 3168, -355.0L / 33, 46732.0L / 5247, 49.0L / 176, -5103.0L / 18656 },
+    { 35.0L / 384, 0, 500.0L / 1113, 125.0L / 192, -2187.0L / 6784, 11.0L / 84 },
+};
+// Difference of the fifth and fourth order weights
+constexpr number_t dpE[7] = { 71.0L / 57600, 0, -71.0L / 16695, 71.0L / 1920, -17253.0L / 339200, 22.0L / 525, -1.0L / 40 };
+// Fourth order continuous extension of Hairer's DOPRI5
+constexpr number_t dpD[7] = { -12715105075.0L / 11282082432, 0, 87487479700.0L / 32700410799, -10690763975.0L / 1880347072,
+                              701980252875.0L / 199316789632, -1453857185.0L / 822651844, 69997945.0L / 29380423 };
+
+// ROS2, second order and L-stable, with linearly implicit Euler as the embedded first order method
+const number_t rosGamma = 1 + 1 / std::sqrt(2.0L);
+
+// Root mean square of values scaled by the tolerance of each state
+number_t errorNorm(std::span<const number_t> error, std::span<const number_t> y, std::span<const number_t> yNew, const OdeOptions& options) {
+    number_t sum = 0;
+    for (size_t i = 0; i < error.size(); ++i) {
+        number_t scale = options.absoluteTolerance + options.relativeTolerance * std::max(std::abs(y[i]), std::abs(yNew[i]));
+        sum += (error[i] / scale) * (error[i] / scale);
+    }
+    return error.empty() ? 0 : std::sqrt(sum / error.size());
+}
+
+number_t stepFactor(number_t norm, number_t order) {
+    return std::clamp(safety * std::pow(std::max(norm, minNorm), -1 / (order + 1)), minFactor, maxFactor);
+}
+
+// Hairer's first guess, a step over which the solution changes by about a hundredth of itself
+number_t initialStep(std::span<const number_t> y, std::span<const number_t> dy, number_t span, const OdeOptions& options) {
+    number_t size = errorNorm(y, y, y, options), slope = errorNorm(dy, y, y, options);
+    number_t h = size < 1e-5L || slope < 1e-5L ? 1e-6L : 0.01L * size / slope;
+    return std::min(h, span);
+}
+
+// Fills in the evenly spaced samples that fall into each accepted step
+class Sampler {
+public:
+    Sampler(std::span<const number_t> initial, number_t t0, number_t t1, size_t samples) : m_t0(t0), m_t1(t1), m_samples(samples) {
+        m_trajectory.times.reserve(samples + 1);
+        m_trajectory.states.reserve((samples + 1) * initial.size());
+        m_trajectory.times.push_back(t0);
+        m_trajectory.states.insert(m_trajectory.states.end(), initial.begin(), initial.end());
+    }
+
+    // interpolate(theta, out) writes the state at tOld + theta * (tNew - tOld)
+    template<typename F>
+    void step(number_t tOld, number_t tNew, F&& interpolate) {
+        size_t n = m_trajectory.states.size() / m_trajectory.times.size();
+        while (m_next <= m_samples && (tNew > tOld ? time(m_next) <= tNew : time(m_next) >= tNew)) {
+            size_t row = m_trajectory.states.size();
+            m_trajectory.states.resize(row + n);
+            interpolate((time(m_next) - tOld) / (tNew - tOld), std::span(m_trajectory.states).subspan(row, n));
+            m_trajectory.times.push_back(time(m_next++));
+        }
+    }
+
+    Trajectory& trajectory() { return m_trajectory; }
+private:
+    // The last sample is t1 itself rather than a rounded sum
+    number_t time(size_t i) const { return i == m_samples ? m_t1 : m_t0 + (m_t1 - m_t0) * i / m_samples; }
+private:
+    Trajectory m_trajectory;
+    number_t m_t0;
+    number_t m_t1;
+    size_t m_samples;
+    size_t m_next = 1;
+};
+}
+
+OdeSystem::OdeSystem(std::vector<std::string> states, std::vector<SharedExpr> derivatives,
+                     const std::function<number_t(const std::string&)>& parameter, const std::string& time) : m_states(std::move(states)) {
+    if (m_states.size() != derivatives.size()) throw std::runtime_error("Every state needs exactly one derivative");
+    for (size_t i = 0; i < m_states.size(); ++i) {
+        if (m_states[i] == time) throw std::runtime_error(time + " is the time and cannot be a state");
+        if (std::find(m_states.begin(), m_states.begin() + i, m_states[i]) != m_states.begin() + i) {
+            throw std::runtime_error(m_states[i] + " has more than one derivative");
+        }
+    }
+
+    size_t n = m_states.size();
+    std::vector<std::string> parameters;
+    for (auto& expr : derivatives) {
+        Derivative derivative{ std::move(expr), {} };
+        for (const auto& symbol : derivative.expr->symbols()) {
+            if (auto state = std::ranges::find(m_states, symbol); state != m_states.end()) {
+                derivative.sources.push_back(static_cast<uint32_t>(state - m_states.begin()));
+            }
+            else if (symbol == time) derivative.sources.push_back(static_cast<uint32_t>(n));
+            else {
+                auto known = std::ranges::find(parameters, symbol);
+                if (known == parameters.end()) {
+                    m_parameters.push_back(parameter(symbol));
+                    parameters.push_back(symbol);
+                    known = parameters.end() - 1;
+                }
+                derivative.sources.push_back(static_cast<uint32_t>(n + 1 + (known - parameters.begin())));
+            }
+        }
+        m_derivatives.push_back(std::move(derivative));
+    }
+}
+
+Trajectory OdeSystem::integrate(std::span<const number_t> initial, number_t t0, number_t t1, size_t samples, const OdeOptions& options) const {
+    if (initial.size() != size()) {
+        throw std::runtime_error("Expected " + std::to_string(size()) + " initial values but got " + std::to_string(initial.size()));
+    }
+    if (samples == 0) throw std::runtime_error("Expected at least one sample interval");
+
+    if (t0 == t1) {
+        Sampler sampler(initial, t0, t1, samples);
+        for (size_t i = 0; i < samples; ++i) {
+            sampler.trajectory().times.push_back(t1);
+            sampler.trajectory().states.insert(sampler.trajectory().states.end(), initial.begin(), initial.end());
+        }
+        return std::move(sampler.trajectory());
+    }
+    return options.stiff ? rosenbrock(initial, t0, t1, samples, options) : dormandPrince(initial, t0, t1, samples, options);
+}
+
+std::vector<Trajectory> OdeSystem::integrateBatch(const std::vector<std::vector<number_t>>& initial, number_t t0, number_t t1, size_t samples,
+                                                  const OdeOptions& options, size_t threads) const {
+    std::vector<std::future<Trajectory>> results;
+    results.reserve(initial.size());
+    ThreadPool pool(std::min(threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads, std::max<size_t>(initial.size(), 1)));
+
+    for (const auto& state : initial)
+        results.push_back(pool.submit([this, &state, t0, t1, samples, &options] { return integrate(state, t0, t1, samples, options); }));
+
+    std::vector<Trajectory> trajectories;
+    trajectories.reserve(initial.size());
+    for (auto& result : results) trajectories.push_back(result.get());
+    return trajectories;
+}
+
+OdeSystem::Workspace OdeSystem::workspace() const {
+    size_t symbols = 0;
+    for (const auto& derivative : m_derivatives) symbols = std::max(symbols, derivative.sources.size());
+
+    Workspace work{ std::vector<number_t>(size() + 1), std::vector<number_t>(symbols), std::vector<number_t>(symbols) };
+    work.values.insert(work.values.end(), m_parameters.begin(), m_parameters.end());
+    return work;
+}
+
+void OdeSystem::evaluate(number_t t, std::span<const number_t> y, std::span<number_t> dy, Workspace& work) const {
+    std::copy(y.begin(), y.end(), work.values.begin());
+    work.values[size()] = t;
+
+    for (size_t i = 0; i < m_derivatives.size(); ++i) {
+        const auto& derivative = m_derivatives[i];
+        for (size_t s = 0; s < derivative.sources.size(); ++s) work.slots[s] = work.values[derivative.sources[s]];
+        dy[i] = derivative.expr->evaluate(std::span(work.slots).first(derivative.sources.size()));
+    }
+}
+
+void OdeSystem::jacobian(number_t t, std::span<const number_t> y, std::span<number_t> jacobian, Workspace& work) const {
+    size_t n = size();
+    std::copy(y.begin(), y.end(), work.values.begin());
+    work.values[n] = t;
+    std::ranges::fill(jacobian, 0);
+
+    for (size_t i = 0; i < n; ++i) {
+        const auto& derivative = m_derivatives[i];
+        size_t symbols = derivative.sources.size();
+        for (size_t s = 0; s < symbols; ++s) work.slots[s] = work.values[derivative.sources[s]];
+        derivative.expr->gradient(std::span(work.slots).first(symbols), std::span(work.partials).first(symbols));
+
+        // Parameters are constant, only states and the time have a column
+        for (size_t s = 0; s < symbols; ++s) {
+            if (derivative.sources[s] <= n) jacobian[i * (n + 1) + derivative.sources[s]] += work.partials[s];
+        }
+    }
+}
+
+Trajectory OdeSystem::dormandPrince(std::span<const number_t> initial, number_t t0, number_t t1, size_t samples, const OdeOptions& options) const {
+    size_t n = size();
+    Workspace work = workspace();
+    Sampler sampler(initial, t0, t1, samples);
+    Trajectory& trajectory = sampler.trajectory();
+
+    std::vector<number_t> y(initial.begin(), initial.end()), yNew(n), stage(n), error(n);
+    std::array<std::vector<number_t>, 7> k;
+    for (auto& derivative : k) derivative.resize(n);
+    // Coefficients of the interpolating polynomial of the last accepted step
+    std::array<std::vector<number_t>, 5> dense;
+    for (auto& coefficient : dense) coefficient.resize(n);
+
+    number_t direction = t1 > t0 ? 1 : -1;
+    number_t t = t0;
+    evaluate(t, y, k[0], work);
+    number_t h = direction * initialStep(y, k[0], std::abs(t1 - t0), options);
+
+    while (t != t1) {
+        if (trajectory.steps + trajectory.rejected >= options.maxSteps) {
+            throw std::runtime_error("Integration needed more than " + std::to_string(options.maxSteps) + " steps, the system may be stiff");
+        }
+        number_t tNew = direction * (t + h - t1) >= 0 ? t1 : t + h;
+        h = tNew - t;
+        if (std::abs(h) <= minRelativeStep * std::abs(t)) throw std::runtime_error("Step size vanished at t = " + formatNumber(t));
+
+        for (size_t s = 1; s < 7; ++s) {
+            auto& target = s == 6 ? yNew : stage;
+            for (size_t i = 0; i < n; ++i) {
+                number_t sum = 0;
+                for (size_t j = 0; j < s; ++j) sum += dpA[s][j] * k[j][i];
+                target[i] = y[i] + h * sum;
+            }
+            evaluate(s == 6 ? tNew : t + dpC[s] * h, target, k[s], work);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            number_t sum = 0;
+            for (size_t j = 0; j < 7; ++j) sum += dpE[j] * k[j][i];
+            error[i] = h * sum;
+        }
+
+        number_t norm = errorNorm(error, y, yNew, options);
+        if (norm > 1) {
+            ++trajectory.rejected;
+            h *= std::min<number_t>(1, stepFactor(norm, 4));
+            continue;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            number_t difference = yNew[i] - y[i], slope = h * k[0][i] - difference;
+            number_t sum = 0;
+            for (size_t j = 0; j < 7; ++j) sum += dpD[j] * k[j][i];
+            dense[0][i] = y[i];
+            dense[1][i] = difference;
+            dense[2][i] = slope;
+            dense[3][i] = difference - h * k[6][i] - slope;
+            dense[4][i] = h * sum;
+        }
+        sampler.step(t, tNew, [&](number_t theta, std::span<number_t> out) {
+            number_t rest = 1 - theta;
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = dense[0][i] + theta * (dense[1][i] + rest * (dense[2][i] + theta * (dense[3][i] + rest * dense[4][i])));
+            }
+        });
+
+        ++trajectory.steps;
+        t = tNew;
+        std::swap(y, yNew);
+        std::swap(k[0], k[6]);
+        h *= stepFactor(norm, 4);
+    }
+    return std::move(trajectory);
+}
+
+Trajectory OdeSystem::rosenbrock(std::span<const number_t> initial, number_t t0, number_t t1, size_t samples, const OdeOptions& options) const {
+    // The time is appended as a state with derivative 1, which makes the system autonomous and puts
+    // the partial derivatives by t into the last column of the Jacobian
+    size_t n = size(), m = n + 1;
+    Workspace work = workspace();
+    Sampler sampler(initial, t0, t1, samples);
+    Trajectory& trajectory = sampler.trajectory();
+
+    std::vector<number_t> y(initial.begin(), initial.end()), yNew(n), stage(n), error(n);
+    std::vector<number_t> dy(n), dyNew(n), jacobian(n * m), w(m * m), lu(m * m), k1(m), k2(m);
+
+    number_t direction = t1 > t0 ? 1 : -1;
+    number_t t = t0;
+    evaluate(t, y, dy, work);
+    this->jacobian(t, y, jacobian, work);
+    number_t h = direction * initialStep(y, dy, std::abs(t1 - t0), options);
+
+    while (t != t1) {
+        if (trajectory.steps + trajectory.rejected >= options.maxSteps) {
+            throw std::runtime_error("Integration needed more than " + std::to_string(options.maxSteps) + " steps");
+        }
+        number_t tNew = direction * (t + h - t1) >= 0 ? t1 : t + h;
+        h = tNew - t;
+        if (std::abs(h) <= minRelativeStep * std::abs(t)) throw std::runtime_error("Step size vanished at t = " + formatNumber(t));
+
+        // W = I - gamma h J, the row of the time is that of the identity
+        std::ranges::fill(w, 0);
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < m; ++j) w[i * m + j] = -rosGamma * h * jacobian[i * m + j];
+        }
+        for (size_t i = 0; i < m; ++i) w[i * m + i] += 1;
+
+        // W k1 = f(z), W k2 = f(z + h k1) - 2 k1
+        std::copy(dy.begin(), dy.end(), k1.begin());
+        k1[n] = 1;
+        lu = w;
+        linear::solveDense(lu, k1, m);
+        for (size_t i = 0; i < n; ++i) stage[i] = y[i] + h * k1[i];
+        evaluate(t + h * k1[n], stage, std::span(k2).first(n), work);
+        for (size_t i = 0; i < n; ++i) k2[i] -= 2 * k1[i];
+        k2[n] = 1 - 2 * k1[n];
+        lu = w;
+        linear::solveDense(lu, k2, m);
+
+        for (size_t i = 0; i < n; ++i) {
+            yNew[i] = y[i] + h * (1.5L * k1[i] + 0.5L * k2[i]);
+            error[i] = 0.5L * h * (k1[i] + k2[i]);
+        }
+
+        // The Jacobian stays that of the current point, so a rejected step only refactors W
+        number_t norm = errorNorm(error, y, yNew, options);
+        if (norm > 1) {
+            ++trajectory.rejected;
+            h *= std::min<number_t>(1, stepFactor(norm, 1));
+            continue;
+        }
+
+        // Cubic Hermite interpolation from the values and derivatives at both ends
+        evaluate(tNew, yNew, dyNew, work);
+        sampler.step(t, tNew, [&](number_t theta, std::span<number_t> out) {
+            number_t theta2 = theta * theta, theta3 = theta2 * theta;
+            number_t startWeight = 2 * theta3 - 3 * theta2 + 1, endWeight = 3 * theta2 - 2 * theta3;
+            number_t startSlope = h * (theta3 - 2 * theta2 + theta), endSlope = h * (theta3 - theta2);
+            for (size_t i = 0; i < n; ++i) out[i] = startWeight * y[i] + startSlope * dy[i] + endWeight * yNew[i] + endSlope * dyNew[i];
+        });
+
+        ++trajectory.steps;
+        t = tNew;
+        std::swap(y, yNew);
+        std::swap(dy, dyNew);
+        if (t != t1) this->jacobian(t, y, jacobian, work);
+        h *= stepFactor(norm, 1);
+    }
+    return std::move(trajectory);
+}
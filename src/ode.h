@@ -0,0 +1,74 @@
+#ifndef ODE_H
+#define ODE_H
+
+#include "types.h"
+#include "compiled.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+struct OdeOptions {
+    number_t relativeTolerance = 1e-6;
+    number_t absoluteTolerance = 1e-9;
+    // Linearly implicit Rosenbrock steps with the Jacobian of the right-hand sides, for systems whose
+    // time scales are too far apart for Dormand-Prince to take steps of a useful size
+    bool stiff = false;
+    size_t maxSteps = 1000000;
+};
+
+// States at evenly spaced times, row i of states holds every state at times[i]
+struct Trajectory {
+    std::vector<number_t> times;
+    std::vector<number_t> states;
+    size_t steps = 0;
+    size_t rejected = 0;
+};
+
+// dy_i/dt = f_i(t, y_1, ..., y_n) with compiled right-hand sides. Symbols that are neither a state nor
+// the time are parameters and bound once, so a step only copies values into slots and runs code.
+class OdeSystem {
+public:
+    // derivatives[i] is the derivative of states[i], parameter gives the value of every other symbol
+    OdeSystem(std::vector<std::string> states, std::vector<SharedExpr> derivatives,
+              const std::function<number_t(const std::string&)>& parameter, const std::string& time = "t");
+
+    size_t size() const { return m_states.size(); }
+    const std::vector<std::string>& states() const { return m_states; }
+
+    // Adaptive steps from t0 to t1 sampled at samples + 1 evenly spaced times by dense output, so the
+    // samples do not constrain the step size. t1 may be before t0.
+    Trajectory integrate(std::span<const number_t> initial, number_t t0, number_t t1, size_t samples, const OdeOptions& options = {}) const;
+    // One trajectory per initial state, integrated in parallel. 0 threads means one per hardware thread.
+    std::vector<Trajectory> integrateBatch(const std::vector<std::vector<number_t>>& initial, number_t t0, number_t t1, size_t samples,
+                                           const OdeOptions& options = {}, size_t threads = 0) const;
+private:
+    struct Derivative {
+        SharedExpr expr;
+        // Index of the value of every symbol in the layout of values: the states, the time, the parameters
+        std::vector<uint32_t> sources;
+    };
+    // Buffers of one integration, sized once
+    struct Workspace {
+        std::vector<number_t> values;
+        std::vector<number_t> slots;
+        std::vector<number_t> partials;
+    };
+
+    Workspace workspace() const;
+    void evaluate(number_t t, std::span<const number_t> y, std::span<number_t> dy, Workspace& work) const;
+    // Row-major n by n + 1 matrix of the partial derivatives by every state and, in the last column, by the time
+    void jacobian(number_t t, std::span<const number_t> y, std::span<number_t> jacobian, Workspace& work) const;
+
+    Trajectory dormandPrince(std::span<const number_t> initial, number_t t0, number_t t1, size_t samples, const OdeOptions& options) const;
+    Trajectory rosenbrock(std::span<const number_t> initial, number_t t0, number_t t1, size_t samples, const OdeOptions& options) const;
+private:
+    std::vector<std::string> m_states;
+    std::vector<Derivative> m_derivatives;
+    std::vector<number_t> m_parameters;
+};
+
+#endif
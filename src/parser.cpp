@@ -6,25 +6,37 @@
 
 
 NodeEquals* Parser::parse() {
-    auto exprAns = new NodeExpr;
-    auto termAns = new NodeTerm;
-    auto termVarAns = new NodeTermVariable { .ident = new Token { .type = TokenType::variable, .value = "ans" } };
+    auto exprAns = make(NodeExpr{});
+    auto termAns = make(NodeTerm{});
+    auto termVarAns = make(NodeTermVariable { .ident = make(Token { .type = TokenType::variable, .value = "ans" }) });
     termAns->var = termVarAns;
     exprAns->var = termAns;
 
     if (auto lhs = parseExpr()) {
-        if (peek().has_value() && peek().value().type != TokenType::end) {
+        // Only consumed here, an = left to a nested expression would let "x - y = -2" run on past it
+        if (tryConsume(TokenType::equals) && peek().has_value() && peek().value().type != TokenType::end) {
             if (auto rhs = parseExpr()) {
-                return new NodeEquals { .lhs = lhs.value(), .rhs = rhs.value() };
+                expectEnd();
+                return make(NodeEquals { .lhs = lhs.value(), .rhs = rhs.value() });
             }
         }
-        return new NodeEquals { .lhs = exprAns, .rhs = lhs.value() };
+        expectEnd();
+        return make(NodeEquals { .lhs = exprAns, .rhs = lhs.value() });
     }
     else throw std::runtime_error("Failed to parse statement");
 }
 
+void Parser::expectEnd() {
+    auto token = peek();
+    if (!token.has_value() || token.value().type == TokenType::end) return;
+
+    std::string got = TokenTypeToString(token.value().type);
+    if (token.value().value.has_value()) got += " " + token.value().value.value();
+    throw std::runtime_error("Expected end of expression but got " + got);
+}
+
 std::optional<NodeExpr*> Parser::parseExpr(const int minPrec) {
-    auto exprLhs = new NodeExpr;
+    auto exprLhs = make(NodeExpr{});
     if (isNextFunction()) {
         exprLhs->var = parseFunc().value();
     }
@@ -49,8 +61,8 @@ std::optional<NodeExpr*> Parser::parseExpr(const int minPrec) {
         auto exprRhs = parseExpr(nextMinPrec);
         if (!exprRhs.has_value()) throw std::runtime_error("Expected expression after " + TokenTypeToString(type));
 
-        auto expr = new NodeBinExpr;
-        auto exprRhs2 = new NodeExpr;
+        auto expr = make(NodeBinExpr{});
+        auto exprRhs2 = make(NodeExpr{});
         if (type == TokenType::equals) {
             consume();
             break;
@@ -60,7 +72,7 @@ std::optional<NodeExpr*> Parser::parseExpr(const int minPrec) {
 
             if (isNegativeNumber(exprRhs.value())) throw std::runtime_error("Right side of addition cannot directly be a negative number");
 
-            auto binExpr = new NodeBinExprAdd{ .lhs = exprRhs2, .rhs = exprRhs.value() };
+            auto binExpr = make(NodeBinExprAdd{ .lhs = exprRhs2, .rhs = exprRhs.value() });
             expr->var = binExpr;
         }
         else if (type == TokenType::minus) {
@@ -68,7 +80,7 @@ std::optional<NodeExpr*> Parser::parseExpr(const int minPrec) {
 
             if (isNegativeNumber(exprRhs.value())) throw std::runtime_error("Right side of subtraction cannot directly be a negative number");
 
-            auto binExpr = new NodeBinExprSub{ .lhs = exprRhs2, .rhs = exprRhs.value() };
+            auto binExpr = make(NodeBinExprSub{ .lhs = exprRhs2, .rhs = exprRhs.value() });
             expr->var = binExpr;
         }
         else if (type == TokenType::multiply) {
@@ -76,7 +88,7 @@ std::optional<NodeExpr*> Parser::parseExpr(const int minPrec) {
 
             if (isNegativeNumber(exprRhs.value())) throw std::runtime_error("Right side of multiplication cannot directly be a negative number");
 
-            auto binExpr = new NodeBinExprMul{ .lhs = exprRhs2, .rhs = exprRhs.value() };
+            auto binExpr = make(NodeBinExprMul{ .lhs = exprRhs2, .rhs = exprRhs.value() });
             expr->var = binExpr;
         }
         else if (type == TokenType::divide) {
@@ -84,7 +96,7 @@ std::optional<NodeExpr*> Parser::parseExpr(const int minPrec) {
 
             if (isNegativeNumber(exprRhs.value())) throw std::runtime_error("Right side of division cannot directly be a negative number");
 
-            auto binExpr = new NodeBinExprDiv{ .lhs = exprRhs2, .rhs = exprRhs.value() };
+            auto binExpr = make(NodeBinExprDiv{ .lhs = exprRhs2, .rhs = exprRhs.value() });
             expr->var = binExpr;
         }
         else if (type == TokenType::power) {
@@ -92,7 +104,7 @@ std::optional<NodeExpr*> Parser::parseExpr(const int minPrec) {
 
             if (isNegativeNumber(exprRhs.value())) throw std::runtime_error("Right side of power cannot directly be a negative number");
 
-            auto binExpr = new NodeBinExprPow{ .lhs = exprRhs2, .rhs = exprRhs.value() };
+            auto binExpr = make(NodeBinExprPow{ .lhs = exprRhs2, .rhs = exprRhs.value() });
             expr->var = binExpr;
         }
         else throw std::runtime_error("Unexpected binary operator " + TokenTypeToString(type));
@@ -100,9 +112,6 @@ std::optional<NodeExpr*> Parser::parseExpr(const int minPrec) {
         exprLhs->var = expr;
     }
 
-    if (peek().has_value() && peek().value().type == TokenType::equals) {
-        consume();
-    }
     return exprLhs;
 }
 
@@ -119,30 +128,47 @@ std::optional<NodeTerm*> Parser::parseTerm() {
         std::string value = literal.value.has_value() ? literal.value.value() : std::string();
         value = std::string("-") + value;
 
-        auto termLit = new NodeTermNumber;
-        Token* tokenCopy = new Token(literal);
+        auto termLit = make(NodeTermNumber{});
+        Token* tokenCopy = make(Token(literal));
         tokenCopy->value = value;
         termLit->lit = tokenCopy;
-        return new NodeTerm{ termLit };
+        return make(NodeTerm{ termLit });
     }
     else if (auto lit = tryConsume(TokenType::number)) {
-        auto termLit = new NodeTermNumber;
-        termLit->lit = new Token(lit.value());
-        return new NodeTerm{ termLit };
+        auto termLit = make(NodeTermNumber{});
+        termLit->lit = make(Token(lit.value()));
+        return make(NodeTerm{ termLit });
+    }
+    else if (auto constant = tryConsume(TokenType::constant)) {
+        auto termConstant = make(NodeTermConstant{});
+        termConstant->name = make(Token(constant.value()));
+        return make(NodeTerm{ termConstant });
     }
     else if (auto ident = tryConsume(TokenType::variable)) {
-        auto termIdent = new NodeTermVariable;
-        termIdent->ident = new Token(ident.value());
-        return new NodeTerm{ termIdent };
+        auto termIdent = make(NodeTermVariable{});
+        termIdent->ident = make(Token(ident.value()));
+        return make(NodeTerm{ termIdent });
     }
     else if (auto lParen = tryConsume(TokenType::lParen)) {
         auto expr = parseExpr();
         if (!expr.has_value()) throw std::runtime_error("Expected expression after left parenthesis");
         if (!tryConsume(TokenType::rParen).has_value())
             throw std::runtime_error("Expected right parenthesis after expression");
-        auto termParen = new NodeTermParen;
+        auto termParen = make(NodeTermParen{});
         termParen->expr = expr.value();
-        return new NodeTerm{ termParen };
+        return make(NodeTerm{ termParen });
+    }
+    else if (auto lBracket = tryConsume(TokenType::lBracket)) {
+        auto termList = make(NodeTermList{});
+        do {
+            auto element = parseExpr();
+            if (!element.has_value()) throw std::runtime_error("Expected expression in list");
+            termList->elements.push_back(element.value());
+        } while (tryConsume(TokenType::comma).has_value());
+
+        if (!tryConsume(TokenType::rBracket).has_value())
+            throw std::runtime_error("Expected right bracket after list elements");
+        return make(NodeTerm{ termList });
     }
     throw std::runtime_error("Expected term but got " + TokenTypeToString(peek().value().type));
 }
@@ -153,57 +179,136 @@ std::optional<NodeExprFunc*> Parser::parseFunc() {
 
     auto type = expr.type;
 
-    auto exprFunc = new NodeExprFunc;
+    auto exprFunc = make(NodeExprFunc{});
 
     if (type == TokenType::sqrt) {
-        auto binExpr = new NodeBinExprSqrt{ .expr = new NodeExpr { .var = parseTerm().value() } };
+        auto binExpr = make(NodeBinExprSqrt{ .expr = make(NodeExpr { .var = parseTerm().value() }) });
         exprFunc->var = binExpr;
         return exprFunc;
     }
     else if (type == TokenType::sin) {
-        auto binExpr = new NodeBinExprSin{ .expr = new NodeExpr { .var = parseTerm().value() } };
+        auto binExpr = make(NodeBinExprSin{ .expr = make(NodeExpr { .var = parseTerm().value() }) });
         exprFunc->var = binExpr;
         return exprFunc;
     }
     else if (type == TokenType::cos) {
-        auto binExpr = new NodeBinExprCos{ .expr = new NodeExpr { .var = parseTerm().value() } };
+        auto binExpr = make(NodeBinExprCos{ .expr = make(NodeExpr { .var = parseTerm().value() }) });
         exprFunc->var = binExpr;
         return exprFunc;
     }
     else if (type == TokenType::tan) {
-        auto binExpr = new NodeBinExprTan{ .expr = new NodeExpr { .var = parseTerm().value() } };
+        auto binExpr = make(NodeBinExprTan{ .expr = make(NodeExpr { .var = parseTerm().value() }) });
         exprFunc->var = binExpr;
         return exprFunc;
     }
     else if (type == TokenType::asin) {
-        auto binExpr = new NodeBinExprAsin{ .expr = new NodeExpr { .var = parseTerm().value() } };
+        auto binExpr = make(NodeBinExprAsin{ .expr = make(NodeExpr { .var = parseTerm().value() }) });
         exprFunc->var = binExpr;
         return exprFunc;
     }
     else if (type == TokenType::acos) {
-        auto binExpr = new NodeBinExprAcos{ .expr = new NodeExpr { .var = parseTerm().value() } };
+        auto binExpr = make(NodeBinExprAcos{ .expr = make(NodeExpr { .var = parseTerm().value() }) });
         exprFunc->var = binExpr;
         return exprFunc;
     }
     else if (type == TokenType::atan) {
-        auto binExpr = new NodeBinExprAtan{ .expr = new NodeExpr { .var = parseTerm().value() } };
+        auto binExpr = make(NodeBinExprAtan{ .expr = make(NodeExpr { .var = parseTerm().value() }) });
         exprFunc->var = binExpr;
         return exprFunc;
     }
     else if (type == TokenType::log) {
-        auto binExpr = new NodeBinExprLog{ .expr = new NodeExpr { .var = parseTerm().value() } };
+        auto binExpr = make(NodeBinExprLog{ .expr = make(NodeExpr { .var = parseTerm().value() }) });
         exprFunc->var = binExpr;
         return exprFunc;
     }
     else if (type == TokenType::ln) {
-        auto binExpr = new NodeBinExprLn{ .expr = new NodeExpr { .var = parseTerm().value() } };
+        auto binExpr = make(NodeBinExprLn{ .expr = make(NodeExpr { .var = parseTerm().value() }) });
         exprFunc->var = binExpr;
         return exprFunc;
     }
 
+    else if (type == TokenType::sum) {
+        exprFunc->var = make(NodeBinExprSum{ .expr = parseReductionArgument() });
+        return exprFunc;
+    }
+    else if (type == TokenType::mean) {
+        exprFunc->var = make(NodeBinExprMean{ .expr = parseReductionArgument() });
+        return exprFunc;
+    }
+    else if (type == TokenType::stdev) {
+        exprFunc->var = make(NodeBinExprStdev{ .expr = parseReductionArgument() });
+        return exprFunc;
+    }
+    else if (type == TokenType::min) {
+        exprFunc->var = make(NodeBinExprMin{ .expr = parseReductionArgument() });
+        return exprFunc;
+    }
+    else if (type == TokenType::max) {
+        exprFunc->var = make(NodeBinExprMax{ .expr = parseReductionArgument() });
+        return exprFunc;
+    }
+    else if (type == TokenType::dot) {
+        auto [lhs, rhs] = parseArgumentPair(type);
+        exprFunc->var = make(NodeBinExprDot{ .lhs = lhs, .rhs = rhs });
+        return exprFunc;
+    }
+    else if (type == TokenType::matmul) {
+        auto [lhs, rhs] = parseArgumentPair(type);
+        exprFunc->var = make(NodeBinExprMatmul{ .lhs = lhs, .rhs = rhs });
+        return exprFunc;
+    }
+
+    else if (type == TokenType::function) {
+        auto call = make(NodeBinExprCall{ .name = make(Token(expr)) });
+        if (!tryConsume(TokenType::lParen).has_value()) throw std::runtime_error("Expected left parenthesis after " + expr.value.value());
+
+        if (!tryConsume(TokenType::rParen).has_value()) {
+            do {
+                auto arg = parseExpr();
+                if (!arg.has_value()) throw std::runtime_error("Expected argument of " + expr.value.value());
+                call->args.push_back(arg.value());
+            } while (tryConsume(TokenType::comma).has_value());
+
+            if (!tryConsume(TokenType::rParen).has_value())
+                throw std::runtime_error("Expected right parenthesis after the arguments of " + expr.value.value());
+        }
+        exprFunc->var = call;
+        return exprFunc;
+    }
+
     return std::nullopt;
 }
 
+NodeExpr* Parser::parseReductionArgument() {
+    if (!peek().has_value() || peek().value().type != TokenType::lParen) return make(NodeExpr{ .var = parseTerm().value() });
+
+    // max(a, b, c) reduces the list [a, b, c], max(v) the value of v itself
+    consume();
+    std::vector<NodeExpr*> args;
+    do {
+        auto arg = parseExpr();
+        if (!arg.has_value()) throw std::runtime_error("Expected argument of reduction");
+        args.push_back(arg.value());
+    } while (tryConsume(TokenType::comma).has_value());
+    if (!tryConsume(TokenType::rParen).has_value()) throw std::runtime_error("Expected right parenthesis after the arguments of reduction");
+
+    if (args.size() == 1) return make(NodeExpr{ .var = make(NodeTerm{ make(NodeTermParen{ .expr = args.front() }) }) });
+    return make(NodeExpr{ .var = make(NodeTerm{ make(NodeTermList{ .elements = std::move(args) }) }) });
+}
+
+std::pair<NodeExpr*, NodeExpr*> Parser::parseArgumentPair(TokenType function) {
+    std::string name = TokenTypeToString(function);
+    if (!tryConsume(TokenType::lParen).has_value()) throw std::runtime_error("Expected left parenthesis after " + name);
+
+    auto lhs = parseExpr();
+    if (!lhs.has_value() || !tryConsume(TokenType::comma).has_value())
+        throw std::runtime_error(name + " expects two arguments separated by a comma");
+    auto rhs = parseExpr();
+    if (!rhs.has_value() || !tryConsume(TokenType::rParen).has_value())
+        throw std::runtime_error("Expected right parenthesis after the arguments of " + name);
+
+    return { lhs.value(), rhs.value() };
+}
 
 std::optional<Token> Parser::peek(int offset) {
     if (m_tokens.size() <= m_currIdx + offset) return std::nullopt;
@@ -245,7 +350,7 @@ bool Parser::isNegativeNumber(NodeExpr* expr) {
 }
 
 bool Parser::isNextFunction() {
-    std::vector<TokenType> functions = {TokenType::sqrt, TokenType::sin, TokenType::cos, TokenType::tan, TokenType::asin, TokenType::acos, TokenType::atan, TokenType::log, TokenType::ln};
+    std::vector<TokenType> functions = {TokenType::sqrt, TokenType::sin, TokenType::cos, TokenType::tan, TokenType::asin, TokenType::acos, TokenType::atan, TokenType::log, TokenType::ln, TokenType::sum, TokenType::mean, TokenType::stdev, TokenType::min, TokenType::max, TokenType::dot, TokenType::matmul, TokenType::function};
 
     if (!peek().has_value()) return false;
 
@@ -1,7 +1,10 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <memory>
+#include <utility>
 #include <variant>
+#include <vector>
 
 #include "lexer.h"
 
@@ -9,6 +12,10 @@ struct NodeTermNumber {
     Token* lit;
 };
 
+struct NodeTermConstant {
+    Token* name;
+};
+
 struct NodeTermVariable {
     Token* ident;
 };
@@ -19,6 +26,11 @@ struct NodeTermParen {
     NodeExpr* expr;
 };
 
+// [a, b, c], a matrix is a list of equally long lists
+struct NodeTermList {
+    std::vector<NodeExpr*> elements;
+};
+
 struct NodeBinExprAdd {
     NodeExpr* lhs;
     NodeExpr* rhs;
@@ -80,13 +92,50 @@ struct NodeBinExprLn {
     NodeExpr* expr;
 };
 
+struct NodeBinExprSum {
+    NodeExpr* expr;
+};
+
+struct NodeBinExprMean {
+    NodeExpr* expr;
+};
+
+struct NodeBinExprStdev {
+    NodeExpr* expr;
+};
+
+struct NodeBinExprMin {
+    NodeExpr* expr;
+};
+
+struct NodeBinExprMax {
+    NodeExpr* expr;
+};
+
+struct NodeBinExprDot {
+    NodeExpr* lhs;
+    NodeExpr* rhs;
+};
+
+struct NodeBinExprMatmul {
+    NodeExpr* lhs;
+    NodeExpr* rhs;
+};
+
+// Call of a user-defined function
+struct NodeBinExprCall {
+    Token* name;
+    std::vector<NodeExpr*> args;
+};
+
 struct NodeBinExprLogn {
     NodeExpr* expr;
     NodeExpr* n;
 };
 
 struct NodeExprFunc {
-    std::variant<NodeBinExprSqrt*, NodeBinExprSin*, NodeBinExprCos*,NodeBinExprTan*, NodeBinExprAsin*, NodeBinExprAcos*, NodeBinExprAtan*, NodeBinExprLog*, NodeBinExprLn*, NodeBinExprLogn*> var;
+    std::variant<NodeBinExprSqrt*, NodeBinExprSin*, NodeBinExprCos*,NodeBinExprTan*, NodeBinExprAsin*, NodeBinExprAcos*, NodeBinExprAtan*, NodeBinExprLog*, NodeBinExprLn*, NodeBinExprLogn*,
+                 NodeBinExprSum*, NodeBinExprMean*, NodeBinExprStdev*, NodeBinExprMin*, NodeBinExprMax*, NodeBinExprDot*, NodeBinExprMatmul*, NodeBinExprCall*> var;
 };
 
 struct NodeBinExpr {
@@ -94,7 +143,7 @@ struct NodeBinExpr {
 };
 
 struct NodeTerm {
-    std::variant<NodeTermNumber*, NodeTermVariable*, NodeTermParen*> var;
+    std::variant<NodeTermNumber*, NodeTermConstant*, NodeTermVariable*, NodeTermParen*, NodeTermList*> var;
 };
 
 struct NodeExpr {
@@ -106,23 +155,47 @@ struct NodeEquals {
     NodeExpr* rhs;
 };
 
+// Owns the nodes of trees, which are all freed with it
+class AstArena {
+public:
+    template<typename T>
+    T* make(T node) {
+        auto owned = new T(std::move(node));
+        m_nodes.emplace_back(owned, [](void* p) { delete static_cast<T*>(p); });
+        return owned;
+    }
+private:
+    std::vector<std::unique_ptr<void, void (*)(void*)>> m_nodes;
+};
+
 class Parser {
 public:
     explicit Parser(const std::vector<Token>& tokens) : m_tokens(tokens) {}
+    // The tree lives as long as the parser or a copy of its arena
     NodeEquals* parse();
+    const std::shared_ptr<AstArena>& arena() const { return m_arena; }
 private:
     std::optional<NodeExpr*> parseExpr(const int minPrec = 0);
     std::optional<NodeTerm*> parseTerm();
     std::optional<NodeExprFunc*> parseFunc();
+    // "(a, b, ...)" of a reduction as one list, or the single term it reduces
+    NodeExpr* parseReductionArgument();
+    // "(lhs, rhs)" of a function with two arguments
+    std::pair<NodeExpr*, NodeExpr*> parseArgumentPair(TokenType function);
+    // Left over tokens would otherwise be dropped, "2 + 3)" evaluating to 5
+    void expectEnd();
 private:
     std::optional<Token> peek(int offset = 0);
     Token consume();
     std::optional<Token> tryConsume(TokenType type);
     bool isNegativeNumber(NodeExpr* expr);
     bool isNextFunction();
+    template<typename T>
+    T* make(T node) { return m_arena->make(std::move(node)); }
 private:
     std::vector<Token> m_tokens;
     size_t m_currIdx = 0;
+    std::shared_ptr<AstArena> m_arena = std::make_shared<AstArena>();
 };
 
 #endif
\ No newline at end of file
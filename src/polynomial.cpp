@@ -0,0 +1,463 @@
+#include "polynomial.h"
+
+#include "functions.h"
+#include "calculate.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace {
+// Largest exponent of a power that is expanded and of any variable in a product
+constexpr uint32_t maxExpandExponent = 1 << 16;
+// Result exponent ranges up to this many slots are accumulated in a flat array instead of a hash map
+constexpr uint64_t maxDenseProductSize = 1 << 20;
+
+std::optional<uint32_t> toExponent(const Polynomial& poly) {
+    if (!poly.isConstant()) return std::nullopt;
+
+    number_t value = poly.coefficient(Monomial{});
+    if (value < 0 || value != std::trunc(value) || value > maxExpandExponent) return std::nullopt;
+
+    return static_cast<uint32_t>(value);
+}
+}
+
+uint32_t Monomial::degree() const {
+    uint32_t sum = 0;
+    for (auto exp : exps) sum += exp;
+    return sum;
+}
+
+size_t MonomialHash::operator()(const Monomial& monomial) const {
+    size_t hash = monomial.exps.size();
+    for (auto exp : monomial.exps) hash ^= exp + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+Polynomial Polynomial::constant(number_t value) {
+    Polynomial poly;
+    if (value != 0) poly.m_terms.emplace(Monomial{}, value);
+    return poly;
+}
+
+Polynomial Polynomial::variable(const std::string& name) {
+    Polynomial poly;
+    poly.m_vars.push_back(name);
+    poly.m_terms.emplace(Monomial{ .exps = { 1 } }, 1);
+    return poly;
+}
+
+std::optional<Polynomial> Polynomial::fromExpr(NodeExpr* expr, bool expand) {
+    if (!expr) return std::nullopt;
+
+    if (std::holds_alternative<NodeTerm*>(expr->var)) {
+        NodeTerm* term = std::get<NodeTerm*>(expr->var);
+        if (std::holds_alternative<NodeTermNumber*>(term->var)) {
+            auto num = std::get<NodeTermNumber*>(term->var);
+            if (num->lit && num->lit->value.has_value()) return constant(std::stold(num->lit->value.value()));
+        }
+        else if (std::holds_alternative<NodeTermConstant*>(term->var)) {
+            if (auto value = constants::value(std::get<NodeTermConstant*>(term->var)->name->value.value())) return constant(value.value());
+        }
+        else if (std::holds_alternative<NodeTermVariable*>(term->var)) {
+            auto var = std::get<NodeTermVariable*>(term->var);
+            if (var->ident && var->ident->value.has_value()) return variable(var->ident->value.value());
+        }
+        else if (std::holds_alternative<NodeTermParen*>(term->var)) {
+            return fromExpr(std::get<NodeTermParen*>(term->var)->expr, expand);
+        }
+    }
+    else if (std::holds_alternative<NodeBinExpr*>(expr->var)) {
+        NodeBinExpr* bin = std::get<NodeBinExpr*>(expr->var);
+        if (std::holds_alternative<NodeBinExprAdd*>(bin->var)) {
+            auto n = std::get<NodeBinExprAdd*>(bin->var);
+            auto lhs = fromExpr(n->lhs, expand);
+            auto rhs = lhs ? fromExpr(n->rhs, expand) : std::nullopt;
+            if (lhs && rhs) return *lhs + *rhs;
+        }
+        else if (std::holds_alternative<NodeBinExprSub*>(bin->var)) {
+            auto n = std::get<NodeBinExprSub*>(bin->var);
+            auto lhs = fromExpr(n->lhs, expand);
+            auto rhs = lhs ? fromExpr(n->rhs, expand) : std::nullopt;
+            if (lhs && rhs) return *lhs - *rhs;
+        }
+        else if (std::holds_alternative<NodeBinExprMul*>(bin->var)) {
+            auto n = std::get<NodeBinExprMul*>(bin->var);
+            auto lhs = fromExpr(n->lhs, expand);
+            auto rhs = lhs ? fromExpr(n->rhs, expand) : std::nullopt;
+            if (!lhs || !rhs) return std::nullopt;
+            if (!expand && lhs->m_terms.size() > 1 && rhs->m_terms.size() > 1) return std::nullopt;
+
+            return *lhs * *rhs;
+        }
+        else if (std::holds_alternative<NodeBinExprDiv*>(bin->var)) {
+            auto n = std::get<NodeBinExprDiv*>(bin->var);
+            auto lhs = fromExpr(n->lhs, expand);
+            auto rhs = lhs ? fromExpr(n->rhs, expand) : std::nullopt;
+            if (!lhs || !rhs || !rhs->isConstant()) return std::nullopt;
+
+            number_t divisor = rhs->coefficient(Monomial{});
+            if (divisor == 0) return std::nullopt;
+
+            return *lhs * (1 / divisor);
+        }
+        else if (std::holds_alternative<NodeBinExprPow*>(bin->var)) {
+            auto n = std::get<NodeBinExprPow*>(bin->var);
+            auto exponent = fromExpr(n->rhs, expand);
+            auto exp = exponent ? toExponent(*exponent) : std::nullopt;
+            if (!exp) return std::nullopt;
+
+            auto base = fromExpr(n->lhs, expand);
+            if (!base) return std::nullopt;
+
+            // -2^2 binds as -(2^2), the same as in calculateExpr::eval
+            if (calculateExpr::isNegativeLiteral(n->lhs)) {
+                return constant(-polynomial::ipow(-base->coefficient(Monomial{}), exp.value()));
+            }
+            if (!expand && base->m_terms.size() > 1 && exp.value() > 1) return std::nullopt;
+
+            return base->pow(exp.value());
+        }
+    }
+
+    return std::nullopt;
+}
+
+Polynomial Polynomial::operator+(const Polynomial& other) const {
+    auto vars = mergeVariables(m_vars, other.m_vars);
+    Polynomial result = withVariables(vars);
+    for (const auto& [monomial, coeff] : other.withVariables(vars).m_terms) result.addTerm(monomial, coeff);
+    result.prune();
+
+    return result;
+}
+
+Polynomial Polynomial::operator-(const Polynomial& other) const {
+    return *this + other * -1;
+}
+
+Polynomial Polynomial::operator*(number_t scalar) const {
+    Polynomial result = *this;
+    for (auto& [monomial, coeff] : result.m_terms) coeff *= scalar;
+    result.prune();
+
+    return result;
+}
+
+Polynomial Polynomial::operator*(const Polynomial& other) const {
+    auto vars = mergeVariables(m_vars, other.m_vars);
+    Polynomial a = withVariables(vars);
+    Polynomial b = other.withVariables(vars);
+
+    Polynomial result;
+    result.m_vars = vars;
+    if (a.m_terms.empty() || b.m_terms.empty()) return Polynomial();
+
+    // Exponent bounds of the product decide between a dense array, packed 64 bit keys or full monomial keys
+    std::vector<uint64_t> bounds(vars.size());
+    for (size_t v = 0; v < vars.size(); ++v) {
+        uint64_t maxA = 0, maxB = 0;
+        for (const auto& [monomial, coeff] : a.m_terms) maxA = std::max<uint64_t>(maxA, monomial.exps[v]);
+        for (const auto& [monomial, coeff] : b.m_terms) maxB = std::max<uint64_t>(maxB, monomial.exps[v]);
+        bounds[v] = maxA + maxB + 1;
+        if (maxA + maxB > maxExpandExponent) {
+            throw std::runtime_error("Exponent of " + vars[v] + " exceeds " + std::to_string(maxExpandExponent));
+        }
+    }
+
+    uint64_t denseSize = 1;
+    unsigned packedBits = 0;
+    for (auto bound : bounds) {
+        denseSize = denseSize > maxDenseProductSize ? denseSize : denseSize * bound;
+        packedBits += std::bit_width(bound - 1);
+    }
+
+    const uint64_t pairs = a.m_terms.size() * b.m_terms.size();
+    if (denseSize <= std::max<uint64_t>(4 * pairs, 1 << 12) && denseSize <= maxDenseProductSize) {
+        // Mixed radix index, multiplying monomials adds their indices
+        auto index = [&](const Monomial& monomial) {
+            uint64_t key = 0;
+            for (size_t v = 0; v < vars.size(); ++v) key = key * bounds[v] + monomial.exps[v];
+            return key;
+        };
+
+        std::vector<std::pair<uint64_t, number_t>> termsB;
+        termsB.reserve(b.m_terms.size());
+        for (const auto& [monomial, coeff] : b.m_terms) termsB.emplace_back(index(monomial), coeff);
+
+        std::vector<number_t> dense(denseSize, 0);
+        for (const auto& [monomial, coeffA] : a.m_terms) {
+            uint64_t keyA = index(monomial);
+            for (const auto& [keyB, coeffB] : termsB) dense[keyA + keyB] += coeffA * coeffB;
+        }
+
+        for (uint64_t key = 0; key < denseSize; ++key) {
+            if (dense[key] == 0) continue;
+
+            Monomial monomial{ .exps = std::vector<uint32_t>(vars.size()) };
+            uint64_t rest = key;
+            for (size_t v = vars.size(); v-- > 0;) {
+                monomial.exps[v] = static_cast<uint32_t>(rest % bounds[v]);
+                rest /= bounds[v];
+            }
+            result.m_terms.emplace(std::move(monomial), dense[key]);
+        }
+    }
+    else if (packedBits <= 64) {
+        std::vector<unsigned> shifts(vars.size());
+        unsigned shift = 0;
+        for (size_t v = 0; v < vars.size(); ++v) {
+            shifts[v] = shift;
+            shift += std::bit_width(bounds[v] - 1);
+        }
+
+        auto pack = [&](const Monomial& monomial) {
+            uint64_t key = 0;
+            for (size_t v = 0; v < vars.size(); ++v) key |= static_cast<uint64_t>(monomial.exps[v]) << shifts[v];
+            return key;
+        };
+
+        std::vector<std::pair<uint64_t, number_t>> termsB;
+        termsB.reserve(b.m_terms.size());
+        for (const auto& [monomial, coeff] : b.m_terms) termsB.emplace_back(pack(monomial), coeff);
+
+        // Fields never carry into each other since every field holds the full exponent bound of the product
+        std::unordered_map<uint64_t, number_t> packed;
+        packed.reserve(std::min<uint64_t>(pairs, maxDenseProductSize));
+        for (const auto& [monomial, coeffA] : a.m_terms) {
+            uint64_t keyA = pack(monomial);
+            for (const auto& [keyB, coeffB] : termsB) packed[keyA + keyB] += coeffA * coeffB;
+        }
+
+        for (const auto& [key, coeff] : packed) {
+            Monomial monomial{ .exps = std::vector<uint32_t>(vars.size()) };
+            for (size_t v = 0; v < vars.size(); ++v) {
+                unsigned bits = std::bit_width(bounds[v] - 1);
+                uint64_t mask = bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+                monomial.exps[v] = static_cast<uint32_t>((key >> shifts[v]) & mask);
+            }
+            result.m_terms.emplace(std::move(monomial), coeff);
+        }
+    }
+    else {
+        for (const auto& [monomialA, coeffA] : a.m_terms) {
+            for (const auto& [monomialB, coeffB] : b.m_terms) {
+                Monomial monomial = monomialA;
+                for (size_t v = 0; v < vars.size(); ++v) monomial.exps[v] += monomialB.exps[v];
+                result.addTerm(monomial, coeffA * coeffB);
+            }
+        }
+    }
+
+    result.prune();
+    return result;
+}
+
+Polynomial Polynomial::pow(uint32_t exp) const {
+    Polynomial result = constant(1);
+    Polynomial base = *this;
+
+    while (exp) {
+        if (exp & 1) result = result * base;
+        exp >>= 1;
+        if (exp) base = base * base;
+    }
+    return result;
+}
+
+bool Polynomial::isConstant() const {
+    return m_vars.empty();
+}
+
+uint32_t Polynomial::degree() const {
+    uint32_t deg = 0;
+    for (const auto& [monomial, coeff] : m_terms) deg = std::max(deg, monomial.degree());
+    return deg;
+}
+
+number_t Polynomial::coefficient(const Monomial& monomial) const {
+    if (auto it = m_terms.find(monomial); it != m_terms.end()) return it->second;
+    return 0;
+}
+
+std::vector<number_t> Polynomial::denseCoefficients() const {
+    if (!isUnivariate()) throw std::runtime_error("Dense coefficients require a univariate polynomial");
+
+    std::vector<number_t> coeffs(degree() + 1, 0);
+    for (const auto& [monomial, coeff] : m_terms) coeffs[monomial.degree()] = coeff;
+
+    return coeffs;
+}
+
+number_t Polynomial::evaluate(number_t x) const {
+    if (!isUnivariate()) throw std::runtime_error("Polynomial has more than one variable");
+    if (m_terms.empty()) return 0;
+    if (isConstant()) return coefficient(Monomial{});
+
+    uint32_t deg = degree();
+    if (m_terms.size() * 4 < deg) {
+        std::vector<std::pair<uint32_t, number_t>> sparse;
+        sparse.reserve(m_terms.size());
+        for (const auto& [monomial, coeff] : m_terms) sparse.emplace_back(monomial.exps.front(), coeff);
+        std::sort(sparse.begin(), sparse.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        return polynomial::sparseHorner(sparse, x);
+    }
+
+    auto coeffs = denseCoefficients();
+    return polynomial::horner(coeffs, x);
+}
+
+number_t Polynomial::evaluate(const std::unordered_map<std::string, number_t>& varTable) const {
+    std::vector<number_t> values;
+    values.reserve(m_vars.size());
+    for (const auto& name : m_vars) {
+        auto it = varTable.find(name);
+        if (it == varTable.end()) throw std::runtime_error("Variable " + name + " does not exist");
+        values.push_back(it->second);
+    }
+
+    if (m_vars.size() == 1) return evaluate(values.front());
+    if (m_vars.empty()) return coefficient(Monomial{});
+
+    // Power tables turn every monomial into a product of lookups
+    std::vector<std::vector<number_t>> powers(m_vars.size());
+    for (const auto& [monomial, coeff] : m_terms) {
+        for (size_t v = 0; v < m_vars.size(); ++v) {
+            auto& table = powers[v];
+            if (table.empty()) table.push_back(1);
+            while (table.size() <= monomial.exps[v]) table.push_back(table.back() * values[v]);
+        }
+    }
+
+    number_t result = 0;
+    for (const auto& [monomial, coeff] : m_terms) {
+        number_t term = coeff;
+        for (size_t v = 0; v < m_vars.size(); ++v) term *= powers[v][monomial.exps[v]];
+        result += term;
+    }
+    return result;
+}
+
+std::string Polynomial::toString() const {
+    if (m_terms.empty()) return "0";
+
+    std::vector<std::pair<Monomial, number_t>> sorted(m_terms.begin(), m_terms.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        auto degA = a.first.degree(), degB = b.first.degree();
+        if (degA != degB) return degA > degB;
+        return a.first.exps > b.first.exps;
+    });
+
+    std::string result;
+    for (const auto& [monomial, coeff] : sorted) {
+        std::string factors;
+        for (size_t v = 0; v < m_vars.size(); ++v) {
+            if (monomial.exps[v] == 0) continue;
+            if (!factors.empty()) factors += "*";
+            factors += m_vars[v];
+            if (monomial.exps[v] > 1) factors += "^" + std::to_string(monomial.exps[v]);
+        }
+
+        number_t magnitude = std::abs(coeff);
+        std::string term;
+        if (factors.empty()) term = formatNumber(magnitude);
+        else if (magnitude == 1) term = factors;
+        else term = formatNumber(magnitude) + "*" + factors;
+
+        if (result.empty()) result = (coeff < 0 ? "-" : "") + term;
+        else result += (coeff < 0 ? " - " : " + ") + term;
+    }
+    return result;
+}
+
+Polynomial Polynomial::withVariables(const std::vector<std::string>& vars) const {
+    if (vars == m_vars) return *this;
+
+    std::vector<size_t> mapping(m_vars.size());
+    for (size_t v = 0; v < m_vars.size(); ++v) {
+        mapping[v] = std::lower_bound(vars.begin(), vars.end(), m_vars[v]) - vars.begin();
+    }
+
+    Polynomial result;
+    result.m_vars = vars;
+    result.m_terms.reserve(m_terms.size());
+    for (const auto& [monomial, coeff] : m_terms) {
+        Monomial mapped{ .exps = std::vector<uint32_t>(vars.size(), 0) };
+        for (size_t v = 0; v < m_vars.size(); ++v) mapped.exps[mapping[v]] = monomial.exps[v];
+        result.m_terms.emplace(std::move(mapped), coeff);
+    }
+    return result;
+}
+
+std::vector<std::string> Polynomial::mergeVariables(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+    std::vector<std::string> merged;
+    merged.reserve(a.size() + b.size());
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(merged));
+
+    return merged;
+}
+
+void Polynomial::addTerm(const Monomial& monomial, number_t coeff) {
+    m_terms[monomial] += coeff;
+}
+
+void Polynomial::prune() {
+    std::erase_if(m_terms, [](const auto& term) { return term.second == 0; });
+
+    std::vector<bool> used(m_vars.size(), false);
+    for (const auto& [monomial, coeff] : m_terms) {
+        for (size_t v = 0; v < m_vars.size(); ++v) used[v] = used[v] || monomial.exps[v] > 0;
+    }
+    if (std::all_of(used.begin(), used.end(), [](bool u) { return u; })) return;
+
+    std::vector<std::string> vars;
+    for (size_t v = 0; v < m_vars.size(); ++v) if (used[v]) vars.push_back(m_vars[v]);
+
+    std::unordered_map<Monomial, number_t, MonomialHash> terms;
+    terms.reserve(m_terms.size());
+    for (const auto& [monomial, coeff] : m_terms) {
+        Monomial reduced;
+        for (size_t v = 0; v < m_vars.size(); ++v) if (used[v]) reduced.exps.push_back(monomial.exps[v]);
+        terms.emplace(std::move(reduced), coeff);
+    }
+
+    m_vars = std::move(vars);
+    m_terms = std::move(terms);
+}
+
+namespace polynomial {
+number_t ipow(number_t base, int64_t exp) {
+    uint64_t n = exp < 0 ? 0 - static_cast<uint64_t>(exp) : static_cast<uint64_t>(exp);
+
+    number_t result = 1;
+    while (n) {
+        if (n & 1) result *= base;
+        n >>= 1;
+        if (n) base *= base;
+    }
+    return exp < 0 ? 1 / result : result;
+}
+
+number_t horner(const std::vector<number_t>& coeffs, number_t x) {
+    number_t result = 0;
+    for (auto it = coeffs.rbegin(); it != coeffs.rend(); ++it) result = result * x + *it;
+
+    return result;
+}
+
+number_t sparseHorner(const std::vector<std::pair<uint32_t, number_t>>& terms, number_t x) {
+    if (terms.empty()) return 0;
+
+    number_t result = 0;
+    uint32_t prevExp = terms.front().first;
+    for (const auto& [exp, coeff] : terms) {
+        result = result * ipow(x, prevExp - exp) + coeff;
+        prevExp = exp;
+    }
+    return result * ipow(x, prevExp);
+}
+}
@@ -0,0 +1,78 @@
+#ifndef POLYNOMIAL_H
+#define POLYNOMIAL_H
+
+#include "types.h"
+#include "parser.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Exponent of every variable of the owning polynomial, in the order of Polynomial::variables()
+struct Monomial {
+    std::vector<uint32_t> exps;
+
+    bool operator==(const Monomial& other) const = default;
+    uint32_t degree() const;
+};
+
+struct MonomialHash {
+    size_t operator()(const Monomial& monomial) const;
+};
+
+class Polynomial {
+public:
+    Polynomial() = default;
+
+    static Polynomial constant(number_t value);
+    static Polynomial variable(const std::string& name);
+
+    // Converts a polynomial subtree. With expand = false only sums of monomials are accepted,
+    // so factored forms like (x+1)^9 are left to the regular evaluator. Throws where the exponent of
+    // a variable would exceed 65536.
+    static std::optional<Polynomial> fromExpr(NodeExpr* expr, bool expand = true);
+
+    Polynomial operator+(const Polynomial& other) const;
+    Polynomial operator-(const Polynomial& other) const;
+    Polynomial operator*(const Polynomial& other) const;
+    Polynomial operator*(number_t scalar) const;
+    Polynomial pow(uint32_t exp) const;
+
+    const std::vector<std::string>& variables() const { return m_vars; }
+    const std::unordered_map<Monomial, number_t, MonomialHash>& terms() const { return m_terms; }
+
+    bool isConstant() const;
+    bool isUnivariate() const { return m_vars.size() <= 1; }
+    uint32_t degree() const;
+    number_t coefficient(const Monomial& monomial) const;
+
+    // Coefficients c[k] of x^k, only valid for univariate polynomials
+    std::vector<number_t> denseCoefficients() const;
+
+    number_t evaluate(number_t x) const;
+    number_t evaluate(const std::unordered_map<std::string, number_t>& varTable) const;
+
+    std::string toString() const;
+private:
+    Polynomial withVariables(const std::vector<std::string>& vars) const;
+    static std::vector<std::string> mergeVariables(const std::vector<std::string>& a, const std::vector<std::string>& b);
+    void addTerm(const Monomial& monomial, number_t coeff);
+    void prune();
+private:
+    std::vector<std::string> m_vars;
+    std::unordered_map<Monomial, number_t, MonomialHash> m_terms;
+};
+
+namespace polynomial {
+    // Binary exponentiation, negative exponents return the reciprocal
+    number_t ipow(number_t base, int64_t exp);
+
+    number_t horner(const std::vector<number_t>& coeffs, number_t x);
+
+    // (exponent, coefficient) pairs sorted by descending exponent
+    number_t sparseHorner(const std::vector<std::pair<uint32_t, number_t>>& terms, number_t x);
+}
+
+#endif
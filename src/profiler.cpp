@@ -0,0 +1,345 @@
+#include "profiler.h"
+
+#include "calculate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+// Nodes listed in each ranking of the report
+constexpr size_t rankedNodes = 10;
+// Calibration times this many batches of empty intervals and keeps the median, as typical as the
+// timing of a real tree
+constexpr int calibrationBatches = 21;
+constexpr int calibrationIntervals = 10000;
+// Time over which timestamp counter ticks are compared to the steady clock
+constexpr auto tickCalibration = std::chrono::milliseconds(20);
+
+// Timestamp counter where there is one, it costs a fraction of reading the clock
+uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+double ticksPerNs() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const double rate = [] {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t first = ticks();
+        while (std::chrono::steady_clock::now() - start < tickCalibration) {}
+        uint64_t last = ticks();
+        return (last - first) / std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }();
+    return rate;
+#else
+    return 1;
+#endif
+}
+
+// What timing a node costs in ticks, inside its own interval and outside it, which is inside its parent's
+struct Overhead {
+    double self;
+    double outside;
+};
+
+Overhead timingOverhead() {
+    static const Overhead overhead = [] {
+        std::vector<double> self, outside;
+        for (int batch = 0; batch < calibrationBatches; ++batch) {
+            // The same steps as Profiler::run with nothing in between
+            uint64_t measured = 0, calls = 0;
+            uint64_t begin = ticks();
+            for (int i = 0; i < calibrationIntervals; ++i) {
+                uint64_t start = ticks();
+                measured += ticks() - start;
+                ++calls;
+            }
+            uint64_t elapsed = ticks() - begin;
+            self.push_back(static_cast<double>(measured) / calls);
+            outside.push_back(static_cast<double>(elapsed - measured) / calls);
+        }
+        auto median = [](std::vector<double>& values) {
+            std::ranges::nth_element(values, values.begin() + values.size() / 2);
+            return values[values.size() / 2];
+        };
+        return Overhead{ .self = median(self), .outside = median(outside) };
+    }();
+    return overhead;
+}
+}
+
+Profiler::Profiler(NodeExpr* expr, const std::function<number_t(const std::string&)>& lookup, const FunctionTable* functions)
+    : m_lookup(&lookup), m_functions(functions) {
+    if (!expr) throw std::runtime_error("Nothing to profile");
+    add(expr, 0, 0);
+    m_lookup = nullptr;
+}
+
+number_t Profiler::evaluate() {
+    return run(0);
+}
+
+uint32_t Profiler::addEntry(Kind kind, std::string label, uint32_t depth, uint32_t parent) {
+    m_entries.push_back(Entry{ .kind = kind, .label = std::move(label), .depth = depth, .parent = parent, .children = {} });
+    return static_cast<uint32_t>(m_entries.size() - 1);
+}
+
+uint32_t Profiler::add(NodeExpr* expr, uint32_t depth, uint32_t parent) {
+    if (auto term = std::get_if<NodeTerm*>(&expr->var)) {
+        if (auto num = std::get_if<NodeTermNumber*>(&(*term)->var)) {
+            std::string text = (*num)->lit && (*num)->lit->value.has_value() ? (*num)->lit->value.value() : "0";
+            uint32_t index = addEntry(Kind::literal, "Number: " + text, depth, parent);
+            m_entries[index].value = std::stod(text);
+            return index;
+        }
+        if (auto constant = std::get_if<NodeTermConstant*>(&(*term)->var)) {
+            const std::string& name = (*constant)->name->value.value();
+            auto value = constants::value(name);
+            if (!value) throw std::runtime_error("Unknown constant " + name);
+            uint32_t index = addEntry(Kind::literal, "Constant: " + name, depth, parent);
+            m_entries[index].value = value.value();
+            return index;
+        }
+        if (auto var = std::get_if<NodeTermVariable*>(&(*term)->var)) {
+            if (!(*var)->ident || !(*var)->ident->value.has_value()) throw std::runtime_error("Variable without a name");
+            const std::string& name = (*var)->ident->value.value();
+
+            // Parameters of the function being inlined shadow variables of the same name
+            auto param = m_params ? std::ranges::find(*m_params, name) : std::vector<std::string>::const_iterator();
+            if (m_params && param != m_params->end()) {
+                uint32_t index = addEntry(Kind::param, "Variable: " + name, depth, parent);
+                m_entries[index].param = static_cast<uint32_t>(param - m_params->begin());
+                return index;
+            }
+            uint32_t index = addEntry(Kind::literal, "Variable: " + name, depth, parent);
+            m_entries[index].value = (*m_lookup)(name);
+            return index;
+        }
+        if (auto paren = std::get_if<NodeTermParen*>(&(*term)->var)) {
+            uint32_t index = addEntry(Kind::paren, "Paren", depth, parent);
+            uint32_t child = add((*paren)->expr, depth + 1, index);
+            m_entries[index].children = { child };
+            return index;
+        }
+        throw std::runtime_error("Vectors cannot be profiled");
+    }
+
+    if (auto bin = std::get_if<NodeBinExpr*>(&expr->var)) {
+        auto [kind, label] = std::visit([](auto n) -> std::pair<Kind, const char*> {
+            using Node = std::remove_pointer_t<decltype(n)>;
+            if constexpr (std::is_same_v<Node, NodeBinExprAdd>) return { Kind::add, "Add" };
+            else if constexpr (std::is_same_v<Node, NodeBinExprSub>) return { Kind::sub, "Sub" };
+            else if constexpr (std::is_same_v<Node, NodeBinExprMul>) return { Kind::mul, "Mul" };
+            else if constexpr (std::is_same_v<Node, NodeBinExprDiv>) return { Kind::div, "Div" };
+            else return { calculateExpr::isNegativeLiteral(n->lhs) ? Kind::powNegLiteral : Kind::pow, "Pow" };
+        }, (*bin)->var);
+        auto [lhs, rhs] = std::visit([](auto n) { return std::make_pair(n->lhs, n->rhs); }, (*bin)->var);
+
+        uint32_t index = addEntry(kind, label, depth, parent);
+        uint32_t left = add(lhs, depth + 1, index);
+        uint32_t right = add(rhs, depth + 1, index);
+        m_entries[index].children = { left, right };
+        return index;
+    }
+
+    NodeExprFunc* func = std::get<NodeExprFunc*>(expr->var);
+    if (auto call = std::get_if<NodeBinExprCall*>(&func->var)) {
+        const std::string& name = (*call)->name->value.value();
+        auto it = m_functions ? m_functions->find(name) : FunctionTable::const_iterator();
+        if (!m_functions || it == m_functions->end()) throw std::runtime_error("Unknown function " + name);
+
+        const FunctionDef& function = it->second;
+        if ((*call)->args.size() != function.arity()) {
+            throw std::runtime_error(name + " takes " + std::to_string(function.arity()) + " arguments but got " + std::to_string((*call)->args.size()));
+        }
+        if (!function.body) throw std::runtime_error(name + " has base cases but no general definition");
+        if (std::ranges::find(m_inlining, name) != m_inlining.end()) throw std::runtime_error("Recursive function " + name + " cannot be profiled");
+
+        uint32_t index = addEntry(Kind::call, "Call: " + name, depth, parent);
+        m_entries[index].function = &function;
+        std::vector<uint32_t> children;
+        for (auto arg : (*call)->args) children.push_back(add(arg, depth + 1, index));
+
+        auto params = std::exchange(m_params, &function.params);
+        m_inlining.push_back(name);
+        children.push_back(add(function.body, depth + 1, index));
+        m_inlining.pop_back();
+        m_params = params;
+
+        m_entries[index].children = std::move(children);
+        return index;
+    }
+
+    auto unary = std::visit([](auto n) -> std::optional<std::tuple<Kind, const char*, NodeExpr*>> {
+        using Node = std::remove_pointer_t<decltype(n)>;
+        if constexpr (std::is_same_v<Node, NodeBinExprSqrt>) return std::tuple(Kind::sqrt, "Sqrt", n->expr);
+        else if constexpr (std::is_same_v<Node, NodeBinExprSin>) return std::tuple(Kind::sin, "Sine", n->expr);
+        else if constexpr (std::is_same_v<Node, NodeBinExprCos>) return std::tuple(Kind::cos, "Cos", n->expr);
+        else if constexpr (std::is_same_v<Node, NodeBinExprTan>) return std::tuple(Kind::tan, "Tan", n->expr);
+        else if constexpr (std::is_same_v<Node, NodeBinExprAsin>) return std::tuple(Kind::asin, "Arcsine", n->expr);
+        else if constexpr (std::is_same_v<Node, NodeBinExprAcos>) return std::tuple(Kind::acos, "Arccosine", n->expr);
+        else if constexpr (std::is_same_v<Node, NodeBinExprAtan>) return std::tuple(Kind::atan, "Arctangent", n->expr);
+        else if constexpr (std::is_same_v<Node, NodeBinExprLog>) return std::tuple(Kind::log, "Log", n->expr);
+        else if constexpr (std::is_same_v<Node, NodeBinExprLn>) return std::tuple(Kind::ln, "Ln", n->expr);
+        else return std::nullopt;
+    }, func->var);
+    if (!unary) throw std::runtime_error("Vector functions cannot be profiled");
+
+    auto [kind, label, operand] = unary.value();
+    uint32_t index = addEntry(kind, label, depth, parent);
+    uint32_t child = add(operand, depth + 1, index);
+    m_entries[index].children = { child };
+    return index;
+}
+
+number_t Profiler::run(uint32_t index) {
+    Entry& entry = m_entries[index];
+    // Too cheap to time with a clock that costs far more, leaves are part of the operation that reads them
+    switch (entry.kind) {
+        case Kind::literal:         ++entry.calls; return entry.value;
+        case Kind::param:           ++entry.calls; return m_frames[m_frameBase + entry.param];
+        case Kind::paren:           ++entry.calls; return run(entry.children[0]);
+        default:                    break;
+    }
+    uint64_t start = ticks();
+
+    number_t result = 0;
+    switch (entry.kind) {
+        case Kind::literal:
+        case Kind::param:
+        case Kind::paren:           break;
+        case Kind::add:             result = run(entry.children[0]) + run(entry.children[1]); break;
+        case Kind::sub:             result = run(entry.children[0]) - run(entry.children[1]); break;
+        case Kind::mul:             result = run(entry.children[0]) * run(entry.children[1]); break;
+        case Kind::div:             result = run(entry.children[0]) / run(entry.children[1]); break;
+        case Kind::pow:
+        case Kind::powNegLiteral: {
+            number_t base = run(entry.children[0]);
+            result = calculateExpr::power(base, run(entry.children[1]), entry.kind == Kind::powNegLiteral);
+            break;
+        }
+        case Kind::sqrt:            result = std::sqrt(run(entry.children[0])); break;
+        case Kind::sin:             result = std::sin(run(entry.children[0])); break;
+        case Kind::cos:             result = std::cos(run(entry.children[0])); break;
+        case Kind::tan:             result = std::tan(run(entry.children[0])); break;
+        case Kind::asin:            result = std::asin(run(entry.children[0])); break;
+        case Kind::acos:            result = std::acos(run(entry.children[0])); break;
+        case Kind::atan:            result = std::atan(run(entry.children[0])); break;
+        case Kind::log:             result = std::log10(run(entry.children[0])); break;
+        case Kind::ln:              result = std::log(run(entry.children[0])); break;
+        case Kind::call: {
+            size_t base = m_frames.size();
+            size_t arity = entry.children.size() - 1;
+            for (size_t i = 0; i < arity; ++i) {
+                number_t arg = run(entry.children[i]);
+                m_frames.push_back(arg);
+            }
+
+            auto match = std::ranges::find_if(entry.function->cases, [&](const auto& c) {
+                return std::ranges::equal(c.first, std::span(m_frames).subspan(base));
+            });
+            if (match != entry.function->cases.end()) result = match->second;
+            else {
+                size_t caller = std::exchange(m_frameBase, base);
+                result = run(entry.children.back());
+                m_frameBase = caller;
+            }
+            m_frames.resize(base);
+            break;
+        }
+    }
+
+    entry.ticks += ticks() - start;
+    ++entry.calls;
+    return result;
+}
+
+std::vector<Profiler::Node> Profiler::nodes() const {
+    Overhead overhead = timingOverhead();
+    double rate = ticksPerNs();
+
+    // Children come after their parent, so one pass from the back has everything about the children.
+    // The ticks and calls of a node that is not timed are those of its nearest timed descendants.
+    std::vector<Node> nodes(m_entries.size());
+    std::vector<double> timedTicks(m_entries.size()), timedCalls(m_entries.size());
+    for (size_t i = m_entries.size(); i-- > 0; ) {
+        const Entry& entry = m_entries[i];
+        bool timed = entry.kind != Kind::literal && entry.kind != Kind::param && entry.kind != Kind::paren;
+        double children = 0, childTicks = 0, childCalls = 0;
+        for (uint32_t child : entry.children) {
+            children += nodes[child].totalNs;
+            childTicks += timedTicks[child];
+            childCalls += timedCalls[child];
+        }
+
+        double self = 0;
+        if (timed) {
+            double timing = entry.calls * overhead.self + childCalls * overhead.outside;
+            self = std::max(entry.ticks - childTicks - timing, 0.0) / rate;
+            timedTicks[i] = static_cast<double>(entry.ticks);
+            timedCalls[i] = static_cast<double>(entry.calls);
+        }
+        else {
+            timedTicks[i] = childTicks;
+            timedCalls[i] = childCalls;
+        }
+        nodes[i] = Node{ .label = entry.label, .depth = entry.depth, .calls = entry.calls, .totalNs = self + children, .selfNs = self };
+    }
+    return nodes;
+}
+
+std::string Profiler::report() const {
+    auto nodes = this->nodes();
+    double total = nodes.front().totalNs;
+    auto share = [&](double ns) { return total > 0 ? 100 * ns / total : 0.0; };
+
+    std::string text = std::format("{} evaluations, {:.1f} ns each\n", evaluations(), evaluations() ? total / evaluations() : 0.0);
+    text += std::format("{:>5} {:>10} {:>7} {:>7} {:>10}\n", "#", "calls", "total", "self", "ns/call");
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const Node& node = nodes[i];
+        text += std::format("{:>5} {:>10} {:>6.1f}% {:>6.1f}% {:>10.1f}  {}{}\n", i, node.calls, share(node.totalNs), share(node.selfNs),
+                            node.calls ? node.totalNs / node.calls : 0.0, std::string(4 * node.depth, ' '), node.label);
+    }
+
+    auto rank = [&](const char* title, double Node::* cost) {
+        std::vector<size_t> order(nodes.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_sort(order, std::ranges::greater(), [&](size_t i) { return nodes[i].*cost; });
+        text += title;
+        auto costly = [&](size_t i) { return nodes[i].*cost > 0; };
+        for (size_t i : order | std::views::take_while(costly) | std::views::take(rankedNodes)) text += std::format("{:>6.1f}%  #{} {}\n", share(nodes[i].*cost), i, nodes[i].label);
+    };
+    rank("By total time\n", &Node::totalNs);
+    rank("By self time\n", &Node::selfNs);
+    return text;
+}
+
+std::string Profiler::folded() const {
+    auto nodes = this->nodes();
+    std::vector<std::string> stacks(nodes.size());
+    std::string text;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        stacks[i] = i ? stacks[m_entries[i].parent] + ";" + nodes[i].label : nodes[i].label;
+        auto ns = std::llround(nodes[i].selfNs);
+        if (ns > 0) text += std::format("{} {}\n", stacks[i], ns);
+    }
+    return text;
+}
@@ -0,0 +1,80 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "types.h"
+#include "parser.h"
+#include "compiled.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Evaluates an expression tree like calculateExpr::eval while timing every operation, accumulated over
+// as many evaluations as are run. Numbers are parsed and variables looked up once when it is built, so
+// the time of a node is that of its operation, much as in compiled code. Numbers, variables and
+// parentheses are counted but not timed, they cost less than reading the clock and are part of the
+// operation that reads them. Calls of user functions are profiled through their body, a copy per call
+// site as the compiler inlines them.
+class Profiler {
+public:
+    // Throws for vectors and recursive functions, which have no fixed tree
+    Profiler(NodeExpr* expr, const std::function<number_t(const std::string&)>& lookup, const FunctionTable* functions = nullptr);
+
+    number_t evaluate();
+    size_t evaluations() const { return m_entries.front().calls; }
+    // Nodes of the tree, with a copy of the body of a function per call
+    size_t size() const { return m_entries.size(); }
+
+    // Cost of a node over all evaluations, less what the timing itself took as calibrated once per
+    // process. Self is the part not spent in its children.
+    struct Node {
+        std::string label;
+        uint32_t depth;
+        uint64_t calls;
+        double totalNs;
+        double selfNs;
+    };
+    // In the order printAST prints them
+    std::vector<Node> nodes() const;
+
+    // The tree as printAST prints it with the calls and the share of the total and self time of every
+    // node, followed by the nodes that take most of either
+    std::string report() const;
+    // "Add;Mul;Sine 1234" for every node, with its self time in nanoseconds. The folded stack format
+    // read by flamegraph.pl and speedscope.
+    std::string folded() const;
+private:
+    enum class Kind : uint8_t { literal, param, paren, add, sub, mul, div, pow, powNegLiteral, sqrt, sin, cos, tan, asin, acos, atan, log, ln, call };
+    struct Entry {
+        Kind kind;
+        std::string label;
+        uint32_t depth;
+        uint32_t parent;
+        // A call has its arguments first and its body last
+        std::vector<uint32_t> children;
+        number_t value = 0;
+        uint32_t param = 0;
+        const FunctionDef* function = nullptr;
+        uint64_t calls = 0;
+        uint64_t ticks = 0;
+    };
+
+    uint32_t add(NodeExpr* expr, uint32_t depth, uint32_t parent);
+    uint32_t addEntry(Kind kind, std::string label, uint32_t depth, uint32_t parent);
+    number_t run(uint32_t index);
+private:
+    std::vector<Entry> m_entries;
+    // Arguments of the calls being evaluated, the innermost from m_frameBase on
+    std::vector<number_t> m_frames;
+    size_t m_frameBase = 0;
+
+    // Only used while building
+    const std::function<number_t(const std::string&)>* m_lookup = nullptr;
+    const FunctionTable* m_functions = nullptr;
+    const std::vector<std::string>* m_params = nullptr;
+    std::vector<std::string> m_inlining;
+};
+
+#endif
@@ -0,0 +1,301 @@
+#include "rational.h"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+// Exact results beyond this many bits are left to floating point, 2^(2^20) has 315653 digits
+constexpr size_t maxExactBits = size_t(1) << 20;
+
+// Both return false on overflow and for INT64_MIN, which small rationals never hold
+bool checkedAdd(int64_t a, int64_t b, int64_t& out) {
+#if defined(__GNUC__) || defined(__clang__)
+    if (__builtin_add_overflow(a, b, &out)) return false;
+#else
+    if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b)) return false;
+    out = a + b;
+#endif
+    return out != INT64_MIN;
+}
+
+bool checkedMul(int64_t a, int64_t b, int64_t& out) {
+#if defined(__GNUC__) || defined(__clang__)
+    if (__builtin_mul_overflow(a, b, &out)) return false;
+#else
+    if (a != 0 && b != 0) {
+        uint64_t ua = a < 0 ? 0 - static_cast<uint64_t>(a) : a, ub = b < 0 ? 0 - static_cast<uint64_t>(b) : b;
+        if (ua > uint64_t(INT64_MAX) / ub) return false;
+    }
+    out = a * b;
+#endif
+    return out != INT64_MIN;
+}
+
+uint64_t magnitude(int64_t value) {
+    return value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+}
+
+// Binary gcd, shifts and subtractions instead of a division per step
+uint64_t gcd(uint64_t a, uint64_t b) {
+    if (a == 0) return b;
+    if (b == 0) return a;
+
+    int shift = std::countr_zero(a | b);
+    a >>= std::countr_zero(a);
+    while (b) {
+        b >>= std::countr_zero(b);
+        if (a > b) std::swap(a, b);
+        b -= a;
+    }
+    return a << shift;
+}
+
+uint64_t isqrt(uint64_t n) {
+    uint64_t root = static_cast<uint64_t>(std::sqrt(static_cast<number_t>(n)));
+    while (root > 0 && root > n / root) --root;
+    while (root + 1 <= n / (root + 1)) ++root;
+    return root;
+}
+}
+
+Rational::Rational(int64_t value) : m_num(value) {
+    if (value == INT64_MIN) *this = fromReduced(BigInt(value), BigInt(1));
+}
+
+Rational::Rational(int64_t num, int64_t den) {
+    if (den == 0) throw std::runtime_error("Division by zero");
+    if (num == INT64_MIN || den == INT64_MIN) {
+        *this = normalize(BigInt(num), BigInt(den));
+        return;
+    }
+
+    int64_t g = static_cast<int64_t>(gcd(magnitude(num), magnitude(den)));
+    m_num = num / g;
+    m_den = den / g;
+    if (m_den < 0) {
+        m_num = -m_num;
+        m_den = -m_den;
+    }
+}
+
+Rational::Rational(BigInt num, BigInt den) {
+    *this = normalize(std::move(num), std::move(den));
+}
+
+std::optional<Rational> Rational::fromDecimal(std::string_view text) {
+    bool negative = !text.empty() && text.front() == '-';
+    if (negative) text.remove_prefix(1);
+
+    std::string digits;
+    size_t fractionDigits = 0;
+    bool point = false;
+    for (char c : text) {
+        if (c == '.' && !point) point = true;
+        else if (c >= '0' && c <= '9') {
+            digits.push_back(c);
+            if (point) ++fractionDigits;
+        }
+        else return std::nullopt;
+    }
+    if (digits.empty()) return std::nullopt;
+
+    // 18 digits always fit, which covers nearly every literal
+    if (digits.size() <= 18) {
+        int64_t num = 0, den = 1;
+        for (char c : digits) num = num * 10 + (c - '0');
+        for (size_t i = 0; i < fractionDigits; ++i) den *= 10;
+        return Rational(negative ? -num : num, den);
+    }
+
+    BigInt num = BigInt::fromString(digits);
+    return normalize(negative ? -num : num, BigInt(10).pow(fractionDigits));
+}
+
+Rational Rational::operator-() const {
+    if (!m_big) {
+        Rational result;
+        result.m_num = -m_num;
+        result.m_den = m_den;
+        return result;
+    }
+    return fromReduced(-m_big->num, m_big->den);
+}
+
+Rational Rational::operator+(const Rational& other) const {
+    if (!m_big && !other.m_big) {
+        int64_t num;
+        if (m_den == 1 && other.m_den == 1) {
+            if (checkedAdd(m_num, other.m_num, num)) return Rational(num);
+        }
+        else {
+            // a/b + c/d with g = gcd(b, d): the sum can only share factors of g with the new denominator
+            int64_t g = static_cast<int64_t>(gcd(static_cast<uint64_t>(m_den), static_cast<uint64_t>(other.m_den)));
+            int64_t lhs, rhs, den;
+            if (checkedMul(m_num, other.m_den / g, lhs) && checkedMul(other.m_num, m_den / g, rhs) && checkedAdd(lhs, rhs, num)) {
+                if (num == 0) return Rational();
+
+                int64_t common = g == 1 ? 1 : static_cast<int64_t>(gcd(magnitude(num), static_cast<uint64_t>(g)));
+                if (checkedMul(m_den / g, other.m_den / common, den)) {
+                    Rational result;
+                    result.m_num = num / common;
+                    result.m_den = den;
+                    return result;
+                }
+            }
+        }
+    }
+
+    // Same reduction on BigInt, with small denominators the gcds stay cheap even for huge numerators
+    BigInt b = denominator(), d = other.denominator();
+    BigInt g = BigInt::gcd(b, d);
+    BigInt num = numerator() * (d / g) + other.numerator() * (b / g);
+    BigInt common = BigInt::gcd(num, g);
+    if (common.isZero()) return Rational();
+
+    return fromReduced(num / common, (b / g) * (d / common));
+}
+
+Rational Rational::operator-(const Rational& other) const {
+    return *this + (-other);
+}
+
+Rational Rational::operator*(const Rational& other) const {
+    if (!m_big && !other.m_big) {
+        // Cancelling across first keeps the products small and the result already reduced
+        int64_t g1 = static_cast<int64_t>(gcd(magnitude(m_num), static_cast<uint64_t>(other.m_den)));
+        int64_t g2 = static_cast<int64_t>(gcd(magnitude(other.m_num), static_cast<uint64_t>(m_den)));
+
+        int64_t num, den;
+        if (checkedMul(m_num / g1, other.m_num / g2, num) && checkedMul(m_den / g2, other.m_den / g1, den)) {
+            if (num == 0) return Rational();
+
+            Rational result;
+            result.m_num = num;
+            result.m_den = den;
+            return result;
+        }
+    }
+
+    BigInt a = numerator(), b = denominator(), c = other.numerator(), d = other.denominator();
+    if (a.isZero() || c.isZero()) return Rational();
+
+    BigInt g1 = BigInt::gcd(a, d), g2 = BigInt::gcd(c, b);
+    return fromReduced((a / g1) * (c / g2), (b / g2) * (d / g1));
+}
+
+Rational Rational::operator/(const Rational& other) const {
+    if (other.isZero()) throw std::runtime_error("Division by zero");
+
+    if (!other.m_big) {
+        Rational inverse;
+        inverse.m_num = other.m_num < 0 ? -other.m_den : other.m_den;
+        inverse.m_den = other.m_num < 0 ? -other.m_num : other.m_num;
+        return *this * inverse;
+    }
+    BigInt num = other.m_big->num.isNegative() ? -other.m_big->den : other.m_big->den;
+    return *this * fromReduced(std::move(num), other.m_big->num.abs());
+}
+
+bool Rational::operator==(const Rational& other) const {
+    if (!m_big && !other.m_big) return m_num == other.m_num && m_den == other.m_den;
+    return numerator() == other.numerator() && denominator() == other.denominator();
+}
+
+std::optional<Rational> Rational::pow(const Rational& exp) const {
+    if (!exp.isInteger() || !exp.isSmall()) return std::nullopt;
+    if (exp.m_num < 0 && isZero()) return std::nullopt;
+
+    Rational base = exp.m_num < 0 ? Rational(1) / *this : *this;
+    uint64_t e = magnitude(exp.m_num);
+    if (e == 0) return Rational(1);
+
+    size_t bits = base.m_big
+        ? std::max(base.m_big->num.bitLength(), base.m_big->den.bitLength())
+        : static_cast<size_t>(std::bit_width(std::max(magnitude(base.m_num), static_cast<uint64_t>(base.m_den))));
+    if (bits > 1 && e > maxExactBits / bits) return std::nullopt;
+
+    // Powers of coprime numbers stay coprime, so no reduction is needed
+    if (!base.m_big) {
+        int64_t num = 1, den = 1, squareNum = base.m_num, squareDen = base.m_den;
+        bool fits = true;
+        for (uint64_t rest = e; rest && fits; ) {
+            if (rest & 1) fits = checkedMul(num, squareNum, num) && checkedMul(den, squareDen, den);
+            rest >>= 1;
+            if (rest && fits) fits = checkedMul(squareNum, squareNum, squareNum) && checkedMul(squareDen, squareDen, squareDen);
+        }
+        if (fits) {
+            Rational result;
+            result.m_num = num;
+            result.m_den = den;
+            return result;
+        }
+    }
+
+    return fromReduced(base.numerator().pow(e), base.denominator().pow(e));
+}
+
+std::optional<Rational> Rational::sqrt() const {
+    if (isNegative()) return std::nullopt;
+
+    if (!m_big) {
+        uint64_t num = isqrt(static_cast<uint64_t>(m_num)), den = isqrt(static_cast<uint64_t>(m_den));
+        if (num * num != static_cast<uint64_t>(m_num) || den * den != static_cast<uint64_t>(m_den)) return std::nullopt;
+
+        Rational result;
+        result.m_num = static_cast<int64_t>(num);
+        result.m_den = static_cast<int64_t>(den);
+        return result;
+    }
+
+    BigInt num = m_big->num.isqrt(), den = m_big->den.isqrt();
+    if (!(num * num == m_big->num) || !(den * den == m_big->den)) return std::nullopt;
+    return fromReduced(std::move(num), std::move(den));
+}
+
+number_t Rational::toNumber() const {
+    if (!m_big) return static_cast<number_t>(m_num) / static_cast<number_t>(m_den);
+
+    // Scale the numerator so the quotient keeps 64 significant bits, then undo it in the exponent
+    const BigInt& num = m_big->num;
+    const BigInt& den = m_big->den;
+    int64_t shift = 64 + static_cast<int64_t>(den.bitLength()) - static_cast<int64_t>(num.bitLength());
+    BigInt quotient = shift >= 0 ? (num << static_cast<size_t>(shift)) / den : num / (den << static_cast<size_t>(-shift));
+
+    return std::ldexp(quotient.toNumber(), static_cast<int>(-shift));
+}
+
+std::string Rational::toString() const {
+    if (!m_big) return m_den == 1 ? std::to_string(m_num) : std::to_string(m_num) + "/" + std::to_string(m_den);
+    return isInteger() ? m_big->num.toString() : m_big->num.toString() + "/" + m_big->den.toString();
+}
+
+Rational Rational::normalize(BigInt num, BigInt den) {
+    if (den.isZero()) throw std::runtime_error("Division by zero");
+    if (den.isNegative()) {
+        num = -num;
+        den = -den;
+    }
+
+    BigInt g = BigInt::gcd(num, den);
+    if (!(g == BigInt(1)) && !g.isZero()) {
+        num = num / g;
+        den = den / g;
+    }
+    return fromReduced(std::move(num), std::move(den));
+}
+
+Rational Rational::fromReduced(BigInt num, BigInt den) {
+    Rational result;
+    if (num.fitsInt64() && den.fitsInt64() && num.toInt64() != INT64_MIN) {
+        result.m_num = num.toInt64();
+        result.m_den = den.toInt64();
+        if (result.m_num == 0) result.m_den = 1;
+    }
+    else result.m_big = std::make_shared<const Big>(Big{ std::move(num), std::move(den) });
+
+    return result;
+}
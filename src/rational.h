@@ -0,0 +1,64 @@
+#ifndef RATIONAL_H
+#define RATIONAL_H
+
+#include "types.h"
+#include "bigint.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Exact fraction in lowest terms with a positive denominator. Most values fit in machine words
+// and stay in two int64, only when an operation overflows does the value move to BigInt.
+class Rational {
+public:
+    Rational() = default;
+    Rational(int64_t value);
+    Rational(int64_t num, int64_t den);
+    Rational(BigInt num, BigInt den);
+
+    // Decimal literals like "-2" or "0.125", the latter is 1/8
+    static std::optional<Rational> fromDecimal(std::string_view text);
+
+    Rational operator-() const;
+    Rational operator+(const Rational& other) const;
+    Rational operator-(const Rational& other) const;
+    Rational operator*(const Rational& other) const;
+    Rational operator/(const Rational& other) const;
+    bool operator==(const Rational& other) const;
+
+    // Only integer exponents have exact results, std::nullopt otherwise or if the result would be huge
+    std::optional<Rational> pow(const Rational& exp) const;
+    // Exact only for squares of rationals
+    std::optional<Rational> sqrt() const;
+
+    bool isZero() const { return !m_big && m_num == 0; }
+    bool isNegative() const { return m_big ? m_big->num.isNegative() : m_num < 0; }
+    bool isInteger() const { return m_big ? m_big->den == BigInt(1) : m_den == 1; }
+    // True while the value is held in machine words
+    bool isSmall() const { return !m_big; }
+
+    BigInt numerator() const { return m_big ? m_big->num : BigInt(m_num); }
+    BigInt denominator() const { return m_big ? m_big->den : BigInt(m_den); }
+
+    number_t toNumber() const;
+    std::string toString() const;
+private:
+    struct Big {
+        BigInt num;
+        BigInt den;
+    };
+
+    // Reduces a fraction and moves it back to machine words if it fits
+    static Rational normalize(BigInt num, BigInt den);
+    static Rational fromReduced(BigInt num, BigInt den);
+private:
+    // INT64_MIN is never stored so negating a small value cannot overflow
+    int64_t m_num = 0;
+    int64_t m_den = 1;
+    std::shared_ptr<const Big> m_big;
+};
+
+#endif
@@ -0,0 +1,430 @@
+#include "series.h"
+
+#include "calculate.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <complex>
+#include <format>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace {
+// Below this many nonzero coefficients in the shorter operand the direct product beats the FFT
+constexpr size_t naiveLimit = 128;
+// Up to this many coefficients the linear recurrences are used, which take O(n^2) but keep every
+// coefficient accurate relative to its own size. Newton iterations extend them beyond.
+constexpr size_t recurrenceLimit = 2048;
+
+using Complex = std::complex<number_t>;
+
+// Roots of unity for the largest transform so far, smaller transforms take every k-th. They are
+// computed one by one because repeated multiplication would accumulate rounding errors.
+const std::vector<Complex>& roots(size_t n) {
+    thread_local std::vector<Complex> cache;
+    if (cache.size() < n / 2) {
+        cache.resize(n / 2);
+        for (size_t k = 0; k < n / 2; ++k) cache[k] = std::polar<number_t>(1, -2 * constants::pi * k / n);
+    }
+    return cache;
+}
+
+// In place radix-2 transform, the inverse is left unscaled
+void fft(std::vector<Complex>& a, bool inverse) {
+    size_t n = a.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(a[i], a[j]);
+    }
+
+    const auto& table = roots(n);
+    for (size_t length = 2; length <= n; length <<= 1) {
+        size_t stride = table.size() * 2 / length;
+        for (size_t i = 0; i < n; i += length) {
+            for (size_t j = 0; j < length / 2; ++j) {
+                Complex w = inverse ? std::conj(table[j * stride]) : table[j * stride];
+                Complex u = a[i + j], v = a[i + j + length / 2] * w;
+                a[i + j] = u + v;
+                a[i + j + length / 2] = u - v;
+            }
+        }
+    }
+}
+
+// Number of coefficients up to the last nonzero one
+size_t used(const Series& a) {
+    size_t n = a.size();
+    while (n > 0 && a[n - 1] == 0) --n;
+    return n;
+}
+
+Series scaled(Series a, number_t factor) {
+    for (number_t& c : a) c *= factor;
+    return a;
+}
+
+Series plus(Series a, const Series& b, number_t factor = 1) {
+    for (size_t i = 0; i < a.size(); ++i) a[i] += factor * b[i];
+    return a;
+}
+
+Series head(const Series& a, size_t n) {
+    Series result(a.begin(), a.begin() + std::min(n, a.size()));
+    result.resize(n, 0);
+    return result;
+}
+
+Series constantSeries(number_t value, size_t length) {
+    Series result(length, 0);
+    result[0] = value;
+    return result;
+}
+
+// Takes the coefficients from m on of next into current. A Newton step only adds those, the ones
+// before came from shorter products, which are exact or at least less noisy than a long FFT.
+void extend(Series& current, const Series& next, size_t m) {
+    std::copy(next.begin() + m, next.end(), current.begin() + m);
+}
+
+bool isConstant(const Series& a) {
+    return std::all_of(a.begin() + 1, a.end(), [](number_t c) { return c == 0; });
+}
+
+// First n coefficients of a / b, from b_0 q_k = a_k - sum_{j=1..k} b_j q_{k-j}
+Series quotientRecurrence(const Series& a, const Series& b, size_t n) {
+    size_t usedB = used(b);
+    Series q(n, 0);
+    for (size_t k = 0; k < n; ++k) {
+        number_t sum = a[k];
+        for (size_t j = 1; j <= k && j < usedB; ++j) sum -= b[j] * q[k - j];
+        q[k] = sum / b[0];
+    }
+    return q;
+}
+
+// First n coefficients of exp(a - a_0), from k g_k = sum_{j=1..k} j a_j g_{k-j}
+Series expRecurrence(const Series& a, size_t n) {
+    size_t usedA = used(a);
+    Series g(n, 0);
+    g[0] = 1;
+    for (size_t k = 1; k < n; ++k) {
+        number_t sum = 0;
+        for (size_t j = 1; j <= k && j < usedA; ++j) sum += j * a[j] * g[k - j];
+        g[k] = sum / k;
+    }
+    return g;
+}
+
+// First n coefficients of sin(a) and cos(a), from s' = a' c and c' = -a' s:
+// k s_k = sum_{j=1..k} j a_j c_{k-j} and k c_k = -sum_{j=1..k} j a_j s_{k-j}
+std::pair<Series, Series> sinCosRecurrence(const Series& a, size_t n) {
+    size_t usedA = used(a);
+    Series sine(n, 0), cosine(n, 0);
+    sine[0] = std::sin(a[0]);
+    cosine[0] = std::cos(a[0]);
+    for (size_t k = 1; k < n; ++k) {
+        number_t s = 0, c = 0;
+        for (size_t j = 1; j <= k && j < usedA; ++j) {
+            s += j * a[j] * cosine[k - j];
+            c -= j * a[j] * sine[k - j];
+        }
+        sine[k] = s / k;
+        cosine[k] = c / k;
+    }
+    return { sine, cosine };
+}
+
+// sin and cos of a, beyond recurrenceLimit both from tan of half the non-constant part
+std::pair<Series, Series> sinCos(const Series& a) {
+    size_t n = a.size();
+    if (n <= recurrenceLimit) return sinCosRecurrence(a, n);
+    Series half = scaled(a, 0.5L);
+    half[0] = 0;
+
+    // Newton on atan(t) = half, t <- t - (atan(t) - half)(1 + t^2). Both sides start at 0, so
+    // atan(t) is the integral of t' / (1 + t^2). The recurrences give the first coefficients.
+    auto [halfSine, halfCosine] = sinCosRecurrence(half, recurrenceLimit);
+    Series t = quotientRecurrence(halfSine, halfCosine, recurrenceLimit);
+    for (size_t m = t.size(); m < n; ) {
+        size_t next = std::min(2 * m, n);
+        t.resize(next, 0);
+        Series u = series::multiply(t, t);
+        u[0] += 1;
+        Series residual = plus(series::integral(series::divide(series::derivative(t), u), 0), head(half, next), -1);
+        extend(t, plus(t, series::multiply(residual, u), -1), m);
+        m = next;
+    }
+
+    // cos = (1 - t^2) / (1 + t^2) and sin = 2t / (1 + t^2) of the half angle
+    Series u = series::multiply(t, t);
+    u[0] += 1;
+    Series inverse = series::inverse(u);
+    Series cosine = scaled(inverse, 2), sine = scaled(series::multiply(t, inverse), 2);
+    cosine[0] -= 1;
+
+    number_t s0 = std::sin(a[0]), c0 = std::cos(a[0]);
+    std::pair result{ plus(scaled(cosine, s0), sine, c0), plus(scaled(cosine, c0), sine, -s0) };
+
+    // The FFT products only keep the first coefficients accurate relative to the largest ones
+    auto [headSine, headCosine] = sinCosRecurrence(a, recurrenceLimit);
+    std::copy(headSine.begin(), headSine.end(), result.first.begin());
+    std::copy(headCosine.begin(), headCosine.end(), result.second.begin());
+    return result;
+}
+
+// d/dx asin(a) = a' / sqrt(1 - a^2)
+Series arcsineSlope(const Series& a) {
+    if (!(std::abs(a[0]) < 1)) throw std::runtime_error("asin and acos are not analytic where their argument is not between -1 and 1");
+    Series rest = scaled(series::multiply(a, a), -1);
+    rest[0] += 1;
+    return series::divide(series::derivative(a), series::sqrt(rest));
+}
+
+struct Expansion {
+    const std::string& variable;
+    number_t center;
+    size_t length;
+    const std::function<number_t(const std::string&)>& lookup;
+
+    Series expand(NodeExpr* expr) const;
+};
+
+Series Expansion::expand(NodeExpr* expr) const {
+    if (auto term = std::get_if<NodeTerm*>(&expr->var)) {
+        if (auto num = std::get_if<NodeTermNumber*>(&(*term)->var)) return constantSeries(std::stod((*num)->lit->value.value()), length);
+        if (auto constant = std::get_if<NodeTermConstant*>(&(*term)->var)) {
+            auto value = constants::value((*constant)->name->value.value());
+            if (!value) throw std::runtime_error("Unknown constant " + (*constant)->name->value.value());
+            return constantSeries(value.value(), length);
+        }
+        if (auto variable = std::get_if<NodeTermVariable*>(&(*term)->var)) {
+            const std::string& name = (*variable)->ident->value.value();
+            if (name != this->variable) return constantSeries(lookup(name), length);
+            Series result = constantSeries(center, length);
+            if (length > 1) result[1] = 1;
+            return result;
+        }
+        if (auto paren = std::get_if<NodeTermParen*>(&(*term)->var)) return expand((*paren)->expr);
+        throw std::runtime_error("Series of vectors are not supported");
+    }
+
+    if (auto bin = std::get_if<NodeBinExpr*>(&expr->var)) {
+        auto operands = std::visit([](auto node) { return std::make_pair(node->lhs, node->rhs); }, (*bin)->var);
+        Series lhs = expand(operands.first), rhs = expand(operands.second);
+
+        if (std::holds_alternative<NodeBinExprAdd*>((*bin)->var)) return plus(std::move(lhs), rhs);
+        if (std::holds_alternative<NodeBinExprSub*>((*bin)->var)) return plus(std::move(lhs), rhs, -1);
+        if (std::holds_alternative<NodeBinExprMul*>((*bin)->var)) return series::multiply(lhs, rhs);
+        if (std::holds_alternative<NodeBinExprDiv*>((*bin)->var)) return series::divide(lhs, rhs);
+        // -2^x is lexed as the literal -2, the sign applies after the power
+        if (calculateExpr::isNegativeLiteral(operands.first)) return scaled(series::pow(scaled(std::move(lhs), -1), rhs), -1);
+        return series::pow(lhs, rhs);
+    }
+
+    return std::visit([this](auto node) -> Series {
+        using Node = std::remove_pointer_t<decltype(node)>;
+        if constexpr (std::is_same_v<Node, NodeBinExprLogn>) return series::divide(series::ln(expand(node->expr)), series::ln(expand(node->n)));
+        else if constexpr (requires { node->expr; }) {
+            Series a = expand(node->expr);
+            if constexpr (std::is_same_v<Node, NodeBinExprSqrt>) return series::sqrt(a);
+            else if constexpr (std::is_same_v<Node, NodeBinExprSin>) return series::sin(a);
+            else if constexpr (std::is_same_v<Node, NodeBinExprCos>) return series::cos(a);
+            else if constexpr (std::is_same_v<Node, NodeBinExprTan>) return series::tan(a);
+            else if constexpr (std::is_same_v<Node, NodeBinExprAsin>) return series::asin(a);
+            else if constexpr (std::is_same_v<Node, NodeBinExprAcos>) return series::acos(a);
+            else if constexpr (std::is_same_v<Node, NodeBinExprAtan>) return series::atan(a);
+            else if constexpr (std::is_same_v<Node, NodeBinExprLog>) return scaled(series::ln(a), 1 / std::log(10.0L));
+            else if constexpr (std::is_same_v<Node, NodeBinExprLn>) return series::ln(a);
+            else throw std::runtime_error("Series of reductions are not supported");
+        }
+        else throw std::runtime_error("Series of vectors and function calls are not supported");
+    }, std::get<NodeExprFunc*>(expr->var)->var);
+}
+}
+
+namespace series {
+
+Series multiply(const Series& a, const Series& b) {
+    size_t n = a.size(), usedA = used(a), usedB = used(b);
+    Series result(n, 0);
+    if (usedA == 0 || usedB == 0) return result;
+
+    if (std::min(usedA, usedB) <= naiveLimit) {
+        for (size_t i = 0; i < usedA; ++i) {
+            for (size_t j = 0; j < usedB && i + j < n; ++j) result[i + j] += a[i] * b[j];
+        }
+        return result;
+    }
+
+    // Both real inputs go into one complex transform as a + ib, their spectra are separated by symmetry
+    size_t size = std::bit_ceil(std::min(usedA, n) + std::min(usedB, n) - 1);
+    std::vector<Complex> packed(size);
+    for (size_t i = 0; i < std::min(usedA, n); ++i) packed[i].real(a[i]);
+    for (size_t i = 0; i < std::min(usedB, n); ++i) packed[i].imag(b[i]);
+    fft(packed, false);
+
+    std::vector<Complex> product(size);
+    for (size_t k = 0; k < size; ++k) {
+        Complex x = packed[k], y = std::conj(packed[(size - k) & (size - 1)]);
+        // (x + y) / 2 * (x - y) / 2i
+        product[k] = (x + y) * (x - y) * Complex(0, -0.25L);
+    }
+    fft(product, true);
+
+    for (size_t i = 0; i < n && i < size; ++i) result[i] = product[i].real() / size;
+    return result;
+}
+
+Series inverse(const Series& a) {
+    if (a[0] == 0) throw std::runtime_error("Division by a series that is 0 at the center");
+
+    // g <- g (2 - a g), each step doubles the correct coefficients
+    size_t n = a.size();
+    Series g = quotientRecurrence(constantSeries(1, n), a, std::min(n, recurrenceLimit));
+    for (size_t m = g.size(); m < n; ) {
+        size_t next = std::min(2 * m, n);
+        g.resize(next, 0);
+        Series error = scaled(multiply(head(a, next), g), -1);
+        error[0] += 2;
+        extend(g, multiply(g, error), m);
+        m = next;
+    }
+    return g;
+}
+
+Series divide(const Series& a, const Series& b) {
+    if (b[0] == 0) throw std::runtime_error("Division by a series that is 0 at the center");
+    if (a.size() <= recurrenceLimit) return quotientRecurrence(a, b, a.size());
+
+    Series result = multiply(a, inverse(b));
+    Series first = quotientRecurrence(a, b, recurrenceLimit);
+    std::copy(first.begin(), first.end(), result.begin());
+    return result;
+}
+
+Series derivative(const Series& a) {
+    Series result(a.size(), 0);
+    for (size_t k = 1; k < a.size(); ++k) result[k - 1] = k * a[k];
+    return result;
+}
+
+Series integral(const Series& a, number_t c) {
+    Series result(a.size(), 0);
+    if (result.empty()) return result;
+    result[0] = c;
+    for (size_t k = 1; k < a.size(); ++k) result[k] = a[k - 1] / k;
+    return result;
+}
+
+Series exp(const Series& a) {
+    // exp(a0) times the exponential of the rest, g <- g (1 + a - ln g)
+    size_t n = a.size();
+    Series g = expRecurrence(a, std::min(n, recurrenceLimit));
+    for (size_t m = g.size(); m < n; ) {
+        size_t next = std::min(2 * m, n);
+        g.resize(next, 0);
+        Series step = plus(head(a, next), ln(g), -1);
+        step[0] = 1;
+        extend(g, multiply(g, step), m);
+        m = next;
+    }
+    return scaled(head(g, n), std::exp(a[0]));
+}
+
+Series ln(const Series& a) {
+    if (!(a[0] > 0)) throw std::runtime_error("ln is not analytic where its argument is not positive");
+    return integral(divide(derivative(a), a), std::log(a[0]));
+}
+
+Series pow(const Series& a, const Series& b) {
+    size_t n = a.size();
+    if (!isConstant(b)) {
+        if (!(a[0] > 0)) throw std::runtime_error("A power with a variable exponent needs a positive base");
+        return exp(multiply(b, ln(a)));
+    }
+
+    number_t exponent = b[0];
+    bool integer = exponent == std::trunc(exponent);
+    // a = (x - x0)^shift u with u(0) nonzero, so a^e = (x - x0)^(shift e) u^e
+    size_t shift = 0;
+    while (shift < n && a[shift] == 0) ++shift;
+    if (shift == n) {
+        if (exponent < 0) throw std::runtime_error("Negative power of a series that is 0");
+        return constantSeries(exponent == 0 ? 1 : 0, n);
+    }
+    if (shift > 0 && (!integer || exponent < 0)) throw std::runtime_error("Only natural powers are analytic where the base is 0");
+
+    // Same convention as for numbers: a negative base to a fractional power is -(|a|^e)
+    Series unit(a.begin() + shift, a.end());
+    unit.resize(n, 0);
+    bool negative = unit[0] < 0;
+    if (negative) unit = scaled(std::move(unit), -1);
+    Series result = exp(scaled(ln(unit), exponent));
+    if (negative && (!integer || std::fmod(exponent, 2) != 0)) result = scaled(std::move(result), -1);
+
+    if (shift == 0) return result;
+    auto offset = static_cast<size_t>(std::min<number_t>(exponent * shift, n));
+    Series shifted(n, 0);
+    std::copy(result.begin(), result.end() - offset, shifted.begin() + offset);
+    return shifted;
+}
+
+Series sqrt(const Series& a) {
+    if (!(a[0] > 0)) throw std::runtime_error("sqrt is not analytic where its argument is not positive");
+    return exp(scaled(ln(a), 0.5L));
+}
+
+Series sin(const Series& a) {
+    return sinCos(a).first;
+}
+
+Series cos(const Series& a) {
+    return sinCos(a).second;
+}
+
+Series tan(const Series& a) {
+    auto [sine, cosine] = sinCos(a);
+    return divide(sine, cosine);
+}
+
+Series asin(const Series& a) {
+    return integral(arcsineSlope(a), std::asin(a[0]));
+}
+
+Series acos(const Series& a) {
+    return integral(scaled(arcsineSlope(a), -1), std::acos(a[0]));
+}
+
+Series atan(const Series& a) {
+    Series u = multiply(a, a);
+    u[0] += 1;
+    return integral(divide(derivative(a), u), std::atan(a[0]));
+}
+
+Series taylor(NodeExpr* expr, const std::string& variable, number_t center, size_t order, const std::function<number_t(const std::string&)>& lookup) {
+    return Expansion{ variable, center, order + 1, lookup }.expand(expr);
+}
+
+std::string toString(const Series& a, const std::string& variable, number_t center) {
+    std::string base = variable;
+    if (center != 0) base = "(" + variable + (center < 0 ? " + " : " - ") + std::format("{:.6g}", std::abs(center)) + ")";
+
+    // Six significant digits, the coefficients of high powers are usually far below what formatNumber shows
+    std::string result;
+    for (size_t k = 0; k < a.size(); ++k) {
+        if (a[k] == 0) continue;
+        std::string power = k == 0 ? "" : k == 1 ? base : base + "^" + std::to_string(k);
+        std::string magnitude = std::format("{:.6g}", std::abs(a[k]));
+        std::string term = power.empty() ? magnitude : magnitude == "1" ? power : magnitude + "*" + power;
+
+        if (result.empty()) result = (a[k] < 0 ? "-" : "") + term;
+        else result += (a[k] < 0 ? " - " : " + ") + term;
+    }
+    return result.empty() ? "0" : result;
+}
+
+}
@@ -0,0 +1,49 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include "types.h"
+#include "parser.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Truncated power series: coefficient k belongs to (x - x0)^k. All operands of an operation have the
+// same length, the order plus one, and so has the result.
+using Series = std::vector<number_t>;
+
+namespace series {
+    // Truncated product. Short series are multiplied directly, long ones by an FFT convolution whose
+    // error is relative to the largest coefficients, as with any floating point FFT.
+    Series multiply(const Series& a, const Series& b);
+    Series inverse(const Series& a);
+    Series divide(const Series& a, const Series& b);
+    Series derivative(const Series& a);
+    // Antiderivative with constant term c, the last coefficient of a falls off
+    Series integral(const Series& a, number_t c);
+
+    // Linear recurrences for the first few thousand coefficients, which keep each of them accurate
+    // relative to its own size. Newton iterations that double the number of correct coefficients per
+    // step take the rest, so each costs a few multiplications of the full length.
+    Series exp(const Series& a);
+    Series ln(const Series& a);
+    Series pow(const Series& a, const Series& b);
+    Series sqrt(const Series& a);
+    Series sin(const Series& a);
+    Series cos(const Series& a);
+    Series tan(const Series& a);
+    // Integrals of their derivatives
+    Series asin(const Series& a);
+    Series acos(const Series& a);
+    Series atan(const Series& a);
+
+    // Taylor coefficients of expr in variable around center up to order. Other variables are constants
+    // from lookup. Throws for anything but numbers, variables, operators and elementary functions.
+    Series taylor(NodeExpr* expr, const std::string& variable, number_t center, size_t order, const std::function<number_t(const std::string&)>& lookup);
+
+    // "1 + x - 0.5*x^2" or around a center of 1, "1 - (x - 1)^2"
+    std::string toString(const Series& a, const std::string& variable, number_t center);
+}
+
+#endif
@@ -0,0 +1,315 @@
+#include "server.h"
+
+#include "commands.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+constexpr int maxEvents = 1024;
+constexpr size_t readChunkSize = 64 * 1024;
+// A client sending more than this without a newline is dropped
+constexpr size_t maxLineLength = 1 << 20;
+
+std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// host:port with a numeric port means TCP, anything else is a Unix socket path
+bool isTcpAddress(const std::string& address, std::string& host, uint16_t& port) {
+    auto colon = address.rfind(':');
+    if (colon == std::string::npos || colon + 1 == address.size() || address.find('/') != std::string::npos) return false;
+    for (size_t i = colon + 1; i < address.size(); ++i) if (!std::isdigit(static_cast<unsigned char>(address[i]))) return false;
+
+    host = address.substr(0, colon);
+    if (host.empty() || host == "localhost") host = "127.0.0.1";
+    port = static_cast<uint16_t>(std::stoul(address.substr(colon + 1)));
+    return true;
+}
+}
+
+Server::Session::~Session() {
+    ::close(fd);
+}
+
+Server::Server(std::string address, size_t threads) : m_address(std::move(address)) {
+    m_pool.emplace(threads);
+}
+
+Server::~Server() {
+    // Workers may still touch the epoll instance, stop them first
+    m_pool.reset();
+    m_sessions.clear();
+
+    if (m_listenFd >= 0) ::close(m_listenFd);
+    if (m_epollFd >= 0) ::close(m_epollFd);
+}
+
+void Server::run() {
+    listen();
+
+    std::cout << "Listening on " << m_address << " with " << m_pool->size() << " worker threads" << std::endl;
+
+    epoll_event events[maxEvents];
+    while (true) {
+        int count = ::epoll_wait(m_epollFd, events, maxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw systemError("epoll_wait failed");
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (!events[i].data.ptr) {
+                acceptAll();
+                continue;
+            }
+
+            auto it = m_sessions.find(static_cast<Session*>(events[i].data.ptr));
+            if (it == m_sessions.end()) continue;
+            auto session = it->second;
+
+            uint32_t flags = events[i].events;
+            if (flags & (EPOLLERR | EPOLLHUP)) {
+                close(session.get());
+                continue;
+            }
+            if (flags & (EPOLLIN | EPOLLRDHUP)) onReadable(session);
+            if (flags & EPOLLOUT) onWritable(session);
+        }
+    }
+}
+
+void Server::listen() {
+    std::string host;
+    uint16_t port = 0;
+
+    if (isTcpAddress(m_address, host, port)) {
+        m_listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (m_listenFd < 0) throw systemError("Cannot create socket");
+
+        int yes = 1;
+        ::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) throw std::runtime_error("Invalid address " + host);
+        // Clients can run anything the prompt can, so they have to be on this machine
+        if ((ntohl(addr.sin_addr.s_addr) >> 24) != 127) throw std::runtime_error("Only loopback addresses can be served but got " + host);
+        if (::bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) throw systemError("Cannot bind " + m_address);
+    }
+    else {
+        sockaddr_un addr{};
+        if (m_address.size() >= sizeof(addr.sun_path)) throw std::runtime_error("Socket path is too long");
+
+        m_listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (m_listenFd < 0) throw systemError("Cannot create socket");
+
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, m_address.c_str(), m_address.size() + 1);
+        ::unlink(m_address.c_str());
+        if (::bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) throw systemError("Cannot bind " + m_address);
+    }
+
+    if (::listen(m_listenFd, SOMAXCONN) != 0) throw systemError("Cannot listen on " + m_address);
+
+    m_epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFd < 0) throw systemError("Cannot create epoll instance");
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    if (::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &ev) != 0) throw systemError("Cannot watch listening socket");
+}
+
+void Server::acceptAll() {
+    while (true) {
+        int fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) std::cerr << "accept failed: " << std::strerror(errno) << '\n';
+            return;
+        }
+
+        int yes = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+        auto session = std::make_shared<Session>(fd);
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = session.get();
+        if (::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            std::cerr << "Cannot watch connection: " << std::strerror(errno) << '\n';
+            continue;
+        }
+        m_sessions.emplace(session.get(), std::move(session));
+    }
+}
+
+void Server::onReadable(const std::shared_ptr<Session>& session) {
+    char buf[readChunkSize];
+    bool eof = false;
+
+    // Edge triggered, so read until the socket is drained
+    while (true) {
+        ssize_t n = ::read(session->fd, buf, sizeof(buf));
+        if (n > 0) {
+            session->input.append(buf, static_cast<size_t>(n));
+            continue;
+        }
+        if (n == 0) eof = true;
+        else if (errno == EINTR) continue;
+        else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            close(session.get());
+            return;
+        }
+        break;
+    }
+
+    std::deque<std::string> lines;
+    size_t start = 0;
+    for (size_t end; (end = session->input.find('\n', start)) != std::string::npos; start = end + 1) {
+        size_t length = end - start;
+        if (length > 0 && session->input[end - 1] == '\r') --length;
+        lines.emplace_back(session->input, start, length);
+    }
+    session->input.erase(0, start);
+    if (eof && !session->input.empty()) {
+        lines.push_back(std::move(session->input));
+        session->input.clear();
+    }
+
+    if (session->input.size() > maxLineLength) {
+        close(session.get());
+        return;
+    }
+
+    bool closeNow = false;
+    {
+        std::lock_guard lock(session->mutex);
+        for (auto& line : lines) session->pending.push_back(std::move(line));
+
+        if (!session->pending.empty() && !session->scheduled) {
+            session->scheduled = true;
+            m_pool->submit([this, session] { process(session); });
+        }
+
+        if (eof) {
+            session->peerClosed = true;
+            closeNow = !session->scheduled && session->outputOffset >= session->output.size();
+        }
+    }
+    if (closeNow) close(session.get());
+}
+
+void Server::onWritable(const std::shared_ptr<Session>& session) {
+    std::lock_guard lock(session->mutex);
+    flush(*session);
+}
+
+void Server::close(Session* session) {
+    ::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, session->fd, nullptr);
+
+    // A worker may still hold the session, the socket closes with the last reference
+    m_sessions.erase(session);
+}
+
+void Server::process(const std::shared_ptr<Session>& session) {
+    static const CommandLimits limits = CommandLimits::shared();
+    while (true) {
+        std::deque<std::string> batch;
+        {
+            std::lock_guard lock(session->mutex);
+            if (session->pending.empty()) {
+                session->scheduled = false;
+                // The event loop sees EPOLLHUP once both sides are shut down and drops the session
+                if (session->peerClosed && session->outputOffset >= session->output.size()) ::shutdown(session->fd, SHUT_WR);
+                return;
+            }
+            batch.swap(session->pending);
+        }
+
+        // Pipelined requests are answered with one write per batch
+        std::string responses;
+        for (const auto& line : batch) {
+            std::string response;
+            try {
+                response = runCommand(session->cas, line, limits);
+            }
+            catch (const std::exception& e) {
+                response = "error: " + std::string(e.what());
+            }
+            // Results that span lines at the prompt, like profile trees, are joined into one
+            while (!response.empty() && response.back() == '\n') response.pop_back();
+            for (size_t end = response.find('\n'); end != std::string::npos; end = response.find('\n', end + 2)) response.replace(end, 1, "; ");
+            responses += response;
+            responses += '\n';
+        }
+
+        std::lock_guard lock(session->mutex);
+        session->output += responses;
+        flush(*session);
+    }
+}
+
+void Server::flush(Session& session) {
+    while (session.outputOffset < session.output.size()) {
+        ssize_t n = ::send(session.fd, session.output.data() + session.outputOffset, session.output.size() - session.outputOffset, MSG_NOSIGNAL);
+        if (n > 0) {
+            session.outputOffset += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!session.writeArmed) updateEvents(session, true);
+            return;
+        }
+
+        // The client is gone, the event loop cleans up on the error event
+        break;
+    }
+
+    session.output.clear();
+    session.outputOffset = 0;
+    if (session.writeArmed) updateEvents(session, false);
+
+    if (session.peerClosed && !session.scheduled) ::shutdown(session.fd, SHUT_WR);
+}
+
+void Server::updateEvents(Session& session, bool wantWrite) {
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (wantWrite ? EPOLLOUT : 0);
+    ev.data.ptr = &session;
+
+    // Fails harmlessly if the event loop already dropped the session
+    ::epoll_ctl(m_epollFd, EPOLL_CTL_MOD, session.fd, &ev);
+    session.writeArmed = wantWrite;
+}
+
+#else
+
+Server::Session::~Session() {}
+
+Server::Server(std::string address, size_t threads) : m_address(std::move(address)) {
+    m_pool.emplace(threads);
+}
+
+Server::~Server() {}
+
+void Server::run() {
+    throw std::runtime_error("Server mode is only available on Linux");
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "cas.h"
+#include "threadpool.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Line protocol: every request line is a command or equation as typed at the prompt,
+// every response is one line with the result or "error: <message>", in request order.
+// Clients may send any number of lines without waiting for responses.
+class Server {
+public:
+    // address is a Unix socket path, or host:port for TCP where host is localhost or a 127.x.x.x address
+    Server(std::string address, size_t threads = 0);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    void run();
+private:
+    struct Session {
+        explicit Session(int fd) : fd(fd) {}
+        ~Session();
+
+        int fd;
+        CAS cas;
+        std::string input;              // only touched by the event loop
+
+        std::mutex mutex;               // guards everything below
+        std::deque<std::string> pending;
+        std::string output;
+        size_t outputOffset = 0;
+        bool scheduled = false;         // a worker owns the session
+        bool writeArmed = false;
+        bool peerClosed = false;        // the client shut down its side, close once everything is answered
+    };
+
+    void listen();
+    void acceptAll();
+    void onReadable(const std::shared_ptr<Session>& session);
+    void onWritable(const std::shared_ptr<Session>& session);
+    void close(Session* session);
+
+    // Runs on a worker, at most one per session at a time so each CAS stays single threaded
+    void process(const std::shared_ptr<Session>& session);
+    // Caller holds session->mutex
+    void flush(Session& session);
+    void updateEvents(Session& session, bool wantWrite);
+private:
+    std::string m_address;
+    int m_listenFd = -1;
+    int m_epollFd = -1;
+
+    std::optional<ThreadPool> m_pool;
+    std::unordered_map<Session*, std::shared_ptr<Session>> m_sessions;
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <memory>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr char snapshotMagic[8] = { 'C', 'A', 'S', 'S', 'N', 'A', 'P', '\0' };
+constexpr uint32_t snapshotVersion = 1;
+constexpr uint32_t snapshotByteOrder = 0x01020304;
+constexpr size_t sectionAlignment = alignof(number_t) > 8 ? alignof(number_t) : 8;
+
+size_t alignUp(size_t value) {
+    return (value + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+
+template<typename T>
+uint64_t appendSection(std::vector<std::byte>& buf, const std::vector<T>& items) {
+    uint64_t offset = alignUp(buf.size());
+    buf.resize(offset + items.size() * sizeof(T));
+    if (!items.empty()) std::memcpy(buf.data() + offset, items.data(), items.size() * sizeof(T));
+
+    return offset;
+}
+}
+
+Snapshot::Snapshot(const std::string& path) {
+#if defined(_WIN32)
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) throw std::runtime_error("Cannot open snapshot " + path);
+
+    m_size = static_cast<size_t>(file.tellg());
+    auto buffer = static_cast<std::byte*>(::operator new(m_size, std::align_val_t(sectionAlignment)));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer), m_size);
+    m_data = buffer;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open snapshot " + path);
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot read snapshot " + path);
+    }
+
+    m_size = static_cast<size_t>(st.st_size);
+    void* mapping = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) throw std::runtime_error("Cannot map snapshot " + path);
+
+    m_data = static_cast<const std::byte*>(mapping);
+#endif
+
+    try {
+        validate();
+    }
+    catch (...) {
+        release();
+        throw;
+    }
+}
+
+Snapshot::~Snapshot() {
+    release();
+}
+
+void Snapshot::release() {
+    if (!m_data) return;
+#if defined(_WIN32)
+    ::operator delete(const_cast<std::byte*>(m_data), std::align_val_t(sectionAlignment));
+#else
+    ::munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+}
+
+void Snapshot::write(const std::string& path,
+                     std::vector<std::pair<std::string, number_t>> variables,
+                     std::vector<std::pair<std::string, const CompiledExpr*>> formulas) {
+    std::sort(variables.begin(), variables.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::sort(formulas.begin(), formulas.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::string strings;
+    auto addString = [&](std::string_view str) {
+        SnapshotString ref{ .offset = strings.size(), .length = str.size() };
+        strings.append(str);
+        return ref;
+    };
+
+    std::vector<SnapshotVariable> varEntries;
+    varEntries.reserve(variables.size());
+    for (const auto& [name, value] : variables) {
+        SnapshotVariable entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.name = addString(name);
+        entry.value = value;
+        varEntries.push_back(entry);
+    }
+
+    std::vector<SnapshotFormula> formulaEntries;
+    std::vector<Instruction> code;
+    std::vector<SnapshotString> symbols;
+    formulaEntries.reserve(formulas.size());
+    for (const auto& [name, formula] : formulas) {
+        SnapshotFormula entry{
+            .name = addString(name),
+            .codeBegin = code.size(),
+            .codeCount = formula->code().size(),
+            .symbolBegin = symbols.size(),
+            .symbolCount = formula->symbols().size(),
+            .stackSize = formula->stackSize()
+        };
+        for (auto ins : formula->code()) {
+            Instruction clean;
+            std::memset(&clean, 0, sizeof(clean));
+            clean.op = ins.op;
+            clean.arg = ins.arg;
+            clean.value = ins.value;
+            code.push_back(clean);
+        }
+        for (const auto& symbol : formula->symbols()) symbols.push_back(addString(symbol));
+        formulaEntries.push_back(entry);
+    }
+
+    // Zeroed padding keeps snapshots of the same session byte for byte identical
+    std::vector<std::byte> buf(sizeof(SnapshotHeader));
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.byteOrder = snapshotByteOrder;
+    header.numberSize = sizeof(number_t);
+    header.instructionSize = sizeof(Instruction);
+
+    header.variableOffset = appendSection(buf, varEntries);
+    header.variableCount = varEntries.size();
+    header.formulaOffset = appendSection(buf, formulaEntries);
+    header.formulaCount = formulaEntries.size();
+    header.codeOffset = appendSection(buf, code);
+    header.codeCount = code.size();
+    header.symbolOffset = appendSection(buf, symbols);
+    header.symbolCount = symbols.size();
+    header.stringOffset = appendSection(buf, std::vector<char>(strings.begin(), strings.end()));
+    header.stringSize = strings.size();
+    header.fileSize = buf.size();
+    std::memcpy(buf.data(), &header, sizeof(header));
+
+    // Written next to the target and renamed, so a snapshot that is currently mapped is never truncated
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file) throw std::runtime_error("Cannot write snapshot " + path);
+        file.write(reinterpret_cast<const char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+        if (!file) throw std::runtime_error("Cannot write snapshot " + path);
+    }
+    std::filesystem::rename(tmpPath, path);
+}
+
+std::optional<number_t> Snapshot::variable(std::string_view name) const {
+    auto it = std::lower_bound(m_variables.begin(), m_variables.end(), name, [this](const SnapshotVariable& entry, std::string_view key) {
+        return string(entry.name) < key;
+    });
+    if (it == m_variables.end() || string(it->name) != name) return std::nullopt;
+
+    return it->value;
+}
+
+std::optional<FormulaView> Snapshot::formula(std::string_view name) const {
+    auto it = std::lower_bound(m_formulas.begin(), m_formulas.end(), name, [this](const SnapshotFormula& entry, std::string_view key) {
+        return string(entry.name) < key;
+    });
+    if (it == m_formulas.end() || string(it->name) != name) return std::nullopt;
+
+    if (it->codeBegin > m_code.size() || it->codeCount > m_code.size() - it->codeBegin ||
+        it->symbolBegin > m_symbols.size() || it->symbolCount > m_symbols.size() - it->symbolBegin) {
+        throw std::runtime_error("Snapshot formula " + std::string(name) + " is out of bounds");
+    }
+
+    FormulaView view{ .code = m_code.subspan(it->codeBegin, it->codeCount), .symbols = {}, .stackSize = static_cast<uint32_t>(it->stackSize) };
+    view.symbols.reserve(it->symbolCount);
+    for (const auto& symbol : m_symbols.subspan(it->symbolBegin, it->symbolCount)) view.symbols.push_back(string(symbol));
+
+    if (!CompiledExpr::validate(view.code, view.symbols.size(), view.stackSize)) {
+        throw std::runtime_error("Snapshot formula " + std::string(name) + " is corrupt");
+    }
+    return view;
+}
+
+std::string_view Snapshot::string(const SnapshotString& str) const {
+    if (str.offset > m_strings.size() || str.length > m_strings.size() - str.offset) {
+        throw std::runtime_error("Snapshot string is out of bounds");
+    }
+    return m_strings.substr(str.offset, str.length);
+}
+
+void Snapshot::validate() {
+    if (m_size < sizeof(SnapshotHeader)) throw std::runtime_error("Snapshot is truncated");
+
+    m_header = reinterpret_cast<const SnapshotHeader*>(m_data);
+    if (std::memcmp(m_header->magic, snapshotMagic, sizeof(snapshotMagic)) != 0) throw std::runtime_error("File is not a snapshot");
+    if (m_header->version != snapshotVersion) throw std::runtime_error("Unsupported snapshot version " + std::to_string(m_header->version));
+    if (m_header->byteOrder != snapshotByteOrder || m_header->numberSize != sizeof(number_t) || m_header->instructionSize != sizeof(Instruction)) {
+        throw std::runtime_error("Snapshot was written on an incompatible platform");
+    }
+    if (m_header->fileSize != m_size) throw std::runtime_error("Snapshot is truncated");
+
+    m_variables = section<SnapshotVariable>(m_header->variableOffset, m_header->variableCount);
+    m_formulas = section<SnapshotFormula>(m_header->formulaOffset, m_header->formulaCount);
+    m_code = section<Instruction>(m_header->codeOffset, m_header->codeCount);
+    m_symbols = section<SnapshotString>(m_header->symbolOffset, m_header->symbolCount);
+
+    auto strings = section<char>(m_header->stringOffset, m_header->stringSize);
+    m_strings = std::string_view(strings.data(), strings.size());
+}
+
+template<typename T>
+std::span<const T> Snapshot::section(uint64_t offset, uint64_t count) const {
+    if (offset % alignof(T) != 0 || offset > m_size || count > (m_size - offset) / sizeof(T)) {
+        throw std::runtime_error("Snapshot section is out of bounds");
+    }
+    return std::span<const T>(reinterpret_cast<const T*>(m_data + offset), count);
+}
@@ -0,0 +1,93 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "types.h"
+#include "compiled.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// On-disk layout. Every reference is an offset from the start of the file, so the mapping can live at any address.
+struct SnapshotString {
+    uint64_t offset;    // into the string pool
+    uint64_t length;
+};
+
+struct SnapshotVariable {
+    SnapshotString name;
+    number_t value;
+};
+
+struct SnapshotFormula {
+    SnapshotString name;
+    uint64_t codeBegin;     // index into the instruction section
+    uint64_t codeCount;
+    uint64_t symbolBegin;   // index into the symbol section
+    uint64_t symbolCount;
+    uint64_t stackSize;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t numberSize;
+    uint32_t instructionSize;
+    uint64_t fileSize;
+    uint64_t variableOffset, variableCount;    // SnapshotVariable, sorted by name
+    uint64_t formulaOffset, formulaCount;      // SnapshotFormula, sorted by name
+    uint64_t codeOffset, codeCount;            // Instruction
+    uint64_t symbolOffset, symbolCount;        // SnapshotString
+    uint64_t stringOffset, stringSize;         // char
+};
+
+// Borrowed view of a formula inside a mapped snapshot
+struct FormulaView {
+    std::span<const Instruction> code;
+    std::vector<std::string_view> symbols;
+    uint32_t stackSize;
+};
+
+class Snapshot {
+public:
+    explicit Snapshot(const std::string& path);
+    ~Snapshot();
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    static void write(const std::string& path,
+                      std::vector<std::pair<std::string, number_t>> variables,
+                      std::vector<std::pair<std::string, const CompiledExpr*>> formulas);
+
+    std::optional<number_t> variable(std::string_view name) const;
+    std::optional<FormulaView> formula(std::string_view name) const;
+
+    std::span<const SnapshotVariable> variables() const { return m_variables; }
+    std::span<const SnapshotFormula> formulas() const { return m_formulas; }
+    std::string_view string(const SnapshotString& str) const;
+private:
+    void validate();
+    void release();
+
+    template<typename T>
+    std::span<const T> section(uint64_t offset, uint64_t count) const;
+private:
+    const std::byte* m_data = nullptr;
+    size_t m_size = 0;
+
+    const SnapshotHeader* m_header = nullptr;
+    std::span<const SnapshotVariable> m_variables;
+    std::span<const SnapshotFormula> m_formulas;
+    std::span<const Instruction> m_code;
+    std::span<const SnapshotString> m_symbols;
+    std::string_view m_strings;
+};
+
+#endif
@@ -0,0 +1,486 @@
+#ifndef STATICEXPR_H
+#define STATICEXPR_H
+
+#include "types.h"
+#include "calculate.h"
+
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+
+// Expressions fixed in C++ code, lexed and parsed by the compiler instead of at runtime:
+//
+//     constexpr auto f = cas::expr<"2x^2 + sin(y)">;
+//     number_t value = f(1.5, 0.25);   // arguments in order of f.variables, here x and y
+//
+// The string follows the grammar of Lexer and Parser, implicit multiplication and the sign rule of
+// -2^2 included, and evaluates bit for bit like calculateExpr::eval, which bench_static checks.
+// Syntax errors are compile errors, the name of the detail::error function in the diagnostic says
+// what is wrong. Only numbers are supported: lists, vector functions and user functions are errors.
+namespace cas {
+template<size_t N>
+struct FixedString {
+    char data[N]{};
+
+    consteval FixedString(const char (&text)[N]) {
+        for (size_t i = 0; i < N; ++i) data[i] = text[i];
+    }
+    constexpr std::string_view view() const { return std::string_view(data, N - 1); }
+};
+
+namespace detail {
+    // Never defined: calling one while parsing makes the expression ill-formed and names the error
+    namespace error {
+        void unknownCharacter();
+        void expectedDigitAfterDecimalPoint();
+        void expectedSubscriptAfterUnderscore();
+        void expectedTerm();
+        void expectedRightParenthesis();
+        void negativeNumberOnRightSideOfOperator();
+        void unexpectedOperator();
+        void onlyNumbersAreSupported();
+        void expectedEndOfExpression();
+        void tooManyVariables();
+    }
+
+    enum class TokenKind { number, constant, variable, function, vectorFunction, plus, minus, multiply, divide, power, lParen, rParen, lBracket, rBracket, comma, equals, end };
+    enum class Op { number, variable, add, sub, mul, div, pow, sqrt, sin, cos, tan, asin, acos, atan, log, ln };
+
+    struct StaticToken {
+        TokenKind kind = TokenKind::end;
+        Op op = Op::number;             // of functions
+        std::string_view text;          // of numbers and variables
+        number_t value = 0;             // of numbers and constants
+        bool negative = false;          // the literal is spelled with a minus, like "-1" from a unary minus
+    };
+
+    struct StaticNode {
+        Op op = Op::number;
+        number_t value = 0;
+        bool negative = false;
+        // Parentheses hide the sign of a literal from the sign rule and the operator checks
+        bool parenthesized = false;
+        size_t variable = 0;
+        int lhs = -1;
+        int rhs = -1;
+    };
+
+    constexpr size_t maxVariables = 64;
+
+    // Every character yields at most one token, a unary minus and implicit multiplication add one each
+    template<size_t N>
+    struct StaticParse {
+        static constexpr size_t capacity = 3 * N + 2;
+
+        std::array<StaticToken, capacity> tokens{};
+        size_t tokenCount = 0;
+        std::array<StaticNode, capacity> nodes{};
+        int nodeCount = 0;
+        int root = -1;
+        std::array<std::string_view, maxVariables> variables{};
+        size_t variableCount = 0;
+        size_t pos = 0;
+
+        constexpr void lex(std::string_view src);
+        constexpr void implicitMultiplication();
+
+        constexpr int parseExpr(int minPrec);
+        constexpr int parseTerm();
+        constexpr int parseFunc();
+        constexpr bool isNegativeNumber(int node) const;
+
+        constexpr int add(StaticNode node) {
+            nodes[nodeCount] = node;
+            return nodeCount++;
+        }
+        constexpr const StaticToken& peek() const { return tokens[pos]; }
+        constexpr void insert(size_t index, StaticToken token) {
+            for (size_t i = tokenCount; i > index; --i) tokens[i] = tokens[i - 1];
+            tokens[index] = token;
+            ++tokenCount;
+        }
+    };
+
+    constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    constexpr bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+    constexpr bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+
+    // Same value as std::stod of the digits, which is how runtime literals are read
+    constexpr number_t parseNumber(std::string_view digits) {
+        uint64_t mantissa = 0;
+        int scale = 0, significant = 0;
+        bool fraction = false, exact = true;
+        for (char c : digits) {
+            if (!isDigit(c)) {
+                fraction = true;
+                continue;
+            }
+            if (significant < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(c - '0');
+                if (mantissa) ++significant;
+                if (fraction) ++scale;
+            }
+            else {
+                exact = exact && c == '0';
+                if (!fraction) --scale;
+            }
+        }
+
+        // Both operands exact in double and a single rounding, so the quotient is correctly rounded
+        if (exact && mantissa <= (uint64_t(1) << 53) && scale >= -22 && scale <= 22) {
+            double power = 1;
+            for (int i = 0; i < (scale < 0 ? -scale : scale); ++i) power *= 10;
+            return scale < 0 ? static_cast<double>(mantissa) * power : static_cast<double>(mantissa) / power;
+        }
+        number_t power = 1;
+        for (int i = 0; i < (scale < 0 ? -scale : scale); ++i) power *= 10;
+        return static_cast<double>(scale < 0 ? mantissa * power : mantissa / power);
+    }
+
+    template<size_t N>
+    constexpr void StaticParse<N>::lex(std::string_view src) {
+        constexpr std::pair<std::string_view, Op> functions[] = {
+            { "sqrt", Op::sqrt }, { "sin", Op::sin }, { "cos", Op::cos }, { "tan", Op::tan }, { "asin", Op::asin },
+            { "acos", Op::acos }, { "atan", Op::atan }, { "log", Op::log }, { "ln", Op::ln }
+        };
+        constexpr std::string_view vectorFunctions[] = { "sum", "mean", "stdev", "min", "max", "dot", "matmul" };
+        constexpr std::pair<std::string_view, number_t> namedConstants[] = {
+            { "pi", constants::pi }, { "e", constants::e }, { "phi", constants::phi }, { "tau", constants::tau }
+        };
+
+        int bracketDepth = 0;
+        size_t i = 0;
+        while (i < src.size()) {
+            char c = src[i];
+            StaticToken token;
+            if (isSpace(c)) {
+                ++i;
+                continue;
+            }
+            else if (isDigit(c)) {
+                size_t start = i;
+                while (i < src.size() && isDigit(src[i])) ++i;
+                bool decimalComma = bracketDepth == 0 && i + 1 < src.size() && src[i] == ',' && isDigit(src[i + 1]);
+                if (i < src.size() && (src[i] == '.' || decimalComma)) {
+                    ++i;
+                    if (i >= src.size() || !isDigit(src[i])) error::expectedDigitAfterDecimalPoint();
+                    while (i < src.size() && isDigit(src[i])) ++i;
+                }
+                token = StaticToken{ .kind = TokenKind::number, .text = src.substr(start, i - start), .value = parseNumber(src.substr(start, i - start)) };
+            }
+            else if (isAlpha(c)) {
+                std::string_view rest = src.substr(i);
+                auto startsWith = [&](std::string_view word) { return rest.substr(0, word.size()) == word; };
+
+                if (rest.size() > 1 && rest[1] == '_') {
+                    size_t length = 2;
+                    while (length < rest.size() && (isAlpha(rest[length]) || isDigit(rest[length]))) ++length;
+                    if (length == 2) error::expectedSubscriptAfterUnderscore();
+                    token = StaticToken{ .kind = TokenKind::variable, .text = rest.substr(0, length) };
+                }
+                else {
+                    token = StaticToken{ .kind = TokenKind::variable, .text = rest.substr(0, 1) };
+                    bool matched = false;
+                    for (auto [name, op] : functions) {
+                        if (!matched && startsWith(name)) {
+                            token = StaticToken{ .kind = TokenKind::function, .op = op, .text = name };
+                            matched = true;
+                        }
+                    }
+                    for (auto name : vectorFunctions) {
+                        if (!matched && startsWith(name)) {
+                            token = StaticToken{ .kind = TokenKind::vectorFunction, .text = name };
+                            matched = true;
+                        }
+                    }
+                    for (auto [name, value] : namedConstants) {
+                        if (!matched && startsWith(name)) {
+                            token = StaticToken{ .kind = TokenKind::constant, .text = name, .value = value };
+                            matched = true;
+                        }
+                    }
+                    if (!matched && startsWith("ans")) token.text = "ans";
+                }
+                i += token.text.size();
+            }
+            else {
+                ++i;
+                switch (c) {
+                    case '=': token.kind = TokenKind::equals; break;
+                    case '(': token.kind = TokenKind::lParen; break;
+                    case ')': token.kind = TokenKind::rParen; break;
+                    case '[': token.kind = TokenKind::lBracket; ++bracketDepth; break;
+                    case ']': token.kind = TokenKind::rBracket; --bracketDepth; break;
+                    case ',': token.kind = TokenKind::comma; break;
+                    case '+': token.kind = TokenKind::plus; break;
+                    case '-': token.kind = TokenKind::minus; break;
+                    case '*': token.kind = TokenKind::multiply; break;
+                    case '/': token.kind = TokenKind::divide; break;
+                    case '^': token.kind = TokenKind::power; break;
+                    default: error::unknownCharacter();
+                }
+            }
+            tokens[tokenCount++] = token;
+        }
+        tokens[tokenCount++] = StaticToken{ .kind = TokenKind::end };
+    }
+
+    // Same rewriting as Lexer::implicitMulConvert
+    template<size_t N>
+    constexpr void StaticParse<N>::implicitMultiplication() {
+        auto isValue = [](TokenKind kind) {
+            return kind == TokenKind::number || kind == TokenKind::constant || kind == TokenKind::variable || kind == TokenKind::rParen || kind == TokenKind::rBracket;
+        };
+        auto startsValue = [](TokenKind kind) {
+            return kind == TokenKind::variable || kind == TokenKind::number || kind == TokenKind::constant || kind == TokenKind::lParen || kind == TokenKind::lBracket;
+        };
+        constexpr StaticToken multiply{ .kind = TokenKind::multiply };
+
+        for (size_t i = 0; i + 1 < tokenCount; ) {
+            TokenKind curr = tokens[i].kind, next = tokens[i + 1].kind;
+            if (curr == TokenKind::minus && next != TokenKind::number && (i == 0 || !isValue(tokens[i - 1].kind))) {
+                tokens[i] = StaticToken{ .kind = TokenKind::number, .text = "-1", .value = -1, .negative = true };
+                insert(i + 1, multiply);
+                i += 2;
+            }
+            else if (isValue(curr) && (next == TokenKind::function || next == TokenKind::vectorFunction || startsValue(next))) {
+                insert(i + 1, multiply);
+                i += 2;
+            }
+            else ++i;
+        }
+    }
+
+    constexpr int precedence(TokenKind kind) {
+        switch (kind) {
+            case TokenKind::plus:
+            case TokenKind::minus:          return 1;
+            case TokenKind::multiply:
+            case TokenKind::divide:         return 2;
+            case TokenKind::power:
+            case TokenKind::function:
+            case TokenKind::vectorFunction: return 3;
+            default:                        return -1;
+        }
+    }
+
+    template<size_t N>
+    constexpr int StaticParse<N>::parseExpr(int minPrec) {
+        int lhs = peek().kind == TokenKind::function || peek().kind == TokenKind::vectorFunction ? parseFunc() : parseTerm();
+
+        while (true) {
+            int prec = precedence(peek().kind);
+            if (prec < 0 || prec < minPrec) break;
+
+            TokenKind kind = tokens[pos++].kind;
+            int rhs = parseExpr(prec + 1);
+
+            Op op = Op::add;
+            switch (kind) {
+                case TokenKind::plus:       op = Op::add; break;
+                case TokenKind::minus:      op = Op::sub; break;
+                case TokenKind::multiply:   op = Op::mul; break;
+                case TokenKind::divide:     op = Op::div; break;
+                case TokenKind::power:      op = Op::pow; break;
+                default:                    error::unexpectedOperator();
+            }
+            if (isNegativeNumber(rhs)) error::negativeNumberOnRightSideOfOperator();
+            lhs = add(StaticNode{ .op = op, .lhs = lhs, .rhs = rhs });
+        }
+        return lhs;
+    }
+
+    template<size_t N>
+    constexpr int StaticParse<N>::parseTerm() {
+        StaticToken token = tokens[pos];
+        if (token.kind == TokenKind::minus && tokens[pos + 1].kind == TokenKind::number) {
+            pos += 2;
+            return add(StaticNode{ .op = Op::number, .value = -tokens[pos - 1].value, .negative = true });
+        }
+
+        switch (token.kind) {
+            case TokenKind::number:
+            case TokenKind::constant:
+                ++pos;
+                return add(StaticNode{ .op = Op::number, .value = token.value, .negative = token.negative });
+            case TokenKind::variable: {
+                ++pos;
+                size_t index = 0;
+                while (index < variableCount && variables[index] != token.text) ++index;
+                if (index == variableCount) {
+                    if (variableCount == maxVariables) error::tooManyVariables();
+                    variables[variableCount++] = token.text;
+                }
+                return add(StaticNode{ .op = Op::variable, .variable = index });
+            }
+            case TokenKind::lParen: {
+                ++pos;
+                int expr = parseExpr(0);
+                if (peek().kind != TokenKind::rParen) error::expectedRightParenthesis();
+                ++pos;
+                nodes[expr].parenthesized = true;
+                return expr;
+            }
+            case TokenKind::lBracket:
+                error::onlyNumbersAreSupported();
+                return -1;
+            default:
+                error::expectedTerm();
+                return -1;
+        }
+    }
+
+    template<size_t N>
+    constexpr int StaticParse<N>::parseFunc() {
+        StaticToken token = tokens[pos++];
+        if (token.kind != TokenKind::function) error::onlyNumbersAreSupported();
+
+        return add(StaticNode{ .op = token.op, .lhs = parseTerm() });
+    }
+
+    template<size_t N>
+    constexpr bool StaticParse<N>::isNegativeNumber(int node) const {
+        const StaticNode& n = nodes[node];
+        if (n.parenthesized) return false;
+        if (n.op == Op::number) return n.negative;
+        if (n.op == Op::pow || n.op == Op::sqrt) return isNegativeNumber(n.lhs);
+        return false;
+    }
+
+    template<size_t N>
+    consteval StaticParse<N> parse(std::string_view src) {
+        StaticParse<N> result;
+        result.lex(src);
+        result.implicitMultiplication();
+        result.root = result.parseExpr(0);
+        if (result.peek().kind != TokenKind::end) error::expectedEndOfExpression();
+        return result;
+    }
+
+    template<FixedString S>
+    inline constexpr auto parsed = parse<sizeof(S.data)>(S.view());
+
+    constexpr number_t ipow(number_t base, int64_t exp) {
+        uint64_t n = exp < 0 ? 0 - static_cast<uint64_t>(exp) : static_cast<uint64_t>(exp);
+
+        number_t result = 1;
+        while (n) {
+            if (n & 1) result *= base;
+            n >>= 1;
+            if (n) base *= base;
+        }
+        return exp < 0 ? 1 / result : result;
+    }
+
+    // The runtime evaluators only see one operation at a time. Seeing the whole expression, -Ofast
+    // would divide by reciprocals of literals and regroup sums and products, which rounds differently.
+    constexpr number_t opaque(number_t value) {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+        // In place on top of the x87 stack, where long doubles are computed, so it costs nothing
+        if !consteval { asm("" : "+t"(value)); }
+#elif defined(__GNUC__)
+        if !consteval { asm("" : "+m"(value)); }
+#endif
+        return value;
+    }
+
+    // Expression template nodes. x holds the value of every variable.
+    template<number_t V, bool Negative>
+    struct Literal {
+        static constexpr bool negativeLiteral = Negative;
+        // Exponents that calculateExpr::power raises by repeated squaring
+        static constexpr bool smallInteger = V >= -64 && V <= 64 && V == static_cast<number_t>(static_cast<int64_t>(V));
+        static constexpr number_t value = V;
+
+        static constexpr number_t eval(const number_t*) { return opaque(V); }
+    };
+
+    template<size_t I>
+    struct Variable {
+        static constexpr bool negativeLiteral = false;
+        static constexpr bool smallInteger = false;
+
+        static constexpr number_t eval(const number_t* x) { return x[I]; }
+    };
+
+    template<Op O, typename L, typename R>
+    struct Binary {
+        static constexpr bool negativeLiteral = false;
+        static constexpr bool smallInteger = false;
+
+        static number_t eval(const number_t* x) {
+            if constexpr (O == Op::add) return opaque(L::eval(x) + R::eval(x));
+            else if constexpr (O == Op::sub) return opaque(L::eval(x) - R::eval(x));
+            else if constexpr (O == Op::mul) return opaque(L::eval(x) * R::eval(x));
+            else if constexpr (O == Op::div) return opaque(L::eval(x) / R::eval(x));
+            else if constexpr (R::smallInteger) {
+                // A literal integer exponent unrolls into multiplications
+                number_t base = L::eval(x);
+                if (L::negativeLiteral && base < 0) return -ipow(-base, static_cast<int64_t>(R::value));
+                return ipow(base, static_cast<int64_t>(R::value));
+            }
+            else return calculateExpr::power(L::eval(x), R::eval(x), L::negativeLiteral);
+        }
+    };
+
+    template<Op O, typename A>
+    struct Unary {
+        static constexpr bool negativeLiteral = false;
+        static constexpr bool smallInteger = false;
+
+        static number_t eval(const number_t* x) {
+            number_t a = A::eval(x);
+            if constexpr (O == Op::sqrt) return std::sqrt(a);
+            else if constexpr (O == Op::sin) return std::sin(a);
+            else if constexpr (O == Op::cos) return std::cos(a);
+            else if constexpr (O == Op::tan) return std::tan(a);
+            else if constexpr (O == Op::asin) return std::asin(a);
+            else if constexpr (O == Op::acos) return std::acos(a);
+            else if constexpr (O == Op::atan) return std::atan(a);
+            else if constexpr (O == Op::log) return std::log10(a);
+            else return std::log(a);
+        }
+    };
+
+    template<FixedString S, int I>
+    constexpr auto build() {
+        constexpr StaticNode node = parsed<S>.nodes[I];
+        if constexpr (node.op == Op::number) return Literal<node.value, node.negative && !node.parenthesized>{};
+        else if constexpr (node.op == Op::variable) return Variable<node.variable>{};
+        else if constexpr (node.rhs >= 0) return Binary<node.op, decltype(build<S, node.lhs>()), decltype(build<S, node.rhs>())>{};
+        else return Unary<node.op, decltype(build<S, node.lhs>())>{};
+    }
+}
+
+template<FixedString S>
+struct StaticExpr {
+    using Tree = decltype(detail::build<S, detail::parsed<S>.root>());
+
+    static constexpr size_t arity = detail::parsed<S>.variableCount;
+    // Names in order of first appearance, which is the order of the arguments
+    static constexpr auto variables = [] {
+        std::array<std::string_view, arity> names{};
+        for (size_t i = 0; i < arity; ++i) names[i] = detail::parsed<S>.variables[i];
+        return names;
+    }();
+
+    template<typename... Args>
+        requires (sizeof...(Args) == arity && (std::convertible_to<Args, number_t> && ...))
+    number_t operator()(Args... args) const {
+        const std::array<number_t, arity + 1> values{ static_cast<number_t>(args)... };
+        return Tree::eval(values.data());
+    }
+
+    number_t operator()(std::span<const number_t, arity> values) const { return Tree::eval(values.data()); }
+};
+
+template<FixedString S>
+inline constexpr StaticExpr<S> expr{};
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// The destructor finishes every queued task, so declare the pool after whatever its tasks read
+class ThreadPool {
+public:
+    // 0 threads means one per hardware thread
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    // Runs task on a worker and hands over its result, or the exception it threw, through the future
+    template<typename F>
+        requires (!std::is_void_v<std::invoke_result_t<F&>>)
+    std::future<std::invoke_result_t<F&>> submit(F task) {
+        auto promise = std::make_shared<std::promise<std::invoke_result_t<F&>>>();
+        auto future = promise->get_future();
+        submit(std::function<void()>([promise, task = std::move(task)]() mutable {
+            try {
+                promise->set_value(task());
+            }
+            catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        }));
+        return future;
+    }
+    size_t size() const { return m_workers.size(); }
+private:
+    void workerLoop();
+private:
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopping = false;
+};
+
+#endif
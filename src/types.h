@@ -1,11 +1,26 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <optional>
+#include <string_view>
+
 typedef long double number_t;
 
 namespace constants {
     constexpr int precision = 18; 
     constexpr number_t pi = 3.141592653589793238L; 
+    constexpr number_t e = 2.718281828459045235L;
+    constexpr number_t phi = 1.618033988749894848L;
+    constexpr number_t tau = 2 * pi;
+
+    // Value of a named constant as the lexer spells it
+    inline std::optional<number_t> value(std::string_view name) {
+        if (name == "pi") return pi;
+        if (name == "e") return e;
+        if (name == "phi") return phi;
+        if (name == "tau") return tau;
+        return std::nullopt;
+    }
 }
 
 #endif
\ No newline at end of file
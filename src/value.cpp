@@ -0,0 +1,204 @@
+#include "value.h"
+
+#include "functions.h"
+
+#include <cmath>
+
+namespace {
+// Tiles of the matrix product. Rows of a and of the transposed b are walked blockDepth elements at a
+// time, so a tile of each stays in L1 while it is reused, long double elements are 16 bytes.
+constexpr size_t blockDepth = 256;
+constexpr size_t blockRows = 64;
+constexpr size_t blockCols = 64;
+
+// c[i][j] += sum over p of a[i][p] bt[j][p] for p in [depthBegin, depthEnd) on one tile. A 2x2 block
+// of c is summed in registers, x87 has eight of them, so each loaded element is used twice.
+void multiplyTile(const number_t* a, const number_t* bt, number_t* c, size_t k, size_t m,
+                  size_t rowBegin, size_t rowEnd, size_t depthBegin, size_t depthEnd, size_t colBegin, size_t colEnd) {
+    size_t i = rowBegin;
+    for (; i + 2 <= rowEnd; i += 2) {
+        const number_t* a0 = a + i * k;
+        const number_t* a1 = a0 + k;
+        size_t j = colBegin;
+        for (; j + 2 <= colEnd; j += 2) {
+            const number_t* b0 = bt + j * k;
+            const number_t* b1 = b0 + k;
+            number_t s00 = 0, s01 = 0, s10 = 0, s11 = 0;
+            for (size_t p = depthBegin; p < depthEnd; ++p) {
+                number_t x0 = a0[p], x1 = a1[p], y0 = b0[p], y1 = b1[p];
+                s00 += x0 * y0;
+                s01 += x0 * y1;
+                s10 += x1 * y0;
+                s11 += x1 * y1;
+            }
+            c[i * m + j] += s00;
+            c[i * m + j + 1] += s01;
+            c[(i + 1) * m + j] += s10;
+            c[(i + 1) * m + j + 1] += s11;
+        }
+        for (; j < colEnd; ++j) {
+            const number_t* b0 = bt + j * k;
+            number_t s0 = 0, s1 = 0;
+            for (size_t p = depthBegin; p < depthEnd; ++p) {
+                s0 += a0[p] * b0[p];
+                s1 += a1[p] * b0[p];
+            }
+            c[i * m + j] += s0;
+            c[(i + 1) * m + j] += s1;
+        }
+    }
+    for (; i < rowEnd; ++i) {
+        const number_t* a0 = a + i * k;
+        for (size_t j = colBegin; j < colEnd; ++j) {
+            const number_t* b0 = bt + j * k;
+            number_t s = 0;
+            for (size_t p = depthBegin; p < depthEnd; ++p) s += a0[p] * b0[p];
+            c[i * m + j] += s;
+        }
+    }
+}
+}
+
+Value Value::vector(std::vector<number_t> elements) {
+    if (elements.empty()) throw std::runtime_error("Vectors need at least one element");
+
+    size_t size = elements.size();
+    return Value(1, 1, size, std::move(elements));
+}
+
+Value Value::matrix(size_t rows, size_t cols, std::vector<number_t> elements) {
+    if (rows == 0 || cols == 0) throw std::runtime_error("Matrices need at least one element");
+    if (elements.size() != rows * cols) throw std::runtime_error("Matrix elements do not match its shape");
+
+    return Value(2, rows, cols, std::move(elements));
+}
+
+number_t Value::scalar() const {
+    if (!isScalar()) throw std::runtime_error("Expected a number but got a value of shape " + shapeString());
+    return m_elements[0];
+}
+
+std::string Value::shapeString() const {
+    if (m_rank == 0) return "[]";
+    if (m_rank == 1) return "[" + std::to_string(m_cols) + "]";
+    return "[" + std::to_string(m_rows) + ", " + std::to_string(m_cols) + "]";
+}
+
+std::string Value::toString() const {
+    if (isScalar()) return formatNumber(m_elements[0]);
+
+    std::string result = m_rank == 2 ? "[" : "";
+    for (size_t i = 0; i < m_rows; ++i) {
+        if (i) result += ", ";
+        result += "[";
+        for (size_t j = 0; j < m_cols; ++j) {
+            if (j) result += ", ";
+            result += formatNumber((*this)(i, j));
+        }
+        result += "]";
+    }
+    return m_rank == 2 ? result + "]" : result;
+}
+
+Value Value::operator-() const {
+    return map([](number_t x) { return -x; });
+}
+
+Value Value::operator+(const Value& other) const {
+    return broadcast(*this, other, [](number_t x, number_t y) { return x + y; });
+}
+
+Value Value::operator-(const Value& other) const {
+    return broadcast(*this, other, [](number_t x, number_t y) { return x - y; });
+}
+
+Value Value::operator*(const Value& other) const {
+    return broadcast(*this, other, [](number_t x, number_t y) { return x * y; });
+}
+
+Value Value::operator/(const Value& other) const {
+    return broadcast(*this, other, [](number_t x, number_t y) { return x / y; });
+}
+
+number_t Value::dot(const Value& a, const Value& b) {
+    if (a.m_rank != 1 || b.m_rank != 1 || a.size() != b.size()) {
+        throw std::runtime_error("dot needs two vectors of the same length, got " + a.shapeString() + " and " + b.shapeString());
+    }
+
+    // Independent sums so consecutive additions do not wait on each other
+    const number_t* x = a.m_elements.data();
+    const number_t* y = b.m_elements.data();
+    number_t sums[4] = {};
+    size_t i = 0;
+    for (; i + 4 <= a.size(); i += 4) {
+        sums[0] += x[i] * y[i];
+        sums[1] += x[i + 1] * y[i + 1];
+        sums[2] += x[i + 2] * y[i + 2];
+        sums[3] += x[i + 3] * y[i + 3];
+    }
+    for (; i < a.size(); ++i) sums[0] += x[i] * y[i];
+
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+Value Value::matmul(const Value& a, const Value& b) {
+    if (a.isScalar() || b.isScalar()) throw std::runtime_error("matmul needs vectors or matrices, use * for scalars");
+
+    // A vector is a row on the left and a column on the right, the rows of a are m_rows either way
+    size_t n = a.m_rows, k = a.m_cols;
+    size_t depth = b.m_rank == 1 ? b.m_cols : b.m_rows, m = b.m_rank == 1 ? 1 : b.m_cols;
+    if (k != depth) throw std::runtime_error("Shapes " + a.shapeString() + " and " + b.shapeString() + " cannot be multiplied");
+    if (a.m_rank == 1 && b.m_rank == 1) return dot(a, b);
+
+    // b is packed transposed once, then both operands are read along contiguous rows
+    std::vector<number_t> bt(k * m);
+    for (size_t p = 0; p < k; ++p) {
+        for (size_t j = 0; j < m; ++j) bt[j * k + p] = b.m_elements[p * m + j];
+    }
+
+    std::vector<number_t> c(n * m, 0);
+    for (size_t p0 = 0; p0 < k; p0 += blockDepth) {
+        for (size_t i0 = 0; i0 < n; i0 += blockRows) {
+            for (size_t j0 = 0; j0 < m; j0 += blockCols) {
+                multiplyTile(a.m_elements.data(), bt.data(), c.data(), k, m,
+                             i0, std::min(i0 + blockRows, n), p0, std::min(p0 + blockDepth, k), j0, std::min(j0 + blockCols, m));
+            }
+        }
+    }
+
+    if (a.m_rank == 1 || b.m_rank == 1) return vector(std::move(c));
+    return matrix(n, m, std::move(c));
+}
+
+number_t Value::sum() const {
+    number_t sum = 0;
+    for (number_t x : m_elements) sum += x;
+    return sum;
+}
+
+number_t Value::mean() const {
+    return sum() / static_cast<number_t>(size());
+}
+
+number_t Value::stdev() const {
+    if (size() < 2) throw std::runtime_error("stdev needs at least two values");
+
+    // Welford's update, a running mean avoids the cancellation of sum(x^2) - n mean^2
+    number_t mean = 0, squares = 0;
+    size_t count = 0;
+    for (number_t x : m_elements) {
+        ++count;
+        number_t delta = x - mean;
+        mean += delta / static_cast<number_t>(count);
+        squares += delta * (x - mean);
+    }
+    return std::sqrt(squares / static_cast<number_t>(count - 1));
+}
+
+number_t Value::min() const {
+    return *std::min_element(m_elements.begin(), m_elements.end());
+}
+
+number_t Value::max() const {
+    return *std::max_element(m_elements.begin(), m_elements.end());
+}
@@ -0,0 +1,120 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include "types.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Scalar, vector or matrix of numbers. Elements are stored row by row in one block, a vector is a
+// single row and a scalar a single element, so every rank shares the same kernels.
+class Value {
+public:
+    Value(number_t scalar = 0) : m_elements{ scalar } {}
+
+    static Value vector(std::vector<number_t> elements);
+    static Value matrix(size_t rows, size_t cols, std::vector<number_t> elements);
+
+    // 0 for scalars, 1 for vectors, 2 for matrices
+    int rank() const { return m_rank; }
+    bool isScalar() const { return m_rank == 0; }
+    size_t rows() const { return m_rows; }
+    size_t cols() const { return m_cols; }
+    size_t size() const { return m_elements.size(); }
+    std::span<const number_t> elements() const { return m_elements; }
+    number_t operator()(size_t row, size_t col) const { return m_elements[row * m_cols + col]; }
+
+    // Throws unless the value is a scalar
+    number_t scalar() const;
+    // "[3]" or "[2, 3]", used in error messages
+    std::string shapeString() const;
+    std::string toString() const;
+
+    // Element-wise with broadcasting: dimensions must match or be 1, a vector counts as a single row
+    template<typename F>
+    static Value broadcast(const Value& a, const Value& b, F&& op);
+    template<typename F>
+    Value map(F&& op) const;
+
+    Value operator-() const;
+    Value operator+(const Value& other) const;
+    Value operator-(const Value& other) const;
+    Value operator*(const Value& other) const;
+    Value operator/(const Value& other) const;
+
+    // Inner product of two vectors of the same length
+    static number_t dot(const Value& a, const Value& b);
+    // Matrix product, a vector on the left is a row and on the right a column
+    static Value matmul(const Value& a, const Value& b);
+
+    // Reductions over all elements
+    number_t sum() const;
+    number_t mean() const;
+    // Sample standard deviation, needs at least two elements
+    number_t stdev() const;
+    number_t min() const;
+    number_t max() const;
+private:
+    Value(int rank, size_t rows, size_t cols, std::vector<number_t> elements)
+        : m_elements(std::move(elements)), m_rows(rows), m_cols(cols), m_rank(rank) {}
+private:
+    std::vector<number_t> m_elements;
+    size_t m_rows = 1;
+    size_t m_cols = 1;
+    int m_rank = 0;
+};
+
+template<typename F>
+Value Value::broadcast(const Value& a, const Value& b, F&& op) {
+    // The common shapes are plain loops over contiguous memory, which the compiler vectorizes
+    if (b.isScalar()) {
+        Value result = a;
+        number_t y = b.m_elements[0];
+        for (number_t& x : result.m_elements) x = op(x, y);
+        return result;
+    }
+    if (a.isScalar()) {
+        Value result = b;
+        number_t x = a.m_elements[0];
+        for (number_t& y : result.m_elements) y = op(x, y);
+        return result;
+    }
+
+    size_t rows = a.m_rows == b.m_rows || b.m_rows == 1 ? a.m_rows : a.m_rows == 1 ? b.m_rows : 0;
+    size_t cols = a.m_cols == b.m_cols || b.m_cols == 1 ? a.m_cols : a.m_cols == 1 ? b.m_cols : 0;
+    if (rows == 0 || cols == 0) throw std::runtime_error("Shapes " + a.shapeString() + " and " + b.shapeString() + " do not match");
+
+    Value result(std::max(a.m_rank, b.m_rank), rows, cols, std::vector<number_t>(rows * cols));
+    const number_t* x = a.m_elements.data();
+    const number_t* y = b.m_elements.data();
+    number_t* out = result.m_elements.data();
+    if (a.m_rows == b.m_rows && a.m_cols == b.m_cols) {
+        for (size_t i = 0; i < rows * cols; ++i) out[i] = op(x[i], y[i]);
+        return result;
+    }
+
+    // A dimension of size 1 is repeated by not advancing along it
+    size_t rowStepA = a.m_rows == 1 ? 0 : a.m_cols, rowStepB = b.m_rows == 1 ? 0 : b.m_cols;
+    size_t colStepA = a.m_cols == 1 ? 0 : 1, colStepB = b.m_cols == 1 ? 0 : 1;
+    for (size_t i = 0; i < rows; ++i, out += cols) {
+        const number_t* rowA = x + i * rowStepA;
+        const number_t* rowB = y + i * rowStepB;
+        for (size_t j = 0; j < cols; ++j) out[j] = op(rowA[j * colStepA], rowB[j * colStepB]);
+    }
+    return result;
+}
+
+template<typename F>
+Value Value::map(F&& op) const {
+    Value result = *this;
+    for (number_t& x : result.m_elements) x = op(x);
+    return result;
+}
+
+#endif